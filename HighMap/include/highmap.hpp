@@ -13,6 +13,8 @@
 
 #include "highmap/algebra.hpp"
 #include "highmap/array.hpp"
+#include "highmap/array_expr.hpp"
+#include "highmap/array_file.hpp"
 #include "highmap/authoring.hpp"
 #include "highmap/blending.hpp"
 #include "highmap/boundary.hpp"
@@ -55,4 +57,6 @@
 #include "highmap/shortest_path.hpp"
 #include "highmap/synthesis.hpp"
 #include "highmap/tensor.hpp"
+#include "highmap/thread_pool.hpp"
+#include "highmap/tile_cache.hpp"
 #include "highmap/transform.hpp"
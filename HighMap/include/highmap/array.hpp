@@ -23,6 +23,9 @@ typedef unsigned int uint;
 namespace hmap
 {
 
+// --- forward declarations
+template <class E> struct ArrayExpr;
+
 /**
  * @brief Array class, helper to manipulate 2D float array with "(i, j)"
  * indexing.
@@ -64,6 +67,15 @@ public:
 
   Array(const std::string &filename); ///< @overload
 
+  /**
+   * @brief Constructs a new Array object by evaluating a lazy expression (see
+   * array_expr.hpp).
+   *
+   * @tparam E    Expression type.
+   * @param  expr Expression.
+   */
+  template <class E> Array(const ArrayExpr<E> &expr);
+
   //----------------------------------------
   // overload
   //----------------------------------------
@@ -76,6 +88,28 @@ public:
    */
   Array &operator=(const float value);
 
+  /**
+   * @brief Overloads the assignment operators for lazy expressions, which are
+   * evaluated in a single pass without temporary array (see array_expr.hpp).
+   *
+   * @tparam E    Expression type.
+   * @param  expr Expression.
+   * @return      Array& Reference to the current object.
+   */
+  template <class E> Array &operator=(const ArrayExpr<E> &expr);
+
+  template <class E>
+  Array &operator*=(const ArrayExpr<E> &expr); ///< @overload
+
+  template <class E>
+  Array &operator/=(const ArrayExpr<E> &expr); ///< @overload
+
+  template <class E>
+  Array &operator+=(const ArrayExpr<E> &expr); ///< @overload
+
+  template <class E>
+  Array &operator-=(const ArrayExpr<E> &expr); ///< @overload
+
   /**
    * @brief Overloads the multiplication-assignment operator for scalar
    * multiplication.
@@ -0,0 +1,357 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file array_expr.hpp
+ * @author Otto Link (otto.link.bv@gmail.com)
+ * @brief Lazy evaluation of element-wise array arithmetic (expression
+ * templates).
+ *
+ * The `Array` operators are evaluated eagerly, each of them allocating and
+ * filling a full temporary array. Wrapping an operand with `lazy` builds
+ * instead an expression tree that is evaluated in a single (multi-threaded for
+ * large arrays) pass when it is assigned to an `Array`:
+ *
+ * @code
+ * // one pass, no temporary array
+ * Array c = -2.f * (lazy(t) * p * p + lazy(r) * q * q + lazy(s) * p * q) /
+ *           (lazy(p) * p + q * q + 1e-30f);
+ * @endcode
+ *
+ * Expressions only store references to the arrays they use: they must be
+ * assigned within the same statement (avoid storing them with `auto`) and the
+ * arrays must all have the same shape (checked by assertions in debug
+ * builds). Since the evaluation is element-wise, an array can be assigned an
+ * expression that uses the array itself.
+ *
+ * @copyright Copyright (c) 2023 Otto Link
+ */
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+
+#include "highmap/array.hpp"
+#include "highmap/thread_pool.hpp"
+
+// number of cells of the blocks evaluated concurrently
+#define HMAP_ARRAY_EXPR_BLOCK_SIZE 65536
+
+// expressions are evaluated in the calling thread below this number of cells
+#define HMAP_ARRAY_EXPR_PARALLEL_SIZE 262144
+
+namespace hmap
+{
+
+/**
+ * @brief Base class of the expression nodes (CRTP). Nodes provide the
+ * expression shape (`get_shape`) and the value of a given cell (`operator[]`,
+ * linear index).
+ *
+ * @tparam E Node type.
+ */
+template <class E> struct ArrayExpr
+{
+  const E &self() const
+  {
+    return static_cast<const E &>(*this);
+  }
+};
+
+/**
+ * @brief Leaf node, reference to the data of an existing array.
+ */
+struct ArrayExprRef : public ArrayExpr<ArrayExprRef>
+{
+  static constexpr bool is_scalar = false;
+
+  const float *data;
+  Vec2<int>    shape;
+
+  ArrayExprRef(const Array &array)
+      : data(array.vector.data()), shape(array.shape)
+  {
+  }
+
+  Vec2<int> get_shape() const
+  {
+    return this->shape;
+  }
+
+  float operator[](size_t k) const
+  {
+    return this->data[k];
+  }
+};
+
+/**
+ * @brief Leaf node, scalar value.
+ */
+struct ArrayExprScalar : public ArrayExpr<ArrayExprScalar>
+{
+  static constexpr bool is_scalar = true;
+
+  float value;
+
+  ArrayExprScalar(float value) : value(value)
+  {
+  }
+
+  Vec2<int> get_shape() const
+  {
+    return Vec2<int>(0, 0);
+  }
+
+  float operator[](size_t) const
+  {
+    return this->value;
+  }
+};
+
+/**
+ * @brief Unary operation node.
+ *
+ * @tparam Op Operation, `float(float)`.
+ * @tparam E  Operand node type.
+ */
+template <class Op, class E>
+struct ArrayExprUnary : public ArrayExpr<ArrayExprUnary<Op, E>>
+{
+  static constexpr bool is_scalar = E::is_scalar;
+
+  Op op;
+  E  e;
+
+  ArrayExprUnary(Op op, const E &e) : op(op), e(e)
+  {
+  }
+
+  Vec2<int> get_shape() const
+  {
+    return this->e.get_shape();
+  }
+
+  float operator[](size_t k) const
+  {
+    return this->op(this->e[k]);
+  }
+};
+
+/**
+ * @brief Binary operation node.
+ *
+ * @tparam Op Operation, `float(float, float)`.
+ * @tparam L  Left operand node type.
+ * @tparam R  Right operand node type.
+ */
+template <class Op, class L, class R>
+struct ArrayExprBinary : public ArrayExpr<ArrayExprBinary<Op, L, R>>
+{
+  static constexpr bool is_scalar = L::is_scalar && R::is_scalar;
+
+  Op op;
+  L  l;
+  R  r;
+
+  ArrayExprBinary(Op op, const L &l, const R &r) : op(op), l(l), r(r)
+  {
+    // operands must have the same shape (checked in debug builds only)
+    if constexpr (!L::is_scalar && !R::is_scalar)
+      assert(l.get_shape() == r.get_shape());
+  }
+
+  Vec2<int> get_shape() const
+  {
+    if constexpr (L::is_scalar)
+      return this->r.get_shape();
+    else
+      return this->l.get_shape();
+  }
+
+  float operator[](size_t k) const
+  {
+    return this->op(this->l[k], this->r[k]);
+  }
+};
+
+/**
+ * @brief Return a lazy expression referencing an array, to start an
+ * expression that will be evaluated in a single pass.
+ *
+ * @param  array Input array.
+ * @return       ArrayExprRef Expression.
+ */
+inline ArrayExprRef lazy(const Array &array)
+{
+  return ArrayExprRef(array);
+}
+
+/**
+ * @brief Evaluate an expression into an array with the same shape.
+ *
+ * @param array Output array.
+ * @param expr  Expression.
+ */
+template <class E> void eval_expr(Array &array, const ArrayExpr<E> &expr)
+{
+  const E &e = expr.self();
+  float   *p_out = array.vector.data();
+  size_t   size = array.vector.size();
+
+  assert(array.shape == e.get_shape());
+
+  auto lambda = [&e, p_out, size](size_t b)
+  {
+    size_t k1 = b * HMAP_ARRAY_EXPR_BLOCK_SIZE;
+    size_t k2 = std::min(size, k1 + HMAP_ARRAY_EXPR_BLOCK_SIZE);
+
+    for (size_t k = k1; k < k2; k++)
+      p_out[k] = e[k];
+  };
+
+  if (size < HMAP_ARRAY_EXPR_PARALLEL_SIZE)
+  {
+    for (size_t k = 0; k < size; k++)
+      p_out[k] = e[k];
+  }
+  else
+  {
+    size_t nblocks = (size + HMAP_ARRAY_EXPR_BLOCK_SIZE - 1) /
+                     HMAP_ARRAY_EXPR_BLOCK_SIZE;
+    parallel_for(nblocks, lambda);
+  }
+}
+
+// --- Array members working with expressions
+
+template <class E>
+Array::Array(const ArrayExpr<E> &expr) : Array(expr.self().get_shape())
+{
+  eval_expr(*this, expr);
+}
+
+template <class E> Array &Array::operator=(const ArrayExpr<E> &expr)
+{
+  if (this->shape == expr.self().get_shape())
+    eval_expr(*this, expr);
+  else
+    *this = Array(expr); // the expression may use the current data
+  return *this;
+}
+
+template <class E> Array &Array::operator*=(const ArrayExpr<E> &expr)
+{
+  return *this = ArrayExprBinary(std::multiplies<>(), lazy(*this), expr.self());
+}
+
+template <class E> Array &Array::operator/=(const ArrayExpr<E> &expr)
+{
+  return *this = ArrayExprBinary(std::divides<>(), lazy(*this), expr.self());
+}
+
+template <class E> Array &Array::operator+=(const ArrayExpr<E> &expr)
+{
+  return *this = ArrayExprBinary(std::plus<>(), lazy(*this), expr.self());
+}
+
+template <class E> Array &Array::operator-=(const ArrayExpr<E> &expr)
+{
+  return *this = ArrayExprBinary(std::minus<>(), lazy(*this), expr.self());
+}
+
+// --- operators, at least one of the operands is an expression
+
+#define HMAP_ARRAY_EXPR_OPERATOR(OP, FCT)                                      \
+  template <class L, class R>                                                  \
+  auto OP(const ArrayExpr<L> &l, const ArrayExpr<R> &r)                        \
+  {                                                                            \
+    return ArrayExprBinary(FCT(), l.self(), r.self());                         \
+  }                                                                            \
+                                                                               \
+  template <class L> auto OP(const ArrayExpr<L> &l, const Array &r)            \
+  {                                                                            \
+    return ArrayExprBinary(FCT(), l.self(), ArrayExprRef(r));                  \
+  }                                                                            \
+                                                                               \
+  template <class R> auto OP(const Array &l, const ArrayExpr<R> &r)            \
+  {                                                                            \
+    return ArrayExprBinary(FCT(), ArrayExprRef(l), r.self());                  \
+  }                                                                            \
+                                                                               \
+  template <class L> auto OP(const ArrayExpr<L> &l, float r)                   \
+  {                                                                            \
+    return ArrayExprBinary(FCT(), l.self(), ArrayExprScalar(r));               \
+  }                                                                            \
+                                                                               \
+  template <class R> auto OP(float l, const ArrayExpr<R> &r)                   \
+  {                                                                            \
+    return ArrayExprBinary(FCT(), ArrayExprScalar(l), r.self());               \
+  }
+
+HMAP_ARRAY_EXPR_OPERATOR(operator+, std::plus<>)
+HMAP_ARRAY_EXPR_OPERATOR(operator-, std::minus<>)
+HMAP_ARRAY_EXPR_OPERATOR(operator*, std::multiplies<>)
+HMAP_ARRAY_EXPR_OPERATOR(operator/, std::divides<>)
+
+#undef HMAP_ARRAY_EXPR_OPERATOR
+
+template <class E> auto operator-(const ArrayExpr<E> &e)
+{
+  return ArrayExprUnary(std::negate<>(), e.self());
+}
+
+// --- functions
+
+/**
+ * @brief Lazy version of `abs`.
+ */
+template <class E> auto abs(const ArrayExpr<E> &e)
+{
+  return ArrayExprUnary([](float v) { return std::abs(v); }, e.self());
+}
+
+/**
+ * @brief Lazy version of `exp`.
+ */
+template <class E> auto exp(const ArrayExpr<E> &e)
+{
+  return ArrayExprUnary([](float v) { return std::exp(v); }, e.self());
+}
+
+/**
+ * @brief Lazy version of `lerp`, `(1 - t) * e1 + t * e2`.
+ */
+template <class E1, class E2, class T>
+auto lerp(const ArrayExpr<E1> &e1,
+          const ArrayExpr<E2> &e2,
+          const ArrayExpr<T>  &t)
+{
+  return e1 * (1.f - t) + e2 * t;
+}
+
+template <class E1, class E2>
+auto lerp(const ArrayExpr<E1> &e1, const ArrayExpr<E2> &e2, float t)
+{
+  return e1 * (1.f - t) + e2 * t;
+}
+
+/**
+ * @brief Lazy version of `pow`.
+ */
+template <class E> auto pow(const ArrayExpr<E> &e, float exp)
+{
+  return ArrayExprUnary([exp](float v) { return std::pow(v, exp); },
+                        e.self());
+}
+
+/**
+ * @brief Lazy version of `sqrt`.
+ */
+template <class E> auto sqrt(const ArrayExpr<E> &e)
+{
+  return ArrayExprUnary([](float v) { return std::sqrt(v); }, e.self());
+}
+
+} // namespace hmap
@@ -0,0 +1,208 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file array_file.hpp
+ * @author Otto Link (otto.link.bv@gmail.com)
+ * @brief Native, self-describing array file format, with tiled storage, tile
+ * compression and memory-mapped read access.
+ *
+ * File layout (native byte order, i.e. little-endian on all supported
+ * platforms):
+ * - header (64 bytes): magic `HMAPARR`, version, data type, array shape,
+ *   tiling, bounding box and value range (16-bit data),
+ * - tile table: offset, size and codec of each tile,
+ * - tile data, in row-major order within each tile, each tile starting on a
+ *   64-byte boundary.
+ *
+ * Tiles can be read independently of each other, and uncompressed 32-bit
+ * tiles can be accessed without any copy through the memory mapping of the
+ * file.
+ *
+ * @copyright Copyright (c) 2023 Otto Link
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "highmap/array.hpp"
+
+#define HMAP_ARRAY_FILE_VERSION 1
+
+namespace hmap
+{
+
+/**
+ * @brief Data type of the values stored in an array file.
+ */
+enum ArrayFileDtype : uint32_t
+{
+  DTYPE_FLOAT32, ///< 32-bit floats, values are stored as they are.
+  DTYPE_UINT16,  ///< 16-bit unsigned integers, values are quantized over the
+                 ///< array range.
+};
+
+/**
+ * @brief Tile codec of an array file.
+ */
+enum ArrayFileCodec : uint32_t
+{
+  CODEC_RAW,           ///< No compression.
+  CODEC_DELTA_BITPACK, ///< Differences with the previous value (row-wise)
+                       ///< packed on the smallest number of bits, per block of
+                       ///< 128 values (lossless, 16-bit data only).
+};
+
+/**
+ * @brief Read-only view of a 2D array stored in an external buffer (no data
+ * ownership).
+ */
+struct ArrayView
+{
+  Vec2<int>    shape = {0, 0}; ///< View shape.
+  const float *data = nullptr; ///< Data, with the same layout as `Array`.
+
+  /**
+   * @brief Return the value of a cell.
+   *
+   * @param  i Cell index along x.
+   * @param  j Cell index along y.
+   * @return   float Value.
+   */
+  float operator()(int i, int j) const
+  {
+    return this->data[j * this->shape.x + i];
+  }
+
+  /**
+   * @brief Return a copy of the view data.
+   *
+   * @return Array Array.
+   */
+  Array to_array() const;
+};
+
+/**
+ * @brief Write an array to a native array file.
+ *
+ * The array is split in `tiling.x * tiling.y` tiles (the last tiles of each
+ * row / column may be smaller). Tiles are encoded concurrently and written in
+ * bulk.
+ *
+ * @param  fname  File name.
+ * @param  array  Input array.
+ * @param  tiling Tiling.
+ * @param  dtype  Data type.
+ * @param  codec  Tile codec (`CODEC_DELTA_BITPACK` requires 16-bit data).
+ * @param  bbox   Domain bounding box, stored in the header.
+ * @return        True if the file has been written.
+ */
+bool write_array_file(const std::string &fname,
+                      const Array       &array,
+                      Vec2<int>          tiling = {1, 1},
+                      ArrayFileDtype     dtype = ArrayFileDtype::DTYPE_FLOAT32,
+                      ArrayFileCodec     codec = ArrayFileCodec::CODEC_RAW,
+                      Vec4<float>        bbox = {0.f, 1.f, 0.f, 1.f});
+
+/**
+ * @brief Read access to a native array file (see `write_array_file`).
+ *
+ * The file is memory-mapped (read from disk on demand by the operating
+ * system), so that reading a single tile of a large file does not read the
+ * rest of the file.
+ */
+class ArrayFile
+{
+public:
+  /**
+   * @brief Open an array file.
+   *
+   * @param fname File name.
+   */
+  ArrayFile(const std::string &fname);
+
+  ArrayFile(const ArrayFile &) = delete;
+
+  ArrayFile &operator=(const ArrayFile &) = delete;
+
+  ~ArrayFile();
+
+  /**
+   * @brief Return whether the file has been opened and has a valid header.
+   */
+  bool is_open() const;
+
+  Vec4<float>    get_bbox() const;   ///< Domain bounding box.
+  ArrayFileDtype get_dtype() const;  ///< Data type.
+  Vec2<int>      get_shape() const;  ///< Array shape.
+  Vec2<int>      get_tiling() const; ///< Tiling.
+
+  /**
+   * @brief Return the index extent {i1, i2, j1, j2} of a tile within the
+   * array (upper bounds excluded).
+   *
+   * @param  it Tile index along x.
+   * @param  jt Tile index along y.
+   * @return    Vec4<int> Extent.
+   */
+  Vec4<int> get_tile_extent(int it, int jt) const;
+
+  /**
+   * @brief Read the whole array (tiles are decoded concurrently).
+   *
+   * @return Array Array, empty if the file is not open or a tile is
+   * corrupted.
+   */
+  Array read() const;
+
+  /**
+   * @brief Read a single tile.
+   *
+   * @param  it Tile index along x.
+   * @param  jt Tile index along y.
+   * @return    Array Tile data, empty if the tile indices are out of the tile
+   *            table or the tile is corrupted.
+   */
+  Array read_tile(int it, int jt) const;
+
+  /**
+   * @brief Return a view of a tile without any copy, only available for
+   * uncompressed 32-bit data (otherwise, or if the tile indices are out of
+   * the tile table, the view is empty).
+   *
+   * @param  it Tile index along x.
+   * @param  jt Tile index along y.
+   * @return    ArrayView Tile view, valid as long as the file is open.
+   */
+  ArrayView view_tile(int it, int jt) const;
+
+private:
+  struct TileEntry
+  {
+    uint64_t       offset;
+    uint64_t       size;
+    ArrayFileCodec codec;
+  };
+
+  Vec2<int>      shape = {0, 0};
+  Vec2<int>      tiling = {0, 0};
+  Vec4<float>    bbox;
+  ArrayFileDtype dtype = ArrayFileDtype::DTYPE_FLOAT32;
+  Vec2<float>    range; ///< Value range for 16-bit data.
+
+  std::vector<TileEntry> tiles = {};
+
+  const char       *data = nullptr; ///< File content.
+  size_t            size = 0;       ///< File size.
+  std::vector<char> buffer = {};    ///< File content if it is not mapped.
+
+  void close();
+
+  bool decode_tile(int it, int jt, Array &array, Vec2<int> origin) const;
+
+  bool is_tile_valid(int it, int jt) const;
+};
+
+} // namespace hmap
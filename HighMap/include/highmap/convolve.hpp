@@ -10,8 +10,8 @@
  * This header file defines functions for performing convolution operations on
  * 1D and 2D arrays using various kernels. The operations include 1D
  * convolutions along different directions, 2D convolutions with symmetry
- * boundary conditions, truncated 2D convolutions, and approximate convolutions
- * using Singular Value Decomposition (SVD).
+ * boundary conditions, truncated 2D convolutions, FFT-based convolutions, and
+ * approximate convolutions using Singular Value Decomposition (SVD).
  *
  * @copyright Copyright (c) 2023 Otto Link
  */
@@ -66,6 +66,17 @@ Array convolve1d_i(const Array &array, const std::vector<float> &kernel);
  */
 Array convolve1d_j(const Array &array, const std::vector<float> &kernel);
 
+/**
+ * @brief Method used to compute 2D convolutions, see {@link convolve2d}.
+ */
+enum ConvolutionMethod : int
+{
+  CONVOLUTION_AUTO,      ///< Cheapest method based on a cost model
+  CONVOLUTION_DIRECT,    ///< Direct summation, O(kernel size) per cell
+  CONVOLUTION_SEPARABLE, ///< Sum of separable 1D convolutions (exact SVD rank)
+  CONVOLUTION_FFT,       ///< FFT products, with tiled overlap-save
+};
+
 /**
  * @brief Return the convolution product of the array with a given 2D kernel.
  *
@@ -73,14 +84,51 @@ Array convolve1d_j(const Array &array, const std::vector<float> &kernel);
  * specified 2D kernel. The output array has the same shape as the input array,
  * and symmetry boundary conditions are used.
  *
- * @param  array  Input array to be convolved.
- * @param  kernel 2D kernel to be used for the convolution.
- * @return        Array Resulting array after applying the 2D convolution.
+ * All the methods give the same result (up to round-off errors). With
+ * `CONVOLUTION_AUTO`, the method is chosen from the kernel size, the kernel
+ * numerical rank (a kernel of rank `r` is a sum of `r` separable kernels) and
+ * the array shape, by comparing the estimated cost per cell of each method.
+ *
+ * @param  array       Input array to be convolved.
+ * @param  kernel      2D kernel to be used for the convolution.
+ * @param  method      Convolution method.
+ * @param  kernel_rank Kernel numerical rank (see {@link convolve2d_svd_rank}),
+ *                     computed (SVD decomposition of the kernel) if negative
+ *                     and needed. Should be provided when the same kernel is
+ *                     used repeatedly.
+ * @return             Array Resulting array after applying the 2D convolution.
  *
  * **Example**
  * @include ex_convolve2d_svd.cpp
+ *
+ * @see                {@link convolve2d_fft}, {@link convolve2d_svd}
  */
-Array convolve2d(const Array &array, const Array &kernel);
+Array convolve2d(const Array      &array,
+                 const Array      &kernel,
+                 ConvolutionMethod method = CONVOLUTION_AUTO,
+                 int               kernel_rank = -1);
+
+/**
+ * @brief Return the convolution product of the array with a given 2D kernel,
+ * computed using Fast Fourier Transforms (FFT).
+ *
+ * Same result as {@link convolve2d} (symmetry boundary conditions). The
+ * transforms are real-to-complex, with sizes padded to products of 2, 3 and 5,
+ * and their plans are cached per thread and per shape. Large arrays are
+ * processed by tiles using the overlap-save method: each tile is transformed
+ * with its kernel footprint, the kernel spectrum is computed once, and the
+ * tiles are processed in parallel.
+ *
+ * @param  array     Input array to be convolved.
+ * @param  kernel    2D kernel to be used for the convolution.
+ * @param  tile_size Output tile size for the overlap-save method. If set to 0,
+ *                   the tile size minimizing the overall cost is used (which
+ *                   can be the whole array).
+ * @return           Array Resulting array after applying the 2D convolution.
+ */
+Array convolve2d_fft(const Array &array,
+                     const Array &kernel,
+                     int          tile_size = 0);
 
 /**
  * @brief Return the convolution product of the array with a given 2D kernel,
@@ -122,6 +170,17 @@ Array convolve2d_truncated(const Array &array, const Array &kernel);
  */
 Array convolve2d_svd(const Array &z, const Array &kernel, int rank = 3);
 
+/**
+ * @brief Return the numerical rank of a kernel, i.e. the number of separable
+ * kernels needed to represent it exactly (see {@link convolve2d_svd}).
+ *
+ * @param  kernel    Kernel.
+ * @param  tolerance Singular values smaller than `tolerance` times the largest
+ *                   one are neglected.
+ * @return           int Kernel rank.
+ */
+int convolve2d_svd_rank(const Array &kernel, float tolerance = 1e-6f);
+
 /**
  * @brief Return the approximate convolution product of the array with a
  * Singular Value Decomposition (SVD) of a kernel combined with kernel
@@ -0,0 +1,264 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file profiler.hpp
+ * @author Otto Link (otto.link.bv@gmail.com)
+ * @brief Thread-safe hierarchical profiler with Chrome trace export.
+ *
+ * Timed zones are defined with RAII guards and can be nested, counters record
+ * quantities (allocated bytes, processed pixels...). Each thread records its
+ * events in its own buffer without any lock, the results can then be
+ * summarized (`dump`, `get_stats`) or exported to the Chrome trace format
+ * (`to_chrome_trace`, to be opened with `chrome://tracing` or Perfetto).
+ *
+ * The library is instrumented with the `HMAP_PROFILE_*` macros, which are
+ * removed at compile time unless `HMAP_ENABLE_PROFILING` is defined (CMake
+ * option `HIGHMAP_ENABLE_PROFILING`).
+ *
+ * @code
+ * {
+ *   HMAP_PROFILE_ZONE("erosion");
+ *   HMAP_PROFILE_COUNT("pixels processed", z.size());
+ *   ...
+ * }
+ *
+ * hmap::Profiler::get_instance().to_chrome_trace("trace.json");
+ * @endcode
+ *
+ * @copyright Copyright (c) 2023 Otto Link
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#ifdef HMAP_ENABLE_PROFILING
+#define HMAP_PROFILE_CONCAT_(a, b) a##b
+#define HMAP_PROFILE_CONCAT(a, b) HMAP_PROFILE_CONCAT_(a, b)
+#define HMAP_PROFILE_ZONE(name)                                                \
+  hmap::ProfileZone HMAP_PROFILE_CONCAT(hmap_profile_zone_, __LINE__)(name)
+#define HMAP_PROFILE_FUNCTION() HMAP_PROFILE_ZONE(__func__)
+#define HMAP_PROFILE_COUNT(name, increment)                                    \
+  hmap::Profiler::get_instance().count(name, (double)(increment))
+#else
+#define HMAP_PROFILE_ZONE(name) (void)0
+#define HMAP_PROFILE_FUNCTION() (void)0
+#define HMAP_PROFILE_COUNT(name, increment) (void)0
+#endif
+
+namespace hmap
+{
+
+/**
+ * @brief Aggregated timings of a zone, in milliseconds.
+ */
+struct ProfileStats
+{
+  int    nb_calls = 0;
+  double total = 0.0; ///< Total time.
+  double self = 0.0;  ///< Total time minus the time of the nested zones.
+  double min = 0.0;
+  double max = 0.0;
+};
+
+/**
+ * @brief Profiler singleton, records the zones and counters of all the
+ * threads.
+ *
+ * Recording is lock-free (a mutex is only taken the first time a thread records
+ * an event, or the first time a thread uses a dynamic name). Events only store
+ * a pointer to their name: names given as `const char *` (string literals,
+ * `__func__`) are used as is, names given as `std::string` are copied once into
+ * a table of interned names. Reading the results (`dump`, `get_stats`,
+ * `to_chrome_trace`...) is safe while other threads are recording, only the
+ * events completed at that time are taken into account. `clear` must not be
+ * called while events are being recorded.
+ */
+class Profiler
+{
+public:
+  /**
+   * @brief Get the profiler instance.
+   *
+   * @return Profiler& Reference to the instance.
+   */
+  static Profiler &get_instance();
+
+  /**
+   * @brief Open a zone in the calling thread, zones must be closed (`end`) in
+   * the reverse order of their opening. The zone is not recorded if the
+   * profiler is disabled when it is opened.
+   *
+   * @param name Zone name, must remain valid as long as the profiler events
+   *             (string literal or `__func__`).
+   */
+  void begin(const char *name);
+
+  /**
+   * @brief Open a zone with a dynamic name (interned).
+   *
+   * @param name Zone name.
+   */
+  void begin(const std::string &name);
+
+  /**
+   * @brief Remove all the recorded events.
+   */
+  void clear();
+
+  /**
+   * @brief Add an increment to a counter (for instance a number of allocated
+   * bytes or processed pixels). Nothing is recorded if the profiler is
+   * disabled.
+   *
+   * @param name      Counter name, must remain valid as long as the profiler
+   *                  events (string literal).
+   * @param increment Increment.
+   */
+  void count(const char *name, double increment);
+
+  /**
+   * @brief Add an increment to a counter with a dynamic name (interned).
+   *
+   * @param name      Counter name.
+   * @param increment Increment.
+   */
+  void count(const std::string &name, double increment);
+
+  /**
+   * @brief Print the zones statistics and the counters totals to the console.
+   */
+  void dump() const;
+
+  /**
+   * @brief Close the last zone opened in the calling thread.
+   */
+  void end();
+
+  /**
+   * @brief Get the counters totals.
+   *
+   * @return std::map<std::string, double> Counter name -> total.
+   */
+  std::map<std::string, double> get_counters() const;
+
+  /**
+   * @brief Get the zones statistics.
+   *
+   * @return std::map<std::string, ProfileStats> Zone name -> statistics.
+   */
+  std::map<std::string, ProfileStats> get_stats() const;
+
+  bool is_enabled() const; ///< Whether events are recorded.
+
+  void set_enabled(bool new_state); ///< Enable / disable the recording.
+
+  /**
+   * @brief Export the recorded events to a Chrome trace JSON file (zones as
+   * complete events, one track per thread, counters as cumulative counter
+   * events).
+   *
+   * @param  fname File name.
+   * @return       bool Success.
+   */
+  bool to_chrome_trace(const std::string &fname) const;
+
+private:
+  enum EventType : int
+  {
+    EVENT_ZONE,
+    EVENT_COUNT,
+  };
+
+  struct Event
+  {
+    EventType   type;
+    const char *name;    ///< Literal or interned name.
+    int64_t     t0;      ///< Start time, in ns since the profiler creation.
+    int64_t     dt;      ///< Duration (zone), in ns.
+    int64_t     dt_self; ///< Duration minus the nested zones (zone), in ns.
+    double      value;   ///< Increment (counter).
+  };
+
+  // fixed-size event blocks, published to the readers through the atomic
+  // count (the block content is never moved)
+  struct Chunk
+  {
+    static constexpr size_t capacity = 1024;
+
+    Event                events[capacity];
+    std::atomic<size_t>  count = 0;
+    std::atomic<Chunk *> next = nullptr;
+  };
+
+  // events of a single thread, only written by that thread
+  struct ThreadBuffer
+  {
+    struct OpenZone
+    {
+      const char *name;
+      int64_t     t0;
+      int64_t     dt_children = 0;
+      bool        is_recorded;
+    };
+
+    int                    tid;
+    std::unique_ptr<Chunk> head;
+    Chunk                 *tail;
+    std::vector<OpenZone>  stack = {};
+
+    ThreadBuffer(int tid);
+    ~ThreadBuffer();
+
+    void push(Event &&event);
+  };
+
+  std::chrono::steady_clock::time_point      t_origin;
+  std::atomic<bool>                          enabled = true;
+  mutable std::mutex                         mutex; ///< Buffers list.
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers = {};
+  std::mutex                                 names_mutex; ///< Names table.
+  std::unordered_set<std::string>            names = {};  ///< Interned names.
+
+  Profiler();
+
+  Profiler(const Profiler &) = delete;
+
+  Profiler &operator=(const Profiler &) = delete;
+
+  std::vector<Event> collect_events(std::vector<int> *p_tids = nullptr) const;
+
+  const char *intern(const std::string &name);
+
+  int64_t now() const;
+
+  ThreadBuffer &thread_buffer();
+};
+
+/**
+ * @brief RAII profiler zone, opened at construction and closed at
+ * destruction.
+ */
+class ProfileZone
+{
+public:
+  ProfileZone(const char *name);
+
+  ProfileZone(const std::string &name);
+
+  ProfileZone(const ProfileZone &) = delete;
+
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+  ~ProfileZone();
+};
+
+} // namespace hmap
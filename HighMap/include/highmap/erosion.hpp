@@ -17,6 +17,7 @@
 #include <cmath>
 
 #include "highmap/array.hpp"
+#include "highmap/heightmap.hpp"
 
 // neighbor pattern search based on Moore pattern and define diagonal
 // weight coefficients ('c' corresponds to a weight coefficient
@@ -51,15 +52,21 @@ enum ErosionProfile : int
 };
 
 /**
- * @brief Fill the depressions of the heightmap using the Planchon-Darboux
+ * @brief Fill the depressions of the heightmap using the Priority-Flood
  * algorithm.
  *
  * Fill heightmap depressions to ensure that every cell can be connected to the
- * boundaries following a downward slope @cite Planchon2002.
+ * boundaries following a downward slope @cite Planchon2002, in a single pass
+ * with a complexity in O(N log N) @cite Barnes2014. Filled areas are given a
+ * small gradient (`epsilon` per cell) toward the outlets. If `epsilon` is set
+ * to zero, filled areas are flat and, if the elevations are integers (quantized
+ * heightmap), a O(N) bucket queue is used.
  *
  * @param z          Input array.
- * @param iterations Number of iterations.
- * @param epsilon
+ * @param iterations Ignored (a message is logged if it differs from the
+ *                   default value), kept for backward compatibility since the
+ *                   algorithm is not iterative anymore.
+ * @param epsilon    Elevation increment between two filled cells.
  *
  * **Example**
  * @include ex_depression_filling.cpp
@@ -69,6 +76,28 @@ enum ErosionProfile : int
  */
 void depression_filling(Array &z, int iterations = 1000, float epsilon = 1e-4f);
 
+/**
+ * @brief Fill the depressions of a tiled heightmap, tile by tile.
+ *
+ * Each tile is flooded independently from its perimeter, the spill elevations
+ * between the perimeter watersheds of all the tiles are then merged in a global
+ * (small) spill graph which is flooded from the heightmap boundaries, and each
+ * tile is finally filled using its updated perimeter as outlets
+ * @cite Barnes2016. Only one tile is processed at a time by each thread and the
+ * global graph is proportional to the tiles perimeter. The overlap buffers are
+ * updated using the neighboring tiles.
+ *
+ * @note The small gradient (`epsilon`) is only applied within each tile: the
+ * filled elevations are not the same as with the `Array` version for a
+ * non-zero `epsilon`, and flat areas may remain at the tile frontiers. With
+ * `epsilon` set to zero, both versions give the same filled elevations. The
+ * heightmap boundaries are left unchanged.
+ *
+ * @param h       Input heightmap.
+ * @param epsilon Elevation increment between two filled cells.
+ */
+void depression_filling(Heightmap &h, float epsilon = 1e-4f);
+
 /**
  * @brief
  *
@@ -159,6 +188,10 @@ void hydraulic_algebric(Array &z,
  * @param water_level        Water level.
  * @param evap_rate          Water evaporation rate.
  * @param rain_rate          Rain relaxation rate.
+ * @param parallel           Whether the cells are updated concurrently, using a
+ *                           multi-color checkerboard schedule (deterministic
+ *                           and independent of the number of threads, but
+ *                           slightly different from the sequential scan).
  *
  * **Example**
  * @include ex_hydraulic_benes.cpp
@@ -178,7 +211,8 @@ void hydraulic_benes(Array &z,
                      float  c_deposition = 0.8f,
                      float  water_level = 0.005f,
                      float  evap_rate = 0.01f,
-                     float  rain_rate = 0.5f);
+                     float  rain_rate = 0.5f,
+                     bool   parallel = false);
 
 void hydraulic_benes(Array &z,
                      int    iterations = 50,
@@ -191,7 +225,8 @@ void hydraulic_benes(Array &z,
                      float  c_deposition = 0.8f,
                      float  water_level = 0.005f,
                      float  evap_rate = 0.01f,
-                     float  rain_rate = 0.5f); ///< @overload
+                     float  rain_rate = 0.5f,
+                     bool   parallel = false); ///< @overload
 
 /**
  * @brief Apply cell-based hydraulic erosion using a nonlinear diffusion model.
@@ -248,6 +283,10 @@ void hydraulic_diffusion(Array &z,
  * @param c_erosion    Erosion coefficient.
  * @param water_level  Water level.
  * @param evap_rate    Water evaporation rate.
+ * @param parallel     Whether the cells are updated concurrently, using a
+ *                     multi-color checkerboard schedule (deterministic and
+ *                     independent of the number of threads, but slightly
+ *                     different from the sequential scan).
  *
  * **Example**
  * @include ex_hydraulic_musgrave.cpp
@@ -262,7 +301,8 @@ void hydraulic_musgrave(Array &z,
                         float  c_erosion = 0.1f,
                         float  c_deposition = 0.1f,
                         float  water_level = 0.01f,
-                        float  evap_rate = 0.01f);
+                        float  evap_rate = 0.01f,
+                        bool   parallel = false);
 
 void hydraulic_musgrave(Array &z,
                         int    iterations = 100,
@@ -270,12 +310,16 @@ void hydraulic_musgrave(Array &z,
                         float  c_erosion = 0.1f,
                         float  c_deposition = 0.1f,
                         float  water_level = 0.01f,
-                        float  evap_rate = 0.01f); ///< @overload
+                        float  evap_rate = 0.01f,
+                        bool   parallel = false); ///< @overload
 
 /**
  * @brief Apply hydraulic erosion using a particle based procedure.
  *
- * Adapted from @cite Beyer2015 and @cite Hjulstroem1935.
+ * Adapted from @cite Beyer2015 and @cite Hjulstroem1935. The particles are
+ * moved concurrently, one step at a time, within tiles scheduled so that
+ * concurrent particles never interact: the result only depends on the seed and
+ * not on the number of threads.
  *
  * @param z                  Input array.
  * @param p_mask             Intensity mask, expected in [0, 1] (applied as a
@@ -13,6 +13,7 @@
 #pragma once
 
 #include "highmap/array.hpp"
+#include "highmap/heightmap.hpp"
 
 /**
  * @brief Packs eight 2-bit values into a 16-bit integer.
@@ -44,6 +45,16 @@
 namespace hmap
 {
 
+/**
+ * @brief Connected component statistics, see connected_components.
+ */
+struct ComponentStatistics
+{
+  float     label = 0.f; ///< Component label.
+  size_t    area = 0;    ///< Number of cells.
+  Vec4<int> bbox;        ///< Bounding box {imin, imax, jmin, jmax}, inclusive.
+};
+
 /**
  * @brief Identifies and labels connected components within a binary or labeled
  * array, with optional filtering by size.
@@ -67,10 +78,18 @@ namespace hmap
  *                           (no filtering).
  * @param  background_value  The value used to represent background pixels,
  *                           which are not part of any component. Default is 0.
+ * @param  p_statistics      (optional) Reference to the output statistics of
+ *                           the retained components.
  * @return                   Array An array with labeled connected components,
  *                           where each component is assigned a unique
- *                           identifier.
+ *                           identifier (starting from 1, in raster scan order
+ *                           of the first cell of each component). Background
+ *                           cells are set to 0 and the cells of the removed
+ *                           components to `background_value`.
  *
+ * @note Components are labelled with a two-pass union-find algorithm (8-cell
+ * connectivity), on strips of rows processed concurrently and merged along
+ * their boundaries.
  *
  * **Example**
  * @include ex_connected_components.cpp
@@ -79,9 +98,37 @@ namespace hmap
  * @image html ex_connected_components0.png
  * @image html ex_connected_components1.png
  */
-Array connected_components(const Array &array,
-                           float        surface_threshold = 0.f,
-                           float        background_value = 0.f);
+Array connected_components(
+    const Array                      &array,
+    float                             surface_threshold = 0.f,
+    float                             background_value = 0.f,
+    std::vector<ComponentStatistics> *p_statistics = nullptr);
+
+/**
+ * @brief Identifies and labels connected components within a tiled heightmap,
+ * with optional filtering by size (see the array version).
+ *
+ * Tiles are labelled concurrently and the labels are merged across the tile
+ * boundaries, so that a component spanning several tiles has a single label.
+ * Overlap buffers are not used for the labelling and are filled with the
+ * labels of the tiles they belong to.
+ *
+ * @param  h                 Input heightmap.
+ * @param  surface_threshold The minimum number of pixels a component must have
+ *                           to be retained.
+ * @param  background_value  The value used to represent background pixels.
+ * @param  p_statistics      (optional) Reference to the output statistics of
+ *                           the retained components (bounding boxes in global
+ *                           indices).
+ * @return                   Heightmap Labels, with the same shape, tiling and
+ *                           overlap as the input. Components are numbered from
+ *                           1, tile by tile.
+ */
+Heightmap connected_components(
+    const Heightmap                  &h,
+    float                             surface_threshold = 0.f,
+    float                             background_value = 0.f,
+    std::vector<ComponentStatistics> *p_statistics = nullptr);
 
 /**
  * @brief Classifies terrain into geomorphological features based on the
@@ -123,7 +170,9 @@ Array geomorphons(const Array &array, int irmin, int irmax, float epsilon);
  * K-means clustering is a popular unsupervised learning algorithm used to
  * partition data into clusters. This function applies k-means clustering to two
  * arrays, which might represent different terrain attributes or environmental
- * variables.
+ * variables. Centroids are initialized with k-means++ on a random subsample of
+ * the data and then refined with Hamerly's accelerated Lloyd iterations
+ * (multi-threaded, the result does not depend on the number of threads).
  *
  * **Usage**:
  * - Use this function to identify regions with similar characteristics based on
@@ -180,7 +229,7 @@ Array kmeans_clustering2(const Array        &array1,
  *
  * This version of k-means clustering includes a third array, enabling more
  * complex clustering based on three terrain attributes or environmental
- * variables.
+ * variables. The clustering algorithm is the same as for `kmeans_clustering2`.
  *
  * **Usage**
  * - Apply this function to analyze the relationships between three different
@@ -38,6 +38,25 @@ enum neighborhood : int
         // neighbors.
 };
 
+/**
+ * @enum SmoothingMethod
+ * @brief Backend used by the separable smoothing filters (`smooth_cone`,
+ * `smooth_cpulse`, `smooth_flat` and `smooth_gaussian`).
+ *
+ * The convolution backend applies the exact kernels, with a cost proportional
+ * to the filter radius. The recursive backend has a cost independent of the
+ * radius: Gaussian smoothing uses the Young-van Vliet recursive (IIR) filter
+ * @cite Young1995 and the other kernels are reproduced by cascades of
+ * running-sum box filters: exactly for the flat kernel, approximately for the
+ * cone kernel (see `smooth_cone`) and by variance matching for the cubic pulse
+ * kernel.
+ */
+enum SmoothingMethod : int
+{
+  SMOOTHING_CONVOLUTION, ///< Direct 1D convolutions with the exact kernel
+  SMOOTHING_RECURSIVE,   ///< Recursive filters, radius-independent cost
+};
+
 /**
  * @brief Applies diffusion retargeting by detecting local maxima and adjusting
  * based on the difference between two arrays.
@@ -1856,6 +1875,14 @@ void shrink_directional(Array       &array,
  * @param p_mask Optional filter mask, expected in the range [0, 1]. If
  *               provided, smoothing is applied according to this mask. If not
  *               provided, the entire array is processed.
+ * @param method Smoothing backend, see {@link SmoothingMethod}.
+ *
+ * @note The recursive backend is an approximation of the convolution kernel.
+ * It applies a centered triangle kernel with weights proportional to `ir + 1 -
+ * |d|`, `|d| <= ir` (same support and unit sum). The convolution kernel is
+ * sampled half a cell off-center: its peak spans two cells and its last tap is
+ * slightly negative. The outputs of both backends are therefore shifted by
+ * half a cell relative to each other.
  *
  * **Example**
  * @include ex_smooth_cone.cpp
@@ -1863,8 +1890,14 @@ void shrink_directional(Array       &array,
  * **Result**
  * @image html ex_smooth_cone.png
  */
-void smooth_cone(Array &array, int ir);
-void smooth_cone(Array &array, int ir, const Array *p_mask); ///< @overload
+void smooth_cone(Array          &array,
+                 int             ir,
+                 SmoothingMethod method = SMOOTHING_CONVOLUTION);
+
+void smooth_cone(Array          &array,
+                 int             ir,
+                 const Array    *p_mask,
+                 SmoothingMethod method = SMOOTHING_CONVOLUTION); ///< @overload
 
 /**
  * @brief Apply filtering to the array using convolution with a cubic pulse
@@ -1882,6 +1915,7 @@ void smooth_cone(Array &array, int ir, const Array *p_mask); ///< @overload
  * @param p_mask Optional filter mask, expected in the range [0, 1]. If
  *               provided, filtering is applied according to this mask. If not
  *               provided, the entire array is processed.
+ * @param method Smoothing backend, see {@link SmoothingMethod}.
  *
  * **Example**
  * @include ex_smooth_cpulse.cpp
@@ -1891,8 +1925,14 @@ void smooth_cone(Array &array, int ir, const Array *p_mask); ///< @overload
  *
  * @see          {@link smooth_gaussian}
  */
-void smooth_cpulse(Array &array, int ir);
-void smooth_cpulse(Array &array, int ir, const Array *p_mask); ///< @overload
+void smooth_cpulse(Array          &array,
+                   int             ir,
+                   SmoothingMethod method = SMOOTHING_CONVOLUTION);
+
+void smooth_cpulse(Array          &array,
+                   int             ir,
+                   const Array    *p_mask,
+                   SmoothingMethod method = SMOOTHING_CONVOLUTION); ///< @overload
 
 /**
  * @brief Applies a smoothing average filter to the given 2D array in both
@@ -1902,12 +1942,14 @@ void smooth_cpulse(Array &array, int ir, const Array *p_mask); ///< @overload
  * with uniform weights, then applies a 1D convolution along both the i (rows)
  * and j (columns) dimensions of the array to achieve a 2D smoothing effect.
  *
- * @param array Reference to the 2D array to be smoothed.
- * @param ir    Radius of the smoothing kernel, determining its size as \(2
- *              \times
- * \text{ir} + 1\). Larger values produce more smoothing.
+ * @param array  Reference to the 2D array to be smoothed.
+ * @param ir     Radius of the smoothing kernel, determining its size as \(2
+ *               \times \text{ir} + 1\). Larger values produce more smoothing.
+ * @param method Smoothing backend, see {@link SmoothingMethod}.
  */
-void smooth_flat(Array &array, int ir);
+void smooth_flat(Array          &array,
+                 int             ir,
+                 SmoothingMethod method = SMOOTHING_CONVOLUTION);
 
 /**
  * @brief Apply Gaussian filtering to the array.
@@ -1924,6 +1966,7 @@ void smooth_flat(Array &array, int ir);
  * @param p_mask Optional filter mask, expected in the range [0, 1]. If
  *               provided, filtering is applied according to this mask. If not
  *               provided, the entire array is processed.
+ * @param method Smoothing backend, see {@link SmoothingMethod}.
  *
  * **Example**
  * @include ex_smooth_gaussian.cpp
@@ -1931,8 +1974,14 @@ void smooth_flat(Array &array, int ir);
  * **Result**
  * @image html ex_smooth_gaussian.png
  */
-void smooth_gaussian(Array &array, int ir);
-void smooth_gaussian(Array &array, int ir, const Array *p_mask); ///< @overload
+void smooth_gaussian(Array          &array,
+                     int             ir,
+                     SmoothingMethod method = SMOOTHING_CONVOLUTION);
+
+void smooth_gaussian(Array          &array,
+                     int             ir,
+                     const Array    *p_mask,
+                     SmoothingMethod method = SMOOTHING_CONVOLUTION); ///< @overload
 /**
  * @brief Apply cubic pulse smoothing to fill lower flat regions while
  * preserving some sharpness.
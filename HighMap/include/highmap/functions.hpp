@@ -30,6 +30,10 @@
 
 #define HMAP_GRADIENT_OFFSET 0.001f
 
+// maximum number of points evaluated at once by the batched evaluations using
+// working arrays (allocated on the stack)
+#define HMAP_FCT_BLOCK_SIZE 128
+
 namespace hmap
 {
 
@@ -106,12 +110,57 @@ public:
    */
   float get_value(float x, float y, float ctrl_param) const;
 
+  /**
+   * @brief Evaluate the function for a batch of points.
+   *
+   * Derived classes can override this method to provide a devirtualized loop
+   * over the points (the default implementation calls the delegate for each
+   * point). Arrays filling should rely on this method rather than on the
+   * delegate.
+   *
+   * @param x          Input x coordinates.
+   * @param y          Input y coordinates.
+   * @param ctrl_param Input control parameters (assumed equal to 1 if
+   *                   `nullptr`).
+   * @param out        Output values.
+   * @param n          Number of points.
+   */
+  virtual void get_values(const float *x,
+                          const float *y,
+                          const float *ctrl_param,
+                          float       *out,
+                          size_t       n) const;
+
   /**
    * @brief Set a new delegate function.
    * @param new_delegate The new delegate function to set.
    */
   void set_delegate(HMAP_FCT_XY_TYPE new_delegate);
 
+protected:
+  /**
+   * @brief Evaluate the function by blocks of at most `HMAP_FCT_BLOCK_SIZE`
+   * points (calls to `get_values`), for derived classes using fixed-size
+   * working arrays.
+   *
+   * @param x          Input x coordinates.
+   * @param y          Input y coordinates.
+   * @param ctrl_param Input control parameters (can be `nullptr`).
+   * @param out        Output values.
+   * @param n          Number of points.
+   */
+  void get_values_by_blocks(const float *x,
+                            const float *y,
+                            const float *ctrl_param,
+                            float       *out,
+                            size_t       n) const;
+
+  /**
+   * @brief Set the delegate as a single point call to the batched evaluation
+   * `get_values`, for derived classes overriding it.
+   */
+  void set_delegate_from_values();
+
 private:
   HMAP_FCT_XY_TYPE delegate; ///< The stored delegate function object.
 };
@@ -839,6 +888,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -872,6 +930,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -908,6 +975,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -941,6 +1017,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -974,6 +1059,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -1007,6 +1101,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -1040,6 +1143,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -1073,6 +1185,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -1190,6 +1311,15 @@ public:
     this->noise.SetSeed(new_seed);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator object.
@@ -1236,6 +1366,15 @@ public:
     this->noise2.SetSeed(new_seed + 1);
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 private:
   /**
    * @brief FastNoiseLite noise generator objects.
@@ -1385,6 +1524,50 @@ protected:
    */
   void update_amp0();
 
+  /**
+   * @brief Batched evaluation of the base noise function (with a zero control
+   * parameter).
+   *
+   * @param x     Input x coordinates.
+   * @param y     Input y coordinates.
+   * @param value Output values.
+   * @param n     Number of points, at most `HMAP_FCT_BLOCK_SIZE`.
+   */
+  void get_base_values(const float *x,
+                       const float *y,
+                       float       *value,
+                       size_t       n) const;
+
+  /**
+   * @brief Batched evaluation of the base noise function and of its gradient
+   * (centered finite differences).
+   *
+   * @param x     Input x coordinates.
+   * @param y     Input y coordinates.
+   * @param value Output values.
+   * @param dvdx  Output gradient x-component.
+   * @param dvdy  Output gradient y-component.
+   * @param n     Number of points, at most `HMAP_FCT_BLOCK_SIZE`.
+   */
+  void get_base_values_and_gradient(const float *x,
+                                    const float *y,
+                                    float       *value,
+                                    float       *dvdx,
+                                    float       *dvdy,
+                                    size_t       n) const;
+
+  /**
+   * @brief Local octave weights for a batch of control parameters.
+   *
+   * @param ctrl_param   Input control parameters (assumed equal to 1 if
+   *                     `nullptr`).
+   * @param local_weight Output local weights.
+   * @param n            Number of points.
+   */
+  void get_local_weights(const float *ctrl_param,
+                         float       *local_weight,
+                         size_t       n) const;
+
 protected:
   std::unique_ptr<NoiseFunction>
         p_base;      ///< Unique pointer to the base noise function.
@@ -1416,6 +1599,15 @@ public:
               float                          weight,
               float                          persistence,
               float                          lacunarity);
+
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
 };
 /**
  * @class FbmIqFunction
@@ -1451,6 +1643,15 @@ public:
     this->gradient_scale = new_gradient_scale;
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 protected:
   float gradient_scale; ///< Gradient scale influence.
 };
@@ -1525,6 +1726,15 @@ public:
     this->damp_scale = new_damp_scale;
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 protected:
   float warp0;      ///< Initial warp.
   float damp0;      ///< Initial damp.
@@ -1564,6 +1774,15 @@ public:
     this->k_smoothing = new_k_smoothing;
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 protected:
   float k_smoothing; ///< Smoothing parameter.
 };
@@ -1602,6 +1821,15 @@ public:
     this->k_smoothing = new_k_smoothing;
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 protected:
   float k_smoothing; ///< Smoothing parameter.
 };
@@ -1641,6 +1869,15 @@ public:
     this->warp_scale_normalized = new_warp_scale / this->kw.x;
   }
 
+  /**
+   * @brief Batched evaluation, see Function::get_values.
+   */
+  void get_values(const float *x,
+                  const float *y,
+                  const float *ctrl_param,
+                  float       *out,
+                  size_t       n) const override;
+
 protected:
   float warp_scale;            ///< Warping scale.
   float warp_scale_normalized; ///< Normalized warping scale.
@@ -97,6 +97,35 @@ public:
    */
   std::map<std::pair<int, int>, float> adjacency_matrix;
 
+  /**
+   * @brief Compressed sparse row (CSR) adjacency, offsets.
+   *
+   * The neighbors of point `i` are stored in `csr_neighbors[r]` for `r` in
+   * [`csr_offsets[i]`, `csr_offsets[i + 1]`[, and the corresponding edge
+   * indices in `csr_edges[r]`. The edge weights are read from `weights` so that
+   * they can be modified in place without rebuilding the adjacency. Built by
+   * `update_csr`, and automatically (re)built by the graph algorithms when the
+   * graph topology has changed (detected using `csr_topology_hash`, including
+   * in-place modifications of `edges`).
+   */
+  std::vector<int> csr_offsets = {};
+
+  /**
+   * @brief Compressed sparse row (CSR) adjacency, neighbor point indices.
+   */
+  std::vector<int> csr_neighbors = {};
+
+  /**
+   * @brief Compressed sparse row (CSR) adjacency, edge indices.
+   */
+  std::vector<int> csr_edges = {};
+
+  /**
+   * @brief Fingerprint of the graph topology (number of points and edge end
+   * points) when the CSR adjacency was last built.
+   */
+  size_t csr_topology_hash = 0;
+
   /**
    * @brief Construct a new Graph object.
    *
@@ -180,7 +209,8 @@ public:
    * This method computes the shortest path from a specified source point to a
    * target point in the graph using Dijkstra's algorithm. It returns a vector
    * of point indices representing the route from the source to the target
-   * point.
+   * point (empty if the target cannot be reached). The edge weights are taken
+   * from `weights` and the frontier is managed with a binary heap.
    *
    * @param  source_point_index The index of the starting point in the graph.
    * @param  target_point_index The index of the ending point in the graph.
@@ -193,6 +223,36 @@ public:
    */
   std::vector<int> dijkstra(int source_point_index, int target_point_index);
 
+  /**
+   * @brief Return the shortest routes between a point and a list of points
+   * using Dijkstra's algorithm.
+   *
+   * A single search is performed and stopped once every target point is
+   * reached. An empty route is returned for the unreachable target points.
+   *
+   * @param  source_point_index   The index of the starting point in the graph.
+   * @param  target_point_indices The indices of the ending points.
+   * @return                      std::vector<std::vector<int>> Routes (point
+   *                              indices) from the source to each target.
+   */
+  std::vector<std::vector<int>> dijkstra(
+      int                     source_point_index,
+      const std::vector<int> &target_point_indices);
+
+  /**
+   * @brief Return the shortest route distance of every point to the closest
+   * point of a set of source points (multi-source Dijkstra's algorithm).
+   *
+   * @param  source_point_indices  The indices of the source points.
+   * @param  p_nearest_source[out] Optional, index of the closest source point
+   *                               for each point (-1 if unreachable).
+   * @return                       std::vector<float> Distances (max float
+   *                               value if unreachable).
+   */
+  std::vector<float> dijkstra_distances(
+      const std::vector<int> &source_point_indices,
+      std::vector<int>       *p_nearest_source = nullptr);
+
   /**
    * @brief Get the length of edge `k`.
    *
@@ -403,5 +463,11 @@ public:
    * relationships between nodes in the graph based on the current edges.
    */
   void update_connectivity();
+
+  /**
+   * @brief Update the compressed sparse row (CSR) adjacency of the graph based
+   * on the current edges (see `csr_offsets`).
+   */
+  void update_csr();
 };
 } // namespace hmap
\ No newline at end of file
@@ -290,6 +290,8 @@ public:
    * elevation versus elevation difference in the cost function used for path
    * finding. The `distance_exponent` affects the weight function used in
    * Dijkstra's algorithm. Areas defined by the `p_mask_nogo` mask are avoided.
+   * The move costs are computed once for all the edges (see `CostField`), an
+   * edge whose end point cannot be reached is left unchanged.
    *
    * **Example**
    * @include ex_path_dijkstra.cpp
@@ -14,6 +14,8 @@
  */
 #pragma once
 #include <functional>
+#include <initializer_list>
+#include <memory>
 
 #include "highmap/array.hpp"
 #include "highmap/export.hpp"
@@ -53,6 +55,7 @@ static std::map<std::string, int> transform_mode_as_string = {
 
 // --- forward declarations
 class HeightmapRGBA;
+class TileCache;
 HeightmapRGBA mix_heightmap_rgba(HeightmapRGBA &rgba1,
                                  HeightmapRGBA &rgba2,
                                  bool           use_sqrt_avg = true);
@@ -61,6 +64,30 @@ HeightmapRGBA mix_heightmap_rgba(std::vector<HeightmapRGBA *> p_rgba_list,
 
 // --- classes
 
+/**
+ * @brief Heightmap statistics, see Heightmap::statistics.
+ */
+struct HeightmapStatistics
+{
+  float  min = 0.f;  ///< Smallest value.
+  float  max = 0.f;  ///< Greatest value.
+  float  sum = 0.f;  ///< Sum of the values.
+  float  mean = 0.f; ///< Mean value.
+  size_t count = 0;  ///< Number of cells accounted for.
+
+  /**
+   * @brief Histogram, with bins evenly distributed over [min, max] (empty if
+   * not requested).
+   */
+  std::vector<size_t> histogram = {};
+
+  /**
+   * @brief Percentiles, in the same order as the requested ranks (empty if not
+   * requested).
+   */
+  std::vector<float> percentiles = {};
+};
+
 /**
  * @brief Tile class, to manipulate a restricted region of an heightmap (with
  * contextual informations).
@@ -145,6 +172,13 @@ public:
 /**
  * @brief HeightMap class, to manipulate heightmap (with contextual
  * informations).
+ *
+ * By default all the tiles are resident in memory. In out-of-core mode (see
+ * Heightmap::enable_out_of_core), tile data are paged from a scratch file
+ * through a bounded cache (see TileCache) and a tile must be pinned to be
+ * accessed (see Heightmap::pin_tile and TilePin). This is done by the
+ * `transform` and `fill` functions and by the Heightmap methods, so that
+ * tile-local operators work unchanged.
  */
 class Heightmap
 {
@@ -183,10 +217,33 @@ public:
 
   Heightmap(); ///< @overload
 
+  /**
+   * @brief Copy constructor. The copy of an out-of-core heightmap is also
+   * out-of-core and uses the same tile cache (tiles are copied one at a time).
+   *
+   * @param other Heightmap to copy.
+   */
+  Heightmap(const Heightmap &other);
+
+  Heightmap(Heightmap &&other) noexcept; ///< @overload
+
+  ~Heightmap();
+
+  Heightmap &operator=(const Heightmap &other);
+
+  Heightmap &operator=(Heightmap &&other) noexcept;
+
   //----------------------------------------
   // accessors
   //----------------------------------------
 
+  /**
+   * @brief Get the tile cache (nullptr if the heightmap is not out-of-core).
+   *
+   * @return std::shared_ptr<TileCache> Tile cache.
+   */
+  std::shared_ptr<TileCache> get_tile_cache() const;
+
   //----------------------------------------
   // methods
   //----------------------------------------
@@ -207,6 +264,16 @@ public:
    */
   int get_tile_index(int i, int j) const;
 
+  /**
+   * @brief Get the index range {i1, i2, j1, j2} (end excluded) of the cells of
+   * a tile that are not part of the overlap buffers. Each global cell belongs
+   * to the core extent of exactly one tile.
+   *
+   * @param  k Tile linear index.
+   * @return   Vec4<int> Index range.
+   */
+  Vec4<int> get_tile_core_extent(size_t k) const;
+
   float get_value_bilinear(float x, float y) const;
 
   float get_value_nearest(float x, float y) const;
@@ -241,6 +308,35 @@ public:
    */
   void set_tiling(Vec2<int> new_tiling);
 
+  /**
+   * @brief Switch back to in-core mode: all the tiles are loaded in memory.
+   */
+  void disable_out_of_core();
+
+  /**
+   * @brief Switch to out-of-core mode: tile data are paged to a scratch file
+   * to keep the memory used by the tiles under a budget.
+   *
+   * Tiles currently in memory are handed over to the cache (and evicted if
+   * needed). To avoid allocating all the tiles of a large heightmap at once,
+   * the out-of-core mode can be enabled before setting the shape, for instance
+   * `Heightmap h; h.enable_out_of_core(budget); h.set_sto(shape, tiling,
+   * overlap);`.
+   *
+   * @param memory_budget Memory budget for the resident tiles, in bytes.
+   * @param scratch_fname Scratch file name (a temporary file if empty).
+   */
+  void enable_out_of_core(size_t             memory_budget,
+                          const std::string &scratch_fname = "");
+
+  /**
+   * @brief Switch to out-of-core mode using an existing tile cache, for
+   * instance to share a single memory budget between several heightmaps.
+   *
+   * @param new_tile_cache Tile cache.
+   */
+  void enable_out_of_core(std::shared_ptr<TileCache> new_tile_cache);
+
   /**
    * @brief Fill tile values by interpolating (bilinear) values from another
    * array.
@@ -280,11 +376,30 @@ public:
    */
   void from_array_interp_nearest(Array &array);
 
+  /**
+   * @brief Compute the histogram of the heightmap data.
+   *
+   * Values outside [vmin, vmax] are clamped to the first or last bin.
+   *
+   * @param  nbins Number of bins.
+   * @param  vmin  Lower bound of the histogram range.
+   * @param  vmax  Upper bound of the histogram range.
+   * @return       std::vector<size_t> Number of cells in each bin.
+   */
+  std::vector<size_t> histogram(int nbins, float vmin, float vmax) const;
+
   /**
    * @brief Print some informations about the object.
    */
   void infos();
 
+  /**
+   * @brief Return whether the tiles are paged through a tile cache.
+   *
+   * @return bool True if the heightmap is out-of-core.
+   */
+  bool is_out_of_core() const;
+
   /**
    * @brief Inverse the heightmap values (max - values).
    */
@@ -295,21 +410,59 @@ public:
    *
    * @return float
    */
-  float max();
+  float max() const;
 
   /**
    * @brief Return the mean of the heightmap data.
    *
    * @return float
    */
-  float mean();
+  float mean() const;
 
   /**
    * @brief Return the value of the smallest element in the heightmap data.
    *
    * @return float
    */
-  float min();
+  float min() const;
+
+  /**
+   * @brief Return the smallest and greatest values of the heightmap data,
+   * computed in a single pass.
+   *
+   * @return Vec2<float> {min, max}.
+   */
+  Vec2<float> minmax() const;
+
+  /**
+   * @brief Return (approximate) percentiles of the heightmap data.
+   *
+   * Percentiles are interpolated from an histogram of the data, the accuracy is
+   * therefore `(max - min) / nbins`.
+   *
+   * @param  ranks Percentile ranks, in [0, 100].
+   * @param  nbins Number of histogram bins.
+   * @return       std::vector<float> Percentiles.
+   */
+  std::vector<float> percentiles(const std::vector<float> &ranks,
+                                 int                       nbins = 4096) const;
+
+  /**
+   * @brief Pin a tile: the tile data are loaded if needed and remain in memory
+   * until the tile is unpinned. Pins are counted and every call must be paired
+   * with a call to Heightmap::unpin_tile (no-op for in-core heightmaps).
+   *
+   * @param k Tile linear index.
+   */
+  void pin_tile(size_t k) const;
+
+  /**
+   * @brief Request the asynchronous loading of a tile that is about to be
+   * pinned (no-op for in-core heightmaps).
+   *
+   * @param k Tile linear index.
+   */
+  void prefetch_tile(size_t k) const;
 
   /**
    * @brief Remap heightmap elements from a starting range to a target range.
@@ -335,12 +488,32 @@ public:
    */
   void smooth_overlap_buffers();
 
+  /**
+   * @brief Compute the heightmap statistics.
+   *
+   * The min, max, sum and mean are computed in a single pass over the data. If
+   * an histogram or percentiles are requested, a second pass is performed to
+   * fill the histogram over the range [min, max], which is then used to
+   * interpolate the percentiles.
+   *
+   * Reductions are performed in place on the tiles (no data copy), and the tile
+   * overlap buffers are excluded so that each cell is accounted for only once.
+   *
+   * @param  nbins Number of histogram bins (0 for no histogram). If
+   *               percentiles are requested without histogram, 4096 bins are
+   *               used.
+   * @param  ranks Percentile ranks, in [0, 100].
+   * @return       HeightmapStatistics Statistics.
+   */
+  HeightmapStatistics statistics(int                       nbins = 0,
+                                 const std::vector<float> &ranks = {}) const;
+
   /**
    * @brief Return the sum of the heightmap data.
    *
    * @return float
    */
-  float sum();
+  float sum() const;
 
   /**
    * @brief Return the heightmap as an array.
@@ -371,10 +544,107 @@ public:
    */
   std::vector<float> unique_values();
 
+  /**
+   * @brief Unpin a tile (see Heightmap::pin_tile).
+   *
+   * @param k           Tile linear index.
+   * @param is_modified Whether the tile data have been modified while pinned.
+   */
+  void unpin_tile(size_t k, bool is_modified = true) const;
+
   /**
    * @brief Update tile parameters.
    */
   void update_tile_parameters();
+
+private:
+  std::shared_ptr<TileCache> tile_cache = nullptr; ///< Out-of-core mode only.
+  std::vector<int>           tile_ids = {};        ///< Tile cache identifiers.
+
+  void release_tiles();
+};
+
+/**
+ * @brief Scoped pin of the tiles of a given index for a set of heightmaps (see
+ * Heightmap::pin_tile). The tiles that should be processed next by the calling
+ * thread are prefetched, according to the iteration order given by the
+ * prefetch stride (tiles dispatched by `parallel_for` by default, a stride of 1
+ * should be used for a serial loop over the tiles). Null pointers and in-core
+ * heightmaps are ignored (no-op if none of the heightmaps is out-of-core).
+ *
+ * **Example**
+ * @code
+ * parallel_for(h.get_ntiles(),
+ *              [&](size_t k)
+ *              {
+ *                TilePin pin({&h_out}, {&h_in}, k);
+ *                h_out.tiles[k] = 2.f * h_in.tiles[k];
+ *              });
+ *
+ * for (size_t k = 0; k < h.get_ntiles(); k++)
+ * {
+ *   TilePin pin({&h}, k, true, 1);
+ *   ...
+ * }
+ * @endcode
+ */
+class TilePin
+{
+public:
+  /**
+   * @brief Pin the tiles.
+   *
+   * @param p_hmaps         Heightmaps.
+   * @param k               Tile linear index.
+   * @param is_modified     Whether the tile data are modified while pinned.
+   * @param prefetch_stride Linear index offset of the next tile processed by
+   *                        the calling thread, which is prefetched: -1 for
+   *                        tiles dispatched by `parallel_for` (number of pool
+   *                        threads), 1 for a serial loop, 0 to disable the
+   *                        prefetching (point queries).
+   */
+  TilePin(std::initializer_list<const Heightmap *> p_hmaps,
+          size_t                                   k,
+          bool                                     is_modified = true,
+          int                                      prefetch_stride = -1);
+
+  /**
+   * @brief Pin the tiles of output heightmaps (modified) and input heightmaps
+   * (read-only, not written back to the scratch file when evicted).
+   *
+   * @param p_outputs       Output heightmaps.
+   * @param p_inputs        Input heightmaps.
+   * @param k               Tile linear index.
+   * @param prefetch_stride Linear index offset of the next tile processed by
+   *                        the calling thread (see above).
+   */
+  TilePin(std::initializer_list<const Heightmap *> p_outputs,
+          std::initializer_list<const Heightmap *> p_inputs,
+          size_t                                   k,
+          int                                      prefetch_stride = -1);
+
+  TilePin(const std::vector<Heightmap *> &p_hmaps,
+          size_t                          k,
+          bool                            is_modified = true,
+          int                             prefetch_stride = -1); ///< @overload
+
+  TilePin(const TilePin &) = delete;
+
+  TilePin &operator=(const TilePin &) = delete;
+
+  ~TilePin(); ///< Unpin the tiles.
+
+private:
+  struct PinnedMap
+  {
+    const Heightmap *p_h;
+    bool             is_modified;
+  };
+
+  std::vector<PinnedMap> pinned = {}; ///< Out-of-core heightmaps only.
+  size_t                 k;
+
+  void pin(const Heightmap *p_h, bool is_modified, int prefetch_stride);
 };
 
 /**
@@ -21,6 +21,7 @@
  * @copyright Copyright (c) 2023 Otto Link
  */
 #pragma once
+#include <cstdint>
 
 #include "highmap/array.hpp"
 #include "highmap/geometry/path.hpp"
@@ -28,6 +29,103 @@
 namespace hmap
 {
 
+/**
+ * @brief Flow routing engine, storing the flow receivers of each cell and the
+ * topological ordering of the cells (from upstream to downstream).
+ *
+ * The receivers are packed in a 8-bit mask per cell (bit `k` is set if the
+ * flow goes to the neighbor `k`, using the D8 nomenclature below), and the
+ * cells are ordered in a stack similar to @cite Braun2013, so that flow
+ * accumulations are then computed in a single linear pass. Once built, the
+ * routing can be reused for any number of accumulations (with different cell
+ * contributions) without recomputing the flow directions.
+ *
+ * @verbatim 5 6 7 4 . 0 3 2 1
+ * @endverbatim
+ *
+ * Border cells do not have any receivers. Cells belonging to flow cycles (flat
+ * areas with the D8 model) are not in the stack and do not propagate their
+ * flow.
+ *
+ * ### Usage Example:
+ *
+ * @code
+ * hmap::FlowRouting routing = hmap::FlowRouting(z, talus_ref);
+ *
+ * hmap::Array facc = routing.accumulate();
+ * hmap::Array facc_rain = routing.accumulate(&rain_map);
+ * @endcode
+ *
+ * @see flow_accumulation_d8, flow_accumulation_dinf
+ */
+class FlowRouting
+{
+public:
+  /**
+   * @brief Routed array shape.
+   */
+  Vec2<int> shape;
+
+  /**
+   * @brief Receivers bitmask of each cell (linear indexing).
+   */
+  std::vector<uint8_t> receivers;
+
+  /**
+   * @brief Cell linear indices ordered from upstream to downstream.
+   */
+  std::vector<int32_t> stack;
+
+  /**
+   * @brief Build the flow routing using the D8 model (single receiver, see
+   * flow_direction_d8).
+   *
+   * @param z Input array representing the heightmap values.
+   */
+  FlowRouting(const Array &z);
+
+  /**
+   * @brief Build the flow routing using the Multiple Flow Direction (MFD)
+   * model @cite Qin2007 (see flow_direction_dinf). The input heightmap is
+   * smoothed before the routing to avoid artifacts.
+   *
+   * @param z         Input array representing the heightmap values.
+   * @param talus_ref Reference talus used to locally define the flow-partition
+   *                  exponent.
+   */
+  FlowRouting(const Array &z, float talus_ref);
+
+  /**
+   * @brief Compute the flow accumulation.
+   *
+   * @param  p_contribution Optional per cell contribution (default to 1 for
+   *                        every cell).
+   * @return                Array Flow accumulation.
+   */
+  Array accumulate(const Array *p_contribution = nullptr) const;
+
+private:
+  /**
+   * @brief Multiple flow direction flag.
+   */
+  bool use_mfd = false;
+
+  /**
+   * @brief Smoothed elevation (MFD model only), used to compute the flow
+   * partition weights on the fly instead of storing them.
+   */
+  Array z_mfd;
+
+  /**
+   * @brief Flow-partition exponent (MFD model only).
+   */
+  Array p_mfd;
+
+  void build_stack();
+
+  void partition_weights(int i, int j, float *weights) const;
+};
+
 /**
  * @brief Computes the number of drainage paths for each cell based on the D8
  * flow direction model.
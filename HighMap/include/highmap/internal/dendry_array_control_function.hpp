@@ -140,7 +140,7 @@ public:
 protected:
   double EvaluateImpl(float x, float y) const
   {
-    return offset + scaling * noise_function.get_delegate()(x, y, 0.f);
+    return offset + scaling * noise_function.get_value(x, y, 0.f);
   }
 
   bool InsideDomainImpl(float x, float y) const
@@ -0,0 +1,160 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file indexed_heap.hpp
+ * @author  Otto Link (otto.link.bv@gmail.com)
+ * @brief Indexed binary min-heap with decrease-key, used by the shortest path
+ * and minimum spanning tree algorithms.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace hmap
+{
+
+/**
+ * @brief Binary min-heap of integer ids in [0, capacity[ with a priority key
+ * per id, supporting key update in O(log n).
+ *
+ * @tparam T Key type.
+ */
+template <typename T> class IndexedMinHeap
+{
+public:
+  /**
+   * @brief Construct a new heap.
+   *
+   * @param capacity Number of possible ids, ids are in [0, capacity[.
+   */
+  explicit IndexedMinHeap(size_t capacity) : pos(capacity, -1)
+  {
+  }
+
+  /**
+   * @brief Check whether an id is currently in the heap.
+   */
+  bool contains(int id) const
+  {
+    return this->pos[id] >= 0;
+  }
+
+  /**
+   * @brief Check whether the heap is empty.
+   */
+  bool empty() const
+  {
+    return this->heap.empty();
+  }
+
+  /**
+   * @brief Remove and return the id with the smallest key.
+   *
+   * @param  key[out] Key of the returned id.
+   * @return          int Id.
+   */
+  int pop(T &key)
+  {
+    std::pair<T, int> top = this->heap.front();
+    this->pos[top.second] = -1;
+
+    std::pair<T, int> last = this->heap.back();
+    this->heap.pop_back();
+
+    if (!this->heap.empty())
+    {
+      this->heap[0] = last;
+      this->pos[last.second] = 0;
+      this->sift_down(0);
+    }
+
+    key = top.first;
+    return top.second;
+  }
+
+  /**
+   * @brief Insert an id, or update its key if already in the heap and the new
+   * key is smaller (decrease-key).
+   *
+   * @param  id  Id.
+   * @param  key Key.
+   * @return     true if the id has been inserted or its key decreased.
+   */
+  bool push_or_decrease(int id, T key)
+  {
+    int k = this->pos[id];
+
+    if (k < 0)
+    {
+      this->heap.push_back({key, id});
+      k = (int)this->heap.size() - 1;
+      this->pos[id] = k;
+    }
+    else if (key < this->heap[k].first)
+      this->heap[k].first = key;
+    else
+      return false;
+
+    this->sift_up(k);
+    return true;
+  }
+
+  /**
+   * @brief Number of ids in the heap.
+   */
+  size_t size() const
+  {
+    return this->heap.size();
+  }
+
+private:
+  std::vector<std::pair<T, int>> heap; ///< {key, id} binary heap
+  std::vector<int>               pos;  ///< id position in the heap, or -1
+
+  void sift_down(int k)
+  {
+    int               n = (int)this->heap.size();
+    std::pair<T, int> item = this->heap[k];
+
+    while (true)
+    {
+      int c = 2 * k + 1;
+      if (c >= n) break;
+      if (c + 1 < n && this->heap[c + 1].first < this->heap[c].first) c++;
+      if (!(this->heap[c].first < item.first)) break;
+
+      this->heap[k] = this->heap[c];
+      this->pos[this->heap[k].second] = k;
+      k = c;
+    }
+
+    this->heap[k] = item;
+    this->pos[item.second] = k;
+  }
+
+  void sift_up(int k)
+  {
+    std::pair<T, int> item = this->heap[k];
+
+    while (k > 0)
+    {
+      int parent = (k - 1) / 2;
+      if (!(item.first < this->heap[parent].first)) break;
+
+      this->heap[k] = this->heap[parent];
+      this->pos[this->heap[k].second] = k;
+      k = parent;
+    }
+
+    this->heap[k] = item;
+    this->pos[item.second] = k;
+  }
+};
+
+} // namespace hmap
@@ -0,0 +1,157 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file point_location.hpp
+ * @author  Otto Link (otto.link.bv@gmail.com)
+ * @brief Spatial indexes for scattered points: triangle location within a
+ * triangulation (uniform bucket grid) and nearest neighbor search (k-d tree).
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include <vector>
+
+#include "highmap/array.hpp"
+
+namespace hmap
+{
+
+/**
+ * @brief Point location within a triangulation, based on a uniform grid of
+ * buckets storing the triangles overlapping each bucket.
+ *
+ * When several triangles contain the query point (shared edges or vertices),
+ * the first one in the triangulation ordering is returned, so that the results
+ * are the same as a linear scan of all the triangles.
+ */
+class TriangleLocator
+{
+public:
+  /**
+   * @brief Construct a new locator.
+   *
+   * @param x         Points x coordinates.
+   * @param y         Points y coordinates.
+   * @param triangles Triangle vertex indices, three consecutive indices per
+   *                  triangle (e.g. `delaunator::Delaunator::triangles`).
+   */
+  TriangleLocator(const std::vector<float>  &x,
+                  const std::vector<float>  &y,
+                  const std::vector<size_t> &triangles);
+
+  /**
+   * @brief Interpolate linearly point values at a given location.
+   *
+   * @param  x          Query x coordinate.
+   * @param  y          Query y coordinate.
+   * @param  values     Values at the triangulation points.
+   * @param  fill_value Value returned outside the triangulation.
+   * @return            Interpolated value.
+   */
+  float interpolate(float                     x,
+                    float                     y,
+                    const std::vector<float> &values,
+                    float                     fill_value) const;
+
+  /**
+   * @brief Find the triangle containing a given location.
+   *
+   * @param  x    Query x coordinate.
+   * @param  y    Query y coordinate.
+   * @param  s[out] First barycentric coordinate.
+   * @param  t[out] Second barycentric coordinate.
+   * @return        Index of the triangle first vertex in the `triangles`
+   *                vector, or -1 if the location is outside the triangulation.
+   */
+  int locate(float x, float y, float &s, float &t) const;
+
+  /**
+   * @brief Interpolate linearly point values on a regular grid by scanning
+   * each triangle once, instead of locating each grid node.
+   *
+   * @param array      Output array.
+   * @param xg         Grid x coordinates, in ascending order (size
+   *                   `array.shape.x`).
+   * @param yg         Grid y coordinates, in ascending order (size
+   *                   `array.shape.y`).
+   * @param values     Values at the triangulation points.
+   * @param fill_value Value used outside the triangulation.
+   */
+  void rasterize(Array                    &array,
+                 const std::vector<float> &xg,
+                 const std::vector<float> &yg,
+                 const std::vector<float> &values,
+                 float                     fill_value) const;
+
+private:
+  std::vector<float> x;         ///< Points x coordinates.
+  std::vector<float> y;         ///< Points y coordinates.
+  std::vector<int>   triangles; ///< Triangle vertex indices.
+  std::vector<float> inv_area;  ///< Inverse of twice the triangle areas.
+
+  Vec4<float> bbox;     ///< Bucket grid bounding box.
+  Vec2<int>   nbuckets; ///< Number of buckets in each direction.
+  Vec2<float> inv_size; ///< Inverse bucket size in each direction.
+
+  std::vector<int> bucket_offsets;   ///< CSR offsets of the buckets.
+  std::vector<int> bucket_triangles; ///< Triangles overlapping each bucket.
+
+  /**
+   * @brief Barycentric coordinates of a location with respect to a triangle.
+   */
+  void barycentric(int k, float x, float y, float &s, float &t) const;
+
+  /**
+   * @brief Bounding box of a triangle, slightly enlarged to account for the
+   * round-off errors of the barycentric coordinates.
+   */
+  Vec4<float> triangle_bbox(int k) const;
+};
+
+/**
+ * @brief Two-dimensional k-d tree for nearest neighbor queries.
+ *
+ * Ties are resolved in favor of the smallest point index, so that the results
+ * are the same as a linear scan of all the points.
+ */
+class KdTree2D
+{
+public:
+  /**
+   * @brief Construct a new tree.
+   *
+   * @param x Points x coordinates.
+   * @param y Points y coordinates.
+   */
+  KdTree2D(const std::vector<float> &x, const std::vector<float> &y);
+
+  /**
+   * @brief Find the nearest point to a given location.
+   *
+   * @param  x Query x coordinate.
+   * @param  y Query y coordinate.
+   * @return   Index of the nearest point, or -1 if the tree is empty.
+   */
+  int nearest(float x, float y) const;
+
+private:
+  std::vector<float> x;     ///< Points x coordinates.
+  std::vector<float> y;     ///< Points y coordinates.
+  std::vector<int>   nodes; ///< Implicit balanced tree (median splits).
+
+  void build(int lo, int hi, int axis);
+
+  void search(int    lo,
+              int    hi,
+              int    axis,
+              float  xq,
+              float  yq,
+              int   &best,
+              float &dbest) const;
+};
+
+} // namespace hmap
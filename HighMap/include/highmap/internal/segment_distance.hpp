@@ -0,0 +1,138 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file segment_distance.hpp
+ * @author  Otto Link (otto.link.bv@gmail.com)
+ * @brief Exact distance field to a set of segments, accelerated by a uniform
+ * bucket grid and by the distance transform of the rasterized segments.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "highmap/array.hpp"
+
+namespace hmap
+{
+
+/**
+ * @brief Distance to a set of segments (possibly degenerated to points).
+ *
+ * Distances are exact, i.e. the same as a linear scan of all the segments. The
+ * segments are stored in a uniform grid of buckets and the search is restricted
+ * to the buckets close to the query point. When filling a regular grid
+ * without any domain warping, the search is further restricted to a thin
+ * annulus around each grid node, obtained from the Euclidean distance transform
+ * of the rasterized segments.
+ */
+class SegmentDistance
+{
+public:
+  /**
+   * @brief Construct a new distance field, segment `k` goes from (xa[k],
+   * ya[k]) to (xb[k], yb[k]).
+   *
+   * @param xa Start points x coordinates.
+   * @param ya Start points y coordinates.
+   * @param xb End points x coordinates.
+   * @param yb End points y coordinates.
+   */
+  SegmentDistance(const std::vector<float> &xa,
+                  const std::vector<float> &ya,
+                  const std::vector<float> &xb,
+                  const std::vector<float> &yb);
+
+  /**
+   * @brief Return the squared distance to the nearest segment.
+   *
+   * @param  x      Query x coordinate.
+   * @param  y      Query y coordinate.
+   * @param  dmin   Lower bound of the distance (segments closer than this
+   *                bound are assumed not to exist).
+   * @param  radius Initial search radius, the search is expanded if no
+   *                segment is found within this radius.
+   * @return        Squared distance (maximum float value if there is no
+   *                segment).
+   */
+  float distance_squared(float x,
+                         float y,
+                         float dmin = 0.f,
+                         float radius = 0.f) const;
+
+  /**
+   * @brief Return whether a point is inside the polygon defined by the
+   * segments, using the same crossing rule as `Path::sdf_closed`.
+   *
+   * @param  x Query x coordinate.
+   * @param  y Query y coordinate.
+   * @return   True if inside.
+   */
+  bool is_inside(float x, float y) const;
+
+  /**
+   * @brief Return the distance field on a regular grid.
+   *
+   * @param  shape     Array shape.
+   * @param  bbox      Domain bounding box.
+   * @param  p_noise_x Reference to the input noise array used for domain
+   *                   warping (NOT in pixels, with respect to a unit domain).
+   * @param  p_noise_y Reference to the input noise array used for domain
+   *                   warping (NOT in pixels, with respect to a unit domain).
+   * @param  is_signed Whether the distance is signed (negative inside the
+   *                   polygon, see `is_inside`).
+   * @return           Distance field.
+   */
+  Array to_array(Vec2<int>    shape,
+                 Vec4<float>  bbox,
+                 const Array *p_noise_x = nullptr,
+                 const Array *p_noise_y = nullptr,
+                 bool         is_signed = false) const;
+
+private:
+  std::vector<float> xa, ya, xb, yb; ///< Segments end points.
+
+  Vec4<float> bbox;        ///< Bucket grid bounding box.
+  Vec2<int>   nbuckets;    ///< Number of buckets in each direction.
+  Vec2<float> bucket_size; ///< Bucket size in each direction.
+
+  std::vector<int> bucket_offsets;  ///< CSR offsets of the buckets.
+  std::vector<int> bucket_segments; ///< Segments overlapping each bucket.
+  std::vector<int> band_offsets;    ///< CSR offsets of the horizontal bands.
+  std::vector<int> band_segments;   ///< Segments spanning each band.
+
+  /**
+   * @brief Lower and upper bounds of the distance at each node of a regular
+   * grid, based on the distance transform of the rasterized segments.
+   *
+   * @return False if the bounds are not available (segments too far away from
+   *         the grid).
+   */
+  bool grid_distance_bounds(const std::vector<float> &xg,
+                            const std::vector<float> &yg,
+                            Array                    &dlow,
+                            Array                    &dup) const;
+
+  /**
+   * @brief Squared distance to a given segment.
+   */
+  float segment_distance_squared(int k, float x, float y) const;
+
+  /**
+   * @brief Update the squared distance `best` with the buckets whose distance
+   * to the query point is within ]r_in, r_out] (and larger than `dmin`).
+   */
+  void visit_buckets(float  x,
+                     float  y,
+                     float  r_in,
+                     float  r_out,
+                     float  dmin,
+                     float &best) const;
+};
+
+} // namespace hmap
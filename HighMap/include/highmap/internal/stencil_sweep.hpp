@@ -0,0 +1,126 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file stencil_sweep.hpp
+ * @author  Otto Link (otto.link.bv@gmail.com)
+ * @brief In-place sweeps of 3x3 stencil updates over the interior cells of an
+ * array, either sequential (raster scan) or multi-threaded using a multi-color
+ * checkerboard schedule.
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+
+#include "highmap/algebra.hpp"
+#include "highmap/thread_pool.hpp"
+
+namespace hmap
+{
+
+/**
+ * @brief Moore neighborhood (8 neighbors) with a fixed size, stored as index
+ * offsets and as linear offsets for a given row length.
+ */
+struct MooreStencil
+{
+  std::array<int, 8> di; ///< Neighbor offsets along i.
+  std::array<int, 8> dj; ///< Neighbor offsets along j.
+  std::array<int, 8> dr; ///< Neighbor linear offsets, `dj * nx + di`.
+
+  /**
+   * @brief Construct a new stencil.
+   *
+   * @param di Neighbor offsets along i.
+   * @param dj Neighbor offsets along j.
+   * @param nx Row length of the array (`shape.x`).
+   */
+  MooreStencil(const std::array<int, 8> &di,
+               const std::array<int, 8> &dj,
+               int                       nx)
+      : di(di), dj(dj), nx(nx)
+  {
+    this->update_linear_offsets();
+  }
+
+  /**
+   * @brief Rotate the neighbor ordering by one position (same as
+   * `std::rotate(v.begin(), v.begin() + 1, v.end())` on the offsets).
+   */
+  void rotate()
+  {
+    std::rotate(this->di.begin(), this->di.begin() + 1, this->di.end());
+    std::rotate(this->dj.begin(), this->dj.begin() + 1, this->dj.end());
+    this->update_linear_offsets();
+  }
+
+private:
+  int nx;
+
+  void update_linear_offsets()
+  {
+    for (int k = 0; k < 8; k++)
+      this->dr[k] = this->dj[k] * this->nx + this->di[k];
+  }
+};
+
+/**
+ * @brief Apply an in-place stencil update `fct(i, j)` to each interior cell
+ * (i in [1, shape.x - 1[, j in [1, shape.y - 1[).
+ *
+ * The update of a cell may read and write the cells of its 3x3 neighborhood.
+ * Sequential sweeps follow the raster scan, rows first (j outer loop) or
+ * columns first (i outer loop). Parallel sweeps process the cells in 9 passes
+ * (one per color, i.e. per `(i % 3, j % 3)` class): cells of the same color are
+ * at least 3 cells apart, their neighborhoods do not overlap and they can be
+ * updated concurrently. The result is deterministic and does not depend on the
+ * number of threads, but it differs from the sequential raster scan.
+ *
+ * @tparam F             Update function type, `void(int i, int j)`.
+ * @param  shape         Array shape.
+ * @param  parallel      Whether the multi-color parallel schedule is used.
+ * @param  columns_first Sequential scan order, columns first if true.
+ * @param  fct           Update function.
+ */
+template <typename F>
+void stencil_sweep(Vec2<int> shape, bool parallel, bool columns_first, F &&fct)
+{
+  if (!parallel)
+  {
+    if (columns_first)
+    {
+      for (int i = 1; i < shape.x - 1; i++)
+        for (int j = 1; j < shape.y - 1; j++)
+          fct(i, j);
+    }
+    else
+    {
+      for (int j = 1; j < shape.y - 1; j++)
+        for (int i = 1; i < shape.x - 1; i++)
+          fct(i, j);
+    }
+    return;
+  }
+
+  for (int cj = 0; cj < 3; cj++)
+    for (int ci = 0; ci < 3; ci++)
+    {
+      // rows of the current color, starting from j = 1 + cj
+      int nrows = std::max(0, (shape.y - 2 - cj + 2) / 3);
+
+      parallel_for(nrows,
+                   [&](size_t r)
+                   {
+                     int j = 1 + cj + 3 * (int)r;
+                     for (int i = 1 + ci; i < shape.x - 1; i += 3)
+                       fct(i, j);
+                   });
+    }
+}
+
+} // namespace hmap
@@ -23,6 +23,8 @@
 namespace hmap
 {
 
+class Function;
+
 /**
  * @brief Add a kernel to a specified position in an array.
  *
@@ -216,6 +218,34 @@ void fill_array_using_xy_function(
     const Array                              *p_stretching,
     std::function<float(float, float, float)> fct_xy);
 
+/**
+ * @brief Fill an array using a Function object based on (x, y) coordinates.
+ *
+ * Same as above, but the function is evaluated row by row using the batched
+ * evaluation `Function::get_values`, which avoids a type-erased call for each
+ * cell. This overload should be preferred for noise functions.
+ *
+ * @param array        The array to be filled with computed values.
+ * @param bbox         The bounding box of the domain specified as {xmin, xmax,
+ *                     ymin, ymax}.
+ * @param p_ctrl_param Pointer to an array of control parameters affecting the
+ *                     scalar function.
+ * @param p_noise_x    Pointer to an array of noise values along the x-direction
+ *                     for domain warping.
+ * @param p_noise_y    Pointer to an array of noise values along the y-direction
+ *                     for domain warping.
+ * @param p_stretching Pointer to an array of local wavenumber multipliers for
+ *                     adjusting the function.
+ * @param fct          The function object.
+ */
+void fill_array_using_xy_function(Array          &array,
+                                  Vec4<float>     bbox,
+                                  const Array    *p_ctrl_param,
+                                  const Array    *p_noise_x,
+                                  const Array    *p_noise_y,
+                                  const Array    *p_stretching,
+                                  const Function &fct);
+
 /**
  * @brief Fill an array using a scalar function based on (x, y) coordinates with
  * subsampling.
@@ -257,6 +287,15 @@ void fill_array_using_xy_function(
     std::function<float(float, float, float)> fct_xy,
     int                                       subsampling); ///< @overload
 
+void fill_array_using_xy_function(Array          &array,
+                                  Vec4<float>     bbox,
+                                  const Array    *p_ctrl_param,
+                                  const Array    *p_noise_x,
+                                  const Array    *p_noise_y,
+                                  const Array    *p_stretching,
+                                  const Function &fct,
+                                  int             subsampling); ///< @overload
+
 /**
  * @brief Find the vertical cut path with the minimum cost using Dijkstra's
  * algorithm.
@@ -281,6 +281,12 @@ Array dendry(Vec2<int>      shape,
  * particles that undergo a random walk until they stick to a seed, gradually
  * forming complex fractal structures.
  *
+ * Far from the cluster, walkers jump at once across the largest area free of
+ * any cluster cell (based on a distance-to-cluster field updated as the cells
+ * stick) instead of moving one cell at a time. Walkers are simulated
+ * concurrently and committed in a deterministic order, the pattern only
+ * depends on the seed.
+ *
  * @param  shape                      The dimensions of the grid where the DLA
  *                                    pattern will be generated. It is
  *                                    represented as a `Vec2<int>` object, where
@@ -54,6 +54,35 @@ Array hillshade(const Array &z,
                 float        zenith,
                 float        talus_ref = 1.f);
 
+/**
+ * @brief Compute the cast shadows of a heightmap for a given light direction.
+ *
+ * The horizon angle of each cell in the light direction is computed with line
+ * sweeps over a grid aligned with the light direction (the lines are swept
+ * concurrently, with a cost proportional to the number of cells), and a cell
+ * is in the shadow if its horizon is above the light.
+ *
+ * @param  z         Input array representing the heightmap.
+ * @param  azimuth   Light azimuth (direction) in degrees, same convention as
+ *                   `shadow_heightmap`.
+ * @param  zenith    Light zenith (elevation above the horizontal) in degrees.
+ * @param  talus_ref Reference talus, i.e. elevation difference between two
+ *                   neighbor cells corresponding to a 45 degrees slope, must
+ *                   be positive (every cell is lit otherwise). Default is 1.f.
+ * @return           Array Light visibility, 1 for lit cells and 0 for cells in
+ *                   the shadow.
+ *
+ * @note The hillshading applied by the colorization and export functions
+ * (`apply_hillshade`) is still based on `hillshade` only, cast shadows must be
+ * combined explicitly.
+ *
+ * @see              {@link sky_view_factor}
+ */
+Array shadow_cast(const Array &z,
+                  float        azimuth,
+                  float        zenith,
+                  float        talus_ref = 1.f);
+
 /**
  * @brief Compute the shadow intensity using a grid-based technique.
  *
@@ -64,6 +93,9 @@ Array hillshade(const Array &z,
  * @param  z            Input array representing the heightmap.
  * @param  shadow_talus Parameter affecting the shadow intensity computation.
  * @return              Array Resulting shadow intensity map.
+ *
+ * @note Shadows are only cast along the +x direction (light coming from the
+ * low `i` side), use `shadow_cast` for an arbitrary light direction.
  */
 Array shadow_grid(const Array &z, float shadow_talus);
 
@@ -79,12 +111,38 @@ Array shadow_grid(const Array &z, float shadow_talus);
  * @param  zenith   Light zenith (elevation) in degrees. Default is 45.f.
  * @param  distance Light distance. Default is 0.2f.
  * @return          Array Resulting crude shadow map.
+ *
+ * @note Only the diffuse and ambient lighting are computed, use `shadow_cast`
+ * for the cast shadows.
  */
 Array shadow_heightmap(const Array &z,
                        float        azimuth = 180.f,
                        float        zenith = 45.f,
                        float        distance = 0.2f);
 
+/**
+ * @brief Compute the sky view factor of a heightmap, i.e. the fraction of the
+ * sky visible from each cell, which can be used as an ambient occlusion term.
+ *
+ * The horizon angle is computed for a set of directions evenly distributed
+ * around each cell (see `shadow_cast`), and the sky view factor is `1 -
+ * mean(sin(horizon angle))`.
+ *
+ * @param  z           Input array representing the heightmap.
+ * @param  ndirections Number of directions. Default is 16.
+ * @param  talus_ref   Reference talus, i.e. elevation difference between two
+ *                     neighbor cells corresponding to a 45 degrees slope, must
+ *                     be positive (the sky is unobstructed otherwise).
+ *                     Default is 1.f.
+ * @return             Array Sky view factor, in [0, 1] (1 for an unobstructed
+ *                     sky).
+ *
+ * @see                {@link shadow_cast}
+ */
+Array sky_view_factor(const Array &z,
+                      int          ndirections = 16,
+                      float        talus_ref = 1.f);
+
 /**
  * @brief Compute the topographic shadow intensity in the range [-1, 1].
  *
@@ -12,6 +12,10 @@
  */
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "highmap/array.hpp"
 
 namespace hmap
@@ -26,6 +30,11 @@ namespace hmap
  * elevation and elevation change. The path is determined by minimizing the
  * combined cost function.
  *
+ * The frontier is managed with an indexed binary heap and the search stops as
+ * soon as the end cell is settled. For this single-target version, the search
+ * is guided by an A* heuristic based on the net elevation difference to the end
+ * cell (a lower bound of the remaining cost).
+ *
  * @see                       @cite Dijkstra1971 and
  *                            https://math.stackexchange.com/questions/3088292
  *
@@ -68,6 +77,22 @@ void find_path_dijkstra(const Array      &z,
                         float             upward_penalization = 1.f,
                         const Array      *p_mask_nogo = nullptr);
 
+/**
+ * @brief Finds the paths with the lowest elevation and elevation difference
+ * between a starting point and a list of end points using Dijkstra's algorithm
+ * (single search, stopped once every end point is settled).
+ *
+ * @param ij_start            Starting coordinates (i, j) for the pathfinding.
+ * @param ij_end_list         List of ending coordinates (i, j).
+ * @param i_path_list[out]    Resulting paths indices in the i direction.
+ * @param j_path_list[out]    Resulting paths indices in the j direction.
+ * @param elevation_ratio     Balance factor between absolute elevation and
+ *                            elevation difference in the cost function.
+ * @param distance_exponent   Exponent used in the distance calculation.
+ * @param upward_penalization Penalize upstream slopes.
+ * @param p_mask_nogo         Optional pointer to an array mask that defines
+ *                            areas to avoid during pathfinding.
+ */
 void find_path_dijkstra(const Array                   &z,
                         Vec2<int>                      ij_start,
                         std::vector<Vec2<int>>         ij_end_list,
@@ -78,4 +103,140 @@ void find_path_dijkstra(const Array                   &z,
                         float        upward_penalization = 1.f,
                         const Array *p_mask_nogo = nullptr);
 
+/**
+ * @brief Reusable cost field for repeated shortest path queries over the same
+ * heightmap.
+ *
+ * The cost of the moves between neighboring cells is computed once (same cost
+ * function as `find_path_dijkstra`), and the state of the Dijkstra search
+ * started from each set of sources (settled distances, predecessors and
+ * frontier) is cached: a query for a target already settled only backtracks
+ * the path, and a query for a new target resumes the search where it stopped.
+ * Several sources can be used at once, in which case paths start from the
+ * closest source (cost-wise).
+ *
+ * Queries can be issued concurrently from several threads: the searches for
+ * different source sets run in parallel, queries sharing the same source set
+ * are serialized.
+ *
+ * @note The edge costs use 8 floats per cell, and each cached search about 16
+ * bytes per cell. At most `max_cached_searches` searches are kept (least
+ * recently used searches are released first), see also `clear_cache`.
+ *
+ * **Example**
+ * @include ex_cost_field.cpp
+ *
+ * **Result**
+ * @image html ex_cost_field0.png
+ * @image html ex_cost_field1.png
+ * @image html ex_cost_field2.png
+ */
+class CostField
+{
+public:
+  /**
+   * @brief Construct a new cost field.
+   *
+   * @param z                   Input heightmap.
+   * @param elevation_ratio     Balance factor between absolute elevation and
+   *                            elevation difference in the cost function.
+   * @param distance_exponent   Exponent used in the distance calculation.
+   * @param upward_penalization Penalize upstream slopes.
+   * @param p_mask_nogo         Optional pointer to an array mask that defines
+   *                            areas to avoid during pathfinding.
+   * @param max_cached_searches Maximum number of cached searches (0 to disable
+   *                            the caching, each query then runs its own
+   *                            search).
+   */
+  CostField(const Array &z,
+            float        elevation_ratio = 0.1f,
+            float        distance_exponent = 2.f,
+            float        upward_penalization = 1.f,
+            const Array *p_mask_nogo = nullptr,
+            size_t       max_cached_searches = 4);
+
+  ~CostField();
+
+  /**
+   * @brief Release the cached searches.
+   */
+  void clear_cache();
+
+  /**
+   * @brief Find the lowest cost path from a start cell to an end cell.
+   *
+   * @param  ij_start    Starting coordinates (i, j).
+   * @param  ij_end      Ending coordinates (i, j).
+   * @param  i_path[out] Path indices in the i direction.
+   * @param  j_path[out] Path indices in the j direction.
+   * @return             True if the end cell could be reached.
+   */
+  bool find_path(Vec2<int>         ij_start,
+                 Vec2<int>         ij_end,
+                 std::vector<int> &i_path,
+                 std::vector<int> &j_path) const;
+
+  /**
+   * @brief Find the lowest cost path from any of the source cells to an end
+   * cell.
+   *
+   * @param  ij_sources  Source coordinates (i, j).
+   * @param  ij_end      Ending coordinates (i, j).
+   * @param  i_path[out] Path indices in the i direction, starting with the
+   *                     selected source.
+   * @param  j_path[out] Path indices in the j direction.
+   * @return             True if the end cell could be reached.
+   */
+  bool find_path(const std::vector<Vec2<int>> &ij_sources,
+                 Vec2<int>                     ij_end,
+                 std::vector<int>             &i_path,
+                 std::vector<int>             &j_path) const;
+
+  /**
+   * @brief Return the cumulated cost of the lowest cost path from the sources
+   * to a given cell.
+   *
+   * @param  ij_sources Source coordinates (i, j).
+   * @param  ij_end     Ending coordinates (i, j).
+   * @return            Cost (maximum float value if the cell cannot be
+   *                    reached).
+   */
+  float get_cost(const std::vector<Vec2<int>> &ij_sources,
+                 Vec2<int>                     ij_end) const;
+
+  /**
+   * @brief Return the cumulated cost of the lowest cost path from the sources
+   * to every cell (the search is run until every cell is settled).
+   *
+   * @param  ij_sources Source coordinates (i, j).
+   * @return            Cost map.
+   */
+  Array get_cost_map(const std::vector<Vec2<int>> &ij_sources) const;
+
+private:
+  struct Search; ///< Resumable search from a set of sources.
+
+  struct CachedSearch
+  {
+    std::vector<int>        sources; ///< Sorted source linear indices.
+    std::shared_ptr<Search> search;
+    size_t                  last_use;
+  };
+
+  Vec2<int>          shape; ///< Heightmap shape.
+  std::vector<float> costs; ///< Cost of the 8 moves from each cell.
+  size_t             max_cached_searches;
+
+  mutable std::mutex                mutex;
+  mutable std::vector<CachedSearch> searches = {}; ///< LRU cache.
+  mutable size_t                    clock = 0;
+
+  // nullptr (with an error message) if the sources are empty or not within the
+  // heightmap
+  std::shared_ptr<Search> get_search(
+      const std::vector<Vec2<int>> &ij_sources) const;
+
+  bool is_within(Vec2<int> ij) const;
+};
+
 } // namespace hmap
\ No newline at end of file
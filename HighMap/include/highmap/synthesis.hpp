@@ -40,8 +40,9 @@ namespace hmap
  * non-parametric sampling method.
  *
  * This method generates a new heightmap by sampling patches from the input
- * array non-parametrically. It is a slow process and is based on the technique
- * described in @cite Efros1999.
+ * array non-parametrically. It is a slow process (exhaustive search of the
+ * best matching patch for each cell, multi-threaded) and is based on the
+ * technique described in @cite Efros1999.
  *
  * @param  array           Input array from which patches are sampled.
  * @param  patch_shape     Shape of the patches used for sampling.
@@ -0,0 +1,188 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file thread_pool.hpp
+ * @author Otto Link (otto.link.bv@gmail.com)
+ * @brief Library-wide work-stealing thread pool used to distribute tile-based
+ * computations.
+ *
+ * @copyright Copyright (c) 2023
+ */
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hmap
+{
+
+/**
+ * @brief The ThreadPool class is a singleton managing a fixed set of persistent
+ * worker threads with one task queue per worker (work-stealing).
+ *
+ * Workers pop tasks from the back of their own queue and steal from the front
+ * of the other queues when they run out of work. Tasks submitted from a worker
+ * thread are pushed to the worker own queue, tasks submitted from any other
+ * thread are dispatched in a round-robin fashion.
+ *
+ * The number of threads accounts for the calling thread, which takes part in
+ * the work when using `parallel_for`: with `n` threads, `n - 1` workers are
+ * spawned and a pool of one thread runs everything sequentially in the calling
+ * thread.
+ *
+ * ### Usage Example:
+ *
+ * @code
+ * hmap::set_num_threads(8);
+ *
+ * hmap::parallel_for(h.get_ntiles(),
+ *                    [&h](size_t k) { h.tiles[k] *= 2.f; });
+ * @endcode
+ */
+class ThreadPool
+{
+public:
+  /**
+   * @brief Gets the singleton instance of the ThreadPool class. Threads are
+   * started on first use using the hardware concurrency.
+   *
+   * @return ThreadPool& Reference to the singleton instance.
+   */
+  static ThreadPool &get_instance();
+
+  /**
+   * @brief Get the number of threads (workers and calling thread).
+   *
+   * @return size_t Number of threads.
+   */
+  size_t get_num_threads() const;
+
+  /**
+   * @brief Check whether the current thread is one of the pool workers.
+   *
+   * @return true  Current thread is a worker.
+   * @return false Otherwise.
+   */
+  bool is_worker_thread() const;
+
+  /**
+   * @brief Run `fct(k)` for `k` in [0, count[, distributed over the pool
+   * threads, and wait for completion.
+   *
+   * The calling thread also processes indices so that nested calls (from
+   * within a task) cannot deadlock. The first exception thrown by `fct` is
+   * rethrown in the calling thread once all the indices have been processed.
+   *
+   * @param count Number of indices.
+   * @param fct   Function to apply to each index.
+   */
+  void parallel_for(size_t count, const std::function<void(size_t)> &fct);
+
+  /**
+   * @brief Set the number of threads. The workers are stopped (after completion
+   * of the pending tasks) and restarted.
+   *
+   * @warning Must not be called from a pool task.
+   *
+   * @param new_num_threads Number of threads, if set to 0, the hardware
+   *                        concurrency is used.
+   */
+  void set_num_threads(size_t new_num_threads);
+
+  /**
+   * @brief Submit a task to the pool.
+   *
+   * @warning Waiting on the returned future from within a pool task may
+   * deadlock if all the workers end up waiting, use `parallel_for` for
+   * fork-join patterns instead.
+   *
+   * @tparam F   Callable type.
+   * @param  fct Task.
+   * @return     std::future holding the task result.
+   */
+  template <typename F>
+  auto submit(F &&fct) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+  {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+
+    auto p_task = std::make_shared<std::packaged_task<R()>>(
+        std::forward<F>(fct));
+    std::future<R> future = p_task->get_future();
+
+    this->push([p_task]() { (*p_task)(); });
+    return future;
+  }
+
+private:
+  /**
+   * @brief Per-worker task queue.
+   */
+  struct WorkerQueue
+  {
+    std::mutex                        mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  ThreadPool();
+
+  ~ThreadPool();
+
+  void push(std::function<void()> task);
+
+  void start(size_t new_num_threads);
+
+  void stop();
+
+  bool try_pop(size_t worker_id, std::function<void()> &task);
+
+  void worker_loop(size_t worker_id);
+
+  // Deleting the copy constructor and assignment operator to enforce singleton
+  // pattern.
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t                                    num_threads = 1;
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread>                  workers;
+  std::mutex                                wake_mutex;
+  std::condition_variable                   wake_cv;
+  std::atomic<size_t>                       pending = 0;
+  std::atomic<size_t>                       next_queue = 0;
+  bool                                      stopping = false;
+};
+
+/**
+ * @brief Get the number of threads used by the library thread pool.
+ *
+ * @return size_t Number of threads.
+ */
+size_t get_num_threads();
+
+/**
+ * @brief Run `fct(k)` for `k` in [0, count[ using the library thread pool (see
+ * ThreadPool::parallel_for).
+ *
+ * @param count Number of indices.
+ * @param fct   Function to apply to each index.
+ */
+void parallel_for(size_t count, const std::function<void(size_t)> &fct);
+
+/**
+ * @brief Set the number of threads used by the library thread pool.
+ *
+ * @param num_threads Number of threads, if set to 0, the hardware concurrency
+ *                    is used.
+ */
+void set_num_threads(size_t num_threads);
+
+} // namespace hmap
@@ -0,0 +1,179 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+   Public License. The full license is in the file LICENSE, distributed with
+   this software. */
+
+/**
+ * @file tile_cache.hpp
+ * @author Otto Link (otto.link.bv@gmail.com)
+ * @brief Bounded cache of tile data, with tiles paged to a scratch file on
+ * demand (out-of-core heightmaps).
+ *
+ * @copyright Copyright (c) 2023 Otto Link
+ */
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hmap
+{
+
+/**
+ * @brief Bounded cache of tile data.
+ *
+ * Tile storages (the `std::vector<float>` of the tile arrays) are registered
+ * to the cache, which then owns their residency: a tile must be pinned to be
+ * accessed and, once unpinned, can be written to a scratch file and released
+ * (least recently used tiles first) to keep the memory used by the resident
+ * tiles under the memory budget. The budget can only be exceeded when all the
+ * resident tiles are pinned.
+ *
+ * A cache can be shared by several heightmaps, the budget then applies to all
+ * of them. Tiles can be prefetched asynchronously (by a dedicated thread) to
+ * overlap the disk reads with the computations.
+ *
+ * All the methods are thread-safe.
+ */
+class TileCache
+{
+public:
+  /**
+   * @brief Construct a new tile cache.
+   *
+   * @param memory_budget Memory budget for the resident tiles, in bytes.
+   * @param scratch_fname Scratch file name, a file in the temporary directory
+   *                      is used if empty. The file is removed when the cache
+   *                      is destroyed.
+   */
+  TileCache(size_t memory_budget, const std::string &scratch_fname = "");
+
+  TileCache(const TileCache &) = delete;
+
+  TileCache &operator=(const TileCache &) = delete;
+
+  ~TileCache();
+
+  size_t get_memory_budget() const; ///< Memory budget, in bytes.
+  size_t get_memory_usage() const;  ///< Resident tiles memory, in bytes.
+
+  /**
+   * @brief Register a tile storage. If the storage is empty, the tile is
+   * considered to be filled with zeros and is not allocated until it is
+   * pinned, otherwise its current content is resident (and may be evicted
+   * right away).
+   *
+   * @warning The storage address must remain valid until the tile is
+   * removed.
+   *
+   * @param  p_data Tile storage.
+   * @param  size   Number of values of the tile.
+   * @return        int Tile identifier.
+   */
+  int add(std::vector<float> *p_data, size_t size);
+
+  /**
+   * @brief Pin a tile: load it if it is not resident and prevent its eviction
+   * until it is unpinned (pins are counted).
+   *
+   * @param id Tile identifier.
+   */
+  void pin(int id);
+
+  /**
+   * @brief Request the asynchronous loading of a tile, which is then
+   * considered as the most recently used tile. Requests are ignored if the
+   * tile is already resident (or being loaded), already requested, or if it
+   * cannot be loaded without exceeding the memory budget.
+   *
+   * @param id Tile identifier.
+   */
+  void prefetch(int id);
+
+  /**
+   * @brief Unregister a tile, its storage is left untouched.
+   *
+   * @param id Tile identifier.
+   */
+  void remove(int id);
+
+  /**
+   * @brief Unpin a tile.
+   *
+   * @param id          Tile identifier.
+   * @param is_modified Whether the tile data have been modified while pinned
+   *                    (unmodified tiles are not written back to the scratch
+   *                    file when evicted).
+   */
+  void unpin(int id, bool is_modified = true);
+
+private:
+  enum SlotState : int
+  {
+    SLOT_UNUSED,   ///< No tile registered.
+    SLOT_ZERO,     ///< Not resident, filled with zeros.
+    SLOT_STORED,   ///< Not resident, stored in the scratch file.
+    SLOT_LOADING,  ///< Being read from the scratch file.
+    SLOT_RESIDENT, ///< Resident.
+    SLOT_EVICTING, ///< Resident, being written to the scratch file.
+  };
+
+  struct Slot
+  {
+    std::vector<float> *p_data = nullptr;
+    size_t              size = 0;
+    SlotState           state = SlotState::SLOT_UNUSED;
+    int                 pins = 0;
+    bool                is_dirty = false; ///< Scratch file content outdated.
+    uint64_t            last_use = 0;
+    int64_t             offset = -1; ///< Position in the scratch file.
+  };
+
+  using Lock = std::unique_lock<std::mutex>;
+
+  size_t      memory_budget;
+  size_t      memory_usage = 0;   ///< Including the tiles being loaded.
+  size_t      evicting_bytes = 0; ///< Tiles being written, still resident.
+  uint64_t    clock = 0;          ///< Logical clock, for the tile last use.
+  std::string scratch_fname;
+
+  std::vector<Slot>              slots = {};
+  std::vector<int>               free_ids = {};
+  std::multimap<size_t, int64_t> free_extents = {}; ///< Size -> offset.
+  int64_t                        scratch_size = 0;
+
+  // scratch file, positional I/O on POSIX systems (concurrent reads and
+  // writes), a stream serialized by its own mutex otherwise
+  int          fd = -1;
+  std::fstream scratch;
+  std::mutex   scratch_mutex;
+
+  // the slot states are guarded by the mutex, which is released during the
+  // scratch file I/O (slots in a loading / evicting state are only accessed
+  // by the thread doing the I/O)
+  mutable std::mutex      mutex;
+  std::condition_variable io_cv; ///< Notified when an I/O completes.
+  std::deque<int>         prefetch_queue = {};
+  std::condition_variable prefetch_cv;
+  bool                    is_stopping = false;
+  std::thread             prefetch_thread;
+
+  bool evict(Lock &lock, int id);
+
+  bool load(Lock &lock, int id, bool force);
+
+  bool make_room(Lock &lock, size_t bytes, bool force);
+
+  void prefetch_loop();
+
+  bool read_scratch(int64_t offset, char *data, size_t bytes);
+
+  bool write_scratch(int64_t offset, const char *data, size_t bytes);
+};
+
+} // namespace hmap
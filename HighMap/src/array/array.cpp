@@ -7,6 +7,7 @@
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
+#include "highmap/dbg/profiler.hpp"
 #include "highmap/export.hpp"
 
 namespace hmap
@@ -19,11 +20,13 @@ Array::Array()
 Array::Array(Vec2<int> shape) : shape(shape)
 {
   this->vector.resize(this->shape.x * this->shape.y);
+  HMAP_PROFILE_COUNT("bytes allocated", sizeof(float) * this->vector.size());
 }
 
 Array::Array(Vec2<int> shape, float value) : shape(shape)
 {
   this->vector.resize(this->shape.x * this->shape.y);
+  HMAP_PROFILE_COUNT("bytes allocated", sizeof(float) * this->vector.size());
   std::fill(this->vector.begin(), this->vector.end(), value);
 }
 
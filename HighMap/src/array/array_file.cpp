@@ -0,0 +1,586 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "highmap/array_file.hpp"
+#include "highmap/thread_pool.hpp"
+
+#define HMAP_ARRAY_FILE_MAGIC "HMAPARR"
+#define HMAP_ARRAY_FILE_HEADER_SIZE 64
+#define HMAP_ARRAY_FILE_TILE_ENTRY_SIZE 24
+#define HMAP_ARRAY_FILE_ALIGNMENT 64
+#define HMAP_ARRAY_FILE_BITPACK_BLOCK 128
+
+namespace hmap
+{
+
+namespace
+{
+
+template <typename T> void put(char *p, size_t &pos, T v)
+{
+  std::memcpy(p + pos, &v, sizeof(T));
+  pos += sizeof(T);
+}
+
+template <typename T> T get(const char *p, size_t &pos)
+{
+  T v;
+  std::memcpy(&v, p + pos, sizeof(T));
+  pos += sizeof(T);
+  return v;
+}
+
+size_t align(size_t offset)
+{
+  size_t a = HMAP_ARRAY_FILE_ALIGNMENT;
+  return (offset + a - 1) / a * a;
+}
+
+// index extent {i1, i2, j1, j2} of a tile, the tile shape is rounded up so
+// that the last tiles of each row / column may be smaller
+Vec4<int> tile_extent(Vec2<int> shape, Vec2<int> tiling, int it, int jt)
+{
+  int ni = (shape.x + tiling.x - 1) / tiling.x;
+  int nj = (shape.y + tiling.y - 1) / tiling.y;
+
+  return Vec4<int>(std::min(it * ni, shape.x),
+                   std::min((it + 1) * ni, shape.x),
+                   std::min(jt * nj, shape.y),
+                   std::min((jt + 1) * nj, shape.y));
+}
+
+// zigzag encoding of the differences between consecutive values (the first
+// value of a row is compared to the first value of the previous row)
+std::vector<uint32_t> delta_encode(const std::vector<uint16_t> &v, int ni)
+{
+  std::vector<uint32_t> d(v.size());
+
+  for (size_t k = 0; k < v.size(); k++)
+  {
+    int32_t pred = 0;
+    if (k % ni > 0)
+      pred = v[k - 1];
+    else if (k >= (size_t)ni)
+      pred = v[k - ni];
+
+    int32_t delta = (int32_t)v[k] - pred;
+    d[k] = (uint32_t)((delta << 1) ^ (delta >> 31));
+  }
+
+  return d;
+}
+
+std::vector<char> bitpack_encode(const std::vector<uint16_t> &v, int ni)
+{
+  std::vector<uint32_t> d = delta_encode(v, ni);
+  std::vector<char>     out = {};
+
+  for (size_t k0 = 0; k0 < d.size(); k0 += HMAP_ARRAY_FILE_BITPACK_BLOCK)
+  {
+    size_t k1 = std::min(d.size(), k0 + HMAP_ARRAY_FILE_BITPACK_BLOCK);
+
+    // number of bits of the block
+    uint32_t dmax = *std::max_element(d.begin() + k0, d.begin() + k1);
+    int      nbits = 0;
+    while (nbits < 32 && (dmax >> nbits) > 0)
+      nbits++;
+
+    out.push_back((char)nbits);
+
+    size_t   pos = out.size();
+    uint64_t acc = 0;
+    int      nacc = 0;
+
+    out.resize(pos + ((k1 - k0) * nbits + 7) / 8, 0);
+
+    for (size_t k = k0; k < k1; k++)
+    {
+      acc |= (uint64_t)d[k] << nacc;
+      nacc += nbits;
+      while (nacc >= 8)
+      {
+        out[pos++] = (char)(acc & 0xff);
+        acc >>= 8;
+        nacc -= 8;
+      }
+    }
+    if (nacc > 0) out[pos] = (char)(acc & 0xff);
+  }
+
+  return out;
+}
+
+bool bitpack_decode(const char            *p,
+                    size_t                 size,
+                    std::vector<uint16_t> &v,
+                    int                    ni)
+{
+  size_t pos = 0;
+
+  for (size_t k0 = 0; k0 < v.size(); k0 += HMAP_ARRAY_FILE_BITPACK_BLOCK)
+  {
+    size_t k1 = std::min(v.size(), k0 + HMAP_ARRAY_FILE_BITPACK_BLOCK);
+
+    if (pos >= size) return false;
+    int nbits = (uint8_t)p[pos++];
+    if (nbits > 32 || pos + ((k1 - k0) * nbits + 7) / 8 > size) return false;
+
+    uint64_t mask = (uint64_t(1) << nbits) - 1;
+    uint64_t acc = 0;
+    int      nacc = 0;
+
+    for (size_t k = k0; k < k1; k++)
+    {
+      while (nacc < nbits)
+      {
+        acc |= (uint64_t)(uint8_t)p[pos++] << nacc;
+        nacc += 8;
+      }
+
+      uint32_t d = (uint32_t)(acc & mask);
+      acc >>= nbits;
+      nacc -= nbits;
+
+      int32_t delta = (int32_t)(d >> 1) ^ -(int32_t)(d & 1);
+      int32_t pred = 0;
+      if (k % ni > 0)
+        pred = v[k - 1];
+      else if (k >= (size_t)ni)
+        pred = v[k - ni];
+
+      v[k] = (uint16_t)(pred + delta);
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------
+// ArrayView
+//----------------------------------------------------------------------
+
+Array ArrayView::to_array() const
+{
+  Array array = Array(this->shape);
+  if (this->data)
+    std::copy(this->data, this->data + array.size(), array.vector.begin());
+  return array;
+}
+
+//----------------------------------------------------------------------
+// writer
+//----------------------------------------------------------------------
+
+bool write_array_file(const std::string &fname,
+                      const Array       &array,
+                      Vec2<int>          tiling,
+                      ArrayFileDtype     dtype,
+                      ArrayFileCodec     codec,
+                      Vec4<float>        bbox)
+{
+  if (tiling.x < 1 || tiling.y < 1)
+  {
+    LOG_ERROR("invalid tiling: {%d, %d}", tiling.x, tiling.y);
+    return false;
+  }
+
+  if (codec == CODEC_DELTA_BITPACK && dtype != DTYPE_UINT16)
+  {
+    LOG_ERROR("delta-bitpack codec is only available for 16-bit data");
+    return false;
+  }
+
+  float vmin = array.size() > 0 ? array.min() : 0.f;
+  float vmax = array.size() > 0 ? array.max() : 0.f;
+  float a = vmax > vmin ? 65535.f / (vmax - vmin) : 0.f;
+
+  // --- encode the tiles (uncompressed 32-bit tiles are written directly
+  // --- from the array rows)
+
+  int                            ntiles = tiling.x * tiling.y;
+  std::vector<std::vector<char>> encoded(ntiles);
+  std::vector<uint64_t>          sizes(ntiles);
+
+  auto lambda_encode = [&](size_t k)
+  {
+    int       it = (int)k % tiling.x;
+    int       jt = (int)k / tiling.x;
+    Vec4<int> ext = tile_extent(array.shape, tiling, it, jt);
+    int       ni = ext.b - ext.a;
+    size_t    n = (size_t)ni * (ext.d - ext.c);
+
+    if (dtype == DTYPE_FLOAT32)
+    {
+      sizes[k] = n * sizeof(float);
+      return;
+    }
+
+    std::vector<uint16_t> v(n);
+    size_t                r = 0;
+
+    for (int j = ext.c; j < ext.d; j++)
+      for (int i = ext.a; i < ext.b; i++)
+        v[r++] = (uint16_t)std::lround(a * (array(i, j) - vmin));
+
+    if (codec == CODEC_DELTA_BITPACK)
+      encoded[k] = bitpack_encode(v, ni);
+    else
+    {
+      encoded[k].resize(n * sizeof(uint16_t));
+      std::memcpy(encoded[k].data(), v.data(), encoded[k].size());
+    }
+
+    sizes[k] = encoded[k].size();
+  };
+
+  parallel_for(ntiles, lambda_encode);
+
+  // --- header and tile table
+
+  std::vector<uint64_t> offsets(ntiles);
+  size_t                offset = align(HMAP_ARRAY_FILE_HEADER_SIZE +
+                                       HMAP_ARRAY_FILE_TILE_ENTRY_SIZE *
+                                           ntiles);
+
+  for (int k = 0; k < ntiles; k++)
+  {
+    offsets[k] = offset;
+    offset = align(offset + sizes[k]);
+  }
+
+  std::vector<char> head(offsets.empty() ? 0 : offsets[0], 0);
+  size_t            pos = 0;
+
+  std::memcpy(head.data(), HMAP_ARRAY_FILE_MAGIC, 8);
+  pos += 8;
+  put<uint32_t>(head.data(), pos, HMAP_ARRAY_FILE_VERSION);
+  put<uint32_t>(head.data(), pos, dtype);
+  put<int32_t>(head.data(), pos, array.shape.x);
+  put<int32_t>(head.data(), pos, array.shape.y);
+  put<int32_t>(head.data(), pos, tiling.x);
+  put<int32_t>(head.data(), pos, tiling.y);
+  put<float>(head.data(), pos, bbox.a);
+  put<float>(head.data(), pos, bbox.b);
+  put<float>(head.data(), pos, bbox.c);
+  put<float>(head.data(), pos, bbox.d);
+  put<float>(head.data(), pos, vmin);
+  put<float>(head.data(), pos, vmax);
+
+  pos = HMAP_ARRAY_FILE_HEADER_SIZE;
+  for (int k = 0; k < ntiles; k++)
+  {
+    put<uint64_t>(head.data(), pos, offsets[k]);
+    put<uint64_t>(head.data(), pos, sizes[k]);
+    put<uint32_t>(head.data(), pos, codec);
+    put<uint32_t>(head.data(), pos, 0);
+  }
+
+  // --- bulk write
+
+  std::ofstream f(fname, std::ios::binary);
+
+  if (!f)
+  {
+    LOG_ERROR("could not open file: %s", fname.c_str());
+    return false;
+  }
+
+  f.write(head.data(), head.size());
+
+  const std::vector<char> padding(HMAP_ARRAY_FILE_ALIGNMENT, 0);
+
+  for (int k = 0; k < ntiles; k++)
+  {
+    if (dtype == DTYPE_FLOAT32)
+    {
+      Vec4<int> ext = tile_extent(array.shape,
+                                  tiling,
+                                  k % tiling.x,
+                                  k / tiling.x);
+
+      if (ext.b > ext.a)
+        for (int j = ext.c; j < ext.d; j++)
+          f.write(reinterpret_cast<const char *>(&array(ext.a, j)),
+                  sizeof(float) * (ext.b - ext.a));
+    }
+    else
+      f.write(encoded[k].data(), encoded[k].size());
+
+    size_t end = offsets[k] + sizes[k];
+    f.write(padding.data(), align(end) - end);
+  }
+
+  return (bool)f;
+}
+
+//----------------------------------------------------------------------
+// ArrayFile
+//----------------------------------------------------------------------
+
+ArrayFile::ArrayFile(const std::string &fname)
+{
+#ifndef _WIN32
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+      {
+        this->data = static_cast<const char *>(p);
+        this->size = st.st_size;
+      }
+    }
+    ::close(fd);
+  }
+#else
+  std::ifstream f(fname, std::ios::binary | std::ios::ate);
+  if (f)
+  {
+    this->buffer.resize((size_t)f.tellg());
+    f.seekg(0);
+    f.read(this->buffer.data(), this->buffer.size());
+    this->data = this->buffer.data();
+    this->size = this->buffer.size();
+  }
+#endif
+
+  if (!this->data)
+  {
+    LOG_ERROR("could not open file: %s", fname.c_str());
+    return;
+  }
+
+  // --- header
+
+  size_t pos = 8;
+
+  if (this->size < HMAP_ARRAY_FILE_HEADER_SIZE ||
+      std::memcmp(this->data, HMAP_ARRAY_FILE_MAGIC, 8) != 0 ||
+      get<uint32_t>(this->data, pos) != HMAP_ARRAY_FILE_VERSION)
+  {
+    LOG_ERROR("not an array file (or unsupported version): %s", fname.c_str());
+    this->close();
+    return;
+  }
+
+  this->dtype = (ArrayFileDtype)get<uint32_t>(this->data, pos);
+  this->shape.x = get<int32_t>(this->data, pos);
+  this->shape.y = get<int32_t>(this->data, pos);
+  this->tiling.x = get<int32_t>(this->data, pos);
+  this->tiling.y = get<int32_t>(this->data, pos);
+  this->bbox.a = get<float>(this->data, pos);
+  this->bbox.b = get<float>(this->data, pos);
+  this->bbox.c = get<float>(this->data, pos);
+  this->bbox.d = get<float>(this->data, pos);
+  this->range.x = get<float>(this->data, pos);
+  this->range.y = get<float>(this->data, pos);
+
+  // --- tile table
+
+  size_t ntiles = (size_t)std::max(0, this->tiling.x) *
+                  (size_t)std::max(0, this->tiling.y);
+  bool   is_valid = this->shape.x >= 0 && this->shape.y >= 0 && ntiles > 0 &&
+                  this->size >= HMAP_ARRAY_FILE_HEADER_SIZE +
+                                    HMAP_ARRAY_FILE_TILE_ENTRY_SIZE * ntiles;
+
+  pos = HMAP_ARRAY_FILE_HEADER_SIZE;
+  for (size_t k = 0; is_valid && k < ntiles; k++)
+  {
+    TileEntry e;
+    e.offset = get<uint64_t>(this->data, pos);
+    e.size = get<uint64_t>(this->data, pos);
+    e.codec = (ArrayFileCodec)get<uint32_t>(this->data, pos);
+    pos += sizeof(uint32_t);
+
+    // written as a difference to avoid any overflow of offset + size
+    is_valid = e.offset <= this->size && e.size <= this->size - e.offset;
+    this->tiles.push_back(e);
+  }
+
+  if (!is_valid)
+  {
+    LOG_ERROR("corrupted array file: %s", fname.c_str());
+    this->close();
+  }
+}
+
+ArrayFile::~ArrayFile()
+{
+  this->close();
+}
+
+void ArrayFile::close()
+{
+#ifndef _WIN32
+  if (this->data) munmap(const_cast<char *>(this->data), this->size);
+#endif
+  this->buffer.clear();
+  this->data = nullptr;
+  this->size = 0;
+  this->tiles.clear();
+}
+
+bool ArrayFile::is_open() const
+{
+  return this->data != nullptr;
+}
+
+Vec4<float> ArrayFile::get_bbox() const
+{
+  return this->bbox;
+}
+
+ArrayFileDtype ArrayFile::get_dtype() const
+{
+  return this->dtype;
+}
+
+Vec2<int> ArrayFile::get_shape() const
+{
+  return this->shape;
+}
+
+Vec2<int> ArrayFile::get_tiling() const
+{
+  return this->tiling;
+}
+
+Vec4<int> ArrayFile::get_tile_extent(int it, int jt) const
+{
+  return tile_extent(this->shape, this->tiling, it, jt);
+}
+
+bool ArrayFile::decode_tile(int        it,
+                            int        jt,
+                            Array     &array,
+                            Vec2<int>  origin) const
+{
+  if (!this->is_tile_valid(it, jt)) return false;
+
+  const TileEntry &e = this->tiles[jt * this->tiling.x + it];
+  const char      *p = this->data + e.offset;
+  Vec4<int>        ext = this->get_tile_extent(it, jt);
+  int              ni = ext.b - ext.a;
+  size_t           n = (size_t)ni * (ext.d - ext.c);
+
+  if (this->dtype == DTYPE_FLOAT32 && e.codec == CODEC_RAW &&
+      e.size == n * sizeof(float))
+  {
+    for (int j = ext.c; j < ext.d; j++)
+      std::memcpy(&array(origin.x, origin.y + j - ext.c),
+                  p + (size_t)(j - ext.c) * ni * sizeof(float),
+                  ni * sizeof(float));
+    return true;
+  }
+
+  if (this->dtype != DTYPE_UINT16)
+  {
+    LOG_ERROR("unsupported tile encoding");
+    return false;
+  }
+
+  std::vector<uint16_t> v(n);
+
+  if (e.codec == CODEC_RAW && e.size == n * sizeof(uint16_t))
+    std::memcpy(v.data(), p, e.size);
+  else if (e.codec != CODEC_DELTA_BITPACK || !bitpack_decode(p, e.size, v, ni))
+  {
+    LOG_ERROR("unsupported or corrupted tile encoding");
+    return false;
+  }
+
+  float a = (this->range.y - this->range.x) / 65535.f;
+  for (size_t r = 0; r < n; r++)
+    array(origin.x + (int)(r % ni), origin.y + (int)(r / ni)) = this->range.x +
+                                                                a * v[r];
+  return true;
+}
+
+bool ArrayFile::is_tile_valid(int it, int jt) const
+{
+  if (it < 0 || it >= this->tiling.x || jt < 0 || jt >= this->tiling.y ||
+      (size_t)jt * this->tiling.x + it >= this->tiles.size())
+  {
+    LOG_ERROR("tile index out of range: {%d, %d} (tiling {%d, %d})",
+              it,
+              jt,
+              this->tiling.x,
+              this->tiling.y);
+    return false;
+  }
+
+  return true;
+}
+
+Array ArrayFile::read() const
+{
+  if (!this->is_open()) return Array();
+
+  Array             array = Array(this->shape);
+  std::atomic<bool> is_decoded = true;
+
+  parallel_for(this->tiles.size(),
+               [this, &array, &is_decoded](size_t k)
+               {
+                 int       it = (int)k % this->tiling.x;
+                 int       jt = (int)k / this->tiling.x;
+                 Vec4<int> ext = this->get_tile_extent(it, jt);
+                 if (!this->decode_tile(it, jt, array, {ext.a, ext.c}))
+                   is_decoded = false;
+               });
+
+  return is_decoded ? array : Array();
+}
+
+Array ArrayFile::read_tile(int it, int jt) const
+{
+  if (!this->is_open() || !this->is_tile_valid(it, jt)) return Array();
+
+  Vec4<int> ext = this->get_tile_extent(it, jt);
+  Array     array = Array(Vec2<int>(ext.b - ext.a, ext.d - ext.c));
+
+  return this->decode_tile(it, jt, array, {0, 0}) ? array : Array();
+}
+
+ArrayView ArrayFile::view_tile(int it, int jt) const
+{
+  ArrayView view;
+
+  if (!this->is_open() || !this->is_tile_valid(it, jt) ||
+      this->dtype != DTYPE_FLOAT32)
+    return view;
+
+  const TileEntry &e = this->tiles[jt * this->tiling.x + it];
+  Vec4<int>        ext = this->get_tile_extent(it, jt);
+  Vec2<int>        tile_shape = {ext.b - ext.a, ext.d - ext.c};
+
+  if (e.codec != CODEC_RAW ||
+      e.size != (size_t)tile_shape.x * tile_shape.y * sizeof(float))
+    return view;
+
+  view.shape = tile_shape;
+  view.data = reinterpret_cast<const float *>(this->data + e.offset);
+  return view;
+}
+
+} // namespace hmap
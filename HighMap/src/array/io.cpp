@@ -21,8 +21,8 @@ void Array::from_file(const std::string &fname)
   std::ifstream f;
   f.open(fname, std::ios::binary);
 
-  for (auto &v : this->vector)
-    f.read(reinterpret_cast<char *>(&v), sizeof(float));
+  f.read(reinterpret_cast<char *>(this->vector.data()),
+         sizeof(float) * this->vector.size());
   f.close();
 }
 
@@ -103,8 +103,8 @@ void Array::to_file(const std::string &fname) const
   std::ofstream f;
   f.open(fname, std::ios::binary);
 
-  for (auto &v : this->vector)
-    f.write(reinterpret_cast<const char *>(&v), sizeof(float));
+  f.write(reinterpret_cast<const char *>(this->vector.data()),
+          sizeof(float) * this->vector.size());
 
   f.close();
 }
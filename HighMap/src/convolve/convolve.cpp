@@ -2,6 +2,7 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 
+#include <algorithm>
 #include <cmath>
 
 #include "macrologger.h"
@@ -13,6 +14,17 @@
 namespace hmap
 {
 
+// mirror index used for the padding of the 1D convolutions
+static int convolve1d_mirror(int k, int n)
+{
+  if (k < 0)
+    k = -k;
+  else if (k > n - 1)
+    k = 2 * n - 1 - k;
+
+  return std::clamp(k, 0, n - 1);
+}
+
 Array convolve1d_i(const Array              &array,
                    const std::vector<float> &kernel) // private
 {
@@ -21,25 +33,26 @@ Array convolve1d_i(const Array              &array,
   // padding extent
   const int nk = (int)kernel.size();
   const int i1 = (int)ceil(0.5f * (float)nk);
+  const int ni = array.shape.x;
+
+  // padded row, the kernel taps then run along contiguous memory
+  std::vector<int>   idx(ni + nk);
+  std::vector<float> row(ni + nk);
 
-  for (int p = 0; p < nk; p++)
+  for (int k = 0; k < ni + nk; k++)
+    idx[k] = convolve1d_mirror(k - i1, ni);
+
+  for (int j = 0; j < array.shape.y; j++)
   {
-    for (int i = 0; i < array.shape.x; i++)
-    {
-      int ii;
-      // east - west
-      if (i + p - i1 < 0)
-        ii = -(i + p - i1);
-      else if (i + p - i1 > array.shape.x - 1)
-        ii = 2 * array.shape.x - 1 - (i + p - i1);
-      else
-        ii = i + p - i1;
-
-      ii = std::clamp(ii, 0, array.shape.x - 1);
-
-      for (int j = 0; j < array.shape.y; j++)
-        array_out(i, j) += array(ii, j) * kernel[p];
-    }
+    const float *p_in = &array.vector[array.linear_index(0, j)];
+    float       *p_out = &array_out.vector[array.linear_index(0, j)];
+
+    for (int k = 0; k < ni + nk; k++)
+      row[k] = p_in[idx[k]];
+
+    for (int p = 0; p < nk; p++)
+      for (int i = 0; i < ni; i++)
+        p_out[i] += row[i + p] * kernel[p];
   }
 
   return array_out;
@@ -53,42 +66,75 @@ Array convolve1d_j(const Array              &array,
   // padding extent
   const int nk = (int)kernel.size();
   const int j1 = (int)ceil(0.5f * (float)nk);
+  const int ni = array.shape.x;
 
-  for (int q = 0; q < nk; q++)
+  // whole rows are accumulated
+  for (int j = 0; j < array.shape.y; j++)
   {
-    for (int j = 0; j < array.shape.y; j++)
-    {
-      int jj;
+    float *p_out = &array_out.vector[array.linear_index(0, j)];
 
-      // north - south
-      if (j + q - j1 < 0)
-        jj = -(j + q - j1);
-      else if (j + q - j1 > array.shape.y - 1)
-        jj = 2 * array.shape.y - 1 - (j + q - j1);
-      else
-        jj = j + q - j1;
-
-      jj = std::clamp(jj, 0, array.shape.y - 1);
+    for (int q = 0; q < nk; q++)
+    {
+      int          jj = convolve1d_mirror(j + q - j1, array.shape.y);
+      const float *p_in = &array.vector[array.linear_index(0, jj)];
 
-      for (int i = 0; i < array.shape.x; i++)
-        array_out(i, j) += array(i, jj) * kernel[q];
+      for (int i = 0; i < ni; i++)
+        p_out[i] += p_in[i] * kernel[q];
     }
   }
 
   return array_out;
 }
 
-Array convolve2d(const Array &array, const Array &kernel)
+Array convolve2d(const Array      &array,
+                 const Array      &kernel,
+                 ConvolutionMethod method,
+                 int               kernel_rank)
 {
-  const int i1 = (int)ceil(0.5f * (float)kernel.shape.x);
-  const int i2 = kernel.shape.x - i1;
-  const int j1 = (int)ceil(0.5f * (float)kernel.shape.y);
-  const int j2 = kernel.shape.y - j1;
+  if (method == CONVOLUTION_AUTO)
+  {
+    // estimated cost per cell (~ multiply-adds) of each method
+    const float nk = (float)kernel.size();
+    const float n = (float)array.size();
+    const float n_fft = (float)(array.shape.x + kernel.shape.x) *
+                        (float)(array.shape.y + kernel.shape.y);
 
-  Array array_buffered = generate_buffered_array(array, {i1, i2, j1, j2});
-  Array array_out = convolve2d_truncated(array_buffered, kernel);
+    float cost_direct = nk;
+    float cost_fft = 4.f * n_fft * std::log2(n_fft) / n;
 
-  return array_out;
+    method = cost_fft < cost_direct ? CONVOLUTION_FFT : CONVOLUTION_DIRECT;
+
+    // the kernel rank is only worth computing for non trivial kernels
+    if (nk > 25.f)
+    {
+      if (kernel_rank < 0) kernel_rank = convolve2d_svd_rank(kernel);
+      float cost_sep = kernel_rank * (kernel.shape.x + kernel.shape.y + 2.f);
+
+      if (cost_sep < std::min(cost_direct, cost_fft))
+        method = CONVOLUTION_SEPARABLE;
+    }
+  }
+
+  switch (method)
+  {
+  case CONVOLUTION_FFT:
+    return convolve2d_fft(array, kernel);
+
+  case CONVOLUTION_SEPARABLE:
+    if (kernel_rank < 0) kernel_rank = convolve2d_svd_rank(kernel);
+    return convolve2d_svd(array, kernel, kernel_rank);
+
+  default:
+  {
+    const int i1 = (int)ceil(0.5f * (float)kernel.shape.x);
+    const int i2 = kernel.shape.x - i1;
+    const int j1 = (int)ceil(0.5f * (float)kernel.shape.y);
+    const int j2 = kernel.shape.y - j1;
+
+    Array array_buffered = generate_buffered_array(array, {i1, i2, j1, j2});
+    return convolve2d_truncated(array_buffered, kernel);
+  }
+  }
 }
 
 Array convolve2d_truncated(const Array &array, const Array &kernel)
@@ -96,11 +142,23 @@ Array convolve2d_truncated(const Array &array, const Array &kernel)
   Array array_out = Array(Vec2<int>(array.shape.x - kernel.shape.x,
                                     array.shape.y - kernel.shape.y));
 
+  // kernel taps outside, contiguous (vectorized) rows inside
   for (int j = 0; j < array_out.shape.y; j++)
-    for (int i = 0; i < array_out.shape.x; i++)
-      for (int q = 0; q < kernel.shape.y; q++)
-        for (int p = 0; p < kernel.shape.x; p++)
-          array_out(i, j) += array(i + p, j + q) * kernel(p, q);
+  {
+    float *p_out = &array_out.vector[array_out.linear_index(0, j)];
+
+    for (int q = 0; q < kernel.shape.y; q++)
+    {
+      const float *p_in = &array.vector[array.linear_index(0, j + q)];
+
+      for (int p = 0; p < kernel.shape.x; p++)
+      {
+        float w = kernel(p, q);
+        for (int i = 0; i < array_out.shape.x; i++)
+          p_out[i] += p_in[i + p] * w;
+      }
+    }
+  }
 
   return array_out;
 }
@@ -0,0 +1,342 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <gsl/gsl_fft_complex.h>
+#include <gsl/gsl_fft_halfcomplex.h>
+#include <gsl/gsl_fft_real.h>
+
+#include "macrologger.h"
+
+#include "highmap/array.hpp"
+#include "highmap/boundary.hpp"
+#include "highmap/convolve.hpp"
+#include "highmap/thread_pool.hpp"
+
+// maximum number of FFT plans (transform shapes) cached per thread
+#define HMAP_FFT_PLAN_CACHE_SIZE 4
+
+namespace hmap
+{
+
+namespace
+{
+
+// GSL wavetables and workspaces for a 2D real transform of shape (nx, ny):
+// real transforms along i, complex transforms along j
+struct FFTPlan
+{
+  int nx, ny;
+
+  gsl_fft_real_wavetable        *real_wt = nullptr;
+  gsl_fft_halfcomplex_wavetable *hc_wt = nullptr;
+  gsl_fft_real_workspace        *real_ws = nullptr;
+  gsl_fft_complex_wavetable     *cplx_wt = nullptr;
+  gsl_fft_complex_workspace     *cplx_ws = nullptr;
+
+  FFTPlan(int nx, int ny) : nx(nx), ny(ny)
+  {
+    this->real_wt = gsl_fft_real_wavetable_alloc(nx);
+    this->hc_wt = gsl_fft_halfcomplex_wavetable_alloc(nx);
+    this->real_ws = gsl_fft_real_workspace_alloc(nx);
+    this->cplx_wt = gsl_fft_complex_wavetable_alloc(ny);
+    this->cplx_ws = gsl_fft_complex_workspace_alloc(ny);
+  }
+
+  ~FFTPlan()
+  {
+    gsl_fft_real_wavetable_free(this->real_wt);
+    gsl_fft_halfcomplex_wavetable_free(this->hc_wt);
+    gsl_fft_real_workspace_free(this->real_ws);
+    gsl_fft_complex_wavetable_free(this->cplx_wt);
+    gsl_fft_complex_workspace_free(this->cplx_ws);
+  }
+
+  FFTPlan(const FFTPlan &) = delete;
+  FFTPlan &operator=(const FFTPlan &) = delete;
+
+  // number of complex coefficients kept along i (Hermitian symmetry)
+  int nkx() const { return this->nx / 2 + 1; }
+
+  // forward transform of the real (nx, ny) input, row-major with a row length
+  // of nx. The spectrum is stored transposed, spectrum[2 * (k * ny + j)] (real
+  // and imaginary parts), so that the transforms along j are contiguous
+  void forward(const std::vector<double> &data, std::vector<double> &spectrum)
+  {
+    const int nk = this->nkx();
+
+    std::vector<double> row(this->nx);
+    spectrum.assign(2 * (size_t)nk * this->ny, 0.0);
+
+    for (int j = 0; j < this->ny; j++)
+    {
+      std::copy(data.begin() + (size_t)j * this->nx,
+                data.begin() + (size_t)(j + 1) * this->nx,
+                row.begin());
+
+      gsl_fft_real_transform(row.data(),
+                             1,
+                             this->nx,
+                             this->real_wt,
+                             this->real_ws);
+
+      // unpack GSL halfcomplex storage
+      for (int k = 0; k < nk; k++)
+      {
+        double re, im;
+        halfcomplex_get(row, k, re, im);
+        spectrum[2 * ((size_t)k * this->ny + j)] = re;
+        spectrum[2 * ((size_t)k * this->ny + j) + 1] = im;
+      }
+    }
+
+    for (int k = 0; k < nk; k++)
+      gsl_fft_complex_forward(&spectrum[2 * (size_t)k * this->ny],
+                              1,
+                              this->ny,
+                              this->cplx_wt,
+                              this->cplx_ws);
+  }
+
+  // normalized inverse transform, the spectrum is overwritten
+  void inverse(std::vector<double> &spectrum, std::vector<double> &data)
+  {
+    const int nk = this->nkx();
+
+    for (int k = 0; k < nk; k++)
+      gsl_fft_complex_inverse(&spectrum[2 * (size_t)k * this->ny],
+                              1,
+                              this->ny,
+                              this->cplx_wt,
+                              this->cplx_ws);
+
+    std::vector<double> row(this->nx);
+    data.resize((size_t)this->nx * this->ny);
+
+    for (int j = 0; j < this->ny; j++)
+    {
+      for (int k = 0; k < nk; k++)
+        halfcomplex_set(row,
+                        k,
+                        spectrum[2 * ((size_t)k * this->ny + j)],
+                        spectrum[2 * ((size_t)k * this->ny + j) + 1]);
+
+      gsl_fft_halfcomplex_inverse(row.data(),
+                                  1,
+                                  this->nx,
+                                  this->hc_wt,
+                                  this->real_ws);
+
+      std::copy(row.begin(), row.end(), data.begin() + (size_t)j * this->nx);
+    }
+  }
+
+private:
+  // GSL mixed-radix halfcomplex layout: r0, r1, i1, r2, i2, ..., and the
+  // Nyquist coefficient (real) last for an even size
+  void halfcomplex_get(const std::vector<double> &row,
+                       int                        k,
+                       double                    &re,
+                       double                    &im) const
+  {
+    if (k == 0)
+    {
+      re = row[0];
+      im = 0.0;
+    }
+    else if (2 * k == this->nx)
+    {
+      re = row[this->nx - 1];
+      im = 0.0;
+    }
+    else
+    {
+      re = row[2 * k - 1];
+      im = row[2 * k];
+    }
+  }
+
+  void halfcomplex_set(std::vector<double> &row, int k, double re, double im)
+      const
+  {
+    if (k == 0)
+      row[0] = re;
+    else if (2 * k == this->nx)
+      row[this->nx - 1] = re;
+    else
+    {
+      row[2 * k - 1] = re;
+      row[2 * k] = im;
+    }
+  }
+};
+
+} // namespace
+
+// plans are cached per thread (GSL workspaces cannot be shared), keyed by
+// the transform shape. Only the most recently used plans are kept, the
+// reference remains valid until the next call in the same thread
+static FFTPlan &get_fft_plan(int nx, int ny)
+{
+  struct CachedPlan
+  {
+    std::unique_ptr<FFTPlan> p_plan;
+    size_t                   last_use;
+  };
+
+  thread_local std::vector<CachedPlan> plans;
+  thread_local size_t                  clock = 0;
+
+  for (auto &cached : plans)
+    if (cached.p_plan->nx == nx && cached.p_plan->ny == ny)
+    {
+      cached.last_use = ++clock;
+      return *cached.p_plan;
+    }
+
+  if (plans.size() >= HMAP_FFT_PLAN_CACHE_SIZE)
+    plans.erase(std::min_element(plans.begin(),
+                                 plans.end(),
+                                 [](const CachedPlan &a, const CachedPlan &b)
+                                 { return a.last_use < b.last_use; }));
+
+  plans.push_back({std::make_unique<FFTPlan>(nx, ny), ++clock});
+
+  return *plans.back().p_plan;
+}
+
+// cost of a 2D transform of size n (arbitrary unit)
+static float fft_cost(int nx, int ny)
+{
+  float n = (float)nx * (float)ny;
+  return n * std::log2(n);
+}
+
+// smallest integer >= n with only 2, 3 and 5 as prime factors (efficient GSL
+// mixed-radix transforms)
+static int fft_smooth_size(int n)
+{
+  for (int m = std::max(1, n);; m++)
+  {
+    int r = m;
+    for (int f : {2, 3, 5})
+      while (r % f == 0)
+        r /= f;
+    if (r == 1) return m;
+  }
+}
+
+Array convolve2d_fft(const Array &array, const Array &kernel, int tile_size)
+{
+  const int kx = kernel.shape.x;
+  const int ky = kernel.shape.y;
+  const int nx = array.shape.x;
+  const int ny = array.shape.y;
+
+  // same boundary conditions as the direct convolution
+  const int i1 = (int)ceil(0.5f * (float)kx);
+  const int j1 = (int)ceil(0.5f * (float)ky);
+
+  Array array_buffered = generate_buffered_array(array,
+                                                 {i1, kx - i1, j1, ky - j1});
+
+  // --- output tile size (overlap-save), chosen to minimize the overall cost
+  // --- if not provided
+
+  Vec2<int> tile;
+
+  if (tile_size > 0)
+    tile = Vec2<int>(std::min(nx, tile_size), std::min(ny, tile_size));
+  else
+  {
+    tile = array.shape;
+    float cost_min = fft_cost(fft_smooth_size(nx + kx),
+                              fft_smooth_size(ny + ky));
+
+    for (int b = 64; b < std::max(nx, ny); b *= 2)
+    {
+      Vec2<int> t = Vec2<int>(std::min(nx, b), std::min(ny, b));
+      int       ntiles = ((nx + t.x - 1) / t.x) * ((ny + t.y - 1) / t.y);
+      float     cost = ntiles * fft_cost(fft_smooth_size(t.x + kx),
+                                     fft_smooth_size(t.y + ky));
+
+      if (cost < cost_min)
+      {
+        cost_min = cost;
+        tile = t;
+      }
+    }
+  }
+
+  // transform size, large enough to avoid any wrap-around within a tile
+  const int fx = fft_smooth_size(tile.x + kx);
+  const int fy = fft_smooth_size(tile.y + ky);
+
+  // --- kernel spectrum, shared by all the tiles
+
+  std::vector<double> kernel_spectrum;
+  {
+    std::vector<double> data((size_t)fx * fy, 0.0);
+    for (int q = 0; q < ky; q++)
+      for (int p = 0; p < kx; p++)
+        data[(size_t)q * fx + p] = kernel(p, q);
+
+    get_fft_plan(fx, fy).forward(data, kernel_spectrum);
+  }
+
+  // --- overlap-save, each tile reads its output extent plus the kernel
+  // --- footprint from the buffered array
+
+  Array     array_out = Array(array.shape);
+  const int ntx = (nx + tile.x - 1) / tile.x;
+  const int nty = (ny + tile.y - 1) / tile.y;
+
+  auto lambda_tile = [&](size_t k)
+  {
+    const int i0 = (int)(k % ntx) * tile.x;
+    const int j0 = (int)(k / ntx) * tile.y;
+    const int bx = std::min(tile.x, nx - i0);
+    const int by = std::min(tile.y, ny - j0);
+
+    FFTPlan            &plan = get_fft_plan(fx, fy);
+    std::vector<double> data((size_t)fx * fy, 0.0);
+    std::vector<double> spectrum;
+
+    for (int q = 0; q < by + ky; q++)
+      for (int p = 0; p < bx + kx; p++)
+        data[(size_t)q * fx + p] = array_buffered(i0 + p, j0 + q);
+
+    plan.forward(data, spectrum);
+
+    // correlation (the kernel is not flipped): product with the conjugate
+    // of the kernel spectrum
+    for (size_t r = 0; r < spectrum.size(); r += 2)
+    {
+      double ar = spectrum[r];
+      double ai = spectrum[r + 1];
+      double br = kernel_spectrum[r];
+      double bi = kernel_spectrum[r + 1];
+
+      spectrum[r] = ar * br + ai * bi;
+      spectrum[r + 1] = ai * br - ar * bi;
+    }
+
+    plan.inverse(spectrum, data);
+
+    for (int j = 0; j < by; j++)
+      for (int i = 0; i < bx; i++)
+        array_out(i0 + i, j0 + j) = (float)data[(size_t)j * fx + i];
+  };
+
+  if (ntx * nty > 1)
+    parallel_for(ntx * nty, lambda_tile);
+  else
+    lambda_tile(0);
+
+  return array_out;
+}
+
+} // namespace hmap
@@ -16,44 +16,49 @@
 namespace hmap
 {
 
-Array convolve2d_svd(const Array &array, const Array &kernel, int rank)
+// SVD decomposition of the kernel: kernel(i, j) = sum_p s[p] * ki[p][i] *
+// kj[p][j], singular values in decreasing order
+static void kernel_svd(const Array                     &kernel,
+                       std::vector<float>              &s,
+                       std::vector<std::vector<float>> &ki,
+                       std::vector<std::vector<float>> &kj)
 {
-  Array array_out = Array(array.shape);
-
-  // --- perform SVD decomposition of the kernel
+  // GSL requires at least as many rows as columns, decompose the transposed
+  // kernel otherwise
+  const bool transposed = kernel.shape.x < kernel.shape.y;
+  const int  m = transposed ? kernel.shape.y : kernel.shape.x;
+  const int  n = transposed ? kernel.shape.x : kernel.shape.y;
 
-  gsl_matrix *mat_u = gsl_matrix_alloc(kernel.shape.x, kernel.shape.y);
-  gsl_matrix *mat_v = gsl_matrix_alloc(kernel.shape.y, kernel.shape.y);
-  gsl_vector *vec_s = gsl_vector_alloc(kernel.shape.y);
-  gsl_vector *vec_w = gsl_vector_alloc(kernel.shape.y); // work vector
+  gsl_matrix *mat_u = gsl_matrix_alloc(m, n);
+  gsl_matrix *mat_v = gsl_matrix_alloc(n, n);
+  gsl_vector *vec_s = gsl_vector_alloc(n);
+  gsl_vector *vec_w = gsl_vector_alloc(n); // work vector
 
   for (int j = 0; j < kernel.shape.y; j++)
     for (int i = 0; i < kernel.shape.x; i++)
-      gsl_matrix_set(mat_u, i, j, kernel(i, j));
+      if (transposed)
+        gsl_matrix_set(mat_u, j, i, kernel(i, j));
+      else
+        gsl_matrix_set(mat_u, i, j, kernel(i, j));
 
   // (NB - mat_v is the transpose of classical "V" of SVD formulation)
   gsl_linalg_SV_decomp(mat_u, mat_v, vec_s, vec_w);
 
-  // --- use SVD vectors for convolution with 1D kernels use SVD
-  // --- vectors for each singular SVD values as a pair of 1D //
-  // --- kernels
+  s.resize(n);
+  ki.assign(n, std::vector<float>(kernel.shape.x));
+  kj.assign(n, std::vector<float>(kernel.shape.y));
 
-  for (int p = 0; p < std::min(rank, kernel.shape.y); p++)
+  for (int p = 0; p < n; p++)
   {
-    Array              c2d = Array(array.shape);
-    std::vector<float> ki(kernel.shape.x);
-    std::vector<float> kj(kernel.shape.y);
+    s[p] = gsl_vector_get(vec_s, p);
 
     for (int i = 0; i < kernel.shape.x; i++)
-      ki[i] = gsl_matrix_get(mat_u, i, p);
+      ki[p][i] = transposed ? gsl_matrix_get(mat_v, i, p)
+                            : gsl_matrix_get(mat_u, i, p);
 
     for (int j = 0; j < kernel.shape.y; j++)
-      kj[j] = gsl_matrix_get(mat_v, j, p);
-
-    c2d = convolve1d_i(array, ki);
-    c2d = convolve1d_j(c2d, kj);
-
-    array_out += gsl_vector_get(vec_s, p) * c2d;
+      kj[p][j] = transposed ? gsl_matrix_get(mat_u, j, p)
+                            : gsl_matrix_get(mat_v, j, p);
   }
 
   // --- delete GSL objects
@@ -61,10 +66,48 @@ Array convolve2d_svd(const Array &array, const Array &kernel, int rank)
   gsl_matrix_free(mat_v);
   gsl_vector_free(vec_s);
   gsl_vector_free(vec_w);
+}
+
+Array convolve2d_svd(const Array &array, const Array &kernel, int rank)
+{
+  Array array_out = Array(array.shape);
+
+  // --- perform SVD decomposition of the kernel
+
+  std::vector<float>              s;
+  std::vector<std::vector<float>> ki, kj;
+
+  kernel_svd(kernel, s, ki, kj);
+
+  // --- use SVD vectors for convolution with 1D kernels use SVD
+  // --- vectors for each singular SVD values as a pair of 1D //
+  // --- kernels
+
+  for (int p = 0; p < std::min(rank, (int)s.size()); p++)
+  {
+    Array c2d = convolve1d_i(array, ki[p]);
+    c2d = convolve1d_j(c2d, kj[p]);
+
+    array_out += s[p] * c2d;
+  }
 
   return array_out;
 }
 
+int convolve2d_svd_rank(const Array &kernel, float tolerance)
+{
+  std::vector<float>              s;
+  std::vector<std::vector<float>> ki, kj;
+
+  kernel_svd(kernel, s, ki, kj);
+
+  int rank = 0;
+  while (rank < (int)s.size() && s[rank] > tolerance * s[0])
+    rank++;
+
+  return rank;
+}
+
 Array convolve2d_svd_rotated_kernel(const Array &array,
                                     const Array &kernel,
                                     int          rank,
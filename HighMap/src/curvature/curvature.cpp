@@ -2,6 +2,7 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include "highmap/curvature.hpp"
+#include "highmap/array_expr.hpp"
 #include "highmap/boundary.hpp"
 #include "highmap/filters.hpp"
 #include "highmap/range.hpp"
@@ -24,7 +25,7 @@ Array accumulation_curvature(const Array &z, int ir)
   Array k = compute_curvature_k(p, q, r, s, t);
   Array h = compute_curvature_h(r, t);
 
-  ac = h * h - k * k;
+  ac = lazy(h) * h - lazy(k) * k;
 
   set_borders(ac, 0.f, ir);
 
@@ -46,7 +47,8 @@ Array curvature_horizontal_cross_sectional(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = -2.f * (t * p * p + r * q * q + s * p * q) / (p * p + q * q + 1e-30f);
+  c = -2.f * (lazy(t) * p * p + lazy(r) * q * q + lazy(s) * p * q) /
+      (lazy(p) * p + lazy(q) * q + 1e-30f);
 
   set_borders(c, 0.f, ir);
 
@@ -61,8 +63,8 @@ Array curvature_horizontal_plan(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = -(t * p * p + r * q * q - 2.f * s * p * q) /
-      (pow(1.f + p * p + q * q, 1.5f));
+  c = -(lazy(t) * p * p + lazy(r) * q * q - 2.f * lazy(s) * p * q) /
+      (pow(1.f + lazy(p) * p + lazy(q) * q, 1.5f));
 
   set_borders(c, 0.f, ir);
 
@@ -77,8 +79,9 @@ Array curvature_horizontal_tangential(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = -(t * p * p + r * q * q - 2.f * s * p * q) /
-      ((p * p + q * q + 1e-30f) * pow(1.f + p * p + q * q, 0.5f));
+  c = -(lazy(t) * p * p + lazy(r) * q * q - 2.f * lazy(s) * p * q) /
+      ((lazy(p) * p + lazy(q) * q + 1e-30f) *
+       pow(1.f + lazy(p) * p + lazy(q) * q, 0.5f));
 
   set_borders(c, 0.f, ir);
 
@@ -100,8 +103,9 @@ Array curvature_ring(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = ((p * p - q * q) * s - p * q * (r - t)) /
-      ((p * p + q * q + 1e-30f) * (1.f + p * p + q * q));
+  c = ((lazy(p) * p - lazy(q) * q) * s - lazy(p) * q * (lazy(r) - t)) /
+      ((lazy(p) * p + lazy(q) * q + 1e-30f) *
+       (1.f + lazy(p) * p + lazy(q) * q));
   c *= c;
 
   set_borders(c, 0.f, ir);
@@ -117,8 +121,8 @@ Array curvature_rotor(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = ((p * p - q * q) * s - p * q * (r - t)) /
-      pow(p * p + q * q + 1e-6f, 1.5f);
+  c = ((lazy(p) * p - lazy(q) * q) * s - lazy(p) * q * (lazy(r) - t)) /
+      pow(lazy(p) * p + lazy(q) * q + 1e-6f, 1.5f);
 
   set_borders(c, 0.f, ir);
 
@@ -135,7 +139,8 @@ Array curvature_vertical_longitudinal(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = -2.f * (r * p * p + t * q * q + s * p * q) / (p * p + q * q + 1e-30f);
+  c = -2.f * (lazy(r) * p * p + lazy(t) * q * q + lazy(s) * p * q) /
+      (lazy(p) * p + lazy(q) * q + 1e-30f);
 
   set_borders(c, 0.f, ir);
 
@@ -150,8 +155,9 @@ Array curvature_vertical_profile(const Array &z, int ir)
   Array p, q, r, s, t;
   compute_curvature_gradients(c, p, q, r, s, t);
 
-  c = -(r * p * p + t * q * q + 2.f * s * p * q) /
-      ((p * p + q * q + 1e-30f) * pow(1. + p * p + q * q, 1.5f));
+  c = -(lazy(r) * p * p + lazy(t) * q * q + 2.f * lazy(s) * p * q) /
+      ((lazy(p) * p + lazy(q) * q + 1e-30f) *
+       pow(1.f + lazy(p) * p + lazy(q) * q, 1.5f));
 
   set_borders(c, 0.f, ir);
 
@@ -170,7 +176,7 @@ Array shape_index(const Array &z, int ir)
   Array k = compute_curvature_k(p, q, r, s, t);
   Array h = compute_curvature_h(r, t);
 
-  Array d = h * h - k;
+  Array d = lazy(h) * h - k;
   clamp_min(d, 0.f);
   d = pow(d, 0.5f);
 
@@ -195,7 +201,7 @@ Array unsphericity(const Array &z, int ir)
   Array k = compute_curvature_k(p, q, r, s, t);
   Array h = compute_curvature_h(r, t);
 
-  Array d = h * h - k;
+  Array d = lazy(h) * h - k;
 
   clamp_min(d, 0.f);
   d = pow(d, 0.5f);
@@ -234,7 +240,7 @@ void compute_curvature_gradients(const Array &z,
 
 Array compute_curvature_h(const Array &r, const Array &t)
 {
-  return -0.5f * (r + t);
+  return -0.5f * (lazy(r) + t);
 }
 
 Array compute_curvature_k(const Array &p,
@@ -243,7 +249,8 @@ Array compute_curvature_k(const Array &p,
                           const Array &s,
                           const Array &t)
 {
-  return (r * t - s * s) / pow(1.f + p * p + q * q, 2.f);
+  return (lazy(r) * t - lazy(s) * s) /
+         pow(1.f + lazy(p) * p + lazy(q) * q, 2.f);
 }
 
 } // namespace hmap
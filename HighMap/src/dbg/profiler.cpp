@@ -0,0 +1,381 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+#include "macrologger.h"
+
+#include "highmap/dbg/profiler.hpp"
+
+namespace hmap
+{
+
+// --- Profiler::ThreadBuffer
+
+Profiler::ThreadBuffer::ThreadBuffer(int tid)
+    : tid(tid), head(std::make_unique<Chunk>()), tail(head.get())
+{
+}
+
+Profiler::ThreadBuffer::~ThreadBuffer()
+{
+  Chunk *p_chunk = this->head->next.load();
+  while (p_chunk)
+  {
+    Chunk *p_next = p_chunk->next.load();
+    delete p_chunk;
+    p_chunk = p_next;
+  }
+}
+
+void Profiler::ThreadBuffer::push(Event &&event)
+{
+  size_t n = this->tail->count.load(std::memory_order_relaxed);
+
+  if (n == Chunk::capacity)
+  {
+    Chunk *p_chunk = new Chunk();
+    this->tail->next.store(p_chunk, std::memory_order_release);
+    this->tail = p_chunk;
+    n = 0;
+  }
+
+  // the event is visible to the readers once the count is updated
+  this->tail->events[n] = std::move(event);
+  this->tail->count.store(n + 1, std::memory_order_release);
+}
+
+// --- Profiler
+
+Profiler::Profiler() : t_origin(std::chrono::steady_clock::now())
+{
+}
+
+void Profiler::begin(const char *name)
+{
+  ThreadBuffer &buffer = this->thread_buffer();
+  buffer.stack.push_back({name, this->now(), 0, this->is_enabled()});
+}
+
+void Profiler::begin(const std::string &name)
+{
+  this->begin(this->intern(name));
+}
+
+void Profiler::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  for (auto &p_buffer : this->buffers)
+  {
+    Chunk *p_chunk = p_buffer->head->next.exchange(nullptr);
+    while (p_chunk)
+    {
+      Chunk *p_next = p_chunk->next.load();
+      delete p_chunk;
+      p_chunk = p_next;
+    }
+
+    p_buffer->head->count.store(0);
+    p_buffer->tail = p_buffer->head.get();
+  }
+}
+
+std::vector<Profiler::Event> Profiler::collect_events(
+    std::vector<int> *p_tids) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  std::vector<Event> events = {};
+
+  for (auto &p_buffer : this->buffers)
+  {
+    const Chunk *p_chunk = p_buffer->head.get();
+    while (p_chunk)
+    {
+      size_t n = p_chunk->count.load(std::memory_order_acquire);
+      for (size_t k = 0; k < n; k++)
+      {
+        events.push_back(p_chunk->events[k]);
+        if (p_tids) p_tids->push_back(p_buffer->tid);
+      }
+      p_chunk = p_chunk->next.load(std::memory_order_acquire);
+    }
+  }
+
+  return events;
+}
+
+void Profiler::count(const char *name, double increment)
+{
+  if (!this->is_enabled()) return;
+
+  this->thread_buffer().push(
+      {EventType::EVENT_COUNT, name, this->now(), 0, 0, increment});
+}
+
+void Profiler::count(const std::string &name, double increment)
+{
+  if (!this->is_enabled()) return;
+
+  this->count(this->intern(name), increment);
+}
+
+void Profiler::dump() const
+{
+  std::map<std::string, ProfileStats> stats = this->get_stats();
+
+  // sorted by decreasing total time
+  std::vector<std::pair<std::string, ProfileStats>> sorted(stats.begin(),
+                                                           stats.end());
+  std::sort(sorted.begin(),
+            sorted.end(),
+            [](const auto &a, const auto &b)
+            { return a.second.total > b.second.total; });
+
+  std::cout << "Profiler dump" << std::endl;
+  std::cout << std::setw(32) << "zone" << std::setw(10) << "calls"
+            << std::setw(14) << "total [ms]" << std::setw(14) << "self [ms]"
+            << std::setw(14) << "mean [ms]" << std::setw(14) << "max [ms]"
+            << std::endl;
+
+  for (auto &[name, s] : sorted)
+  {
+    std::cout << std::setw(32) << name;
+    std::cout << std::setw(10) << s.nb_calls;
+    std::cout << std::setw(14) << s.total;
+    std::cout << std::setw(14) << s.self;
+    std::cout << std::setw(14) << s.total / (double)s.nb_calls;
+    std::cout << std::setw(14) << s.max;
+    std::cout << std::endl;
+  }
+
+  for (auto &[name, value] : this->get_counters())
+    std::cout << std::setw(32) << name << std::setw(24) << std::fixed
+              << std::setprecision(0) << value << std::defaultfloat
+              << std::setprecision(6) << std::endl;
+}
+
+void Profiler::end()
+{
+  ThreadBuffer &buffer = this->thread_buffer();
+
+  if (buffer.stack.empty())
+  {
+    LOG_ERROR("no profiler zone to close");
+    return;
+  }
+
+  ThreadBuffer::OpenZone zone = buffer.stack.back();
+  buffer.stack.pop_back();
+
+  int64_t dt = this->now() - zone.t0;
+
+  if (!buffer.stack.empty()) buffer.stack.back().dt_children += dt;
+
+  if (zone.is_recorded)
+    buffer.push({EventType::EVENT_ZONE,
+                 zone.name,
+                 zone.t0,
+                 dt,
+                 dt - zone.dt_children,
+                 0.0});
+}
+
+std::map<std::string, double> Profiler::get_counters() const
+{
+  std::map<std::string, double> counters = {};
+
+  for (auto &e : this->collect_events())
+    if (e.type == EventType::EVENT_COUNT) counters[e.name] += e.value;
+
+  return counters;
+}
+
+Profiler &Profiler::get_instance()
+{
+  static Profiler instance;
+  return instance;
+}
+
+std::map<std::string, ProfileStats> Profiler::get_stats() const
+{
+  std::map<std::string, ProfileStats> stats = {};
+
+  for (auto &e : this->collect_events())
+  {
+    if (e.type != EventType::EVENT_ZONE) continue;
+
+    ProfileStats &s = stats[e.name];
+    double        dt = 1e-6 * (double)e.dt;
+
+    s.min = s.nb_calls ? std::min(s.min, dt) : dt;
+    s.max = s.nb_calls ? std::max(s.max, dt) : dt;
+    s.total += dt;
+    s.self += 1e-6 * (double)e.dt_self;
+    s.nb_calls++;
+  }
+
+  return stats;
+}
+
+const char *Profiler::intern(const std::string &name)
+{
+  // per-thread cache of the interned names, the table is only locked the
+  // first time a thread uses a name (the table nodes are never moved)
+  thread_local std::unordered_map<std::string, const char *> cache;
+
+  auto it = cache.find(name);
+  if (it != cache.end()) return it->second;
+
+  const char *p_name;
+  {
+    std::lock_guard<std::mutex> lock(this->names_mutex);
+    p_name = this->names.insert(name).first->c_str();
+  }
+
+  cache.emplace(name, p_name);
+  return p_name;
+}
+
+bool Profiler::is_enabled() const
+{
+  return this->enabled.load(std::memory_order_relaxed);
+}
+
+int64_t Profiler::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - this->t_origin)
+      .count();
+}
+
+void Profiler::set_enabled(bool new_state)
+{
+  this->enabled.store(new_state);
+}
+
+Profiler::ThreadBuffer &Profiler::thread_buffer()
+{
+  // buffers are owned by the profiler, they outlive their thread
+  thread_local ThreadBuffer *p_buffer = nullptr;
+
+  if (!p_buffer)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->buffers.push_back(
+        std::make_unique<ThreadBuffer>((int)this->buffers.size()));
+    p_buffer = this->buffers.back().get();
+  }
+
+  return *p_buffer;
+}
+
+bool Profiler::to_chrome_trace(const std::string &fname) const
+{
+  std::ofstream f(fname);
+
+  if (!f.is_open())
+  {
+    LOG_ERROR("could not open file: %s", fname.c_str());
+    return false;
+  }
+
+  std::vector<int>   tids = {};
+  std::vector<Event> events = this->collect_events(&tids);
+
+  auto escape = [](const std::string &str)
+  {
+    std::string out;
+    for (char c : str)
+    {
+      if (c == '"' || c == '\\') out += '\\';
+      out += c;
+    }
+    return out;
+  };
+
+  f << std::fixed << std::setprecision(3);
+  f << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+  bool is_first = true;
+  auto separator = [&f, &is_first]()
+  {
+    if (!is_first) f << ",\n";
+    is_first = false;
+  };
+
+  // thread names
+  int ntids = 0;
+  for (int tid : tids)
+    ntids = std::max(ntids, tid + 1);
+
+  for (int tid = 0; tid < ntids; tid++)
+  {
+    separator();
+    f << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+      << tid << ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+  }
+
+  // zones (timestamps in microseconds)
+  for (size_t k = 0; k < events.size(); k++)
+  {
+    const Event &e = events[k];
+    if (e.type != EventType::EVENT_ZONE) continue;
+
+    separator();
+    f << "{\"name\": \"" << escape(e.name)
+      << "\", \"cat\": \"hmap\", \"ph\": \"X\", \"ts\": " << 1e-3 * e.t0
+      << ", \"dur\": " << 1e-3 * e.dt << ", \"pid\": 0, \"tid\": " << tids[k]
+      << "}";
+  }
+
+  // counters, accumulated over all the threads in chronological order
+  std::vector<const Event *> counts = {};
+  for (auto &e : events)
+    if (e.type == EventType::EVENT_COUNT) counts.push_back(&e);
+
+  std::stable_sort(counts.begin(),
+                   counts.end(),
+                   [](const Event *a, const Event *b)
+                   { return a->t0 < b->t0; });
+
+  std::map<std::string, double> totals = {};
+
+  for (auto p_e : counts)
+  {
+    double total = (totals[p_e->name] += p_e->value);
+
+    separator();
+    f << "{\"name\": \"" << escape(p_e->name)
+      << "\", \"ph\": \"C\", \"ts\": " << 1e-3 * p_e->t0
+      << ", \"pid\": 0, \"args\": {\"value\": " << total << "}}";
+  }
+
+  f << "\n]}\n";
+
+  return (bool)f;
+}
+
+// --- ProfileZone
+
+ProfileZone::ProfileZone(const char *name)
+{
+  Profiler::get_instance().begin(name);
+}
+
+ProfileZone::ProfileZone(const std::string &name)
+{
+  Profiler::get_instance().begin(name);
+}
+
+ProfileZone::~ProfileZone()
+{
+  Profiler::get_instance().end();
+}
+
+} // namespace hmap
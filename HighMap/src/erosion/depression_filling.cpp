@@ -2,10 +2,20 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include <cmath>
+#include <limits>
+#include <map>
+#include <queue>
+
+#include "macrologger.h"
 
 #include "highmap/array.hpp"
 #include "highmap/boundary.hpp"
+#include "highmap/erosion.hpp"
+#include "highmap/heightmap.hpp"
 #include "highmap/math.hpp"
+#include "highmap/thread_pool.hpp"
+
+#include "highmap/internal/indexed_heap.hpp"
 
 // neighbor pattern search
 // 6 2 8
@@ -17,45 +27,470 @@
 #define C  {1.f, 1.f, 1.f, 1.f, M_SQRT2, M_SQRT2, M_SQRT2, M_SQRT2}
 // clang-format on
 
+// maximum number of elevation levels handled by the bucket queue
+#define HMAP_DEPRESSION_FILLING_MAX_BUCKETS 65536
+
 namespace hmap
 {
 
+// check whether the sub-domain values are integers within a limited range,
+// returns the minimum value and the number of levels
+static bool is_quantized(const Array &z,
+                         Vec4<int>    idx,
+                         int         &vmin,
+                         int         &nlevels)
+{
+  float zmin = std::numeric_limits<float>::max();
+  float zmax = -std::numeric_limits<float>::max();
+
+  for (int j = idx.c; j < idx.d; j++)
+    for (int i = idx.a; i < idx.b; i++)
+    {
+      if (z(i, j) != std::floor(z(i, j))) return false;
+      zmin = std::min(zmin, z(i, j));
+      zmax = std::max(zmax, z(i, j));
+    }
+
+  // range checked with floats first, the elevations may be out of the int
+  // range (the bucket queue indices are then computed with ints)
+  float zlim = (float)(std::numeric_limits<int>::max() / 2);
+
+  if (!(zmax - zmin < (float)HMAP_DEPRESSION_FILLING_MAX_BUCKETS) ||
+      zmin < -zlim || zmax > zlim)
+    return false;
+
+  vmin = (int)zmin;
+  nlevels = (int)(zmax - zmin) + 1;
+  return true;
+}
+
+// Priority-Flood (Barnes et al., 2014) of the sub-domain idx = {i1, i2, j1,
+// j2} (upper bounds excluded) of the array. The cells of the sub-domain
+// perimeter are the outlets and are left unchanged. With a non-zero epsilon,
+// the filled cells are given a small gradient toward the outlets (same fixed
+// point as the Planchon-Darboux algorithm), otherwise the filled areas are flat
+// and a bucket queue is used if the elevations are integers.
+static void priority_flood(Array &z, Vec4<int> idx, float epsilon)
+{
+  const int   di[8] = DI;
+  const int   dj[8] = DJ;
+  const float c[8] = C;
+
+  const int nx = idx.b - idx.a;
+  const int ny = idx.d - idx.c;
+
+  if (nx < 3 || ny < 3) return;
+
+  // working arrays defined on the sub-domain
+  std::vector<float>   w(nx * ny, std::numeric_limits<float>::max());
+  std::vector<uint8_t> settled(nx * ny, 0);
+
+  auto lambda_is_perimeter = [nx, ny](int p, int q)
+  { return p == 0 || p == nx - 1 || q == 0 || q == ny - 1; };
+
+  int zmin, nlevels;
+
+  if (epsilon == 0.f && is_quantized(z, idx, zmin, nlevels))
+  {
+    // --- flat filling, O(N) bucket queue, the first elevation assigned to a
+    // --- cell is final
+    std::vector<std::vector<int>> buckets(nlevels);
+
+    for (int q = 0; q < ny; q++)
+      for (int p = 0; p < nx; p++)
+        if (lambda_is_perimeter(p, q))
+        {
+          int r = p + q * nx;
+          w[r] = z(p + idx.a, q + idx.c);
+          settled[r] = 1;
+          buckets[(int)w[r] - zmin].push_back(r);
+        }
+
+    for (size_t level = 0; level < buckets.size(); level++)
+      while (!buckets[level].empty())
+      {
+        int r = buckets[level].back();
+        buckets[level].pop_back();
+
+        int p = r % nx;
+        int q = r / nx;
+
+        for (int k = 0; k < 8; k++)
+        {
+          int pn = p + di[k];
+          int qn = q + dj[k];
+
+          if (pn < 0 || pn >= nx || qn < 0 || qn >= ny) continue;
+
+          int s = pn + qn * nx;
+          if (settled[s]) continue;
+
+          w[s] = std::max(z(pn + idx.a, qn + idx.c), w[r]);
+          settled[s] = 1;
+          buckets[(int)w[s] - zmin].push_back(s);
+        }
+      }
+  }
+  else
+  {
+    // --- generic case, binary heap with decrease-key (the elevation
+    // --- increment depends on the neighbor direction)
+    IndexedMinHeap<float> queue(nx * ny);
+
+    for (int q = 0; q < ny; q++)
+      for (int p = 0; p < nx; p++)
+        if (lambda_is_perimeter(p, q))
+        {
+          int r = p + q * nx;
+          w[r] = z(p + idx.a, q + idx.c);
+          queue.push_or_decrease(r, w[r]);
+        }
+
+    while (!queue.empty())
+    {
+      float wr;
+      int   r = queue.pop(wr);
+      int   p = r % nx;
+      int   q = r / nx;
+
+      settled[r] = 1;
+
+      for (int k = 0; k < 8; k++)
+      {
+        int pn = p + di[k];
+        int qn = q + dj[k];
+
+        if (pn < 0 || pn >= nx || qn < 0 || qn >= ny) continue;
+
+        int s = pn + qn * nx;
+        if (settled[s]) continue;
+
+        float ws = std::max(z(pn + idx.a, qn + idx.c), wr + epsilon * c[k]);
+
+        if (ws < w[s])
+        {
+          w[s] = ws;
+          queue.push_or_decrease(s, ws);
+        }
+      }
+    }
+  }
+
+  for (int q = 1; q < ny - 1; q++)
+    for (int p = 1; p < nx - 1; p++)
+      z(p + idx.a, q + idx.c) = w[p + q * nx];
+}
+
 void depression_filling(Array &z, int iterations, float epsilon)
 {
-  std::vector<int>   di = DI;
-  std::vector<int>   dj = DJ;
-  std::vector<float> c = C;
-  const uint         nb = di.size();
+  if (iterations != 1000)
+    LOG_DEBUG("iterations (%d) is ignored, depression filling is not "
+              "iterative anymore",
+              iterations);
+
+  priority_flood(z, {0, z.shape.x, 0, z.shape.y}, epsilon);
+  extrapolate_borders(z);
+}
+
+// --- tiled version (Barnes, 2016)
+
+// index of a perimeter cell (p, q) of a nx x ny domain
+static int perimeter_index(int p, int q, int nx, int ny)
+{
+  if (q == 0) return p;
+  if (q == ny - 1) return nx + p;
+  if (p == 0) return 2 * nx + q - 1;
+  return 2 * nx + ny - 2 + q - 1;
+}
+
+void depression_filling(Heightmap &h, float epsilon)
+{
+  const int di[8] = DI;
+  const int dj[8] = DJ;
 
-  Array z_new = z;
-  z_new.set_slice({1, z.shape.x - 1, 1, z.shape.y - 1}, 1e6f);
+  // tile core domains (i.e. without the overlap buffers), assumed to have the
+  // same shape for every tile
+  const int nx = h.shape.x / h.tiling.x;
+  const int ny = h.shape.y / h.tiling.y;
+  const int delta_buffer_i = (int)(h.overlap * h.shape.x / h.tiling.x);
+  const int delta_buffer_j = (int)(h.overlap * h.shape.y / h.tiling.y);
+  const int ntiles = (int)h.get_ntiles();
 
-  for (int it = 0; it < iterations; it++)
+  if (nx < 3 || ny < 3) return;
+
+  // pin (out-of-core heightmaps) the tiles neighboring tile k, tile k
+  // included, for the passes using the neighbor tiles values
+  auto lambda_pin_neighbors = [&](int k, bool do_pin)
   {
-    for (int j = 1; j < z.shape.y - 1; j++)
-      for (int i = 1; i < z.shape.x - 1; i++)
+    int it = k % h.tiling.x;
+    int jt = k / h.tiling.x;
+
+    for (int jtn = std::max(0, jt - 1); jtn < std::min(h.tiling.y, jt + 2);
+         jtn++)
+      for (int itn = std::max(0, it - 1); itn < std::min(h.tiling.x, it + 2);
+           itn++)
       {
-        if (z_new(i, j) > z(i, j))
+        int kn = h.get_tile_index(itn, jtn);
+
+        // read-only, modified tiles are pinned separately
+        if (do_pin)
+          h.pin_tile(kn);
+        else
+          h.unpin_tile(kn, false);
+      }
+  };
+
+  // core domain of tile k in tile coordinates
+  auto lambda_core = [&](int k)
+  {
+    int it = k % h.tiling.x;
+    int jt = k / h.tiling.x;
+    int i1 = it > 0 ? delta_buffer_i : 0;
+    int j1 = jt > 0 ? delta_buffer_j : 0;
+    return Vec4<int>(i1, i1 + nx, j1, j1 + ny);
+  };
+
+  // labels: 0 for the global domain boundary, then one label per tile
+  // perimeter cell
+  const int ocean = 0;
+  const int nperimeter = 2 * nx + 2 * (ny - 2);
+
+  auto lambda_label = [&](int k, int p, int q)
+  {
+    int it = k % h.tiling.x;
+    int jt = k / h.tiling.x;
+    int gi = it * nx + p;
+    int gj = jt * ny + q;
+
+    if (gi == 0 || gi == h.tiling.x * nx - 1 || gj == 0 ||
+        gj == h.tiling.y * ny - 1)
+      return ocean;
+    else
+      return 1 + k * nperimeter + perimeter_index(p, q, nx, ny);
+  };
+
+  // --- 1st pass: flood each tile from its perimeter and retrieve the spill
+  // --- elevations between perimeter watersheds (tile spill graph)
+
+  std::vector<std::map<std::pair<int, int>, float>> spill_edges(ntiles);
+
+  auto lambda_flood = [&](size_t k)
+  {
+    TilePin     pin({&h}, k, false);
+    const Tile &tile = h.tiles[k];
+    Vec4<int>   idx = lambda_core((int)k);
+
+    std::vector<float> w(nx * ny);
+    std::vector<int>   label(nx * ny, -1);
+
+    using Cell = std::pair<float, int>;
+    std::priority_queue<Cell, std::vector<Cell>, std::greater<Cell>> queue;
+
+    for (int q = 0; q < ny; q++)
+      for (int p = 0; p < nx; p++)
+        if (p == 0 || p == nx - 1 || q == 0 || q == ny - 1)
         {
-          for (uint k = 0; k < nb; k++)
-          {
-            int p = i + di[k];
-            int q = j + dj[k];
+          int r = p + q * nx;
+          w[r] = tile(p + idx.a, q + idx.c);
+          label[r] = lambda_label((int)k, p, q);
+          queue.push({w[r], r});
+        }
+
+    auto &edges = spill_edges[k];
+
+    while (!queue.empty())
+    {
+      int r = queue.top().second;
+      queue.pop();
+
+      int p = r % nx;
+      int q = r / nx;
 
-            if (z(i, j) >= z_new(p, q) + epsilon * c[k])
-            {
-              z_new(i, j) = z(i, j);
-              break;
-            }
+      for (int n = 0; n < 8; n++)
+      {
+        int pn = p + di[n];
+        int qn = q + dj[n];
+
+        if (pn < 0 || pn >= nx || qn < 0 || qn >= ny) continue;
+
+        int s = pn + qn * nx;
 
-            if (z_new(i, j) > z_new(p, q) + epsilon * c[k])
-              z_new(i, j) = z_new(p, q) + epsilon * c[k];
+        if (label[s] >= 0)
+        {
+          // two watersheds meet
+          if (label[s] != label[r])
+          {
+            auto  key = std::minmax(label[r], label[s]);
+            float ws = std::max(w[r], w[s]);
+            auto  it = edges.find(key);
+
+            if (it == edges.end())
+              edges[key] = ws;
+            else
+              it->second = std::min(it->second, ws);
           }
+          continue;
         }
+
+        w[s] = std::max(tile(pn + idx.a, qn + idx.c), w[r]);
+        label[s] = label[r];
+        queue.push({w[s], s});
       }
+    }
+  };
+
+  parallel_for(ntiles, lambda_flood);
+
+  // --- 2nd pass: global spill graph, including the edges between adjacent
+  // --- perimeter cells of neighboring tiles, and flood from the domain
+  // --- boundary
+
+  int nlabels = 1 + ntiles * nperimeter;
+
+  std::vector<std::vector<std::pair<int, float>>> graph(nlabels);
+
+  auto lambda_add_edge = [&graph](int a, int b, float weight)
+  {
+    graph[a].push_back({b, weight});
+    graph[b].push_back({a, weight});
+  };
+
+  for (auto &edges : spill_edges)
+    for (auto &[key, weight] : edges)
+      lambda_add_edge(key.first, key.second, weight);
+
+  for (int k = 0; k < ntiles; k++)
+  {
+    int       it = k % h.tiling.x;
+    int       jt = k / h.tiling.x;
+    Vec4<int> idx = lambda_core(k);
+
+    lambda_pin_neighbors(k, true);
+
+    for (int q = 0; q < ny; q++)
+      for (int p = 0; p < nx; p++)
+      {
+        if (p != 0 && p != nx - 1 && q != 0 && q != ny - 1) continue;
+
+        int a = lambda_label(k, p, q);
+
+        for (int n = 0; n < 8; n++)
+        {
+          // neighbor global indices, only consider neighbors in the tiles
+          // with a larger index to count each edge once
+          int gi = it * nx + p + di[n];
+          int gj = jt * ny + q + dj[n];
+
+          if (gi < 0 || gi >= h.tiling.x * nx || gj < 0 ||
+              gj >= h.tiling.y * ny)
+            continue;
+
+          int itn = gi / nx;
+          int jtn = gj / ny;
+          int kn = h.get_tile_index(itn, jtn);
+
+          if (kn <= k) continue;
+
+          int       pn = gi - itn * nx;
+          int       qn = gj - jtn * ny;
+          Vec4<int> idxn = lambda_core(kn);
+          int       b = lambda_label(kn, pn, qn);
+
+          if (a == b) continue;
+
+          float weight = std::max(h.tiles[k](p + idx.a, q + idx.c),
+                                  h.tiles[kn](pn + idxn.a, qn + idxn.c));
+          lambda_add_edge(a, b, weight);
+        }
+      }
+
+    lambda_pin_neighbors(k, false);
+  }
+
+  spill_edges.clear();
+
+  // minimax flood of the spill graph
+  std::vector<float> level(nlabels, std::numeric_limits<float>::max());
+  {
+    IndexedMinHeap<float> queue(nlabels);
+
+    level[ocean] = std::numeric_limits<float>::lowest();
+    queue.push_or_decrease(ocean, level[ocean]);
+
+    while (!queue.empty())
+    {
+      float la;
+      int   a = queue.pop(la);
+
+      for (auto &[b, weight] : graph[a])
+      {
+        float lb = std::max(la, weight);
+        if (lb < level[b])
+        {
+          level[b] = lb;
+          queue.push_or_decrease(b, lb);
+        }
+      }
+    }
   }
-  extrapolate_borders(z_new);
-  z = z_new;
+
+  // --- 3rd pass: raise the tile perimeters to their spill elevation and fill
+  // --- the tile interiors
+
+  auto lambda_fill = [&](size_t k)
+  {
+    TilePin   pin({&h}, k);
+    Tile     &tile = h.tiles[k];
+    Vec4<int> idx = lambda_core((int)k);
+
+    for (int q = 0; q < ny; q++)
+      for (int p = 0; p < nx; p++)
+        if (p == 0 || p == nx - 1 || q == 0 || q == ny - 1)
+        {
+          int a = lambda_label((int)k, p, q);
+          if (a != ocean)
+            tile(p + idx.a, q + idx.c) = std::max(tile(p + idx.a, q + idx.c),
+                                                  level[a]);
+        }
+
+    priority_flood(tile, idx, epsilon);
+  };
+
+  parallel_for(ntiles, lambda_fill);
+
+  // --- update the overlap buffers using the neighboring tile cores
+
+  auto lambda_buffers = [&](size_t k)
+  {
+    TilePin pin({&h}, k);
+    lambda_pin_neighbors((int)k, true);
+
+    Tile     &tile = h.tiles[k];
+    Vec4<int> idx = lambda_core((int)k);
+    int       it = (int)k % h.tiling.x;
+    int       jt = (int)k / h.tiling.x;
+
+    for (int j = 0; j < tile.shape.y; j++)
+      for (int i = 0; i < tile.shape.x; i++)
+      {
+        if (i >= idx.a && i < idx.b && j >= idx.c && j < idx.d) continue;
+
+        int gi = it * nx + i - idx.a;
+        int gj = jt * ny + j - idx.c;
+        int itn = std::min(gi / nx, h.tiling.x - 1);
+        int jtn = std::min(gj / ny, h.tiling.y - 1);
+
+        Vec4<int> idxn = lambda_core(h.get_tile_index(itn, jtn));
+
+        tile(i, j) = h.tiles[h.get_tile_index(itn, jtn)](
+            gi - itn * nx + idxn.a,
+            gj - jtn * ny + idxn.c);
+      }
+
+    lambda_pin_neighbors((int)k, false);
+  };
+
+  parallel_for(ntiles, lambda_buffers);
 }
 
 } // namespace hmap
@@ -3,6 +3,7 @@
  * this software. */
 
 #include <algorithm>
+#include <array>
 
 #include "highmap/array.hpp"
 #include "highmap/boundary.hpp"
@@ -12,6 +13,8 @@
 #include "highmap/primitives.hpp"
 #include "highmap/range.hpp"
 
+#include "highmap/internal/stencil_sweep.hpp"
+
 #include "macrologger.h"
 
 namespace hmap
@@ -32,11 +35,10 @@ void hydraulic_benes(Array &z,
                      float  c_deposition,
                      float  water_level,
                      float  evap_rate,
-                     float  rain_rate)
+                     float  rain_rate,
+                     bool   parallel)
 {
-  std::vector<int> di = DI;
-  std::vector<int> dj = DJ;
-  const uint       nb = di.size();
+  MooreStencil st(DI, DJ, z.shape.x);
 
   // keep a backup of the input if the erosion / deposition maps need
   // to be computed
@@ -54,126 +56,121 @@ void hydraulic_benes(Array &z,
 
   Array vel = Array(z.shape);
 
-  // main loop
-  for (int it = 0; it < iterations; it++)
+  // state fields, updated in place
+  float       *pz = z.vector.data();
+  float       *pw = w.vector.data();
+  float       *ps = s.vector.data();
+  float       *pvel = vel.vector.data();
+  const float *pw_init = w_init.vector.data();
+  const size_t n = z.vector.size();
+
+  // --- water flow dynamic and sediment transport
+
+  auto lambda_flow = [&](int i, int j)
   {
-    // modify neighbor search at each iterations to limit numerical
-    // artifacts
-    std::rotate(di.begin(), di.begin() + 1, di.end());
-    std::rotate(dj.begin(), dj.begin() + 1, dj.end());
+    const int r = z.linear_index(i, j);
 
-    w = (1.f - rain_rate) * w + rain_rate * w_init;
+    float zw = pz[r] + pw[r];
+    float dsum = 0.f;
+    float zsavg = 0.f;
+    int   navg = 0;
 
-    // --- water flow dynamic and sediment transport
+    std::array<float, 8> dz;
+
+    for (int k = 0; k < 8; k++)
+    {
+      const int ra = r + st.dr[k];
+      dz[k] = zw - pz[ra] - pw[ra];
 
-    for (int j = 1; j < z.shape.y - 1; j++)
-      for (int i = 1; i < z.shape.x - 1; i++)
+      if (dz[k] > 0.f)
       {
-        float              dsum = 0.f;
-        float              zsavg = 0.f;
-        int                navg = 0;
-        std::vector<float> dz(nb);
+        dsum += dz[k];
+        zsavg += pz[ra] + pw[ra];
+        navg++;
+      }
+    }
 
-        for (uint k = 0; k < nb; k++)
-        {
-          int ia = i + di[k];
-          int ja = j + dj[k];
-          dz[k] = z(i, j) + w(i, j) - z(ia, ja) - w(ia, ja);
-
-          if (dz[k] > 0.f)
-          {
-            dsum += dz[k];
-            zsavg += z(ia, ja) + w(ia, ja);
-            navg++;
-          }
-          else
-            dz[k] = 0.f;
-        }
+    if (dsum > 0.f and pw[r] > wmin)
+    {
+      zsavg /= (float)navg;
 
-        if (dsum > 0.f and w(i, j) > wmin)
+      float dw_tot = std::min(pw[r], zw - zsavg);
+      float ds_tot = pw[r] > 0.f ? ps[r] * dw_tot / pw[r] : 0.f;
+
+      pw[r] -= dw_tot;
+      ps[r] -= ds_tot;
+      pvel[r] = dw_tot;
+
+      for (int k = 0; k < 8; k++)
+        if (dz[k] > 0.f)
         {
-          zsavg /= (float)navg;
+          const int ra = r + st.dr[k];
+          float     ratio = dz[k] / dsum;
 
-          float dw_tot = std::min(w(i, j), z(i, j) + w(i, j) - zsavg);
-          float ds_tot;
+          pw[ra] += dw_tot * ratio;
+          ps[ra] += ds_tot * ratio;
+        }
+    }
+  };
 
-          if (w(i, j) > 0.f)
-            ds_tot = s(i, j) * dw_tot / w(i, j);
-          else
-            ds_tot = 0.f;
+  // --- erosion and deposition
 
-          w(i, j) -= dw_tot;
-          s(i, j) -= ds_tot;
+  auto lambda_erosion = [&](int i, int j)
+  {
+    const int r = z.linear_index(i, j);
 
-          vel(i, j) = dw_tot;
+    float zw = pz[r] + pw[r];
+    float dsum = 0.f;
 
-          for (uint k = 0; k < nb; k++)
-          {
-            if (dz[k] > 0.f)
-            {
-              int   ia = i + di[k];
-              int   ja = j + dj[k];
-              float r = dz[k] / dsum;
+    std::array<float, 8> dz;
 
-              w(ia, ja) += dw_tot * r;
-              s(ia, ja) += ds_tot * r;
-            }
-          }
-        }
-      }
+    for (int k = 0; k < 8; k++)
+    {
+      const int ra = r + st.dr[k];
+      dz[k] = zw - pz[ra] - pw[ra];
+      if (dz[k] > 0.f) dsum += dz[k];
+    }
 
-    // --- erosion and deposition
-    for (int i = 1; i < z.shape.x - 1; i++)
+    if (dsum > 0.f)
     {
-      for (int j = 1; j < z.shape.y - 1; j++)
-      {
-        float              dsum = 0.f;
-        std::vector<float> dz(nb);
+      float ds_tot = c_capacity * pw[r] * pvel[r] - ps[r];
+      float amount = ds_tot > 0.f ? c_erosion * ds_tot : c_deposition * ds_tot;
 
-        for (uint k = 0; k < nb; k++)
-        {
-          int ia = i + di[k];
-          int ja = j + dj[k];
-          dz[k] = z(i, j) + w(i, j) - z(ia, ja) - w(ia, ja); // no water
-
-          if (dz[k] > 0.f)
-            dsum += dz[k];
-          else
-            dz[k] = 0.f;
-        }
+      pz[r] -= amount;
+      ps[r] += amount;
 
-        if (dsum > 0.f)
+      for (int k = 0; k < 8; k++)
+        if (dz[k] > 0.f)
         {
-          float ds_tot = c_capacity * w(i, j) * vel(i, j) - s(i, j);
-          float amount;
-
-          if (ds_tot > 0.f)
-            amount = c_erosion * ds_tot;
-          else
-            amount = c_deposition * ds_tot;
-
-          z(i, j) -= amount;
-          s(i, j) += amount;
-
-          for (uint k = 0; k < nb; k++)
-          {
-            if (dz[k] > 0.f)
-            {
-              int   ia = i + di[k];
-              int   ja = j + dj[k];
-              float r = dz[k] / dsum;
-
-              z(ia, ja) -= amount * r;
-              s(ia, ja) += amount * r;
-            }
-          }
+          const int ra = r + st.dr[k];
+          float     ratio = dz[k] / dsum;
+
+          pz[ra] -= amount * ratio;
+          ps[ra] += amount * ratio;
         }
+    }
+  };
+
+  // main loop
+  for (int it = 0; it < iterations; it++)
+  {
+    // modify neighbor search at each iterations to limit numerical
+    // artifacts
+    st.rotate();
+
+    // rain
+    for (size_t r = 0; r < n; r++)
+      pw[r] = (1.f - rain_rate) * pw[r] + rain_rate * pw_init[r];
 
-      } // j
-    } // i
+    stencil_sweep(z.shape, parallel, false, lambda_flow);
+    stencil_sweep(z.shape, parallel, true, lambda_erosion);
 
-    w = (1.f - evap_rate) * w;
-    chop(w, wmin);
+    // evaporation
+    for (size_t r = 0; r < n; r++)
+    {
+      pw[r] *= 1.f - evap_rate;
+      if (!(pw[r] > wmin)) pw[r] = 0.f;
+    }
 
     extrapolate_borders(z);
     fill_borders(w);
@@ -184,9 +181,11 @@ void hydraulic_benes(Array &z,
 
     // make sure bedrock is not eroded
     if (p_bedrock)
-      for (int i = 0; i < z.shape.x; i++)
-        for (int j = 0; j < z.shape.y; j++)
-          z(i, j) = std::max(z(i, j), (*p_bedrock)(i, j));
+    {
+      const float *pb = p_bedrock->vector.data();
+      for (size_t r = 0; r < n; r++)
+        pz[r] = std::max(pz[r], pb[r]);
+    }
 
   } // it
 
@@ -216,7 +215,8 @@ void hydraulic_benes(Array &z,
                      float  c_deposition,
                      float  water_level,
                      float  evap_rate,
-                     float  rain_rate)
+                     float  rain_rate,
+                     bool   parallel)
 {
   if (!p_mask)
     hydraulic_benes(z,
@@ -230,7 +230,8 @@ void hydraulic_benes(Array &z,
                     c_deposition,
                     water_level,
                     evap_rate,
-                    rain_rate);
+                    rain_rate,
+                    parallel);
   else
   {
     Array z_f = z;
@@ -245,7 +246,8 @@ void hydraulic_benes(Array &z,
                     c_deposition,
                     water_level,
                     evap_rate,
-                    rain_rate);
+                    rain_rate,
+                    parallel);
     z = lerp(z, z_f, *(p_mask));
   }
 }
@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <array>
 #include <cmath>
 
 #include "highmap/array.hpp"
@@ -8,6 +10,8 @@
 #include "highmap/filters.hpp"
 #include "highmap/primitives.hpp"
 
+#include "highmap/internal/stencil_sweep.hpp"
+
 namespace hmap
 {
 
@@ -35,66 +39,75 @@ void hydraulic_musgrave(Array &z,
                         float  c_erosion,
                         float  c_deposition,
                         float  water_level,
-                        float  evap_rate)
+                        float  evap_rate,
+                        bool   parallel)
 {
   Array s = constant(z.shape);          // sediment level
   Array w = water_level * moisture_map; // backup initial moisture map
 
-  std::vector<int>   di = DI;
-  std::vector<int>   dj = DJ;
-  std::vector<float> c = C;
-  const uint         nb = di.size();
+  MooreStencil         st(DI, DJ, z.shape.x);
+  std::array<float, 8> c = C;
+
+  // state fields, updated in place
+  float       *pz = z.vector.data();
+  float       *pw = w.vector.data();
+  float       *ps = s.vector.data();
+  const float *pm = moisture_map.vector.data();
+  const size_t n = z.vector.size();
+
+  auto lambda_cell = [&](int i, int j)
+  {
+    const int r = z.linear_index(i, j);
+
+    for (int k = 0; k < 8; k++) // loop over 1st neighbors
+    {
+      const int ra = r + st.dr[k];
+      float     dw = std::min(pw[r], (pw[r] + pz[r] - pw[ra] - pz[ra]) * c[k]);
+
+      if (dw <= 0.f)
+      {
+        // sediment deposition
+        pz[r] = pz[r] + c_deposition * ps[r];
+        ps[r] = (1.f - c_deposition) * ps[r];
+      }
+      else
+      {
+        pw[r] = pw[r] - 0.5f * dw;
+        pw[ra] = pw[ra] + 0.5f * dw;
+
+        // differential of sediment capacity of water gap (ks *
+        // dw)
+        float sc = c_capacity * dw;
+        float delta_sc = ps[r] - sc;
+        if (delta_sc > 0.f)
+        {
+          // deposition
+          ps[ra] = ps[ra] + sc;
+          pz[r] = pz[r] + c_deposition * delta_sc;
+          ps[r] = (1.f - c_deposition) * delta_sc;
+        }
+        else
+        {
+          // erosion
+          ps[ra] = ps[ra] + ps[r] - c_erosion * delta_sc;
+          pz[r] = pz[r] + c_erosion * delta_sc;
+          ps[r] = 0.f;
+        }
+      }
+    } // k
+  };
 
   for (int it = 0; it < iterations; it++)
   {
-    w = (1 - evap_rate) * w + evap_rate * moisture_map * water_level;
+    for (size_t r = 0; r < n; r++)
+      pw[r] = (1 - evap_rate) * pw[r] + evap_rate * pm[r] * water_level;
 
     // modify neighbor search at each iterations to limit numerical
     // artifacts
-    std::rotate(di.begin(), di.begin() + 1, di.end());
-    std::rotate(dj.begin(), dj.begin() + 1, dj.end());
+    st.rotate();
     std::rotate(c.begin(), c.begin() + 1, c.end());
 
-    for (int j = 1; j < z.shape.y - 1; j++)
-      for (int i = 1; i < z.shape.x - 1; i++)
-        for (uint k = 0; k < nb; k++) // loop over 1st neighbors
-        {
-          int   p = i + di[k];
-          int   q = j + dj[k];
-          float dw = std::min(w(i, j),
-                              (w(i, j) + z(i, j) - w(p, q) - z(p, q)) * c[k]);
-
-          if (dw <= 0.f)
-          {
-            // sediment deposition
-            z(i, j) = z(i, j) + c_deposition * s(i, j);
-            s(i, j) = (1.f - c_deposition) * s(i, j);
-          }
-          else
-          {
-            w(i, j) = w(i, j) - 0.5f * dw;
-            w(p, q) = w(p, q) + 0.5f * dw;
-
-            // differential of sediment capacity of water gap (ks *
-            // dw)
-            float sc = c_capacity * dw;
-            float delta_sc = s(i, j) - sc;
-            if (delta_sc > 0.f)
-            {
-              // deposition
-              s(p, q) = s(p, q) + sc;
-              z(i, j) = z(i, j) + c_deposition * delta_sc;
-              s(i, j) = (1.f - c_deposition) * delta_sc;
-            }
-            else
-            {
-              // erosion
-              s(p, q) = s(p, q) + s(i, j) - c_erosion * delta_sc;
-              z(i, j) = z(i, j) + c_erosion * delta_sc;
-              s(i, j) = 0.f;
-            }
-          }
-        } // k
+    stencil_sweep(z.shape, parallel, false, lambda_cell);
 
     // fix boundaries
     fill_borders(z);
@@ -122,7 +135,8 @@ void hydraulic_musgrave(Array &z,
                         float  c_erosion,
                         float  c_deposition,
                         float  water_level,
-                        float  evap_rate)
+                        float  evap_rate,
+                        bool   parallel)
 {
   Array mmap = constant(z.shape, 1.f);
   hydraulic_musgrave(z,
@@ -132,7 +146,8 @@ void hydraulic_musgrave(Array &z,
                      c_erosion,
                      c_deposition,
                      water_level,
-                     evap_rate);
+                     evap_rate,
+                     parallel);
 }
 
 } // namespace hmap
@@ -1,7 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
-#include <random>
+#include <algorithm>
+#include <numeric>
 
 #include "macrologger.h"
 
@@ -14,6 +15,7 @@
 #include "highmap/math.hpp"
 #include "highmap/primitives.hpp"
 #include "highmap/range.hpp"
+#include "highmap/thread_pool.hpp"
 
 #include "highmap/geometry/cloud.hpp"
 
@@ -21,10 +23,79 @@
 
 #define HMAP_EROSION_DT 1.f
 #define HMAP_EROSION_VOLUME_MIN 0.01f
+#define HMAP_EROSION_TILE_SIZE_MIN 32
 
 namespace hmap
 {
 
+namespace
+{
+
+// move a particle by one step and apply the corresponding erosion /
+// deposition, the particle only reads and writes the heightmap within a few
+// cells around its position
+void step_particle(Array       &z,
+                   const Array *p_bedrock,
+                   Particle    &particle,
+                   float        dt,
+                   float        evap_rate)
+{
+  const int ni = z.shape.x;
+  const int nj = z.shape.y;
+
+  float z_prev = z.get_value_bilinear_at(particle.pos.i,
+                                         particle.pos.j,
+                                         particle.pos.u,
+                                         particle.pos.v);
+  Pos   pos_prev = particle.pos;
+
+  particle.move(z, dt);
+
+  if ((particle.pos.i < 1) or (particle.pos.i > ni - 2) or
+      (particle.pos.j < 1) or (particle.pos.j > nj - 2))
+  {
+    particle.is_active = false;
+  }
+  else
+  {
+    float z_next = z.get_value_bilinear_at(particle.pos.i,
+                                           particle.pos.j,
+                                           particle.pos.u,
+                                           particle.pos.v);
+
+    // particle sediment capacity
+    float dz = z_prev - z_next;
+    float sc = particle.c_capacity * particle.volume * particle.vnorm * dz;
+    float delta_sc = dt * (sc - particle.sediment);
+    float amount;
+
+    if (delta_sc > 0.f)
+      amount = particle.c_erosion * delta_sc; // erosion
+    else
+      amount = particle.c_deposition * delta_sc; // deposition
+
+    particle.sediment += amount;
+
+    z.depose_amount_bilinear_at(pos_prev.i,
+                                pos_prev.j,
+                                pos_prev.u,
+                                pos_prev.v,
+                                -amount);
+
+    // make sure bedrock is not eroded
+    if (p_bedrock)
+      z(pos_prev.i, pos_prev.j) = std::max(z(pos_prev.i, pos_prev.j),
+                                           (*p_bedrock)(pos_prev.i,
+                                                        pos_prev.j));
+
+    particle.volume *= (1 - dt * evap_rate);
+
+    if (particle.volume < HMAP_EROSION_VOLUME_MIN) particle.is_active = false;
+  }
+}
+
+} // namespace
+
 //----------------------------------------------------------------------
 // Main operator(s)
 //----------------------------------------------------------------------
@@ -48,9 +119,6 @@ void hydraulic_particle(Array &z,
   const int nj = z.shape.y;
   float     dt = HMAP_EROSION_DT;
 
-  std::mt19937                          gen(seed);
-  std::uniform_real_distribution<float> dis(0, 1);
-
   // --- initialization
 
   // keep a backup of the input if the erosion / deposition maps need
@@ -82,71 +150,78 @@ void hydraulic_particle(Array &z,
 
   // --- main loop
 
-  // keep track of the number of active particles
-  int n_active_particles = nparticles;
+  // The particles are moved one step at a time. At each step, they are
+  // bucketed by tile and the tiles are processed in 4 passes (2x2
+  // checkerboard): a particle only interacts with the heightmap within a few
+  // cells around its tile, tiles of the same color can then be processed
+  // concurrently, and the particles of a tile are moved sequentially in
+  // index order. The result only depends on the particle positions and
+  // indices, not on the number of threads.
+
+  const int tile_size = std::max(HMAP_EROSION_TILE_SIZE_MIN,
+                                 (std::max(ni, nj) + 63) / 64);
+  const int ntx = (ni + tile_size - 1) / tile_size;
+  const int nty = (nj + tile_size - 1) / tile_size;
+
+  std::vector<int> active(nparticles); // active particles, in index order
+  std::iota(active.begin(), active.end(), 0);
 
-  // loop over particles
-  while (n_active_particles > 0)
+  std::vector<int> tile_offsets(ntx * nty + 1);
+  std::vector<int> tile_particles(nparticles);
+
+  while (!active.empty())
   {
-    for (auto &particle : particles)
+    // bucket the particles by tile (counting sort, stable)
+    auto tile_id = [&](int ip)
     {
-      if (particle.is_active)
-      {
-        float z_prev = z.get_value_bilinear_at(particle.pos.i,
-                                               particle.pos.j,
-                                               particle.pos.u,
-                                               particle.pos.v);
-        Pos   pos_prev = particle.pos;
+      const Pos &pos = particles[ip].pos;
+      return (pos.j / tile_size) * ntx + pos.i / tile_size;
+    };
 
-        particle.move(z, dt);
+    std::fill(tile_offsets.begin(), tile_offsets.end(), 0);
 
-        if ((particle.pos.i < 1) or (particle.pos.i > ni - 2) or
-            (particle.pos.j < 1) or (particle.pos.j > nj - 2))
-        {
-          particle.is_active = false;
-        }
-        else
+    for (int ip : active)
+      tile_offsets[tile_id(ip) + 1]++;
+
+    for (int t = 0; t < ntx * nty; t++)
+      tile_offsets[t + 1] += tile_offsets[t];
+
+    {
+      std::vector<int> fill(tile_offsets.begin(), tile_offsets.end() - 1);
+      for (int ip : active)
+        tile_particles[fill[tile_id(ip)]++] = ip;
+    }
+
+    // move the particles, one pass per tile color, one row of tiles of the
+    // current color per task
+    for (int cj = 0; cj < 2; cj++)
+      for (int ci = 0; ci < 2; ci++)
+      {
+        auto lambda_tiles = [&](size_t r)
         {
-          float z_next = z.get_value_bilinear_at(particle.pos.i,
-                                                 particle.pos.j,
-                                                 particle.pos.u,
-                                                 particle.pos.v);
-
-          // particle sediment capacity
-          float dz = z_prev - z_next;
-          float sc = particle.c_capacity * particle.volume * particle.vnorm *
-                     dz;
-          float delta_sc = dt * (sc - particle.sediment);
-          float amount;
-
-          if (delta_sc > 0.f)
-            amount = particle.c_erosion * delta_sc; // erosion
-          else
-            amount = particle.c_deposition * delta_sc; // deposition
-
-          particle.sediment += amount;
-
-          z.depose_amount_bilinear_at(pos_prev.i,
-                                      pos_prev.j,
-                                      pos_prev.u,
-                                      pos_prev.v,
-                                      -amount);
-
-          // make sure bedrock is not eroded
-          if (p_bedrock)
-            z(pos_prev.i,
-              pos_prev.j) = std::max(z(pos_prev.i, pos_prev.j),
-                                     (*p_bedrock)(pos_prev.i, pos_prev.j));
-
-          particle.volume *= (1 - dt * evap_rate);
-
-          if (particle.volume < HMAP_EROSION_VOLUME_MIN)
-            particle.is_active = false;
-        }
-
-        if (!particle.is_active) n_active_particles--;
+          int jt = cj + 2 * (int)r;
+
+          for (int it = ci; it < ntx; it += 2)
+          {
+            int t = jt * ntx + it;
+            for (int k = tile_offsets[t]; k < tile_offsets[t + 1]; k++)
+              step_particle(z,
+                            p_bedrock,
+                            particles[tile_particles[k]],
+                            dt,
+                            evap_rate);
+          }
+        };
+
+        parallel_for((nty - cj + 1) / 2, lambda_tiles);
       }
-    }
+
+    // remove inactive particles
+    active.erase(std::remove_if(active.begin(),
+                                active.end(),
+                                [&particles](int ip)
+                                { return !particles[ip].is_active; }),
+                 active.end());
   }
 
   extrapolate_borders(z);
@@ -45,7 +45,7 @@ void hydraulic_stream(Array &z,
   {
     Array kernel = cone({ir, ir});
     kernel.normalize();
-    facc = convolve2d_svd(facc, kernel);
+    facc = convolve2d(facc, kernel);
   }
 
   if (p_moisture_map)
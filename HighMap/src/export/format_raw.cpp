@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
 #include <vector>
@@ -14,8 +15,11 @@ namespace hmap
 
 void write_raw_16bit(const std::string &fname, const Array &array)
 {
-  const float vmin = array.min();
-  const float vmax = array.max();
+  // single pass over the data for both bounds
+  const auto [it_min, it_max] = std::minmax_element(array.vector.begin(),
+                                                    array.vector.end());
+  const float vmin = *it_min;
+  const float vmax = *it_max;
   float       a = 0.f;
   float       b = 0.f;
   if (vmin != vmax)
@@ -27,21 +31,18 @@ void write_raw_16bit(const std::string &fname, const Array &array)
   a *= 65535.f;
   b *= 65535.f;
 
-  std::ofstream f;
-  f.open(fname, std::ios::binary);
+  // rows are flipped (first row on top), converted and written at once
+  std::vector<uint16_t> data(array.size());
+  size_t                r = 0;
 
   for (int j = array.shape.y - 1; j > -1; j -= 1)
     for (int i = 0; i < array.shape.x; i++)
-    {
-      uint16_t v = (uint32_t)(a * array(i, j) + b);
-      f.write(reinterpret_cast<const char *>(&v), sizeof(uint16_t));
-    }
-
-  // for (auto &v : array.vector)
-  // {
-  //   uint16_t d = (uint32_t)(a * v + b);
-  //   f.write(reinterpret_cast<const char *>(&d), sizeof(uint16_t));
-  // }
+      data[r++] = (uint32_t)(a * array(i, j) + b);
+
+  std::ofstream f;
+  f.open(fname, std::ios::binary);
+  f.write(reinterpret_cast<const char *>(data.data()),
+          sizeof(uint16_t) * data.size());
 
   f.close();
 }
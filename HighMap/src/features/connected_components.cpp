@@ -1,117 +1,380 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
-#include <map>
+#include <algorithm>
 
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
-#include "highmap/boundary.hpp"
+#include "highmap/features.hpp"
+#include "highmap/heightmap.hpp"
+#include "highmap/thread_pool.hpp"
+
+// number of rows of the strips labelled concurrently (arrays)
+#define HMAP_CC_STRIP_HEIGHT 64
 
 namespace hmap
 {
 
-Array connected_components(const Array &array,
-                           float        surface_threshold,
-                           float        background_value)
+namespace
+{
+
+// rectangular block of a global grid, labelled independently of the other
+// blocks (data are read in place)
+struct Block
+{
+  const float *data;   // first cell of the block
+  int          stride; // row length of the underlying array
+  Vec2<int>    origin; // global indices of the first cell
+  Vec2<int>    shape;  // block shape
+
+  std::vector<int>                 labels; // provisional labels (-1: none)
+  std::vector<int>                 parent; // union-find forest of the labels
+  std::vector<ComponentStatistics> stats;  // statistics per provisional label
+  int                              offset; // global index of the first label
+};
+
+// uniform grid of blocks (the last blocks of each row / column may be
+// smaller)
+struct BlockGrid
+{
+  std::vector<Block> blocks;
+  Vec2<int>          nblocks;
+  Vec2<int>          block_shape;
+  Vec2<int>          shape;
+
+  // global provisional label of a cell (-1 for background)
+  int get_label(int i, int j) const
+  {
+    const Block &b = this->blocks[(j / this->block_shape.y) * this->nblocks.x +
+                                  i / this->block_shape.x];
+    int          l = b.labels[(j - b.origin.y) * b.shape.x + i - b.origin.x];
+    return l < 0 ? -1 : b.offset + l;
+  }
+};
+
+int find_root(std::vector<int> &parent, int l)
+{
+  // path halving
+  while (parent[l] != l)
+  {
+    parent[l] = parent[parent[l]];
+    l = parent[l];
+  }
+  return l;
+}
+
+// the root of a tree is its smallest label
+void merge(std::vector<int> &parent, int la, int lb)
 {
-  // neighbor search pattern
-  const std::vector<int> di = {0, -1, -1, -1};
-  const std::vector<int> dj = {-1, -1, 0, 1};
-  const size_t           nb = di.size();
+  int ra = find_root(parent, la);
+  int rb = find_root(parent, lb);
+
+  if (ra < rb)
+    parent[rb] = ra;
+  else if (rb < ra)
+    parent[ra] = rb;
+}
 
-  // padding: one cell with a non-background value on the borders
-  const int npi = array.shape.x + 2;
-  const int npj = array.shape.y + 2;
+void merge_statistics(ComponentStatistics &s, const ComponentStatistics &t)
+{
+  s.area += t.area;
+  s.bbox.a = std::min(s.bbox.a, t.bbox.a);
+  s.bbox.b = std::max(s.bbox.b, t.bbox.b);
+  s.bbox.c = std::min(s.bbox.c, t.bbox.c);
+  s.bbox.d = std::max(s.bbox.d, t.bbox.d);
+}
 
-  Array labels = Array(Vec2<int>(npi, npj));
-  Array array_pad = generate_buffered_array(array, {1, 1, 1, 1});
-  set_borders(array_pad, background_value + 1.f, 1);
+// first pass of the two-pass labelling, within a single block (8-connectivity,
+// the neighbors already visited are W, NW, N and NE)
+void label_block(Block &b, float background_value)
+{
+  const int di[4] = {-1, -1, 0, 1};
+  const int dj[4] = {0, -1, -1, -1};
 
-  // --- first pass of labelling
+  b.labels.resize(b.shape.x * b.shape.y);
+  b.parent.clear();
+  b.stats.clear();
 
-  int                                 current_label = 0;
-  std::map<float, std::vector<float>> labels_mapping = {};
+  for (int j = 0; j < b.shape.y; j++)
+    for (int i = 0; i < b.shape.x; i++)
+    {
+      int k = j * b.shape.x + i;
 
-  for (int j = 0; j < npj; j++)
-    for (int i = 0; i < npi; i++)
-      if (array_pad(i, j) != background_value)
+      if (b.data[j * b.stride + i] == background_value)
       {
-        // scan neighbors and count those that are "background"
-        std::vector<int> nbrs_label = {};
-        nbrs_label.reserve(nb);
+        b.labels[k] = -1;
+        continue;
+      }
 
-        for (size_t k = 0; k < nb; k++)
-        {
-          int p = i + di[k];
-          int q = j + dj[k];
-          if ((p > 0) and (p < npi) and (q > 0) and (q < npj))
-            if (array_pad(p, q) != background_value)
-              nbrs_label.push_back(labels(p, q));
-        }
+      int l = -1;
+
+      for (int r = 0; r < 4; r++)
+      {
+        int p = i + di[r];
+        int q = j + dj[r];
 
-        if (nbrs_label.size() == 0)
-          labels(i, j) = current_label++;
-        else if (nbrs_label.size() == 1)
-          // set current label to the value of the only
-          // non-background neighbor
-          labels(i, j) = nbrs_label.back();
-        else
+        if (p >= 0 && p < b.shape.x && q >= 0)
         {
-          int lmin = *std::min_element(nbrs_label.begin(), nbrs_label.end());
-          labels(i, j) = lmin;
+          int ln = b.labels[q * b.shape.x + p];
 
-          // keep track of links between label values
-          for (auto &v : nbrs_label)
-            if (lmin != v) labels_mapping[lmin].push_back(v);
+          if (ln < 0)
+            continue;
+          else if (l < 0)
+            l = ln;
+          else if (ln != l)
+            merge(b.parent, l, ln);
         }
       }
 
-  // --- relabel components
+      int ig = b.origin.x + i;
+      int jg = b.origin.y + j;
+
+      if (l < 0)
+      {
+        l = (int)b.parent.size();
+        b.parent.push_back(l);
+        b.stats.push_back({0.f, 0, Vec4<int>(ig, ig, jg, jg)});
+      }
+
+      b.labels[k] = l;
+      merge_statistics(b.stats[l], {0.f, 1, Vec4<int>(ig, ig, jg, jg)});
+    }
+}
+
+// label the blocks and resolve the labels across the blocks. Return the output
+// value of each global provisional label (component label, or background value
+// if the component is removed). Components are numbered from 1, in the order
+// of the blocks and in raster order within a block
+std::vector<float> label_grid(BlockGrid                        &grid,
+                              float                             threshold,
+                              float                             background,
+                              std::vector<ComponentStatistics> *p_statistics)
+{
+  std::vector<Block> &blocks = grid.blocks;
 
-  // reverse the labels mapping
-  std::map<float, float> labels_mapping_reverse = {};
+  parallel_for(blocks.size(),
+               [&blocks, background](size_t k)
+               { label_block(blocks[k], background); });
 
-  for (auto &[key, v] : labels_mapping)
-    for (auto &s : v)
-      labels_mapping_reverse[s] = key;
+  // gather the union-find forests of the blocks
+  std::vector<int>                 parent = {};
+  std::vector<ComponentStatistics> stats = {};
 
-  // find the root label by "traversing" the mapping, starting from
-  // the higher labels
-  for (auto it = labels_mapping_reverse.rbegin();
-       it != labels_mapping_reverse.rend();
-       it++)
+  for (auto &b : blocks)
   {
-    float label_root = it->first;
-    while (true)
+    b.offset = (int)parent.size();
+    for (int l : b.parent)
+      parent.push_back(b.offset + l);
+    stats.insert(stats.end(), b.stats.begin(), b.stats.end());
+
+    b.parent.clear();
+    b.stats.clear();
+  }
+
+  // merge labels across the block boundaries
+  for (auto &b : blocks)
+  {
+    auto lambda_merge = [&](int i, int j)
     {
-      if (labels_mapping_reverse.contains(label_root))
-        label_root = labels_mapping_reverse[label_root];
-      else
-        break;
+      int l = b.labels[(j - b.origin.y) * b.shape.x + i - b.origin.x];
+      if (l < 0) return;
+
+      for (int q = j - 1; q <= j + 1; q++)
+        for (int p = i - 1; p <= i + 1; p++)
+        {
+          bool is_inside_block = p >= b.origin.x &&
+                                 p < b.origin.x + b.shape.x &&
+                                 q >= b.origin.y && q < b.origin.y + b.shape.y;
+
+          if (is_inside_block || p < 0 || p >= grid.shape.x || q < 0 ||
+              q >= grid.shape.y)
+            continue;
+
+          int ln = grid.get_label(p, q);
+          if (ln >= 0) merge(parent, b.offset + l, ln);
+        }
+    };
+
+    for (int i = b.origin.x; i < b.origin.x + b.shape.x; i++)
+    {
+      lambda_merge(i, b.origin.y);
+      lambda_merge(i, b.origin.y + b.shape.y - 1);
+    }
+
+    for (int j = b.origin.y; j < b.origin.y + b.shape.y; j++)
+    {
+      lambda_merge(b.origin.x, j);
+      lambda_merge(b.origin.x + b.shape.x - 1, j);
     }
-    it->second = label_root;
   }
 
-  std::map<float, float> labels_surface = {};
+  // relabelling, roots are visited before the other labels of their tree
+  std::vector<int>                 component(parent.size());
+  std::vector<ComponentStatistics> components = {};
+
+  for (int l = 0; l < (int)parent.size(); l++)
+  {
+    int r = find_root(parent, l);
 
-  for (int j = 0; j < npj; j++)
-    for (int i = 0; i < npi; i++)
+    if (r == l)
+    {
+      component[l] = (int)components.size();
+      components.push_back(stats[l]);
+      components.back().label = (float)components.size();
+    }
+    else
     {
-      if ((labels(i, j) > 0) & (labels_mapping_reverse.contains(labels(i, j))))
-        labels(i, j) = labels_mapping_reverse[labels(i, j)];
-      labels_surface[labels(i, j)] += 1.f;
+      component[l] = component[r];
+      merge_statistics(components[component[l]], stats[l]);
     }
+  }
+
+  // output values
+  std::vector<float> values(parent.size());
+
+  for (size_t l = 0; l < parent.size(); l++)
+  {
+    const ComponentStatistics &s = components[component[l]];
+    values[l] = (float)s.area < threshold ? background : s.label;
+  }
+
+  if (p_statistics)
+  {
+    p_statistics->clear();
+    for (auto &s : components)
+      if ((float)s.area >= threshold) p_statistics->push_back(s);
+  }
+
+  return values;
+}
+
+} // namespace
+
+Array connected_components(const Array                      &array,
+                           float                             surface_threshold,
+                           float                             background_value,
+                           std::vector<ComponentStatistics> *p_statistics)
+{
+  Array labels = Array(array.shape);
+
+  if (array.size() == 0) return labels;
+
+  // horizontal strips of the input array
+  BlockGrid grid;
+  grid.shape = array.shape;
+  grid.block_shape = {array.shape.x,
+                      std::min(array.shape.y, HMAP_CC_STRIP_HEIGHT)};
+  grid.nblocks = {1,
+                  (array.shape.y + grid.block_shape.y - 1) /
+                      grid.block_shape.y};
+
+  for (int r = 0; r < grid.nblocks.y; r++)
+  {
+    Block b;
+    b.origin = {0, r * grid.block_shape.y};
+    b.shape = {array.shape.x,
+               std::min(grid.block_shape.y, array.shape.y - b.origin.y)};
+    b.data = array.vector.data() + array.linear_index(0, b.origin.y);
+    b.stride = array.shape.x;
+    grid.blocks.push_back(b);
+  }
+
+  std::vector<float> values = label_grid(grid,
+                                         surface_threshold,
+                                         background_value,
+                                         p_statistics);
+
+  // background cells are set to zero
+  parallel_for(grid.blocks.size(),
+               [&](size_t k)
+               {
+                 const Block &b = grid.blocks[k];
+                 float       *p_out = labels.vector.data() +
+                                labels.linear_index(0, b.origin.y);
+
+                 for (size_t r = 0; r < b.labels.size(); r++)
+                   p_out[r] = b.labels[r] < 0 ? 0.f
+                                              : values[b.offset + b.labels[r]];
+               });
+
+  return labels;
+}
+
+Heightmap connected_components(
+    const Heightmap                  &h,
+    float                             surface_threshold,
+    float                             background_value,
+    std::vector<ComponentStatistics> *p_statistics)
+{
+  Heightmap labels = Heightmap(h.shape, h.tiling, h.overlap);
+
+  // one block per tile, restricted to the cells that are not part of the
+  // tile overlap buffers (same as Heightmap::statistics)
+  BlockGrid grid;
+  grid.nblocks = h.tiling;
+  grid.block_shape = {h.shape.x / h.tiling.x, h.shape.y / h.tiling.y};
+  grid.shape = {grid.block_shape.x * h.tiling.x,
+                grid.block_shape.y * h.tiling.y};
+
+  if (grid.block_shape.x == 0 || grid.block_shape.y == 0) return labels;
+
+  int delta_buffer_i = (int)(h.overlap * h.shape.x / h.tiling.x);
+  int delta_buffer_j = (int)(h.overlap * h.shape.y / h.tiling.y);
+
+  // origin of the tile cores within the tiles
+  std::vector<Vec2<int>> core_origins(h.get_ntiles());
+
+  // blocks read the tiles in place, all the tiles are pinned during the
+  // labelling (out-of-core heightmaps)
+  for (size_t k = 0; k < h.get_ntiles(); k++)
+  {
+    h.pin_tile(k);
+
+    int it = (int)k % h.tiling.x;
+    int jt = (int)k / h.tiling.x;
+
+    core_origins[k] = {it > 0 ? delta_buffer_i : 0,
+                       jt > 0 ? delta_buffer_j : 0};
+
+    Block b;
+    b.origin = {it * grid.block_shape.x, jt * grid.block_shape.y};
+    b.shape = grid.block_shape;
+    b.data = h.tiles[k].vector.data() +
+             h.tiles[k].linear_index(core_origins[k].x, core_origins[k].y);
+    b.stride = h.tiles[k].shape.x;
+    grid.blocks.push_back(b);
+  }
+
+  std::vector<float> values = label_grid(grid,
+                                         surface_threshold,
+                                         background_value,
+                                         p_statistics);
+
+  for (size_t k = 0; k < h.get_ntiles(); k++)
+    h.unpin_tile(k, false);
+
+  // fill the tiles, including the overlap buffers (the value of a cell is
+  // taken from the tile core it belongs to)
+  parallel_for(h.get_ntiles(),
+               [&](size_t k)
+               {
+                 TilePin pin({&labels}, k);
+                 Tile   &tile = labels.tiles[k];
+
+                 for (int q = 0; q < tile.shape.y; q++)
+                   for (int p = 0; p < tile.shape.x; p++)
+                   {
+                     int ig = grid.blocks[k].origin.x + p - core_origins[k].x;
+                     int jg = grid.blocks[k].origin.y + q - core_origins[k].y;
 
-  // removing padding before returning the result
-  labels = labels.extract_slice({1, npi - 1, 1, npj - 1});
+                     ig = std::clamp(ig, 0, grid.shape.x - 1);
+                     jg = std::clamp(jg, 0, grid.shape.y - 1);
 
-  // --- remove component with a "small" surface
-  if (surface_threshold > 0.f)
-    for (int j = 0; j < labels.shape.y; j++)
-      for (int i = 0; i < labels.shape.x; i++)
-        if (labels_surface[labels(i, j)] < surface_threshold)
-          labels(i, j) = background_value;
+                     int l = grid.get_label(ig, jg);
+                     tile(p, q) = l < 0 ? 0.f : values[l];
+                   }
+               });
 
   return labels;
 }
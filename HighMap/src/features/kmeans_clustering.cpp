@@ -1,256 +1,475 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
-#include "dkm.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
-#include "highmap/geometry/cloud.hpp"
+#include "highmap/thread_pool.hpp"
+
+// number of points per block, centroid partial sums are stored per block so
+// that the result does not depend on the number of threads
+#define HMAP_KMEANS_BLOCK_SIZE 16384
+// number of points sampled to initialize the centroids
+#define HMAP_KMEANS_SAMPLE_SIZE 16384
+#define HMAP_KMEANS_MAX_ITERATIONS 100
 
 namespace hmap
 {
 
-Array kmeans_clustering2(const Array        &array1,
-                         const Array        &array2,
-                         int                 nclusters,
-                         std::vector<Array> *p_scoring,
-                         Array              *p_aggregate_scoring,
-                         Vec2<float>         weights,
-                         uint                seed)
+namespace
+{
+
+template <size_t N> using Vector = std::array<float, N>;
+
+// weighted data points, read on the fly from the input arrays
+template <size_t N> struct Data
+{
+  std::array<const Array *, N> arrays;
+  Vector<N>                    weights;
+
+  size_t size() const
+  {
+    return this->arrays[0]->vector.size();
+  }
+
+  Vector<N> operator[](size_t k) const
+  {
+    Vector<N> x;
+    for (size_t d = 0; d < N; d++)
+      x[d] = this->weights[d] * this->arrays[d]->vector[k];
+    return x;
+  }
+};
+
+template <size_t N> float distance(const Vector<N> &a, const Vector<N> &b)
 {
-  Vec2<int> shape = array1.shape;
-  Array     kmeans = Array(shape); // output
+  float sum = 0.f;
+  for (size_t d = 0; d < N; d++)
+    sum += (a[d] - b[d]) * (a[d] - b[d]);
+  return std::sqrt(sum);
+}
 
-  // recast data
-  std::vector<std::array<float, 2>> data = {};
-  data.resize(shape.x * shape.y);
+// nearest and second nearest centroids
+template <size_t N>
+void nearest_centroids(const Vector<N>              &x,
+                       const std::vector<Vector<N>> &centroids,
+                       int                          &best,
+                       float                        &d1,
+                       float                        &d2)
+{
+  best = 0;
+  d1 = std::numeric_limits<float>::max();
+  d2 = std::numeric_limits<float>::max();
 
-  for (int j = 0; j < shape.y; j++)
-    for (int i = 0; i < shape.x; i++)
+  for (int c = 0; c < (int)centroids.size(); c++)
+  {
+    float d = distance(x, centroids[c]);
+    if (d < d1)
     {
-      int k = i + j * shape.x;
-      data[k][0] = weights.x * array1(i, j);
-      data[k][1] = weights.y * array2(i, j);
+      d2 = d1;
+      d1 = d;
+      best = c;
     }
+    else if (d < d2)
+      d2 = d;
+  }
+}
 
-  dkm::clustering_parameters<float> parameters =
-      dkm::clustering_parameters<float>(nclusters);
-  parameters.set_random_seed(seed);
-  auto dkm = dkm::kmeans_lloyd(data, parameters);
+// k-means++ seeding followed by Lloyd iterations on a random subsample of
+// the data points
+template <size_t N>
+std::vector<Vector<N>> init_centroids(const Data<N> &data,
+                                      int            nclusters,
+                                      uint           seed)
+{
+  std::mt19937                          gen(seed);
+  std::uniform_real_distribution<float> dis(0.f, 1.f);
+
+  size_t                 n = data.size();
+  std::vector<Vector<N>> sample = {};
 
-  // modify labelling to ensure it remains fairly consistent when the
-  // data are modified (centroid are sorted by their coordinates)
-  std::vector<int>   isort_rev(nclusters);
-  std::vector<Point> centroids = {};
+  if (n <= HMAP_KMEANS_SAMPLE_SIZE)
+  {
+    for (size_t k = 0; k < n; k++)
+      sample.push_back(data[k]);
+  }
+  else
+  {
+    std::uniform_int_distribution<size_t> dis_k(0, n - 1);
+    for (size_t k = 0; k < HMAP_KMEANS_SAMPLE_SIZE; k++)
+      sample.push_back(data[dis_k(gen)]);
+  }
 
-  for (auto &p : std::get<0>(dkm))
-    centroids.push_back(Point(p[0], p[1]));
+  size_t m = sample.size();
 
-  sort_points(centroids);
+  // k-means++, squared distance to the nearest centroid
+  std::vector<Vector<N>> centroids = {sample[(size_t)(dis(gen) * (m - 1))]};
+  std::vector<double>    d2(m);
 
-  // TODO dirty
-  for (int i = 0; i < nclusters; i++)
-    for (int j = 0; j < nclusters; j++)
-      if ((centroids[i].x == std::get<0>(dkm)[j][0]) &
-          (centroids[i].y == std::get<0>(dkm)[j][1]))
-        isort_rev[j] = i;
+  for (size_t k = 0; k < m; k++)
+    d2[k] = std::pow(distance(sample[k], centroids[0]), 2);
 
-  for (size_t k = 0; k < std::get<1>(dkm).size(); k++)
+  while ((int)centroids.size() < nclusters)
   {
-    int j = int(k / shape.x);
-    int i = k - j * shape.x;
-    kmeans(i, j) = isort_rev[std::get<1>(dkm)[k]];
+    double total = std::accumulate(d2.begin(), d2.end(), 0.0);
+    size_t kc = (size_t)(dis(gen) * (m - 1));
+
+    if (total > 0.0)
+    {
+      double target = dis(gen) * total;
+      double cumul = 0.0;
+      for (kc = 0; kc < m - 1; kc++)
+      {
+        cumul += d2[kc];
+        if (cumul > target) break;
+      }
+    }
+
+    centroids.push_back(sample[kc]);
+
+    for (size_t k = 0; k < m; k++)
+      d2[k] = std::min(d2[k],
+                       (double)std::pow(distance(sample[k], centroids.back()),
+                                        2));
   }
 
-  // --- compute a score of belonging to a given cluster (see
-  // https://datascience.stackexchange.com/questions/14435)
+  // Lloyd iterations on the sample
+  std::vector<int> labels(m, -1);
 
-  // those scores are necessary for the aggregate score. If only the
-  // aggregate score is requested, then work on a local vector, if
-  // not, work on the input score vector of arrays
-  std::vector<Array>  scores = {};
-  std::vector<Array> *p_working_scores;
+  for (int it = 0; it < HMAP_KMEANS_MAX_ITERATIONS; it++)
+  {
+    std::vector<std::array<double, N>> sums(nclusters);
+    std::vector<int>                   counts(nclusters, 0);
+    int                                nchanges = 0;
 
-  if (p_scoring)
-    p_working_scores = p_scoring;
-  else
-    p_working_scores = &scores;
+    for (auto &s : sums)
+      s.fill(0.0);
 
-  if (p_scoring || p_aggregate_scoring)
+    for (size_t k = 0; k < m; k++)
+    {
+      int   best;
+      float d1, d2nd;
+      nearest_centroids(sample[k], centroids, best, d1, d2nd);
+
+      if (best != labels[k]) nchanges++;
+      labels[k] = best;
+
+      for (size_t d = 0; d < N; d++)
+        sums[best][d] += sample[k][d];
+      counts[best]++;
+    }
+
+    if (nchanges == 0) break;
+
+    for (int c = 0; c < nclusters; c++)
+      if (counts[c] > 0)
+        for (size_t d = 0; d < N; d++)
+          centroids[c][d] = (float)(sums[c][d] / counts[c]);
+  }
+
+  return centroids;
+}
+
+// k-means on all the data points using Hamerly's algorithm (Lloyd iterations
+// with an upper bound of the distance to the assigned centroid and a lower
+// bound of the distance to the second nearest centroid, to skip most of the
+// distance computations)
+template <size_t N>
+void kmeans_hamerly(const Data<N>          &data,
+                    std::vector<Vector<N>> &centroids,
+                    std::vector<int>       &labels)
+{
+  const size_t n = data.size();
+  const int    nc = (int)centroids.size();
+  const size_t nblocks = (n + HMAP_KMEANS_BLOCK_SIZE - 1) /
+                         HMAP_KMEANS_BLOCK_SIZE;
+
+  std::vector<float> upper(n);
+  std::vector<float> lower(n);
+
+  labels.resize(n);
+
+  // partial sums per block, updated when a point changes of cluster
+  std::vector<std::array<double, N>> sums(nblocks * nc);
+  std::vector<size_t>                counts(nblocks * nc, 0);
+  std::vector<int>                   nchanges(nblocks);
+
+  for (auto &s : sums)
+    s.fill(0.0);
+
+  auto lambda_init = [&](size_t b)
   {
-    p_working_scores->clear();
-    p_working_scores->reserve(nclusters);
-    for (int r = 0; r < nclusters; r++)
-      p_working_scores->push_back(Array(shape));
+    size_t k1 = std::min(n, (b + 1) * HMAP_KMEANS_BLOCK_SIZE);
 
-    for (int j = 0; j < shape.y; j++)
-      for (int i = 0; i < shape.x; i++)
+    for (size_t k = b * HMAP_KMEANS_BLOCK_SIZE; k < k1; k++)
+    {
+      Vector<N> x = data[k];
+      nearest_centroids(x, centroids, labels[k], upper[k], lower[k]);
+
+      for (size_t d = 0; d < N; d++)
+        sums[b * nc + labels[k]][d] += x[d];
+      counts[b * nc + labels[k]]++;
+    }
+  };
+
+  parallel_for(nblocks, lambda_init);
+
+  std::vector<float> moved(nc);
+  std::vector<float> half_gap(nc);
+
+  for (int it = 0; it < HMAP_KMEANS_MAX_ITERATIONS; it++)
+  {
+    // move the centroids (reduction in block order)
+    for (int c = 0; c < nc; c++)
+    {
+      std::array<double, N> sum;
+      size_t                count = 0;
+
+      sum.fill(0.0);
+      for (size_t b = 0; b < nblocks; b++)
       {
-        int k = i + j * shape.x; // linear index
+        for (size_t d = 0; d < N; d++)
+          sum[d] += sums[b * nc + c][d];
+        count += counts[b * nc + c];
+      }
 
-        // normalization factor
-        float sum = 0.f;
-        for (int r = 0; r < nclusters; r++)
-          sum += 1.f / std::hypot(data[k][0] - centroids[r].x,
-                                  data[k][1] - centroids[r].y);
+      Vector<N> cnew = centroids[c];
+      if (count > 0)
+        for (size_t d = 0; d < N; d++)
+          cnew[d] = (float)(sum[d] / count);
 
-        // compute score for each cluster
-        for (int r = 0; r < nclusters; r++)
-        {
-          float score = 1.f / std::hypot(data[k][0] - centroids[r].x,
-                                         data[k][1] - centroids[r].y);
-          score /= sum;
-          p_working_scores->at(r)(i, j) = score;
-        }
+      moved[c] = distance(cnew, centroids[c]);
+      centroids[c] = cnew;
+    }
+
+    // largest and second largest displacements
+    int   cmax = 0;
+    float max1 = 0.f;
+    float max2 = 0.f;
+
+    for (int c = 0; c < nc; c++)
+      if (moved[c] > max1)
+      {
+        max2 = max1;
+        max1 = moved[c];
+        cmax = c;
       }
-  }
+      else if (moved[c] > max2)
+        max2 = moved[c];
+
+    // half distance to the nearest other centroid
+    for (int c = 0; c < nc; c++)
+    {
+      half_gap[c] = std::numeric_limits<float>::max();
+      for (int c2 = 0; c2 < nc; c2++)
+        if (c2 != c)
+          half_gap[c] = std::min(half_gap[c],
+                                 0.5f * distance(centroids[c], centroids[c2]));
+    }
 
-  // --- compute an aggregate score
+    // assignment
+    auto lambda_assign = [&](size_t b)
+    {
+      size_t k1 = std::min(n, (b + 1) * HMAP_KMEANS_BLOCK_SIZE);
 
-  if (p_aggregate_scoring)
-  {
-    *p_aggregate_scoring = Array(shape);
+      nchanges[b] = 0;
 
-    for (int j = 0; j < shape.y; j++)
-      for (int i = 0; i < shape.x; i++)
+      for (size_t k = b * HMAP_KMEANS_BLOCK_SIZE; k < k1; k++)
       {
-        float max = 0.f;
-        int   rmax = 0;
-        for (int r = 0; r < nclusters; r++)
-          if (p_working_scores->at(r)(i, j) > max)
+        int   a = labels[k];
+        float u = upper[k] + moved[a];
+        float l = lower[k] - (a == cmax ? max2 : max1);
+        float bound = std::max(half_gap[a], l);
+
+        if (u > bound)
+        {
+          Vector<N> x = data[k];
+          u = distance(x, centroids[a]);
+
+          if (u > bound)
           {
-            max = p_working_scores->at(r)(i, j);
-            rmax = r;
+            int anew;
+            nearest_centroids(x, centroids, anew, u, l);
+
+            if (anew != a)
+            {
+              for (size_t d = 0; d < N; d++)
+              {
+                sums[b * nc + a][d] -= x[d];
+                sums[b * nc + anew][d] += x[d];
+              }
+              counts[b * nc + a]--;
+              counts[b * nc + anew]++;
+              nchanges[b]++;
+              a = anew;
+            }
           }
+        }
 
-        (*p_aggregate_scoring)(i, j) = ((float)rmax + max) / (float)nclusters;
+        labels[k] = a;
+        upper[k] = u;
+        lower[k] = l;
       }
-  }
+    };
 
-  return kmeans;
+    parallel_for(nblocks, lambda_assign);
+
+    if (std::accumulate(nchanges.begin(), nchanges.end(), 0) == 0) break;
+  }
 }
 
-Array kmeans_clustering3(const Array        &array1,
-                         const Array        &array2,
-                         const Array        &array3,
-                         int                 nclusters,
-                         std::vector<Array> *p_scoring,
-                         Array              *p_aggregate_scoring,
-                         Vec3<float>         weights,
-                         uint                seed)
+// clustering with labels sorted by centroid coordinates (to ensure the
+// labelling remains fairly consistent when the data are modified), and
+// cluster scores (see https://datascience.stackexchange.com/questions/14435),
+// with a score proportional to 'distance^(-exponent)'
+template <size_t N>
+Array kmeans_clustering(const Data<N>      &data,
+                        Vec2<int>           shape,
+                        int                 nclusters,
+                        std::vector<Array> *p_scoring,
+                        Array              *p_aggregate_scoring,
+                        int                 exponent,
+                        uint                seed)
 {
-  Vec2<int> shape = array1.shape;
-  Array     kmeans = Array(shape); // output
-
-  // recast data
-  std::vector<std::array<float, 3>> data = {};
-  data.resize(shape.x * shape.y);
+  Array kmeans = Array(shape); // output
 
-  for (int j = 0; j < shape.y; j++)
-    for (int i = 0; i < shape.x; i++)
-    {
-      int k = i + j * shape.x;
-      data[k][0] = weights.x * array1(i, j);
-      data[k][1] = weights.y * array2(i, j);
-      data[k][2] = weights.z * array3(i, j);
-    }
+  if (nclusters < 1)
+  {
+    LOG_ERROR("nclusters must be at least 1");
+    return kmeans;
+  }
 
-  dkm::clustering_parameters<float> parameters =
-      dkm::clustering_parameters<float>(nclusters);
-  parameters.set_random_seed(seed);
-  auto dkm = dkm::kmeans_lloyd(data, parameters);
+  if (data.size() == 0) return kmeans;
 
-  // modify labelling to ensure it remains fairly consistent when the
-  // data are modified (centroid are sorted by their coordinates)
-  std::vector<int>   isort_rev(nclusters);
-  std::vector<Point> centroids = {};
+  std::vector<Vector<N>> centroids = init_centroids(data, nclusters, seed);
+  std::vector<int>       labels;
 
-  for (auto &p : std::get<0>(dkm))
-    centroids.push_back(Point(p[0], p[1], p[2]));
+  kmeans_hamerly(data, centroids, labels);
 
-  sort_points(centroids);
+  std::vector<int> isort(nclusters);
+  std::vector<int> isort_rev(nclusters);
 
-  // TODO dirty
-  for (int i = 0; i < nclusters; i++)
-    for (int j = 0; j < nclusters; j++)
-      if ((centroids[i].x == std::get<0>(dkm)[j][0]) &
-          (centroids[i].y == std::get<0>(dkm)[j][1]) &
-          (centroids[i].v == std::get<0>(dkm)[j][2]))
-        isort_rev[j] = i;
+  std::iota(isort.begin(), isort.end(), 0);
+  std::sort(isort.begin(),
+            isort.end(),
+            [&centroids](int a, int b) { return centroids[a] < centroids[b]; });
 
-  for (size_t k = 0; k < std::get<1>(dkm).size(); k++)
+  std::vector<Vector<N>> centroids_sorted(nclusters);
+  for (int r = 0; r < nclusters; r++)
   {
-    int j = int(k / shape.x);
-    int i = k - j * shape.x;
-    kmeans(i, j) = isort_rev[std::get<1>(dkm)[k]];
+    isort_rev[isort[r]] = r;
+    centroids_sorted[r] = centroids[isort[r]];
   }
 
-  // --- compute a score of belonging to a given cluster (see
-  // https://datascience.stackexchange.com/questions/14435)
+  for (size_t k = 0; k < labels.size(); k++)
+    kmeans.vector[k] = (float)isort_rev[labels[k]];
 
-  std::vector<Array>  scores = {};
-  std::vector<Array> *p_working_scores;
+  // --- compute the scores and the aggregate score in a single pass
 
   if (p_scoring)
-    p_working_scores = p_scoring;
-  else
-    p_working_scores = &scores;
-
-  if (p_working_scores)
   {
-    p_working_scores->reserve(nclusters);
+    p_scoring->clear();
+    p_scoring->reserve(nclusters);
     for (int r = 0; r < nclusters; r++)
-      p_working_scores->push_back(Array(shape));
+      p_scoring->push_back(Array(shape));
+  }
+
+  if (p_aggregate_scoring) *p_aggregate_scoring = Array(shape);
+
+  if (p_scoring || p_aggregate_scoring)
+  {
+    auto lambda_row = [&](size_t j)
+    {
+      std::vector<float> scores(nclusters);
 
-    for (int i = 0; i < shape.x; i++)
-      for (int j = 0; j < shape.y; j++)
+      for (int i = 0; i < shape.x; i++)
       {
-        int k = i + j * shape.x; // linear index
+        size_t    k = kmeans.linear_index(i, (int)j);
+        Vector<N> x = data[k];
 
         // normalization factor
         float sum = 0.f;
-        for (int r = 0; r < nclusters; r++)
-          sum += 1.f / std::pow(std::hypot(data[k][0] - centroids[r].x,
-                                           data[k][1] - centroids[r].y,
-                                           data[k][2] - centroids[r].v),
-                                2);
-
-        // compute score for each cluster
         for (int r = 0; r < nclusters; r++)
         {
-          float score = 1.f / std::pow(std::hypot(data[k][0] - centroids[r].x,
-                                                  data[k][1] - centroids[r].y,
-                                                  data[k][2] - centroids[r].v),
-                                       2);
-          score /= sum;
-          p_working_scores->at(r)(i, j) = score;
+          scores[r] = 1.f / std::pow(distance(x, centroids_sorted[r]),
+                                     (float)exponent);
+          sum += scores[r];
         }
-      }
-  }
-
-  // --- compute an aggregate score
-
-  if (p_aggregate_scoring)
-  {
-    *p_aggregate_scoring = Array(shape);
 
-    for (int i = 0; i < shape.x; i++)
-      for (int j = 0; j < shape.y; j++)
-      {
         float max = 0.f;
         int   rmax = 0;
+
         for (int r = 0; r < nclusters; r++)
-          if (p_working_scores->at(r)(i, j) > max)
+        {
+          scores[r] /= sum;
+          if (p_scoring) (*p_scoring)[r].vector[k] = scores[r];
+
+          if (scores[r] > max)
           {
-            max = p_working_scores->at(r)(i, j);
+            max = scores[r];
             rmax = r;
           }
+        }
 
-        (*p_aggregate_scoring)(i, j) = ((float)rmax + max) / (float)nclusters;
+        if (p_aggregate_scoring)
+          p_aggregate_scoring->vector[k] = ((float)rmax + max) /
+                                           (float)nclusters;
       }
+    };
+
+    parallel_for(shape.y, lambda_row);
   }
 
   return kmeans;
 }
 
+} // namespace
+
+Array kmeans_clustering2(const Array        &array1,
+                         const Array        &array2,
+                         int                 nclusters,
+                         std::vector<Array> *p_scoring,
+                         Array              *p_aggregate_scoring,
+                         Vec2<float>         weights,
+                         uint                seed)
+{
+  Data<2> data = {{&array1, &array2}, {weights.x, weights.y}};
+
+  return kmeans_clustering(data,
+                           array1.shape,
+                           nclusters,
+                           p_scoring,
+                           p_aggregate_scoring,
+                           1,
+                           seed);
+}
+
+Array kmeans_clustering3(const Array        &array1,
+                         const Array        &array2,
+                         const Array        &array3,
+                         int                 nclusters,
+                         std::vector<Array> *p_scoring,
+                         Array              *p_aggregate_scoring,
+                         Vec3<float>         weights,
+                         uint                seed)
+{
+  Data<3> data = {{&array1, &array2, &array3},
+                  {weights.x, weights.y, weights.z}};
+
+  return kmeans_clustering(data,
+                           array1.shape,
+                           nclusters,
+                           p_scoring,
+                           p_aggregate_scoring,
+                           2,
+                           seed);
+}
+
 } // namespace hmap
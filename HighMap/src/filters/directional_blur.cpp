@@ -45,7 +45,7 @@ void directional_blur(Array       &array,
         float x = (i + kr * ca) / (array.shape.x - 1.f);
         float y = (j + kr * sa) / (array.shape.y - 1.f);
 
-        blured(i, j) += t[std::abs(k)] * f.get_delegate()(x, y, 0.f);
+        blured(i, j) += t[std::abs(k)] * f.get_value(x, y, 0.f);
       }
 
   // try to rescale output
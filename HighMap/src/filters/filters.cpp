@@ -3,6 +3,7 @@
  * this software. */
 
 #include <cmath>
+#include <functional>
 #include <random>
 
 #include "macrologger.h"
@@ -60,33 +61,8 @@ void equalize(Array &array, const Array *p_mask)
 
 void expand(Array &array, int ir, int iterations)
 {
-  Array array_new = array;
-  int   ni = array.shape.x;
-  int   nj = array.shape.y;
   Array k = cubic_pulse({2 * ir + 1, 2 * ir + 1});
-
-  for (int it = 0; it < iterations; ++it)
-  {
-    for (int j = 0; j < nj; j++)
-    {
-      int q1 = std::max(0, j - ir) - j;
-      int q2 = std::min(nj, j + ir + 1) - j;
-      for (int i = 0; i < ni; i++)
-      {
-        int p1 = std::max(0, i - ir) - i;
-        int p2 = std::min(ni, i + ir + 1) - i;
-
-        for (int q = q1; q < q2; q++)
-          for (int p = p1; p < p2; p++)
-          {
-            float v = array(i + p, j + q) * k(p + ir, q + ir);
-            array_new(i, j) = std::max(array_new(i, j), v);
-          }
-      }
-    }
-
-    array = array_new;
-  }
+  expand(array, k, iterations);
 }
 
 void expand(Array &array, int ir, const Array *p_mask, int iterations)
@@ -108,27 +84,33 @@ void expand(Array &array, const Array &kernel, int iterations)
   int   nj = array.shape.y;
 
   int ri1 = (int)(0.5f * kernel.shape.x);
-  int ri2 = kernel.shape.x - ri1 - 1;
   int rj1 = (int)(0.5f * kernel.shape.y);
-  int rj2 = kernel.shape.y - rj1 - 1;
 
   for (int it = 0; it < iterations; ++it)
   {
+    // weighted maximum, loop over the kernel cells for each output row so
+    // that the innermost loop runs along contiguous (vectorized) rows
     for (int j = 0; j < nj; j++)
     {
-      int q1 = std::max(0, j - rj1) - j;
-      int q2 = std::min(nj, j + rj2 + 1) - j;
-      for (int i = 0; i < ni; i++)
+      float *p_new = &array_new.vector[array.linear_index(0, j)];
+
+      for (int kj = 0; kj < kernel.shape.y; kj++)
       {
-        int p1 = std::max(0, i - ri1) - i;
-        int p2 = std::min(ni, i + ri2 + 1) - i;
-
-        for (int q = q1; q < q2; q++)
-          for (int p = p1; p < p2; p++)
-          {
-            float v = array(i + p, j + q) * kernel(p + ri1, q + rj1);
-            array_new(i, j) = std::max(array_new(i, j), v);
-          }
+        int q = j + kj - rj1;
+        if (q < 0 || q >= nj) continue;
+
+        const float *p_row = &array.vector[array.linear_index(0, q)];
+
+        for (int ki = 0; ki < kernel.shape.x; ki++)
+        {
+          int   p = ki - ri1;
+          int   i1 = std::max(0, -p);
+          int   i2 = std::min(ni, ni - p);
+          float w = kernel(ki, kj);
+
+          for (int i = i1; i < i2; i++)
+            p_new[i] = std::max(p_new[i], p_row[i + p] * w);
+        }
       }
     }
     array = array_new;
@@ -912,8 +894,162 @@ void shrink_directional(Array       &array,
   shrink(array, kernel, p_mask);
 }
 
-void smooth_cone(Array &array, int ir)
+// --- recursive smoothing backend (cost independent of the radius)
+
+// symmetric padding index (period 2 n)
+static int smoothing_mirror(int k, int n)
+{
+  k %= 2 * n;
+  if (k < 0) k += 2 * n;
+  return k < n ? k : 2 * n - 1 - k;
+}
+
+// running-sum box filter along j over the window [j - r1, j + r2], whole rows
+// are processed at once so that the inner loops are vectorized
+static void smoothing_box_j(Array &array, int r1, int r2, float weight)
+{
+  const int ni = array.shape.x;
+  const int nj = array.shape.y;
+
+  Array               array_in = array;
+  std::vector<double> acc(ni, 0.0);
+
+  auto lambda_row = [&](int q)
+  {
+    int jj = smoothing_mirror(q, nj);
+    return &array_in.vector[array_in.linear_index(0, jj)];
+  };
+
+  for (int q = -r1; q <= r2; q++)
+  {
+    const float *p_row = lambda_row(q);
+    for (int i = 0; i < ni; i++)
+      acc[i] += p_row[i];
+  }
+
+  for (int j = 0; j < nj; j++)
+  {
+    float       *p_out = &array.vector[array.linear_index(0, j)];
+    const float *p_add = lambda_row(j + r2 + 1);
+    const float *p_sub = lambda_row(j - r1);
+
+    for (int i = 0; i < ni; i++)
+    {
+      p_out[i] = weight * (float)acc[i];
+      acc[i] += (double)p_add[i] - (double)p_sub[i];
+    }
+  }
+}
+
+// odd widths of a cascade of n box filters approximating a Gaussian of
+// standard deviation sigma (Kovesi, "Fast almost-Gaussian filtering", 2010)
+static std::vector<int> smoothing_box_widths(float sigma, int n)
 {
+  float s2 = 12.f * sigma * sigma;
+  int   wl = (int)std::sqrt(s2 / (float)n + 1.f);
+  if (wl % 2 == 0) wl--;
+  wl = std::max(1, wl);
+
+  int m = (int)std::round((s2 - n * wl * wl - 4 * n * wl - 3 * n) /
+                          (-4.f * wl - 4.f));
+
+  std::vector<int> widths(n);
+  for (int k = 0; k < n; k++)
+    widths[k] = k < m ? wl : wl + 2;
+
+  return widths;
+}
+
+// Young-van Vliet recursive Gaussian filter along j, the boundaries are
+// initialized with the steady state of a constant (edge) value
+static void smoothing_gaussian_j(Array &array, float sigma)
+{
+  const int ni = array.shape.x;
+  const int nj = array.shape.y;
+
+  double q;
+  if (sigma >= 2.5f)
+    q = 0.98711 * sigma - 0.96330;
+  else
+    q = 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+  double q2 = q * q;
+  double q3 = q2 * q;
+
+  double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+  double b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+  double b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+  double b3 = 0.422205 * q3 / b0;
+  double bb = 1.0 - (b1 + b2 + b3);
+
+  // forward then backward (in-place) passes, whole rows at once
+  std::vector<double> w((size_t)ni * nj);
+  std::vector<double> edge(ni);
+
+  for (int i = 0; i < ni; i++)
+    edge[i] = array(i, 0);
+
+  for (int j = 0; j < nj; j++)
+  {
+    const float  *p_in = &array.vector[array.linear_index(0, j)];
+    double       *p_w = &w[(size_t)j * ni];
+    const double *p1 = j > 0 ? p_w - ni : edge.data();
+    const double *p2 = j > 1 ? p_w - 2 * ni : edge.data();
+    const double *p3 = j > 2 ? p_w - 3 * ni : edge.data();
+
+    for (int i = 0; i < ni; i++)
+      p_w[i] = bb * p_in[i] + b1 * p1[i] + b2 * p2[i] + b3 * p3[i];
+  }
+
+  std::copy(w.end() - ni, w.end(), edge.begin());
+
+  for (int j = nj - 1; j >= 0; j--)
+  {
+    double       *p_w = &w[(size_t)j * ni];
+    const double *p1 = j < nj - 1 ? p_w + ni : edge.data();
+    const double *p2 = j < nj - 2 ? p_w + 2 * ni : edge.data();
+    const double *p3 = j < nj - 3 ? p_w + 3 * ni : edge.data();
+    float        *p_out = &array.vector[array.linear_index(0, j)];
+
+    for (int i = 0; i < ni; i++)
+    {
+      p_w[i] = bb * p_w[i] + b1 * p1[i] + b2 * p2[i] + b3 * p3[i];
+      p_out[i] = (float)p_w[i];
+    }
+  }
+}
+
+// apply a filter along j, then along i using (cache-blocked) transposes
+static void smoothing_separable(Array                             &array,
+                                const std::function<void(Array &)> &fct_j)
+{
+  fct_j(array);
+  array = transpose(array);
+  fct_j(array);
+  array = transpose(array);
+}
+
+void smooth_cone(Array &array, int ir, SmoothingMethod method)
+{
+  if (method == SMOOTHING_RECURSIVE)
+  {
+    // centered triangle kernel (support 2 ir + 1), computed exactly as the
+    // convolution of two box kernels of width ir + 1. Approximation of the
+    // convolution kernel below, which is sampled half a cell off-center
+    if (ir <= 0) return;
+
+    int   r1 = ir / 2;
+    int   r2 = ir - r1;
+    float weight = 1.f / (float)(ir + 1);
+
+    smoothing_separable(array,
+                        [&](Array &a)
+                        {
+                          smoothing_box_j(a, r1, r2, weight);
+                          smoothing_box_j(a, r2, r1, weight);
+                        });
+    return;
+  }
+
   // define kernel
   const int          nk = 2 * ir + 1;
   std::vector<float> k(nk);
@@ -938,20 +1074,42 @@ void smooth_cone(Array &array, int ir)
   array = convolve1d_j(array, k);
 }
 
-void smooth_cone(Array &array, int ir, const Array *p_mask)
+void smooth_cone(Array          &array,
+                 int             ir,
+                 const Array    *p_mask,
+                 SmoothingMethod method)
 {
   if (!p_mask)
-    smooth_cone(array, ir);
+    smooth_cone(array, ir, method);
   else
   {
     Array array_f = array;
-    smooth_cone(array_f, ir);
+    smooth_cone(array_f, ir, method);
     array = lerp(array, array_f, *(p_mask));
   }
 }
 
-void smooth_cpulse(Array &array, int ir)
+void smooth_cpulse(Array &array, int ir, SmoothingMethod method)
 {
+  if (method == SMOOTHING_RECURSIVE)
+  {
+    // cascade of three box filters with the same variance as the cubic
+    // pulse kernel (2 ir^2 / 15)
+    if (ir <= 0) return;
+
+    std::vector<int> widths = smoothing_box_widths(
+        std::sqrt(2.f / 15.f) * (float)ir,
+        3);
+
+    smoothing_separable(array,
+                        [&](Array &a)
+                        {
+                          for (int w : widths)
+                            smoothing_box_j(a, w / 2, w / 2, 1.f / (float)w);
+                        });
+    return;
+  }
+
   // define kernel
   const int          nk = 2 * ir + 1;
   std::vector<float> k(nk);
@@ -976,19 +1134,22 @@ void smooth_cpulse(Array &array, int ir)
   array = convolve1d_j(array, k);
 }
 
-void smooth_cpulse(Array &array, int ir, const Array *p_mask)
+void smooth_cpulse(Array          &array,
+                   int             ir,
+                   const Array    *p_mask,
+                   SmoothingMethod method)
 {
   if (!p_mask)
-    smooth_cpulse(array, ir);
+    smooth_cpulse(array, ir, method);
   else
   {
     Array array_f = array;
-    smooth_cpulse(array_f, ir);
+    smooth_cpulse(array_f, ir, method);
     array = lerp(array, array_f, *(p_mask));
   }
 }
 
-void smooth_flat(Array &array, int ir)
+void smooth_flat(Array &array, int ir, SmoothingMethod method)
 {
   // define kernel
   const int          nk = 2 * ir + 1;
@@ -996,13 +1157,30 @@ void smooth_flat(Array &array, int ir)
 
   std::fill(k.begin(), k.end(), 1.f / (2.f * nk + 1.f));
 
+  if (method == SMOOTHING_RECURSIVE)
+  {
+    // same kernel weights as the convolution
+    smoothing_separable(array,
+                        [&](Array &a) { smoothing_box_j(a, ir, ir, k[0]); });
+    return;
+  }
+
   // eventually convolve
   array = convolve1d_i(array, k);
   array = convolve1d_j(array, k);
 }
 
-void smooth_gaussian(Array &array, int ir)
+void smooth_gaussian(Array &array, int ir, SmoothingMethod method)
 {
+  if (method == SMOOTHING_RECURSIVE)
+  {
+    if (ir <= 0) return;
+
+    smoothing_separable(array,
+                        [&](Array &a) { smoothing_gaussian_j(a, (float)ir); });
+    return;
+  }
+
   // define Gaussian kernel (we keep NSIGMA standard deviations of the
   // kernel support)
   const int          nk = NSIGMA * (2 * ir + 1);
@@ -1029,14 +1207,17 @@ void smooth_gaussian(Array &array, int ir)
   array = convolve1d_j(array, k);
 }
 
-void smooth_gaussian(Array &array, int ir, const Array *p_mask)
+void smooth_gaussian(Array          &array,
+                     int             ir,
+                     const Array    *p_mask,
+                     SmoothingMethod method)
 {
   if (!p_mask)
-    smooth_gaussian(array, ir);
+    smooth_gaussian(array, ir, method);
   else
   {
     Array array_f = array;
-    smooth_gaussian(array_f, ir);
+    smooth_gaussian(array_f, ir, method);
     array = lerp(array, array_f, *(p_mask));
   }
 }
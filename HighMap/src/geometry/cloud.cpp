@@ -18,8 +18,11 @@
 #include "highmap/geometry/graph.hpp"
 #include "highmap/geometry/grids.hpp"
 #include "highmap/interpolate2d.hpp"
+#include "highmap/math.hpp"
 #include "highmap/operator.hpp"
 
+#include "highmap/internal/segment_distance.hpp"
+
 namespace hmap
 {
 
@@ -428,24 +431,15 @@ Array Cloud::to_array_sdf(Vec2<int>   shape,
     yp[k] = (yp[k] - bbox.c) / (bbox.d - bbox.c);
   }
 
-  // fill heightmap
-  auto distance_fct = [&xp, &yp](float x, float y, float)
-  {
-    float d = std::numeric_limits<float>::max();
-    for (size_t i = 0; i < xp.size(); i++)
-      d = std::min(d, std::hypot(x - xp[i], y - yp[i]));
-    return std::sqrt(d);
-  };
-
-  Array z = Array(shape);
-  fill_array_using_xy_function(z,
-                               bbox_array,
-                               nullptr,
-                               p_noise_x,
-                               p_noise_y,
-                               nullptr,
-                               distance_fct);
-  return z;
+  // nodes are handled as zero-length segments
+  if (xp.empty())
+    return Array(shape, std::sqrt(std::numeric_limits<float>::max()));
+
+  SegmentDistance sdf = SegmentDistance(xp, yp, xp, yp);
+  Array           z = sdf.to_array(shape, bbox_array, p_noise_x, p_noise_y);
+
+  // NB - square root of the distance
+  return sqrt(z);
 }
 
 void Cloud::to_csv(const std::string &fname) const
@@ -6,7 +6,6 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
-#include <list>
 
 #include "macrologger.h"
 
@@ -15,72 +14,157 @@
 #include "highmap/geometry/path.hpp"
 #include "highmap/operator.hpp"
 
+#include "highmap/internal/indexed_heap.hpp"
+#include "highmap/internal/segment_distance.hpp"
+
 namespace hmap
 {
 
-std::vector<int> Graph::dijkstra(int source_point_index, int target_point_index)
+// fingerprint of the graph topology (number of points and edge end points),
+// a single pass over the edges, cheap compared to the graph algorithms
+static size_t topology_hash(Graph &graph)
+{
+  size_t hash = graph.get_npoints();
+
+  for (auto &e : graph.edges)
+    for (int i : {e[0], e[1]})
+      hash ^= (size_t)i + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+  return hash;
+}
+
+// (re)build the CSR adjacency if the graph topology has changed, including
+// in-place modifications of the edges
+static void check_csr(Graph &graph)
+{
+  if (graph.csr_offsets.size() != graph.get_npoints() + 1 ||
+      graph.csr_neighbors.size() != 2 * graph.get_nedges() ||
+      graph.csr_topology_hash != topology_hash(graph))
+    graph.update_csr();
+}
+
+// multi-source Dijkstra's algorithm on the CSR adjacency, the search is
+// stopped once all the target points (if any) are settled. 'origin' is the
+// source point each point has been reached from
+static void shortest_path_tree(const Graph            &graph,
+                               const std::vector<int> &sources,
+                               const std::vector<int> &targets,
+                               std::vector<float>     &dist,
+                               std::vector<int>       &prev,
+                               std::vector<int>       &origin)
 {
-  std::vector<float> dist(this->get_npoints());
-  std::vector<int>   prev(this->get_npoints());
+  size_t npoints = graph.get_npoints();
+
+  dist.assign(npoints, std::numeric_limits<float>::max());
+  prev.assign(npoints, -1);
+  origin.assign(npoints, -1);
+
+  std::vector<bool> is_target(npoints, false);
+  size_t            ntargets = 0;
 
-  // --- Dijkstra's algo
-  std::list<int> queue = {};
+  for (int k : targets)
+    if (!is_target[k])
+    {
+      is_target[k] = true;
+      ntargets++;
+    }
 
-  for (size_t i = 0; i < this->get_npoints(); i++)
+  IndexedMinHeap<float> queue(npoints);
+
+  for (int k : sources)
   {
-    dist[i] = std::numeric_limits<float>::max();
-    prev[i] = -1;
-    queue.push_back((int)i);
+    dist[k] = 0.f;
+    origin[k] = k;
+    queue.push_or_decrease(k, 0.f);
   }
-  dist[source_point_index] = 0.f;
 
-  while (queue.size() > 0)
+  while (!queue.empty())
   {
-    // find closest point, within the queue
-    int   i = 0;
-    float dmax = std::numeric_limits<float>::max();
-    for (auto &k : queue)
-      if (dist[k] < dmax)
-      {
-        dmax = dist[k];
-        i = k;
-      }
-
-    if (i == target_point_index) break;
+    float d;
+    int   i = queue.pop(d);
 
-    queue.remove(i);
+    if (is_target[i] && --ntargets == 0) break;
 
     // loop over point i neighbors
-    for (int &k : this->connectivity[i])
+    for (int r = graph.csr_offsets[i]; r < graph.csr_offsets[i + 1]; r++)
     {
-      // check if the neighbor is in the queue
-      bool found = (std::find(queue.begin(), queue.end(), k) != queue.end());
+      int   k = graph.csr_neighbors[r];
+      float alt = d + graph.weights[graph.csr_edges[r]];
 
-      if (found)
+      if (alt < dist[k]) // alternative route is better
       {
-        float alt = dist[i] + this->adjacency_matrix[{i, k}];
-        if (alt < dist[k]) // alternative route is better
-        {
-          dist[k] = alt;
-          prev[k] = i;
-        }
+        dist[k] = alt;
+        prev[k] = i;
+        origin[k] = origin[i];
+        queue.push_or_decrease(k, alt);
       }
     }
   }
+}
+
+std::vector<int> Graph::dijkstra(int source_point_index, int target_point_index)
+{
+  return this->dijkstra(source_point_index,
+                        std::vector<int>{target_point_index})
+      .front();
+}
+
+std::vector<std::vector<int>> Graph::dijkstra(
+    int                     source_point_index,
+    const std::vector<int> &target_point_indices)
+{
+  check_csr(*this);
 
-  // --- backward rebuild the complete path
-  int              i = target_point_index;
-  std::vector<int> path = {i};
+  std::vector<float> dist;
+  std::vector<int>   prev, origin;
 
-  while (prev[i] > 0)
+  shortest_path_tree(*this,
+                     {source_point_index},
+                     target_point_indices,
+                     dist,
+                     prev,
+                     origin);
+
+  // --- backward rebuild the complete paths
+  std::vector<std::vector<int>> paths = {};
+
+  for (int target : target_point_indices)
   {
-    i = prev[i];
-    path.push_back(i);
+    std::vector<int> path = {};
+
+    if (target == source_point_index)
+      path.push_back(target);
+    else if (prev[target] >= 0)
+    {
+      for (int i = target; i >= 0; i = prev[i])
+        path.push_back(i);
+      std::reverse(path.begin(), path.end());
+    }
+    else
+      LOG_ERROR("point %d cannot be reached from point %d",
+                target,
+                source_point_index);
+
+    paths.push_back(path);
   }
-  path.push_back(source_point_index);
-  std::reverse(path.begin(), path.end());
 
-  return path;
+  return paths;
+}
+
+std::vector<float> Graph::dijkstra_distances(
+    const std::vector<int> &source_point_indices,
+    std::vector<int>       *p_nearest_source)
+{
+  check_csr(*this);
+
+  std::vector<float> dist;
+  std::vector<int>   prev, origin;
+
+  shortest_path_tree(*this, source_point_indices, {}, dist, prev, origin);
+
+  if (p_nearest_source) *p_nearest_source = origin;
+
+  return dist;
 }
 
 void Graph::add_edge(std::vector<int> edge, float weight)
@@ -143,50 +227,50 @@ size_t Graph::get_nedges()
 
 Graph Graph::minimum_spanning_tree_prim()
 {
-  std::vector<int>   parent(this->get_npoints());
-  std::vector<float> key(this->get_npoints());
-  std::vector<bool>  is_point_in_mst(this->get_npoints());
+  check_csr(*this);
 
-  for (size_t i = 0; i < this->get_npoints(); i++)
-  {
-    key[i] = std::numeric_limits<float>::max();
-    is_point_in_mst[i] = false;
-  }
+  size_t             npoints = this->get_npoints();
+  std::vector<int>   parent(npoints, -1);
+  std::vector<float> key(npoints, std::numeric_limits<float>::max());
+  std::vector<bool>  is_point_in_mst(npoints, false);
 
-  // starting point
-  key[0] = 0.f;
-  parent[0] = -1;
+  IndexedMinHeap<float> queue(npoints);
 
-  for (size_t i = 0; i < this->get_npoints() - 1; i++)
+  // one tree per connected component, starting with point 0
+  for (size_t s = 0; s < npoints; s++)
   {
-    // find point with smallest 'key' while not being in the MS tree
-    int   k = 0;
-    float key_max = std::numeric_limits<float>::max();
-    for (size_t p = 0; p < key.size(); p++)
-      if ((key[p] < key_max) and (is_point_in_mst[p] == false))
-      {
-        key_max = key[p];
-        k = (int)p;
-      }
+    if (is_point_in_mst[s]) continue;
 
-    is_point_in_mst[k] = true;
+    key[s] = 0.f;
+    queue.push_or_decrease((int)s, 0.f);
 
-    for (size_t p = 0; p < this->get_npoints(); p++)
+    while (!queue.empty())
     {
-      if ((this->adjacency_matrix[{k, p}] > 0.f) and
-          (is_point_in_mst[p] == false) and
-          (this->adjacency_matrix[{k, p}] < key[p]))
+      // point with smallest 'key' while not being in the MS tree
+      float kmin;
+      int   k = queue.pop(kmin);
+
+      is_point_in_mst[k] = true;
+
+      for (int r = this->csr_offsets[k]; r < this->csr_offsets[k + 1]; r++)
       {
-        parent[p] = k;
-        key[p] = this->adjacency_matrix[{k, p}];
+        int   p = this->csr_neighbors[r];
+        float w = this->weights[this->csr_edges[r]];
+
+        if (!is_point_in_mst[p] && w < key[p])
+        {
+          parent[p] = k;
+          key[p] = w;
+          queue.push_or_decrease(p, w);
+        }
       }
     }
   }
 
   // build output graph
   Graph graph = Graph(this->points);
-  for (size_t i = 1; i < this->get_npoints(); i++)
-    graph.add_edge({(int)i, parent[i]});
+  for (size_t i = 1; i < npoints; i++)
+    if (parent[i] >= 0) graph.add_edge({(int)i, parent[i]});
 
   return graph;
 }
@@ -223,11 +307,11 @@ Graph Graph::remove_orphan_points()
   // been added
   std::fill(new_point_idx.begin(), new_point_idx.end(), -1);
 
-  this->update_connectivity();
+  check_csr(*this);
 
   for (size_t k = 0; k < this->get_npoints(); k++)
   {
-    if (this->connectivity[k].size() > 0)
+    if (this->csr_offsets[k + 1] > this->csr_offsets[k])
     {
       // current point is connected to at least one other node =>
       // add it
@@ -237,9 +321,9 @@ Graph Graph::remove_orphan_points()
         new_point_idx[k] = (int)graph_out.get_npoints() - 1;
       }
 
-      for (size_t r = 0; r < this->connectivity[k].size(); r++)
+      for (int r = this->csr_offsets[k]; r < this->csr_offsets[k + 1]; r++)
       {
-        int j = this->connectivity[k][r];
+        int j = this->csr_neighbors[r];
         if ((j > (int)k) and (new_point_idx[j] == -1))
         {
           graph_out.add_point(this->points[j]);
@@ -318,42 +402,19 @@ Array Graph::to_array_sdf(Vec2<int>   shape,
                           Array      *p_noise_y,
                           Vec4<float> bbox_array)
 {
-  // nodes
-  std::vector<float> xp = this->get_edge_x_pairs();
-  std::vector<float> yp = this->get_edge_y_pairs();
+  // edges, with nodes coordinates normalized with respect to the bounding box
+  std::vector<float> xa, ya, xb, yb;
 
-  for (size_t k = 0; k < xp.size(); k++)
+  for (auto &e : this->edges)
   {
-    xp[k] = (xp[k] - bbox.a) / (bbox.b - bbox.a);
-    yp[k] = (yp[k] - bbox.c) / (bbox.d - bbox.c);
+    xa.push_back((this->points[e[0]].x - bbox.a) / (bbox.b - bbox.a));
+    ya.push_back((this->points[e[0]].y - bbox.c) / (bbox.d - bbox.c));
+    xb.push_back((this->points[e[1]].x - bbox.a) / (bbox.b - bbox.a));
+    yb.push_back((this->points[e[1]].y - bbox.c) / (bbox.d - bbox.c));
   }
 
-  // fill heightmap
-  auto distance_fct = [&xp, &yp](float x, float y, float)
-  {
-    float d = std::numeric_limits<float>::max();
-
-    for (size_t i = 0; i < xp.size() - 1; i += 2)
-    {
-      size_t      j = i + 1;
-      Vec2<float> e = {xp[j] - xp[i], yp[j] - yp[i]};
-      Vec2<float> w = {x - xp[i], y - yp[i]};
-      float       coeff = std::clamp(dot(w, e) / dot(e, e), 0.f, 1.f);
-      Vec2<float> b = {w.x - e.x * coeff, w.y - e.y * coeff};
-      d = std::min(d, dot(b, b));
-    }
-    return std::sqrt(d);
-  };
-
-  Array z = Array(shape);
-  fill_array_using_xy_function(z,
-                               bbox_array,
-                               nullptr,
-                               p_noise_x,
-                               p_noise_y,
-                               nullptr,
-                               distance_fct);
-  return z;
+  SegmentDistance sdf = SegmentDistance(xa, ya, xb, yb);
+  return sdf.to_array(shape, bbox_array, p_noise_x, p_noise_y);
 }
 
 void Graph::to_csv(std::string fname_xy, std::string fname_adjacency)
@@ -417,4 +478,39 @@ void Graph::update_connectivity()
   this->connectivity = nbrs;
 }
 
+void Graph::update_csr()
+{
+  size_t npoints = this->get_npoints();
+  size_t nedges = this->get_nedges();
+
+  // count neighbors and then fill (counting sort, preserves the edge order)
+  this->csr_offsets.assign(npoints + 1, 0);
+
+  for (auto &e : this->edges)
+  {
+    this->csr_offsets[e[0] + 1]++;
+    this->csr_offsets[e[1] + 1]++;
+  }
+
+  for (size_t i = 0; i < npoints; i++)
+    this->csr_offsets[i + 1] += this->csr_offsets[i];
+
+  this->csr_neighbors.resize(2 * nedges);
+  this->csr_edges.resize(2 * nedges);
+
+  std::vector<int> pos(this->csr_offsets.begin(), this->csr_offsets.end() - 1);
+
+  for (size_t k = 0; k < nedges; k++)
+  {
+    int i = this->edges[k][0];
+    int j = this->edges[k][1];
+
+    this->csr_neighbors[pos[i]] = j;
+    this->csr_edges[pos[i]++] = (int)k;
+    this->csr_neighbors[pos[j]] = i;
+    this->csr_edges[pos[j]++] = (int)k;
+  }
+  this->csr_topology_hash = topology_hash(*this);
+}
+
 } // namespace hmap
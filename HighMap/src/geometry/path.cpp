@@ -12,6 +12,7 @@
 #include "highmap/features.hpp"
 #include "highmap/filters.hpp"
 #include "highmap/geometry/path.hpp"
+#include "highmap/internal/segment_distance.hpp"
 #include "highmap/internal/vector_utils.hpp"
 #include "highmap/interpolate_curve.hpp"
 #include "highmap/morphology.hpp"
@@ -220,6 +221,15 @@ void Path::dijkstra(Array      &array,
                     float       upward_penalization,
                     Array      *p_mask_nogo)
 {
+  // the move costs are computed once for all the edges (each edge has its own
+  // starting point, the searches are not cached)
+  CostField cost_field(array,
+                       elevation_ratio,
+                       distance_exponent,
+                       upward_penalization,
+                       p_mask_nogo,
+                       0);
+
   size_t ks = this->closed ? 0 : 1; // trick to handle closed contours
   for (size_t k = 0; k < this->get_npoints() - ks; k++)
   {
@@ -237,16 +247,9 @@ void Path::dijkstra(Array      &array,
         (int)((this->points[knext].y - bbox.c) / (bbox.d - bbox.c) *
               (array.shape.y - 1)));
 
+    // edge left unchanged if the end point cannot be reached
     std::vector<int> ip, jp;
-    find_path_dijkstra(array,
-                       ij_start,
-                       ij_end,
-                       ip,
-                       jp,
-                       elevation_ratio,
-                       distance_exponent,
-                       upward_penalization,
-                       p_mask_nogo);
+    if (!cost_field.find_path(ij_start, ij_end, ip, jp)) continue;
 
     // backup cuurrent edge informations before adding points to this edge
     Point p1 = this->points[k];
@@ -861,35 +864,29 @@ Array Path::to_array_sdf(Vec2<int>   shape,
                          Array      *p_noise_y,
                          Vec4<float> bbox_array)
 {
-  // Path nodes
-  std::vector<float> xp = this->get_x();
-  std::vector<float> yp = this->get_y();
-
-  for (size_t k = 0; k < xp.size(); k++)
-  {
-    xp[k] = (xp[k] - bbox.a) / (bbox.b - bbox.a);
-    yp[k] = (yp[k] - bbox.c) / (bbox.d - bbox.c);
-  }
-
-  // fill heightmap
-  std::function<float(float, float, float)> distance_fct;
+  // segments, same ordering as 'sdf_open' and 'sdf_closed'
+  size_t             npoints = this->get_npoints();
+  std::vector<float> xa, ya, xb, yb;
 
   if (this->closed)
-    distance_fct = [this](float x, float y, float)
-    { return this->sdf_closed(x, y); };
+    for (size_t i = 0, j = npoints - 1; i < npoints; j = i, i++)
+    {
+      xa.push_back(this->points[i].x);
+      ya.push_back(this->points[i].y);
+      xb.push_back(this->points[j].x);
+      yb.push_back(this->points[j].y);
+    }
   else
-    distance_fct = [this](float x, float y, float)
-    { return this->sdf_open(x, y); };
-
-  Array z = Array(shape);
-  fill_array_using_xy_function(z,
-                               bbox_array,
-                               nullptr,
-                               p_noise_x,
-                               p_noise_y,
-                               nullptr,
-                               distance_fct);
-  return z;
+    for (size_t i = 0; i + 1 < npoints; i++)
+    {
+      xa.push_back(this->points[i].x);
+      ya.push_back(this->points[i].y);
+      xb.push_back(this->points[i + 1].x);
+      yb.push_back(this->points[i + 1].y);
+    }
+
+  SegmentDistance sdf = SegmentDistance(xa, ya, xb, yb);
+  return sdf.to_array(shape, bbox_array, p_noise_x, p_noise_y, this->closed);
 }
 
 void Path::to_png(std::string fname, Vec2<int> shape)
@@ -0,0 +1,388 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+
+#include "highmap/algebra.hpp"
+#include "highmap/geometry/grids.hpp"
+#include "highmap/morphology.hpp"
+#include "highmap/thread_pool.hpp"
+
+#include "highmap/internal/segment_distance.hpp"
+
+namespace hmap
+{
+
+// bucket index of a coordinate (the same mapping is used to store and to
+// query the buckets)
+static int bucket_index(float v, float origin, float size, int n)
+{
+  float f = std::floor((v - origin) / size);
+  return (int)std::clamp(f, 0.f, (float)(n - 1));
+}
+
+SegmentDistance::SegmentDistance(const std::vector<float> &xa,
+                                 const std::vector<float> &ya,
+                                 const std::vector<float> &xb,
+                                 const std::vector<float> &yb)
+    : xa(xa), ya(ya), xb(xb), yb(yb)
+{
+  const int nseg = (int)xa.size();
+
+  if (nseg == 0) return;
+
+  // --- bucket grid covering the segments, about one segment per bucket
+
+  this->bbox = {std::min(*std::min_element(xa.begin(), xa.end()),
+                         *std::min_element(xb.begin(), xb.end())),
+                std::max(*std::max_element(xa.begin(), xa.end()),
+                         *std::max_element(xb.begin(), xb.end())),
+                std::min(*std::min_element(ya.begin(), ya.end()),
+                         *std::min_element(yb.begin(), yb.end())),
+                std::max(*std::max_element(ya.begin(), ya.end()),
+                         *std::max_element(yb.begin(), yb.end()))};
+
+  float scale = std::max({std::abs(this->bbox.a),
+                          std::abs(this->bbox.b),
+                          std::abs(this->bbox.c),
+                          std::abs(this->bbox.d),
+                          1.f});
+  float lx = std::max(this->bbox.b - this->bbox.a, 1e-6f * scale);
+  float ly = std::max(this->bbox.d - this->bbox.c, 1e-6f * scale);
+
+  float ratio = std::clamp(lx / ly, 1e-3f, 1e3f);
+  int   nx = std::clamp((int)std::sqrt((float)nseg * ratio), 1, 4096);
+  int   ny = std::clamp(nseg / nx, 1, 4096);
+
+  this->nbuckets = {nx, ny};
+  this->bucket_size = {lx / (float)nx, ly / (float)ny};
+
+  // --- store the segments in the buckets overlapped by their bounding box,
+  // --- and in the horizontal bands they span (CSR format, two passes: count
+  // --- and fill)
+
+  this->bucket_offsets.assign(nx * ny + 1, 0);
+  this->band_offsets.assign(ny + 1, 0);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    std::vector<int> bucket_fill, band_fill;
+
+    if (pass == 1)
+    {
+      for (int b = 0; b < nx * ny; b++)
+        this->bucket_offsets[b + 1] += this->bucket_offsets[b];
+      for (int q = 0; q < ny; q++)
+        this->band_offsets[q + 1] += this->band_offsets[q];
+
+      this->bucket_segments.resize(this->bucket_offsets.back());
+      this->band_segments.resize(this->band_offsets.back());
+
+      bucket_fill.assign(this->bucket_offsets.begin(),
+                         this->bucket_offsets.end() - 1);
+      band_fill.assign(this->band_offsets.begin(),
+                       this->band_offsets.end() - 1);
+    }
+
+    for (int k = 0; k < nseg; k++)
+    {
+      int p0 = bucket_index(std::min(xa[k], xb[k]),
+                            this->bbox.a,
+                            this->bucket_size.x,
+                            nx);
+      int p1 = bucket_index(std::max(xa[k], xb[k]),
+                            this->bbox.a,
+                            this->bucket_size.x,
+                            nx);
+      int q0 = bucket_index(std::min(ya[k], yb[k]),
+                            this->bbox.c,
+                            this->bucket_size.y,
+                            ny);
+      int q1 = bucket_index(std::max(ya[k], yb[k]),
+                            this->bbox.c,
+                            this->bucket_size.y,
+                            ny);
+
+      for (int q = q0; q <= q1; q++)
+      {
+        if (pass == 0)
+          this->band_offsets[q + 1]++;
+        else
+          this->band_segments[band_fill[q]++] = k;
+
+        for (int p = p0; p <= p1; p++)
+        {
+          if (pass == 0)
+            this->bucket_offsets[q * nx + p + 1]++;
+          else
+            this->bucket_segments[bucket_fill[q * nx + p]++] = k;
+        }
+      }
+    }
+  }
+}
+
+float SegmentDistance::distance_squared(float x,
+                                        float y,
+                                        float dmin,
+                                        float radius) const
+{
+  float best = std::numeric_limits<float>::max();
+
+  if (this->xa.empty()) return best;
+
+  // buckets are visited by increasing search radius, until the nearest
+  // segment found is within the visited disk
+  float r_in = -1.f;
+  float r_out = std::max({radius, this->bucket_size.x, this->bucket_size.y});
+
+  while (true)
+  {
+    this->visit_buckets(x, y, r_in, r_out, dmin, best);
+
+    // (with a margin for the round-off errors)
+    if (best <= 0.9999f * r_out * r_out) break;
+
+    r_in = r_out;
+    r_out *= 2.f;
+  }
+
+  return best;
+}
+
+bool SegmentDistance::grid_distance_bounds(const std::vector<float> &xg,
+                                           const std::vector<float> &yg,
+                                           Array                    &dlow,
+                                           Array                    &dup) const
+{
+  const int nx = (int)xg.size();
+  const int ny = (int)yg.size();
+
+  if (this->xa.empty() || nx < 2 || ny < 2) return false;
+
+  const float dx = (xg.back() - xg.front()) / (float)(nx - 1);
+  const float dy = (yg.back() - yg.front()) / (float)(ny - 1);
+
+  if (!(dx > 0.f && dy > 0.f)) return false;
+
+  auto ci = [&xg, dx](float x) { return (x - xg.front()) / dx; };
+  auto cj = [&yg, dy](float y) { return (y - yg.front()) / dy; };
+
+  // the segments are rasterized on a padded grid, if they do not lie too far
+  // away from the grid
+  float pad_f = std::max({0.f,
+                          -ci(this->bbox.a),
+                          ci(this->bbox.b) - (float)(nx - 1),
+                          -cj(this->bbox.c),
+                          cj(this->bbox.d) - (float)(ny - 1)});
+
+  if (pad_f > 0.5f * (float)std::max(nx, ny)) return false;
+
+  const int pad = (int)std::ceil(pad_f) + 1;
+  Array     seeds = Array(Vec2<int>(nx + 2 * pad, ny + 2 * pad));
+
+  // rasterization: segments are sampled with a step smaller than half a cell
+  // and each sample marks its nearest grid node
+  for (size_t k = 0; k < this->xa.size(); k++)
+  {
+    float i0 = ci(this->xa[k]);
+    float j0 = cj(this->ya[k]);
+    float li = ci(this->xb[k]) - i0;
+    float lj = cj(this->yb[k]) - j0;
+    int   ns = (int)std::ceil(2.f * std::hypot(li, lj)) + 1;
+
+    for (int s = 0; s < ns; s++)
+    {
+      float t = ns > 1 ? (float)s / (float)(ns - 1) : 0.f;
+      int   i = (int)std::lround(i0 + t * li) + pad;
+      int   j = (int)std::lround(j0 + t * lj) + pad;
+      seeds(i, j) = 1.f;
+    }
+  }
+
+  Array dt = distance_transform(seeds);
+
+  // the nearest segment is at most half a cell diagonal away from the nearest
+  // marked node, and the nearest marked node is at most half a cell diagonal
+  // and half a sampling step away from the nearest segment
+  const float smin = std::min(dx, dy);
+  const float smax = std::max(dx, dy);
+  const float hdiag = 0.5f * std::hypot(dx, dy);
+  const float margin = 1e-3f * smin;
+
+  dlow = Array(Vec2<int>(nx, ny));
+  dup = Array(Vec2<int>(nx, ny));
+
+  for (int j = 0; j < ny; j++)
+    for (int i = 0; i < nx; i++)
+    {
+      float d = dt(i + pad, j + pad);
+      dlow(i, j) = std::max(0.f,
+                            0.999f * (d * smin - hdiag - 0.25f * smax) -
+                                margin);
+      dup(i, j) = 1.001f * (d * smax + hdiag) + margin;
+    }
+
+  return true;
+}
+
+bool SegmentDistance::is_inside(float x, float y) const
+{
+  if (this->band_offsets.empty()) return false;
+
+  // only the segments spanning the query ordinate can be crossed
+  if (!(y >= this->bbox.c && y <= this->bbox.d)) return false;
+
+  int  q = bucket_index(y, this->bbox.c, this->bucket_size.y, this->nbuckets.y);
+  bool inside = false;
+
+  for (int r = this->band_offsets[q]; r < this->band_offsets[q + 1]; r++)
+  {
+    int         k = this->band_segments[r];
+    Vec2<float> e = {this->xb[k] - this->xa[k], this->yb[k] - this->ya[k]};
+    Vec2<float> w = {x - this->xa[k], y - this->ya[k]};
+
+    bool cx = y >= this->ya[k];
+    bool cy = y < this->yb[k];
+    bool cz = e.x * w.y > e.y * w.x;
+
+    if ((cx && cy && cz) || (!cx && !cy && !cz)) inside = !inside;
+  }
+
+  return inside;
+}
+
+float SegmentDistance::segment_distance_squared(int k, float x, float y) const
+{
+  Vec2<float> e = {this->xb[k] - this->xa[k], this->yb[k] - this->ya[k]};
+  Vec2<float> w = {x - this->xa[k], y - this->ya[k]};
+
+  // degenerated segment
+  if (dot(e, e) == 0.f) return dot(w, w);
+
+  float       coeff = std::clamp(dot(w, e) / dot(e, e), 0.f, 1.f);
+  Vec2<float> b = {w.x - e.x * coeff, w.y - e.y * coeff};
+  return dot(b, b);
+}
+
+Array SegmentDistance::to_array(Vec2<int>    shape,
+                                Vec4<float>  bbox,
+                                const Array *p_noise_x,
+                                const Array *p_noise_y,
+                                bool         is_signed) const
+{
+  Array              z = Array(shape);
+  std::vector<float> xg, yg;
+  grid_xy_vector(xg, yg, shape, bbox, false); // no endpoint
+
+  // without any domain warping, the search is restricted using distance
+  // bounds obtained from the rasterized segments
+  Array dlow, dup;
+  bool  use_bounds = !p_noise_x && !p_noise_y &&
+                    this->grid_distance_bounds(xg, yg, dlow, dup);
+
+  auto lambda_row = [&](size_t j)
+  {
+    for (int i = 0; i < shape.x; i++)
+    {
+      float x = p_noise_x ? xg[i] + (*p_noise_x)(i, j) : xg[i];
+      float y = p_noise_y ? yg[j] + (*p_noise_y)(i, j) : yg[j];
+
+      float d2 = use_bounds
+                     ? this->distance_squared(x, y, dlow(i, j), dup(i, j))
+                     : this->distance_squared(x, y);
+
+      z(i, j) = std::sqrt(d2);
+      if (is_signed && this->is_inside(x, y)) z(i, j) = -z(i, j);
+    }
+  };
+
+  parallel_for(shape.y, lambda_row);
+
+  return z;
+}
+
+void SegmentDistance::visit_buckets(float  x,
+                                    float  y,
+                                    float  r_in,
+                                    float  r_out,
+                                    float  dmin,
+                                    float &best) const
+{
+  const Vec2<int>   nb = this->nbuckets;
+  const Vec2<float> bs = this->bucket_size;
+
+  // buckets are slightly enlarged to account for the round-off errors of the
+  // bucket indexing
+  const float eps = 1e-4f * std::max(bs.x, bs.y);
+  const float r_out2 = r_out * r_out;
+  const float r_in2 = r_in < 0.f ? -1.f : r_in * r_in;
+  const float dmin2 = dmin * dmin;
+
+  // range of buckets within the search radius (computed in float to avoid
+  // any integer overflow for very large radii)
+  auto index_range = [](float v0, float v1, float origin, float size, int n)
+  {
+    float f0 = std::clamp(std::floor((v0 - origin) / size), 0.f, (float)n);
+    float f1 = std::clamp(std::floor((v1 - origin) / size), -1.f, (float)n - 1);
+    return Vec2<int>((int)f0, (int)f1);
+  };
+
+  // distance (and farthest distance) between a coordinate and an interval
+  auto interval_distance = [](float v, float v0, float v1, float &dfar)
+  {
+    dfar = std::max(std::abs(v - v0), std::abs(v - v1));
+    return v < v0 ? v0 - v : (v > v1 ? v - v1 : 0.f);
+  };
+
+  Vec2<int> rq = index_range(y - r_out - eps,
+                             y + r_out + eps,
+                             this->bbox.c,
+                             bs.y,
+                             nb.y);
+
+  for (int q = rq.x; q <= rq.y; q++)
+  {
+    float y0 = this->bbox.c + (float)q * bs.y - eps;
+    float y1 = this->bbox.c + (float)(q + 1) * bs.y + eps;
+    float dy_far;
+    float dy = interval_distance(y, y0, y1, dy_far);
+
+    if (dy > r_out) continue;
+
+    float     rx = std::sqrt(std::max(0.f, r_out2 - dy * dy));
+    Vec2<int> rp = index_range(x - rx - eps,
+                               x + rx + eps,
+                               this->bbox.a,
+                               bs.x,
+                               nb.x);
+
+    for (int p = rp.x; p <= rp.y; p++)
+    {
+      float x0 = this->bbox.a + (float)p * bs.x - eps;
+      float x1 = this->bbox.a + (float)(p + 1) * bs.x + eps;
+      float dx_far;
+      float dx = interval_distance(x, x0, x1, dx_far);
+
+      float d2_near = dx * dx + dy * dy;
+      float d2_far = dx_far * dx_far + dy_far * dy_far;
+
+      // outside the search annulus, closer than the distance lower bound
+      // (hence empty) or too far to improve the current distance
+      if (d2_near > r_out2 || d2_near <= r_in2) continue;
+      if (d2_far < dmin2) continue;
+      if (0.9999f * d2_near > best) continue;
+
+      int b = q * nb.x + p;
+      for (int r = this->bucket_offsets[b]; r < this->bucket_offsets[b + 1];
+           r++)
+        best = std::min(best,
+                        this->segment_distance_squared(this->bucket_segments[r],
+                                                       x,
+                                                       y));
+    }
+  }
+}
+
+} // namespace hmap
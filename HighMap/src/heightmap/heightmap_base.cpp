@@ -1,16 +1,18 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
-#include <future>
+#include <algorithm>
 #include <iostream>
-#include <thread>
 
 #include "macrologger.h"
 
+#include "highmap/dbg/profiler.hpp"
 #include "highmap/heightmap.hpp"
 #include "highmap/interpolate2d.hpp"
 #include "highmap/operator.hpp"
 #include "highmap/range.hpp"
+#include "highmap/thread_pool.hpp"
+#include "highmap/tile_cache.hpp"
 
 #include "highmap/internal/vector_utils.hpp"
 
@@ -59,11 +61,98 @@ Heightmap::Heightmap() : shape(0, 0)
   this->update_tile_parameters();
 }
 
+Heightmap::Heightmap(const Heightmap &other)
+    : shape(other.shape), tiling(other.tiling), overlap(other.overlap)
+{
+  if (!other.tile_cache)
+  {
+    this->tiles = other.tiles;
+    return;
+  }
+
+  // out-of-core, tiles are copied one at a time and handed over to the cache
+  this->tile_cache = other.tile_cache;
+  this->tiles.resize(other.get_ntiles());
+  this->tile_ids.resize(other.get_ntiles());
+
+  for (size_t k = 0; k < other.get_ntiles(); k++)
+  {
+    other.pin_tile(k);
+    this->tiles[k] = other.tiles[k];
+    other.unpin_tile(k, false);
+
+    this->tile_ids[k] = this->tile_cache->add(&this->tiles[k].vector,
+                                              this->tiles[k].size());
+  }
+}
+
+Heightmap::Heightmap(Heightmap &&other) noexcept
+    : shape(other.shape), tiling(other.tiling), overlap(other.overlap),
+      tiles(std::move(other.tiles)), tile_cache(std::move(other.tile_cache)),
+      tile_ids(std::move(other.tile_ids))
+{
+  // NB - the tile storages (registered to the cache) are not moved in memory
+  other.tiles.clear();
+  other.tile_ids.clear();
+}
+
+Heightmap::~Heightmap()
+{
+  this->release_tiles();
+}
+
+Heightmap &Heightmap::operator=(const Heightmap &other)
+{
+  if (this != &other) *this = Heightmap(other);
+  return *this;
+}
+
+Heightmap &Heightmap::operator=(Heightmap &&other) noexcept
+{
+  if (this != &other)
+  {
+    this->release_tiles();
+
+    this->shape = other.shape;
+    this->tiling = other.tiling;
+    this->overlap = other.overlap;
+    this->tiles = std::move(other.tiles);
+    this->tile_cache = std::move(other.tile_cache);
+    this->tile_ids = std::move(other.tile_ids);
+
+    other.tiles.clear();
+    other.tile_ids.clear();
+  }
+  return *this;
+}
+
 size_t Heightmap::get_ntiles() const
 {
   return this->tiles.size();
 }
 
+std::shared_ptr<TileCache> Heightmap::get_tile_cache() const
+{
+  return this->tile_cache;
+}
+
+Vec4<int> Heightmap::get_tile_core_extent(size_t k) const
+{
+  int it = (int)k % this->tiling.x;
+  int jt = (int)k / this->tiling.x;
+
+  int delta_buffer_i = (int)(this->overlap * this->shape.x / this->tiling.x);
+  int delta_buffer_j = (int)(this->overlap * this->shape.y / this->tiling.y);
+
+  int i1 = it > 0 ? delta_buffer_i : 0;
+  int j1 = jt > 0 ? delta_buffer_j : 0;
+
+  return Vec4<int>(i1,
+                   i1 + this->shape.x / this->tiling.x,
+                   j1,
+                   j1 + this->shape.y / this->tiling.y);
+}
+
 int Heightmap::get_tile_index(int i, int j) const
 {
   return i + j * this->tiling.x;
@@ -101,48 +190,84 @@ void Heightmap::set_tiling(Vec2<int> new_tiling)
   this->update_tile_parameters();
 }
 
-void Heightmap::from_array_interp(Array &array)
+void Heightmap::disable_out_of_core()
 {
-  this->from_array_interp_bilinear(array);
+  if (!this->tile_cache) return;
+
+  // tiles are loaded and left in memory once unregistered
+  for (size_t k = 0; k < this->get_ntiles(); k++)
+  {
+    this->tile_cache->pin(this->tile_ids[k]);
+    this->tile_cache->remove(this->tile_ids[k]);
+  }
+
+  this->tile_cache = nullptr;
+  this->tile_ids.clear();
 }
 
-void Heightmap::from_array_interp_bicubic(Array &array)
+void Heightmap::enable_out_of_core(size_t             memory_budget,
+                                   const std::string &scratch_fname)
+{
+  this->enable_out_of_core(
+      std::make_shared<TileCache>(memory_budget, scratch_fname));
+}
+
+void Heightmap::enable_out_of_core(std::shared_ptr<TileCache> new_tile_cache)
 {
-  std::vector<std::future<void>> futures(this->get_ntiles());
+  if (!new_tile_cache || new_tile_cache == this->tile_cache) return;
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::from_array_interp_bicubic,
-                            std::ref(tiles[i]),
-                            std::ref(array));
+  // tiles are handed over one at a time from the current cache (if any) to
+  // the new one, which may evict them right away
+  this->tile_ids.resize(this->get_ntiles(), -1);
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i].get();
+  for (size_t k = 0; k < this->get_ntiles(); k++)
+  {
+    if (this->tile_cache)
+    {
+      this->tile_cache->pin(this->tile_ids[k]);
+      this->tile_cache->remove(this->tile_ids[k]);
+    }
+
+    this->tile_ids[k] = new_tile_cache->add(&this->tiles[k].vector,
+                                            this->tiles[k].size());
+  }
+
+  this->tile_cache = new_tile_cache;
 }
 
-void Heightmap::from_array_interp_bilinear(Array &array)
+void Heightmap::from_array_interp(Array &array)
 {
-  std::vector<std::future<void>> futures(this->get_ntiles());
+  this->from_array_interp_bilinear(array);
+}
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::from_array_interp,
-                            std::ref(tiles[i]),
-                            std::ref(array));
+void Heightmap::from_array_interp_bicubic(Array &array)
+{
+  parallel_for(this->get_ntiles(),
+               [this, &array](size_t i)
+               {
+                 TilePin pin({this}, i);
+                 tiles[i].from_array_interp_bicubic(array);
+               });
+}
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i].get();
+void Heightmap::from_array_interp_bilinear(Array &array)
+{
+  parallel_for(this->get_ntiles(),
+               [this, &array](size_t i)
+               {
+                 TilePin pin({this}, i);
+                 tiles[i].from_array_interp(array);
+               });
 }
 
 void Heightmap::from_array_interp_nearest(Array &array)
 {
-  std::vector<std::future<void>> futures(this->get_ntiles());
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::from_array_interp_nearest,
-                            std::ref(tiles[i]),
-                            std::ref(array));
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i].get();
+  parallel_for(this->get_ntiles(),
+               [this, &array](size_t i)
+               {
+                 TilePin pin({this}, i);
+                 tiles[i].from_array_interp_nearest(array);
+               });
 }
 
 float Heightmap::get_value_bilinear(float x, float y) const
@@ -173,6 +298,8 @@ float Heightmap::get_value_bilinear(float x, float y) const
   int i1 = (i == this->tiles[k].shape.x - 1) ? i - 1 : i + 1;
   int j1 = (j == this->tiles[k].shape.y - 1) ? j - 1 : j + 1;
 
+  TilePin pin({this}, k, false, 0);
+
   float value = bilinear_interp(this->tiles[k](i, j),
                                 this->tiles[k](i1, j),
                                 this->tiles[k](i, j1),
@@ -202,24 +329,33 @@ float Heightmap::get_value_nearest(float x, float y) const
   int i = static_cast<int>(xt / lxt * this->tiles[k].shape.x);
   int j = static_cast<int>(yt / lyt * this->tiles[k].shape.y);
 
+  TilePin pin({this}, k, false, 0);
+
   return this->tiles[k](i, j);
 }
 
 void Heightmap::infos()
 {
+  Vec2<float> vminmax = this->minmax();
+
   std::cout << "Heightmap, ";
   std::cout << "address: " << this << ", ";
   std::cout << "shape: {" << this->shape.x << ", " << this->shape.y << "}, ";
   std::cout << "tiling: {" << this->tiling.x << ", " << this->tiling.y << "}, ";
   std::cout << "overlap: " << this->overlap << ", ";
-  std::cout << "min: " << this->min() << ", ";
-  std::cout << "max: " << this->max();
+  std::cout << "min: " << vminmax.x << ", ";
+  std::cout << "max: " << vminmax.y;
   std::cout << std::endl;
 
   for (auto &t : this->tiles)
     t.infos();
 }
 
+bool Heightmap::is_out_of_core() const
+{
+  return this->tile_cache != nullptr;
+}
+
 void Heightmap::inverse()
 {
   float hmax = this->max();
@@ -237,20 +373,6 @@ void Heightmap::inverse()
       TransformMode::DISTRIBUTED);
 }
 
-float Heightmap::max()
-{
-  std::vector<float>              max_tiles(this->get_ntiles());
-  std::vector<std::future<float>> futures(this->get_ntiles());
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::max, tiles[i]);
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    max_tiles[i] = futures[i].get();
-
-  return *std::max_element(max_tiles.begin(), max_tiles.end());
-}
-
 void Heightmap::smooth_overlap_buffers()
 {
   int delta_buffer_i = (int)(this->overlap * this->shape.x / this->tiling.x);
@@ -263,6 +385,9 @@ void Heightmap::smooth_overlap_buffers()
       int k = this->get_tile_index(it, jt);
       int kn = this->get_tile_index(it + 1, jt);
 
+      TilePin pin({this}, k, true, this->tiling.x);
+      TilePin pin_n({this}, kn, true, this->tiling.x);
+
       for (int p = 0; p < delta_buffer_i; p++)
         for (int q = 0; q < tiles[k].shape.y; q++)
         {
@@ -281,6 +406,9 @@ void Heightmap::smooth_overlap_buffers()
       int k = this->get_tile_index(it, jt);
       int kn = this->get_tile_index(it, jt + 1);
 
+      TilePin pin({this}, k, true, this->tiling.x);
+      TilePin pin_n({this}, kn, true, this->tiling.x);
+
       for (int p = 0; p < tiles[k].shape.x; p++)
         for (int q = 0; q < delta_buffer_j; q++)
         {
@@ -293,30 +421,30 @@ void Heightmap::smooth_overlap_buffers()
     }
 }
 
-float Heightmap::min()
+void Heightmap::pin_tile(size_t k) const
 {
-  std::vector<float>              min_tiles(this->get_ntiles());
-  std::vector<std::future<float>> futures(this->get_ntiles());
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::min, tiles[i]);
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    min_tiles[i] = futures[i].get();
+  if (this->tile_cache) this->tile_cache->pin(this->tile_ids[k]);
+}
 
-  return *std::min_element(min_tiles.begin(), min_tiles.end());
+void Heightmap::prefetch_tile(size_t k) const
+{
+  if (this->tile_cache) this->tile_cache->prefetch(this->tile_ids[k]);
 }
 
-float Heightmap::mean()
+void Heightmap::release_tiles()
 {
-  float mean = this->sum() / (float)(this->shape.x * this->shape.y);
-  return mean;
+  if (this->tile_cache)
+    for (int id : this->tile_ids)
+      this->tile_cache->remove(id);
+
+  this->tile_ids.clear();
 }
 
 void Heightmap::remap(float vmin, float vmax)
 {
-  float hmin = this->min();
-  float hmax = this->max();
+  Vec2<float> hminmax = this->minmax();
+  float       hmin = hminmax.x;
+  float       hmax = hminmax.y;
 
   transform(
       {this},
@@ -326,6 +454,10 @@ void Heightmap::remap(float vmin, float vmax)
       {
         hmap::Array *pa_out = p_arrays[0];
         hmap::remap(*pa_out, vmin, vmax, hmin, hmax);
+
+        // the bounds only account for the tile cores, the overlap buffers
+        // are clamped to the target range
+        hmap::clamp(*pa_out, std::min(vmin, vmax), std::max(vmin, vmax));
       },
       TransformMode::DISTRIBUTED);
 }
@@ -344,26 +476,10 @@ void Heightmap::remap(float vmin, float vmax, float from_min, float from_max)
       TransformMode::DISTRIBUTED);
 }
 
-float Heightmap::sum()
-{
-  std::vector<float>              sum_tiles(this->get_ntiles());
-  std::vector<std::future<float>> futures(this->get_ntiles());
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::sum, tiles[i]);
-
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    sum_tiles[i] = futures[i].get();
-
-  float sum = 0.f;
-  for (auto &v : sum_tiles)
-    sum += v;
-
-  return sum;
-}
-
 Array Heightmap::to_array()
 {
+  HMAP_PROFILE_ZONE("Heightmap::to_array");
+
   Array array = Array(this->shape);
 
   for (int it = 0; it < tiling.x; it++)
@@ -375,6 +491,8 @@ Array Heightmap::to_array()
       int i1 = (int)(tiles[k].shift.x * this->shape.x);
       int j1 = (int)(tiles[k].shift.y * this->shape.y);
 
+      TilePin pin({this}, k, false, this->tiling.x);
+
       for (int q = 0; q < tiles[k].shape.y; ++q)
         for (int p = 0; p < tiles[k].shape.x; ++p)
           array(p + i1, q + j1) = tiles[k](p, q);
@@ -385,6 +503,8 @@ Array Heightmap::to_array()
 
 Array Heightmap::to_array(Vec2<int> shape_export)
 {
+  HMAP_PROFILE_ZONE("Heightmap::to_array");
+
   Array array = Array(shape_export);
 
   // interpolation grid points
@@ -407,9 +527,10 @@ std::vector<uint8_t> Heightmap::to_grayscale_image_8bit()
 {
   std::vector<uint8_t> img(this->shape.x * this->shape.y);
 
-  float vmin = this->min();
-  float vmax = this->max();
-  float inv_vptp = vmin != vmax ? 1.f / (this->max() - vmin) : 0.f;
+  Vec2<float> vminmax = this->minmax();
+  float       vmin = vminmax.x;
+  float       vmax = vminmax.y;
+  float       inv_vptp = vmin != vmax ? 1.f / (vmax - vmin) : 0.f;
 
   for (int it = 0; it < tiling.x; it++)
     for (int jt = 0; jt < tiling.y; jt++)
@@ -421,8 +542,14 @@ std::vector<uint8_t> Heightmap::to_grayscale_image_8bit()
       int i1 = (int)(tiles[k].shift.x * this->shape.x);
       int j1 = (int)(tiles[k].shift.y * this->shape.y);
 
-      for (int p = 0; p < tiles[k].shape.x; p++)
-        for (int q = 0; q < tiles[k].shape.y; q++)
+      TilePin pin({this}, k, false, this->tiling.x);
+
+      // tile core only, the overlap buffers would overwrite the cells of
+      // the neighboring tiles
+      Vec4<int> idx = this->get_tile_core_extent(k);
+
+      for (int p = idx.a; p < idx.b; p++)
+        for (int q = idx.c; q < idx.d; q++)
         {
           // linear index for the global image array (flip y axis and
           // change to row/col major)
@@ -444,9 +571,10 @@ std::vector<uint16_t> Heightmap::to_grayscale_image_16bit()
 {
   std::vector<uint16_t> img(this->shape.x * this->shape.y);
 
-  float vmin = this->min();
-  float vmax = this->max();
-  float inv_vptp = vmin != vmax ? 1.f / (this->max() - vmin) : 0.f;
+  Vec2<float> vminmax = this->minmax();
+  float       vmin = vminmax.x;
+  float       vmax = vminmax.y;
+  float       inv_vptp = vmin != vmax ? 1.f / (vmax - vmin) : 0.f;
 
   for (int it = 0; it < tiling.x; it++)
     for (int jt = 0; jt < tiling.y; jt++)
@@ -458,8 +586,14 @@ std::vector<uint16_t> Heightmap::to_grayscale_image_16bit()
       int i1 = (int)(tiles[k].shift.x * this->shape.x);
       int j1 = (int)(tiles[k].shift.y * this->shape.y);
 
-      for (int p = 0; p < tiles[k].shape.x; p++)
-        for (int q = 0; q < tiles[k].shape.y; q++)
+      TilePin pin({this}, k, false, this->tiling.x);
+
+      // tile core only, the overlap buffers would overwrite the cells of
+      // the neighboring tiles
+      Vec4<int> idx = this->get_tile_core_extent(k);
+
+      for (int p = idx.a; p < idx.b; p++)
+        for (int q = idx.c; q < idx.d; q++)
         {
           // linear index for the global image array (flip y axis and
           // change to row/col major)
@@ -481,25 +615,26 @@ std::vector<uint16_t> Heightmap::to_grayscale_image_16bit_multithread()
 {
   std::vector<uint16_t> img(this->shape.x * this->shape.y);
 
-  float vmin = this->min();
-  float vmax = this->max();
-  float inv_vptp = vmin != vmax ? 1.f / (this->max() - vmin) : 0.f;
-
-  std::vector<std::future<void>> futures;
+  Vec2<float> vminmax = this->minmax();
+  float       vmin = vminmax.x;
+  float       vmax = vminmax.y;
+  float       inv_vptp = vmin != vmax ? 1.f / (vmax - vmin) : 0.f;
 
   // --- function to compute for each tile
 
-  auto lambda = [this, &img, vmin, inv_vptp](int it, int jt)
+  auto lambda = [this, &img, vmin, inv_vptp](size_t k)
   {
-    // tile array position within the global array
-    int k = this->get_tile_index(it, jt);
-
     // bottom-left indices of the current tile
     int i1 = (int)(tiles[k].shift.x * this->shape.x);
     int j1 = (int)(tiles[k].shift.y * this->shape.y);
 
-    for (int p = 0; p < tiles[k].shape.x; p++)
-      for (int q = 0; q < tiles[k].shape.y; q++)
+    TilePin pin({this}, k, false);
+
+    // tile core only, each cell of the image is written by a single thread
+    Vec4<int> idx = this->get_tile_core_extent(k);
+
+    for (int p = idx.a; p < idx.b; p++)
+      for (int q = idx.c; q < idx.d; q++)
       {
         // linear index for the global image array (flip y axis and
         // change to row/col major)
@@ -514,18 +649,20 @@ std::vector<uint16_t> Heightmap::to_grayscale_image_16bit_multithread()
 
   // --- distribute
 
-  for (int it = 0; it < tiling.x; it++)
-    for (int jt = 0; jt < tiling.y; jt++)
-      futures.push_back(std::async(lambda, it, jt));
-
-  for (auto &f : futures)
-    f.get();
+  parallel_for(this->get_ntiles(), lambda);
 
   return img;
 }
 
+void Heightmap::unpin_tile(size_t k, bool is_modified) const
+{
+  if (this->tile_cache) this->tile_cache->unpin(this->tile_ids[k], is_modified);
+}
+
 void Heightmap::update_tile_parameters()
 {
+  this->release_tiles();
+
   tiles.resize(this->tiling.x * this->tiling.y);
 
   // what the buffers extent to the tile domain at both frontiers
@@ -569,19 +706,34 @@ void Heightmap::update_tile_parameters()
 
       tiles[k] = Tile(tile_shape, shift, scale, tile_bbox);
     }
+
+  // out-of-core, tiles are released and registered to the cache as zero
+  // tiles (only allocated once pinned)
+  if (this->tile_cache)
+  {
+    this->tile_ids.resize(this->get_ntiles());
+
+    for (size_t k = 0; k < this->get_ntiles(); k++)
+    {
+      std::vector<float>().swap(tiles[k].vector);
+      this->tile_ids[k] = this->tile_cache->add(&tiles[k].vector,
+                                                tiles[k].size());
+    }
+  }
 }
 
 std::vector<float> Heightmap::unique_values()
 {
   std::vector<std::vector<float>> tile_unique_values(this->get_ntiles());
-  std::vector<std::future<std::vector<float>>> futures(this->get_ntiles());
-  std::vector<float>                           hmap_unique_values = {};
+  std::vector<float>              hmap_unique_values = {};
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    futures[i] = std::async(&Tile::unique_values, tiles[i]);
+  auto lambda = [this, &tile_unique_values](size_t i)
+  {
+    TilePin pin({this}, i, false);
+    tile_unique_values[i] = tiles[i].unique_values();
+  };
 
-  for (decltype(futures)::size_type i = 0; i < this->get_ntiles(); ++i)
-    tile_unique_values[i] = futures[i].get();
+  parallel_for(this->get_ntiles(), lambda);
 
   // fill heightmap vector values
   for (size_t i = 0; i < this->get_ntiles(); ++i)
@@ -592,4 +744,63 @@ std::vector<float> Heightmap::unique_values()
   return hmap_unique_values;
 }
 
+TilePin::TilePin(std::initializer_list<const Heightmap *> p_hmaps,
+                 size_t                                   k,
+                 bool                                     is_modified,
+                 int                                      prefetch_stride)
+    : k(k)
+{
+  for (auto p_h : p_hmaps)
+    this->pin(p_h, is_modified, prefetch_stride);
+}
+
+TilePin::TilePin(std::initializer_list<const Heightmap *> p_outputs,
+                 std::initializer_list<const Heightmap *> p_inputs,
+                 size_t                                   k,
+                 int                                      prefetch_stride)
+    : k(k)
+{
+  for (auto p_h : p_outputs)
+    this->pin(p_h, true, prefetch_stride);
+  for (auto p_h : p_inputs)
+    this->pin(p_h, false, prefetch_stride);
+}
+
+TilePin::TilePin(const std::vector<Heightmap *> &p_hmaps,
+                 size_t                          k,
+                 bool                            is_modified,
+                 int                             prefetch_stride)
+    : k(k)
+{
+  for (auto p_h : p_hmaps)
+    this->pin(p_h, is_modified, prefetch_stride);
+}
+
+TilePin::~TilePin()
+{
+  for (auto &p : this->pinned)
+    p.p_h->unpin_tile(this->k, p.is_modified);
+}
+
+void TilePin::pin(const Heightmap *p_h, bool is_modified, int prefetch_stride)
+{
+  if (!p_h || !p_h->is_out_of_core()) return;
+
+  p_h->pin_tile(this->k);
+  this->pinned.push_back({p_h, is_modified});
+
+  // with parallel_for, tiles are dispatched in increasing order to the pool
+  // threads, the tile following the ones currently processed by the other
+  // threads is the next one to be pinned
+  size_t stride = prefetch_stride < 0
+                      ? ThreadPool::get_instance().get_num_threads()
+                      : (size_t)prefetch_stride;
+
+  if (stride > 0)
+  {
+    size_t k_next = this->k + stride;
+    if (k_next < p_h->get_ntiles()) p_h->prefetch_tile(k_next);
+  }
+}
+
 } // namespace hmap
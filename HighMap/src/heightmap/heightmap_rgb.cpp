@@ -2,8 +2,6 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include <functional>
-#include <future>
-#include <thread>
 
 #include "macrologger.h"
 
@@ -13,6 +11,7 @@
 #include "highmap/math.hpp"
 #include "highmap/operator.hpp"
 #include "highmap/tensor.hpp"
+#include "highmap/thread_pool.hpp"
 
 namespace hmap
 {
@@ -70,20 +69,19 @@ void HeightmapRGB::colorize(Heightmap                      &h,
   };
 
   // apply to the each rgb heightmaps
-  for (size_t kc = 0; kc < this->rgb.size(); kc++)
+  size_t ntiles = this->rgb[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = this->rgb[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(h.tiles[i]),
-                              std::ref(this->rgb[kc].tiles[i]),
-                              kc);
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
+
+    TilePin pin({&this->rgb[kc]}, {&h}, i);
+
+    lambda(h.tiles[i], this->rgb[kc].tiles[i], kc);
+  };
+
+  parallel_for(this->rgb.size() * ntiles, lambda_tile);
 }
 
 void HeightmapRGB::colorize(Heightmap &h,
@@ -151,21 +149,22 @@ HeightmapRGB mix_heightmap_rgb(HeightmapRGB &rgb1,
   { out = lerp(in1, in2, t); };
 
   // apply to the each rgb heightmaps
-  for (size_t kc = 0; kc < rgb1.rgb.size(); kc++)
+  size_t ntiles = rgb1.rgb[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = rgb1.rgb[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
+
+    TilePin pin({&rgb_out.rgb[kc]}, {&rgb1.rgb[kc], &rgb2.rgb[kc], &t}, i);
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(rgb_out.rgb[kc].tiles[i]),
-                              std::ref(rgb1.rgb[kc].tiles[i]),
-                              std::ref(rgb2.rgb[kc].tiles[i]),
-                              std::ref(t.tiles[i]));
+    lambda(rgb_out.rgb[kc].tiles[i],
+           rgb1.rgb[kc].tiles[i],
+           rgb2.rgb[kc].tiles[i],
+           t.tiles[i]);
+  };
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+  parallel_for(rgb1.rgb.size() * ntiles, lambda_tile);
 
   return rgb_out;
 }
@@ -180,20 +179,21 @@ HeightmapRGB mix_heightmap_rgb(HeightmapRGB &rgb1, HeightmapRGB &rgb2, float t)
   { out = lerp(in1, in2, t); };
 
   // apply to the each rgb heightmaps
-  for (size_t kc = 0; kc < rgb1.rgb.size(); kc++)
+  size_t ntiles = rgb1.rgb[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = rgb1.rgb[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(rgb_out.rgb[kc].tiles[i]),
-                              std::ref(rgb1.rgb[kc].tiles[i]),
-                              std::ref(rgb2.rgb[kc].tiles[i]));
+    TilePin pin({&rgb_out.rgb[kc]}, {&rgb1.rgb[kc], &rgb2.rgb[kc]}, i);
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    lambda(rgb_out.rgb[kc].tiles[i],
+           rgb1.rgb[kc].tiles[i],
+           rgb2.rgb[kc].tiles[i]);
+  };
+
+  parallel_for(rgb1.rgb.size() * ntiles, lambda_tile);
 
   return rgb_out;
 }
@@ -210,21 +210,22 @@ HeightmapRGB mix_heightmap_rgb_sqrt(HeightmapRGB &rgb1,
   { out = pow((1.f - t) * in1 * in1 + t * in2 * in2, 0.5f); };
 
   // apply to the each rgb heightmaps
-  for (size_t kc = 0; kc < rgb1.rgb.size(); kc++)
+  size_t ntiles = rgb1.rgb[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = rgb1.rgb[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(rgb_out.rgb[kc].tiles[i]),
-                              std::ref(rgb1.rgb[kc].tiles[i]),
-                              std::ref(rgb2.rgb[kc].tiles[i]),
-                              std::ref(t.tiles[i]));
+    TilePin pin({&rgb_out.rgb[kc]}, {&rgb1.rgb[kc], &rgb2.rgb[kc], &t}, i);
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    lambda(rgb_out.rgb[kc].tiles[i],
+           rgb1.rgb[kc].tiles[i],
+           rgb2.rgb[kc].tiles[i],
+           t.tiles[i]);
+  };
+
+  parallel_for(rgb1.rgb.size() * ntiles, lambda_tile);
 
   return rgb_out;
 }
@@ -241,20 +242,21 @@ HeightmapRGB mix_heightmap_rgb_sqrt(HeightmapRGB &rgb1,
   { out = pow((1.f - t) * in1 * in1 + t * in2 * in2, 0.5f); };
 
   // apply to the each rgb heightmaps
-  for (size_t kc = 0; kc < rgb1.rgb.size(); kc++)
+  size_t ntiles = rgb1.rgb[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = rgb1.rgb[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(rgb_out.rgb[kc].tiles[i]),
-                              std::ref(rgb1.rgb[kc].tiles[i]),
-                              std::ref(rgb2.rgb[kc].tiles[i]));
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
+
+    TilePin pin({&rgb_out.rgb[kc]}, {&rgb1.rgb[kc], &rgb2.rgb[kc]}, i);
+
+    lambda(rgb_out.rgb[kc].tiles[i],
+           rgb1.rgb[kc].tiles[i],
+           rgb2.rgb[kc].tiles[i]);
+  };
+
+  parallel_for(rgb1.rgb.size() * ntiles, lambda_tile);
 
   return rgb_out;
 }
@@ -2,8 +2,6 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include <functional>
-#include <future>
-#include <thread>
 
 #include "macrologger.h"
 
@@ -14,6 +12,7 @@
 #include "highmap/operator.hpp"
 #include "highmap/primitives.hpp"
 #include "highmap/tensor.hpp"
+#include "highmap/thread_pool.hpp"
 
 namespace hmap
 {
@@ -154,25 +153,21 @@ void HeightmapRGBA::colorize(Heightmap                      &color_level,
   };
 
   // apply to the each rgb heightmaps (but not the alpha channel)
-  for (size_t kc = 0; kc < 3; kc++)
+  size_t ntiles = this->rgba[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = this->rgba[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-    {
-      Array *p_n = (p_noise == nullptr) ? nullptr : &p_noise->tiles[i];
+    TilePin pin({&this->rgba[kc]}, {&color_level, p_noise}, i);
 
-      futures[i] = std::async(lambda,
-                              std::ref(color_level.tiles[i]),
-                              std::ref(this->rgba[kc].tiles[i]),
-                              p_n,
-                              kc);
-    }
+    Array *p_n = (p_noise == nullptr) ? nullptr : &p_noise->tiles[i];
 
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    lambda(color_level.tiles[i], this->rgba[kc].tiles[i], p_n, kc);
+  };
+
+  parallel_for(3 * ntiles, lambda_tile);
 
   // alpha channel
   if (p_alpha)
@@ -243,21 +238,24 @@ HeightmapRGBA mix_heightmap_rgba(HeightmapRGBA &rgba1,
       TransformMode::DISTRIBUTED);
 
   // apply mixing
-  for (size_t kc = 0; kc < 3; kc++)
+  size_t ntiles = rgba1.rgba[0].get_ntiles();
+
+  auto lambda_tile = [&](size_t k)
   {
-    size_t                         nthreads = rgba1.rgba[kc].get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i] = std::async(lambda,
-                              std::ref(rgba_out.rgba[kc].tiles[i]),
-                              std::ref(rgba1.rgba[kc].tiles[i]),
-                              std::ref(rgba2.rgba[kc].tiles[i]),
-                              std::ref(t.tiles[i]));
-
-    for (decltype(futures)::size_type i = 0; i < nthreads; ++i)
-      futures[i].get();
-  }
+    size_t kc = k / ntiles;
+    size_t i = k % ntiles;
+
+    TilePin pin({&rgba_out.rgba[kc]},
+                {&rgba1.rgba[kc], &rgba2.rgba[kc], &t},
+                i);
+
+    lambda(rgba_out.rgba[kc].tiles[i],
+           rgba1.rgba[kc].tiles[i],
+           rgba2.rgba[kc].tiles[i],
+           t.tiles[i]);
+  };
+
+  parallel_for(3 * ntiles, lambda_tile);
 
   // alpha channel
   transform(
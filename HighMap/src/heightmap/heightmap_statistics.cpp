@@ -0,0 +1,226 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <limits>
+
+#include "macrologger.h"
+
+#include "highmap/heightmap.hpp"
+#include "highmap/thread_pool.hpp"
+
+namespace hmap
+{
+
+// partial reduction of a single tile
+struct TileReduction
+{
+  float  min = std::numeric_limits<float>::max();
+  float  max = -std::numeric_limits<float>::max();
+  double sum = 0.0;
+  size_t count = 0;
+};
+
+// min / max / sum / count in a single pass over every tile, performed in place
+static TileReduction reduce_tiles(const Heightmap &h)
+{
+  std::vector<TileReduction> reductions(h.get_ntiles());
+
+  auto lambda = [&h, &reductions](size_t k)
+  {
+    TilePin pin({&h}, k, false);
+
+    const Tile    &tile = h.tiles[k];
+    Vec4<int>      idx = h.get_tile_core_extent(k);
+    TileReduction &r = reductions[k];
+
+    for (int j = idx.c; j < idx.d; j++)
+    {
+      const float *p_row = tile.vector.data() + j * tile.shape.x;
+      double       row_sum = 0.0;
+
+      for (int i = idx.a; i < idx.b; i++)
+      {
+        r.min = std::min(r.min, p_row[i]);
+        r.max = std::max(r.max, p_row[i]);
+        row_sum += p_row[i];
+      }
+      r.sum += row_sum;
+    }
+
+    r.count = (size_t)std::max(0, idx.b - idx.a) *
+              (size_t)std::max(0, idx.d - idx.c);
+  };
+
+  parallel_for(h.get_ntiles(), lambda);
+
+  // merge
+  TileReduction reduction;
+  for (auto &r : reductions)
+  {
+    reduction.min = std::min(reduction.min, r.min);
+    reduction.max = std::max(reduction.max, r.max);
+    reduction.sum += r.sum;
+    reduction.count += r.count;
+  }
+
+  return reduction;
+}
+
+// percentiles interpolated from an histogram defined over [vmin, vmax]
+static std::vector<float> histogram_percentiles(
+    const std::vector<size_t> &histogram,
+    float                      vmin,
+    float                      vmax,
+    size_t                     count,
+    const std::vector<float>  &ranks)
+{
+  std::vector<float> percentiles = {};
+  percentiles.reserve(ranks.size());
+
+  if (count == 0 || vmin == vmax || histogram.empty())
+  {
+    percentiles.resize(ranks.size(), vmin);
+    return percentiles;
+  }
+
+  const size_t nbins = histogram.size();
+  const float  bin_width = (vmax - vmin) / (float)nbins;
+
+  for (float rank : ranks)
+  {
+    // target (fractional) number of cells below the percentile value
+    double target = std::clamp(rank, 0.f, 100.f) / 100.0 * (double)count;
+    double cumul = 0.0;
+    size_t b = 0;
+
+    while (b < nbins - 1 && cumul + (double)histogram[b] < target)
+      cumul += (double)histogram[b++];
+
+    double t = histogram[b] ? (target - cumul) / (double)histogram[b] : 0.0;
+    float  v = vmin + bin_width * ((float)b + (float)std::clamp(t, 0.0, 1.0));
+
+    percentiles.push_back(std::clamp(v, vmin, vmax));
+  }
+
+  return percentiles;
+}
+
+std::vector<size_t> Heightmap::histogram(int   nbins,
+                                         float vmin,
+                                         float vmax) const
+{
+  if (nbins <= 0) return {};
+
+  std::vector<std::vector<size_t>> tile_histograms(this->get_ntiles());
+
+  const float norm = vmin != vmax ? (float)nbins / (vmax - vmin) : 0.f;
+
+  auto lambda = [this, &tile_histograms, nbins, vmin, norm](size_t k)
+  {
+    TilePin pin({this}, k, false);
+
+    const Tile          &tile = this->tiles[k];
+    Vec4<int>            idx = this->get_tile_core_extent(k);
+    std::vector<size_t> &hist = tile_histograms[k];
+
+    hist.assign(nbins, 0);
+
+    for (int j = idx.c; j < idx.d; j++)
+    {
+      const float *p_row = tile.vector.data() + j * tile.shape.x;
+
+      for (int i = idx.a; i < idx.b; i++)
+      {
+        int b = (int)((p_row[i] - vmin) * norm);
+        hist[std::clamp(b, 0, nbins - 1)]++;
+      }
+    }
+  };
+
+  parallel_for(this->get_ntiles(), lambda);
+
+  // merge
+  std::vector<size_t> hist(nbins, 0);
+  for (auto &th : tile_histograms)
+    for (int b = 0; b < nbins; b++)
+      hist[b] += th[b];
+
+  return hist;
+}
+
+float Heightmap::max() const
+{
+  return reduce_tiles(*this).max;
+}
+
+float Heightmap::mean() const
+{
+  TileReduction r = reduce_tiles(*this);
+  return r.count ? (float)(r.sum / (double)r.count) : 0.f;
+}
+
+float Heightmap::min() const
+{
+  return reduce_tiles(*this).min;
+}
+
+Vec2<float> Heightmap::minmax() const
+{
+  TileReduction r = reduce_tiles(*this);
+  return Vec2<float>(r.min, r.max);
+}
+
+std::vector<float> Heightmap::percentiles(const std::vector<float> &ranks,
+                                          int                       nbins) const
+{
+  return this->statistics(nbins, ranks).percentiles;
+}
+
+HeightmapStatistics Heightmap::statistics(int                       nbins,
+                                          const std::vector<float> &ranks) const
+{
+  HeightmapStatistics stats;
+
+  // --- first pass: min, max, sum and count
+
+  TileReduction r = reduce_tiles(*this);
+
+  if (r.count == 0)
+  {
+    LOG_ERROR("empty heightmap, statistics are not defined");
+    return stats;
+  }
+
+  stats.min = r.min;
+  stats.max = r.max;
+  stats.sum = (float)r.sum;
+  stats.mean = (float)(r.sum / (double)r.count);
+  stats.count = r.count;
+
+  // --- second pass (if requested): histogram and percentiles
+
+  if (nbins > 0 || !ranks.empty())
+  {
+    int nbins_eff = nbins > 0 ? nbins : 4096;
+
+    std::vector<size_t> hist = this->histogram(nbins_eff, r.min, r.max);
+
+    stats.percentiles = histogram_percentiles(hist,
+                                              r.min,
+                                              r.max,
+                                              r.count,
+                                              ranks);
+
+    if (nbins > 0) stats.histogram = std::move(hist);
+  }
+
+  return stats;
+}
+
+float Heightmap::sum() const
+{
+  return (float)reduce_tiles(*this).sum;
+}
+
+} // namespace hmap
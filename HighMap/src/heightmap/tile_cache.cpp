@@ -0,0 +1,429 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "macrologger.h"
+
+#include "highmap/dbg/profiler.hpp"
+#include "highmap/tile_cache.hpp"
+
+namespace hmap
+{
+
+TileCache::TileCache(size_t memory_budget, const std::string &scratch_fname)
+    : memory_budget(memory_budget), scratch_fname(scratch_fname)
+{
+  if (this->scratch_fname.empty())
+  {
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::string name = "hmap_tile_cache_" +
+                       std::to_string(reinterpret_cast<uintptr_t>(this)) +
+                       "_" + std::to_string(stamp) + ".bin";
+
+    this->scratch_fname = (std::filesystem::temp_directory_path() / name)
+                              .string();
+  }
+
+#ifndef _WIN32
+  this->fd = ::open(this->scratch_fname.c_str(),
+                    O_RDWR | O_CREAT | O_TRUNC,
+                    0600);
+  bool is_open = this->fd >= 0;
+#else
+  this->scratch.open(this->scratch_fname,
+                     std::ios::in | std::ios::out | std::ios::binary |
+                         std::ios::trunc);
+  bool is_open = this->scratch.is_open();
+#endif
+
+  // without scratch file, tiles are simply never evicted
+  if (!is_open)
+  {
+    LOG_ERROR("could not create scratch file: %s, memory budget ignored",
+              this->scratch_fname.c_str());
+    this->memory_budget = std::numeric_limits<size_t>::max();
+  }
+
+  this->prefetch_thread = std::thread(&TileCache::prefetch_loop, this);
+}
+
+TileCache::~TileCache()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->is_stopping = true;
+  }
+  this->prefetch_cv.notify_all();
+  this->prefetch_thread.join();
+
+#ifndef _WIN32
+  bool is_open = this->fd >= 0;
+  if (is_open) ::close(this->fd);
+#else
+  bool is_open = this->scratch.is_open();
+  if (is_open) this->scratch.close();
+#endif
+
+  if (is_open)
+  {
+    std::error_code ec;
+    std::filesystem::remove(this->scratch_fname, ec);
+  }
+}
+
+int TileCache::add(std::vector<float> *p_data, size_t size)
+{
+  Lock lock(this->mutex);
+
+  int id;
+  if (this->free_ids.empty())
+  {
+    id = (int)this->slots.size();
+    this->slots.push_back(Slot());
+  }
+  else
+  {
+    id = this->free_ids.back();
+    this->free_ids.pop_back();
+  }
+
+  Slot &slot = this->slots[id];
+  slot.p_data = p_data;
+  slot.size = size;
+
+  if (p_data->empty())
+    slot.state = SlotState::SLOT_ZERO;
+  else
+  {
+    slot.state = SlotState::SLOT_RESIDENT;
+    slot.is_dirty = true;
+    slot.last_use = ++this->clock;
+    this->memory_usage += sizeof(float) * size;
+    this->make_room(lock, 0, false);
+  }
+
+  return id;
+}
+
+bool TileCache::evict(Lock &lock, int id)
+{
+  HMAP_PROFILE_ZONE("TileCache::evict");
+
+  Slot  &slot = this->slots[id];
+  size_t bytes = sizeof(float) * slot.size;
+
+  if (slot.is_dirty)
+  {
+    // reuse a released extent of the same size if any
+    if (slot.offset < 0)
+    {
+      auto it = this->free_extents.find(bytes);
+      if (it != this->free_extents.end())
+      {
+        slot.offset = it->second;
+        this->free_extents.erase(it);
+      }
+      else
+      {
+        slot.offset = this->scratch_size;
+        this->scratch_size += (int64_t)bytes;
+      }
+    }
+
+    // the tile is unpinned and cannot be pinned while evicting, its data can
+    // be written without the lock
+    int64_t     offset = slot.offset;
+    const char *data = reinterpret_cast<const char *>(slot.p_data->data());
+
+    // the tile memory is released once written, it is not accounted for in
+    // the meantime so that other threads do not evict more tiles
+    slot.state = SlotState::SLOT_EVICTING;
+    this->evicting_bytes += bytes;
+    lock.unlock();
+    bool is_written = this->write_scratch(offset, data, bytes);
+    lock.lock();
+    this->evicting_bytes -= bytes;
+
+    // slots may have been reallocated while unlocked
+    Slot &slot_after = this->slots[id];
+    slot_after.state = SlotState::SLOT_RESIDENT;
+    this->io_cv.notify_all();
+
+    if (!is_written)
+    {
+      LOG_ERROR("could not write to scratch file: %s",
+                this->scratch_fname.c_str());
+      return false;
+    }
+
+    slot_after.is_dirty = false;
+    HMAP_PROFILE_COUNT("tile cache bytes written", bytes);
+  }
+
+  Slot &s = this->slots[id];
+
+  // a clean tile that has never been written is still filled with zeros
+  s.state = s.offset < 0 ? SlotState::SLOT_ZERO : SlotState::SLOT_STORED;
+
+  std::vector<float>().swap(*s.p_data);
+  this->memory_usage -= bytes;
+
+  return true;
+}
+
+size_t TileCache::get_memory_budget() const
+{
+  return this->memory_budget;
+}
+
+size_t TileCache::get_memory_usage() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->memory_usage;
+}
+
+bool TileCache::load(Lock &lock, int id, bool force)
+{
+  HMAP_PROFILE_ZONE("TileCache::load");
+
+  auto lambda_is_loadable = [this, id]()
+  {
+    SlotState state = this->slots[id].state;
+    return state == SlotState::SLOT_ZERO || state == SlotState::SLOT_STORED;
+  };
+
+  if (!lambda_is_loadable()) return false;
+
+  size_t bytes = sizeof(float) * this->slots[id].size;
+
+  // evictions release the lock, the slot may have been loaded meanwhile
+  if (!this->make_room(lock, bytes, force) || !lambda_is_loadable())
+    return false;
+
+  Slot &slot = this->slots[id];
+
+  bool                is_stored = slot.state == SlotState::SLOT_STORED;
+  int64_t             offset = slot.offset;
+  size_t              size = slot.size;
+  std::vector<float> *p_data = slot.p_data;
+
+  // the memory is accounted for before the read to respect the budget
+  slot.state = SlotState::SLOT_LOADING;
+  this->memory_usage += bytes;
+
+  lock.unlock();
+
+  bool is_read = true;
+
+  if (is_stored)
+  {
+    p_data->resize(size);
+    is_read = this->read_scratch(offset,
+                                 reinterpret_cast<char *>(p_data->data()),
+                                 bytes);
+  }
+  else
+    p_data->assign(size, 0.f);
+
+  lock.lock();
+
+  if (!is_read)
+    LOG_ERROR("could not read from scratch file: %s",
+              this->scratch_fname.c_str());
+  else if (is_stored)
+    HMAP_PROFILE_COUNT("tile cache bytes read", bytes);
+
+  Slot &slot_after = this->slots[id];
+  slot_after.state = SlotState::SLOT_RESIDENT;
+  slot_after.last_use = ++this->clock;
+  this->io_cv.notify_all();
+
+  return true;
+}
+
+bool TileCache::make_room(Lock &lock, size_t bytes, bool force)
+{
+  while (this->memory_usage - this->evicting_bytes + bytes >
+         this->memory_budget)
+  {
+    // least recently used tile among the unpinned resident tiles (linear
+    // search, the number of tiles is expected to remain small)
+    int id_lru = -1;
+
+    for (int id = 0; id < (int)this->slots.size(); id++)
+    {
+      const Slot &slot = this->slots[id];
+
+      if (slot.state == SlotState::SLOT_RESIDENT && slot.pins == 0 &&
+          (id_lru < 0 || slot.last_use < this->slots[id_lru].last_use))
+        id_lru = id;
+    }
+
+    // write error, the tile is kept resident
+    if (id_lru < 0 || !this->evict(lock, id_lru)) return force;
+  }
+
+  return true;
+}
+
+void TileCache::pin(int id)
+{
+  Lock lock(this->mutex);
+
+  while (true)
+  {
+    SlotState state = this->slots[id].state;
+
+    if (state == SlotState::SLOT_RESIDENT)
+      break;
+    else if (state == SlotState::SLOT_LOADING ||
+             state == SlotState::SLOT_EVICTING)
+      this->io_cv.wait(lock); // I/O in progress in another thread
+    else
+      this->load(lock, id, true);
+  }
+
+  Slot &slot = this->slots[id];
+  slot.pins++;
+  slot.last_use = ++this->clock;
+}
+
+void TileCache::prefetch(int id)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    SlotState state = this->slots[id].state;
+
+    if (state != SlotState::SLOT_ZERO && state != SlotState::SLOT_STORED)
+      return;
+
+    // the queue length is bounded by the number of tiles
+    auto &queue = this->prefetch_queue;
+    if (std::find(queue.begin(), queue.end(), id) != queue.end()) return;
+
+    queue.push_back(id);
+  }
+  this->prefetch_cv.notify_one();
+}
+
+void TileCache::prefetch_loop()
+{
+  Lock lock(this->mutex);
+
+  while (true)
+  {
+    this->prefetch_cv.wait(lock,
+                           [this]
+                           {
+                             return this->is_stopping ||
+                                    !this->prefetch_queue.empty();
+                           });
+
+    if (this->is_stopping) return;
+
+    int id = this->prefetch_queue.front();
+    this->prefetch_queue.pop_front();
+
+    // ignored if already loaded since the request, and without forcing the
+    // eviction of pinned tiles
+    this->load(lock, id, false);
+  }
+}
+
+bool TileCache::read_scratch(int64_t offset, char *data, size_t bytes)
+{
+#ifndef _WIN32
+  while (bytes > 0)
+  {
+    ssize_t n = ::pread(this->fd, data, bytes, (off_t)offset);
+    if (n <= 0) return false;
+    data += n;
+    offset += n;
+    bytes -= (size_t)n;
+  }
+  return true;
+#else
+  std::lock_guard<std::mutex> lock(this->scratch_mutex);
+  this->scratch.seekg(offset);
+  this->scratch.read(data, bytes);
+  bool is_ok = (bool)this->scratch;
+  this->scratch.clear();
+  return is_ok;
+#endif
+}
+
+void TileCache::remove(int id)
+{
+  Lock lock(this->mutex);
+
+  // wait for the I/O of the prefetch thread if any
+  this->io_cv.wait(lock,
+                   [this, id]
+                   {
+                     SlotState state = this->slots[id].state;
+                     return state != SlotState::SLOT_LOADING &&
+                            state != SlotState::SLOT_EVICTING;
+                   });
+
+  Slot &slot = this->slots[id];
+
+  if (slot.state == SlotState::SLOT_RESIDENT)
+    this->memory_usage -= sizeof(float) * slot.size;
+
+  if (slot.offset >= 0)
+    this->free_extents.insert({sizeof(float) * slot.size, slot.offset});
+
+  auto &queue = this->prefetch_queue;
+  queue.erase(std::remove(queue.begin(), queue.end(), id), queue.end());
+
+  slot = Slot();
+  this->free_ids.push_back(id);
+}
+
+void TileCache::unpin(int id, bool is_modified)
+{
+  Lock lock(this->mutex);
+
+  Slot &slot = this->slots[id];
+
+  slot.pins--;
+  slot.is_dirty |= is_modified;
+  slot.last_use = ++this->clock;
+
+  // the budget may have been exceeded while every resident tile was pinned
+  this->make_room(lock, 0, false);
+}
+
+bool TileCache::write_scratch(int64_t offset, const char *data, size_t bytes)
+{
+#ifndef _WIN32
+  while (bytes > 0)
+  {
+    ssize_t n = ::pwrite(this->fd, data, bytes, (off_t)offset);
+    if (n <= 0) return false;
+    data += n;
+    offset += n;
+    bytes -= (size_t)n;
+  }
+  return true;
+#else
+  std::lock_guard<std::mutex> lock(this->scratch_mutex);
+  this->scratch.seekp(offset);
+  this->scratch.write(data, bytes);
+  bool is_ok = (bool)this->scratch;
+  this->scratch.clear();
+  return is_ok;
+#endif
+}
+
+} // namespace hmap
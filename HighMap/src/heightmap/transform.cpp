@@ -2,14 +2,14 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include <functional>
-#include <future>
-#include <thread>
 
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
+#include "highmap/dbg/profiler.hpp"
 #include "highmap/geometry/point.hpp"
 #include "highmap/heightmap.hpp"
+#include "highmap/thread_pool.hpp"
 
 namespace hmap
 {
@@ -27,28 +27,27 @@ void transform(std::vector<Heightmap *>                     p_hmaps,
     return;
   }
 
+  HMAP_PROFILE_ZONE("transform");
+
   switch (transform_mode)
   {
   case TransformMode::DISTRIBUTED:
   {
-    size_t                         nthreads = p_hmaps[0]->get_ntiles();
-    std::vector<std::future<void>> futures(nthreads);
-
-    for (size_t i = 0; i < nthreads; ++i)
+    auto lambda = [&p_hmaps, &op](size_t i)
     {
+      TilePin pin(p_hmaps, i);
+      HMAP_PROFILE_ZONE("transform tile");
+      HMAP_PROFILE_COUNT("pixels processed", p_hmaps[0]->tiles[i].size());
+
       // fill-in arrays pointers
       std::vector<Array *> p_arrays = {};
       for (auto p_h : p_hmaps)
         p_arrays.push_back((p_h == nullptr) ? nullptr : &p_h->tiles[i]);
 
-      futures[i] = std::async(op,
-                              p_arrays,
-                              p_hmaps[0]->tiles[i].shape,
-                              p_hmaps[0]->tiles[i].bbox);
-    }
+      op(p_arrays, p_hmaps[0]->tiles[i].shape, p_hmaps[0]->tiles[i].bbox);
+    };
 
-    for (size_t i = 0; i < nthreads; ++i)
-      futures[i].get();
+    parallel_for(p_hmaps[0]->get_ntiles(), lambda);
   }
   break;
   //
@@ -56,6 +55,10 @@ void transform(std::vector<Heightmap *>                     p_hmaps,
   {
     for (size_t i = 0; i < p_hmaps[0]->get_ntiles(); ++i)
     {
+      TilePin pin(p_hmaps, i, true, 1);
+      HMAP_PROFILE_ZONE("transform tile");
+      HMAP_PROFILE_COUNT("pixels processed", p_hmaps[0]->tiles[i].size());
+
       std::vector<Array *> p_arrays = {};
       for (auto p_h : p_hmaps)
         p_arrays.push_back((p_h == nullptr) ? nullptr : &p_h->tiles[i]);
@@ -85,7 +88,11 @@ void transform(std::vector<Heightmap *>                     p_hmaps,
         p_arrays.push_back(nullptr);
 
     Vec4<float> bbox = unit_square_bbox();
-    op(p_arrays, p_hmaps[0]->shape, bbox);
+    {
+      HMAP_PROFILE_ZONE("transform single array");
+      HMAP_PROFILE_COUNT("pixels processed", arrays[0].size());
+      op(p_arrays, p_hmaps[0]->shape, bbox);
+    }
 
     // convert back to heightmaps from arrays
     for (size_t k = 0; k < p_hmaps.size(); k++)
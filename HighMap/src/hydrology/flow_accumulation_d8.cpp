@@ -2,12 +2,10 @@
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
 #include <cmath>
-#include <list>
 
 #include "highmap/array.hpp"
 #include "highmap/boundary.hpp"
 #include "highmap/hydrology.hpp"
-#include "highmap/primitives.hpp"
 
 // neighbor pattern search based on D8 flow direction neighborhood
 // coding
@@ -48,50 +46,8 @@ Array d8_compute_ndip(const Array &d8)
 
 Array flow_accumulation_d8(const Array &z)
 {
-  Array facc = constant(z.shape, 1.f);
-  Array d8 = flow_direction_d8(z);
-  Array nidp = d8_compute_ndip(d8);
-
-  // --- flow accumulation
-  const std::vector<int> di = DI;
-  const std::vector<int> dj = DJ;
-
-  // populate queue
-  std::list<int> i_queue = {};
-  std::list<int> j_queue = {};
-
-  for (int j = 1; j < z.shape.y - 1; j++)
-    for (int i = 1; i < z.shape.x - 1; i++)
-      if (nidp(i, j) == 0)
-      {
-        i_queue.push_back(i);
-        j_queue.push_back(j);
-      }
-
-  // main loop
-  while (i_queue.size() > 0)
-  {
-    int i = i_queue.back();
-    int j = j_queue.back();
-    i_queue.pop_back();
-    j_queue.pop_back();
-
-    // next cell (according to flow direction)
-    int k = d8(i, j);
-    int p = i + di[k];
-    int q = j + dj[k];
-
-    if ((i != p) or (j != q))
-    {
-      facc(p, q) += facc(i, j);
-      nidp(p, q) -= 1.f;
-      if (nidp(p, q) == 0)
-      {
-        i_queue.push_back(p);
-        j_queue.push_back(q);
-      }
-    }
-  }
+  FlowRouting routing = FlowRouting(z);
+  Array       facc = routing.accumulate();
 
   fill_borders(facc);
   return facc;
@@ -0,0 +1,203 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <cmath>
+
+#include "highmap/array.hpp"
+#include "highmap/filters.hpp"
+#include "highmap/gradient.hpp"
+#include "highmap/hydrology.hpp"
+#include "highmap/range.hpp"
+
+// neighbor pattern search based on D8 flow direction neighborhood
+// coding
+
+// 5 6 7
+// 4 . 0
+// 3 2 1
+// clang-format off
+#define DI {1, 1, 0, -1, -1, -1, 0, 1}
+#define DJ {0, -1, -1, -1, 0, 1, 1, 1}
+#define C  {1.f, M_SQRT1_2, 1.f, M_SQRT1_2, 1.f, M_SQRT1_2, 1.f, M_SQRT1_2}
+
+// the "effective contour length" of pixel i. The value of L i is 0.5
+// for pixels in cardinal directions and 0.354 for pixels in diagonal
+// directions (Quinn et al., 1991)
+#define ECL {0.5f, 0.354f, 0.5f, 0.354f, 0.5f, 0.354f, 0.5f, 0.354f}
+// clang-format on
+
+namespace hmap
+{
+
+FlowRouting::FlowRouting(const Array &z) : shape(z.shape)
+{
+  const int   di[8] = DI;
+  const int   dj[8] = DJ;
+  const float c[8] = C;
+
+  this->receivers.assign(z.size(), 0);
+
+  // steepest descent, same as flow_direction_d8 (cells without any lower
+  // neighbor are assigned the direction 0)
+  for (int j = 1; j < z.shape.y - 1; j++)
+    for (int i = 1; i < z.shape.x - 1; i++)
+    {
+      float dmax = 0.f;
+      int   kn = 0;
+
+      for (int k = 0; k < 8; k++)
+      {
+        // elevation difference between the two cells
+        float delta = (z(i, j) - z(i + di[k], j + dj[k])) * c[k];
+
+        if (delta > dmax)
+        {
+          dmax = delta;
+          kn = k;
+        }
+      }
+
+      this->receivers[z.linear_index(i, j)] = (uint8_t)(1 << kn);
+    }
+
+  this->build_stack();
+}
+
+FlowRouting::FlowRouting(const Array &z, float talus_ref)
+    : shape(z.shape), use_mfd(true)
+{
+  // smooth small wavelenghts before computing flow directions to
+  // avoid artifacts
+  this->z_mfd = z;
+  laplace(this->z_mfd);
+
+  // the flow-partition exponent is defined locally based on the local
+  // talus in [1, 10] (Qin et al 2007)
+  this->p_mfd = gradient_talus(this->z_mfd) / talus_ref;
+  clamp_max(this->p_mfd, 1.f);
+  this->p_mfd = 10.f * this->p_mfd + 1.f;
+
+  // receivers are the neighbors with a non-zero flow partition
+  this->receivers.assign(z.size(), 0);
+
+  for (int j = 1; j < z.shape.y - 1; j++)
+    for (int i = 1; i < z.shape.x - 1; i++)
+    {
+      float   weights[8];
+      uint8_t mask = 0;
+
+      this->partition_weights(i, j, weights);
+
+      for (int k = 0; k < 8; k++)
+        if (weights[k] > 0.f) mask |= (uint8_t)(1 << k);
+
+      this->receivers[z.linear_index(i, j)] = mask;
+    }
+
+  this->build_stack();
+}
+
+Array FlowRouting::accumulate(const Array *p_contribution) const
+{
+  const int di[8] = DI;
+  const int dj[8] = DJ;
+
+  Array facc = p_contribution ? *p_contribution : Array(this->shape, 1.f);
+
+  // linear index offset of each neighbor
+  int offset[8];
+  for (int k = 0; k < 8; k++)
+    offset[k] = di[k] + dj[k] * this->shape.x;
+
+  // upstream cells are always visited before their receivers
+  for (int32_t r : this->stack)
+  {
+    uint8_t mask = this->receivers[r];
+    if (!mask) continue;
+
+    if (!this->use_mfd)
+    {
+      for (int k = 0; k < 8; k++)
+        if (mask & (1 << k)) facc.vector[r + offset[k]] += facc.vector[r];
+    }
+    else
+    {
+      float weights[8];
+      this->partition_weights(r % this->shape.x, r / this->shape.x, weights);
+
+      for (int k = 0; k < 8; k++)
+        if (mask & (1 << k))
+          facc.vector[r + offset[k]] += facc.vector[r] * weights[k];
+    }
+  }
+
+  return facc;
+}
+
+void FlowRouting::build_stack()
+{
+  const int di[8] = DI;
+  const int dj[8] = DJ;
+  const int ncells = this->shape.x * this->shape.y;
+
+  int offset[8];
+  for (int k = 0; k < 8; k++)
+    offset[k] = di[k] + dj[k] * this->shape.x;
+
+  // number of donors (neighbors flowing into each cell)
+  std::vector<int32_t> ndonors(ncells, 0);
+
+  for (int r = 0; r < ncells; r++)
+    for (int k = 0; k < 8; k++)
+      if (this->receivers[r] & (1 << k)) ndonors[r + offset[k]]++;
+
+  // topological ordering: the stack itself is used as a FIFO queue, cells
+  // are appended once all their donors have been stacked
+  this->stack.resize(ncells);
+
+  int tail = 0;
+  for (int r = 0; r < ncells; r++)
+    if (ndonors[r] == 0) this->stack[tail++] = r;
+
+  for (int head = 0; head < tail; head++)
+  {
+    int r = this->stack[head];
+
+    for (int k = 0; k < 8; k++)
+      if (this->receivers[r] & (1 << k))
+      {
+        int s = r + offset[k];
+        if (--ndonors[s] == 0) this->stack[tail++] = s;
+      }
+  }
+
+  // cells within flow cycles are never stacked
+  this->stack.resize(tail);
+}
+
+void FlowRouting::partition_weights(int i, int j, float *weights) const
+{
+  const int   di[8] = DI;
+  const int   dj[8] = DJ;
+  const float c[8] = C;
+  const float ecl[8] = ECL;
+
+  const Array &z = this->z_mfd;
+  float        sum = 0.f;
+
+  for (int k = 0; k < 8; k++)
+  {
+    float dz = z(i, j) - z(i + di[k], j + dj[k]);
+
+    weights[k] = dz > 0.f ? std::pow(dz * c[k], this->p_mfd(i, j)) * ecl[k]
+                          : 0.f;
+    sum += weights[k];
+  }
+
+  // normalize
+  if (sum > 0.f)
+    for (int k = 0; k < 8; k++)
+      weights[k] /= sum;
+}
+
+} // namespace hmap
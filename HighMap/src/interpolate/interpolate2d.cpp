@@ -6,10 +6,13 @@
 
 #include "highmap/array.hpp"
 #include "highmap/functions.hpp"
+#include "highmap/geometry/grids.hpp"
 #include "highmap/interpolate2d.hpp"
 #include "highmap/operator.hpp"
 #include "highmap/primitives.hpp"
 
+#include "highmap/internal/point_location.hpp"
+
 namespace hmap
 {
 
@@ -57,21 +60,12 @@ Array interpolate2d_nearest(Vec2<int>                 shape,
                             const Array              *p_stretching,
                             Vec4<float>               bbox)
 {
-  auto itp_fct = [&x, &y, &values](float x_, float y_, float)
+  KdTree2D tree = KdTree2D(x, y);
+
+  auto itp_fct = [&tree, &values](float x_, float y_, float)
   {
-    float dmax = std::numeric_limits<float>::max();
-    float value_;
-    for (size_t k = 0; k < x.size(); k++)
-    {
-      float d = std::hypot(x_ - x[k], y_ - y[k]);
-      if (d < dmax)
-      {
-        dmax = d;
-        value_ = values[k];
-      }
-    }
-
-    return value_;
+    int k = tree.nearest(x_, y_);
+    return k < 0 ? 0.f : values[k];
   };
 
   Array array_out = Array(shape);
@@ -106,51 +100,24 @@ Array interpolate2d_delaunay(Vec2<int>                 shape,
   }
 
   delaunator::Delaunator<float> d(coords);
+  TriangleLocator               locator = TriangleLocator(x, y, d.triangles);
 
-  // compute and store triangles area
-  std::vector<float> area(d.triangles.size());
+  Array array_out = Array(shape);
 
-  for (size_t k = 0; k < d.triangles.size(); k += 3)
+  // without any domain deformation, the output grid is regular and the
+  // triangles can be scanned one by one
+  if (!p_noise_x && !p_noise_y && !p_stretching && bbox.a <= bbox.b &&
+      bbox.c <= bbox.d)
   {
-    int p0 = d.triangles[k];
-    int p1 = d.triangles[k + 1];
-    int p2 = d.triangles[k + 2];
-
-    // true area
-    area[k] = 0.5f * (-y[p1] * x[p2] + y[p0] * (-x[p1] + x[p2]) +
-                      x[p0] * (y[p1] - y[p2]) + x[p1] * y[p2]);
+    std::vector<float> xg, yg;
+    grid_xy_vector(xg, yg, shape, bbox, false); // no endpoint
 
-    // but stored like this to avoid doing it at each evaluation while
-    // interpolating
-    area[k] = 1.f / (2.f * area[k]);
+    locator.rasterize(array_out, xg, yg, values, 0.f);
+    return array_out;
   }
 
-  auto itp_fct = [&x, &y, &values, &d, &area](float x_, float y_, float)
-  {
-    // https://stackoverflow.com/questions/2049582
-
-    // compute barycentric coordinates to find in which triangle the
-    // point (x_, y_) is inside
-    for (size_t k = 0; k < d.triangles.size(); k += 3)
-    {
-      int p0 = d.triangles[k];
-      int p1 = d.triangles[k + 1];
-      int p2 = d.triangles[k + 2];
-
-      float s = area[k] * (y[p0] * x[p2] - x[p0] * y[p2] +
-                           (y[p2] - y[p0]) * x_ + (x[p0] - x[p2]) * y_);
-      float t = area[k] * (x[p0] * y[p1] - y[p0] * x[p1] +
-                           (y[p0] - y[p1]) * x_ + (x[p1] - x[p0]) * y_);
-
-      if (s >= 0.f && t >= 0.f && s + t <= 1.f)
-        return values[p0] + s * (values[p1] - values[p0]) +
-               t * (values[p2] - values[p0]);
-    }
-
-    return 0.f;
-  };
-
-  Array array_out = Array(shape);
+  auto itp_fct = [&locator, &values](float x_, float y_, float)
+  { return locator.interpolate(x_, y_, values, 0.f); };
 
   fill_array_using_xy_function(array_out,
                                bbox,
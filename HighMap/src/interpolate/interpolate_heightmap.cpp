@@ -20,6 +20,8 @@ void flatten_heightmap(Heightmap        &h_source1,
 
   for (size_t k = 0; k < h_source1.tiles.size(); k++)
   {
+    TilePin pin({&h_source1_cpy}, k, true, 1);
+
     Vec4<float> bbox = h_source1.tiles[k].bbox;
 
     for (int j = 0; j < h_source1.tiles[k].shape.y; j++)
@@ -67,6 +69,8 @@ void flatten_heightmap(const hmap::Heightmap &h_source1,
 {
   for (size_t k = 0; k < h_target.tiles.size(); k++)
   {
+    TilePin pin({&h_target}, k, true, 1);
+
     Vec4<float> bbox = h_target.tiles[k].bbox;
 
     for (int j = 0; j < h_target.tiles[k].shape.y; j++)
@@ -137,6 +141,8 @@ void interpolate_heightmap(const hmap::Heightmap &h_source,
 {
   for (size_t k = 0; k < h_target.tiles.size(); k++)
   {
+    TilePin pin({&h_target}, k, true, 1);
+
     Vec4<float> bbox = h_target.tiles[k].bbox;
 
     for (int j = 0; j < h_target.tiles[k].shape.y; j++)
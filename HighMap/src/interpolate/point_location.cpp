@@ -0,0 +1,325 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "highmap/internal/point_location.hpp"
+
+namespace hmap
+{
+
+//----------------------------------------------------------------------
+// TriangleLocator
+//----------------------------------------------------------------------
+
+TriangleLocator::TriangleLocator(const std::vector<float>  &x,
+                                 const std::vector<float>  &y,
+                                 const std::vector<size_t> &triangles)
+    : x(x), y(y), triangles(triangles.begin(), triangles.end())
+{
+  const int ntri = (int)this->triangles.size() / 3;
+
+  // stored like this to avoid doing it at each evaluation while
+  // interpolating
+  this->inv_area.resize(ntri);
+
+  for (int k = 0; k < ntri; k++)
+  {
+    int p0 = this->triangles[3 * k];
+    int p1 = this->triangles[3 * k + 1];
+    int p2 = this->triangles[3 * k + 2];
+
+    float area = 0.5f * (-y[p1] * x[p2] + y[p0] * (-x[p1] + x[p2]) +
+                         x[p0] * (y[p1] - y[p2]) + x[p1] * y[p2]);
+
+    this->inv_area[k] = 1.f / (2.f * area);
+  }
+
+  // --- bucket grid covering the triangulation, about one triangle per
+  // --- bucket
+
+  this->bbox = {std::numeric_limits<float>::max(),
+                -std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::max(),
+                -std::numeric_limits<float>::max()};
+
+  for (int p : this->triangles)
+  {
+    this->bbox.a = std::min(this->bbox.a, x[p]);
+    this->bbox.b = std::max(this->bbox.b, x[p]);
+    this->bbox.c = std::min(this->bbox.c, y[p]);
+    this->bbox.d = std::max(this->bbox.d, y[p]);
+  }
+
+  if (ntri == 0)
+  {
+    this->nbuckets = {0, 0};
+    return;
+  }
+
+  float lx = std::max(this->bbox.b - this->bbox.a,
+                      std::numeric_limits<float>::min());
+  float ly = std::max(this->bbox.d - this->bbox.c,
+                      std::numeric_limits<float>::min());
+
+  float ratio = std::clamp(lx / ly, 1e-3f, 1e3f);
+  int   nx = std::clamp((int)std::sqrt((float)ntri * ratio), 1, 4096);
+  int   ny = std::clamp(ntri / nx, 1, 4096);
+
+  this->nbuckets = {nx, ny};
+  this->inv_size = {(float)nx / lx, (float)ny / ly};
+
+  auto bucket_range = [this](const Vec4<float> &b, Vec4<int> &r)
+  {
+    float fx0 = (b.a - this->bbox.a) * this->inv_size.x;
+    float fx1 = (b.b - this->bbox.a) * this->inv_size.x;
+    float fy0 = (b.c - this->bbox.c) * this->inv_size.y;
+    float fy1 = (b.d - this->bbox.c) * this->inv_size.y;
+
+    r.a = std::clamp((int)std::floor(fx0), 0, this->nbuckets.x - 1);
+    r.b = std::clamp((int)std::floor(fx1), 0, this->nbuckets.x - 1);
+    r.c = std::clamp((int)std::floor(fy0), 0, this->nbuckets.y - 1);
+    r.d = std::clamp((int)std::floor(fy1), 0, this->nbuckets.y - 1);
+  };
+
+  // two passes (count, then fill) to store the buckets in CSR format,
+  // triangles are stored in ascending order within each bucket
+  this->bucket_offsets.assign(nx * ny + 1, 0);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    std::vector<int> fill;
+    if (pass == 1)
+    {
+      for (int b = 0; b < nx * ny; b++)
+        this->bucket_offsets[b + 1] += this->bucket_offsets[b];
+      this->bucket_triangles.resize(this->bucket_offsets.back());
+      fill.assign(this->bucket_offsets.begin(), this->bucket_offsets.end() - 1);
+    }
+
+    for (int k = 0; k < ntri; k++)
+    {
+      Vec4<int> r;
+      bucket_range(this->triangle_bbox(k), r);
+
+      for (int q = r.c; q <= r.d; q++)
+        for (int p = r.a; p <= r.b; p++)
+        {
+          if (pass == 0)
+            this->bucket_offsets[q * nx + p + 1]++;
+          else
+            this->bucket_triangles[fill[q * nx + p]++] = k;
+        }
+    }
+  }
+}
+
+void TriangleLocator::barycentric(int k, float x, float y, float &s, float &t)
+    const
+{
+  // https://stackoverflow.com/questions/2049582
+  const std::vector<float> &xp = this->x;
+  const std::vector<float> &yp = this->y;
+
+  int p0 = this->triangles[3 * k];
+  int p1 = this->triangles[3 * k + 1];
+  int p2 = this->triangles[3 * k + 2];
+
+  s = this->inv_area[k] * (yp[p0] * xp[p2] - xp[p0] * yp[p2] +
+                           (yp[p2] - yp[p0]) * x + (xp[p0] - xp[p2]) * y);
+  t = this->inv_area[k] * (xp[p0] * yp[p1] - yp[p0] * xp[p1] +
+                           (yp[p0] - yp[p1]) * x + (xp[p1] - xp[p0]) * y);
+}
+
+float TriangleLocator::interpolate(float                     x,
+                                   float                     y,
+                                   const std::vector<float> &values,
+                                   float                     fill_value) const
+{
+  float s, t;
+  int   k = this->locate(x, y, s, t);
+
+  if (k < 0) return fill_value;
+
+  int p0 = this->triangles[k];
+  int p1 = this->triangles[k + 1];
+  int p2 = this->triangles[k + 2];
+
+  return values[p0] + s * (values[p1] - values[p0]) +
+         t * (values[p2] - values[p0]);
+}
+
+int TriangleLocator::locate(float x, float y, float &s, float &t) const
+{
+  if (this->nbuckets.x == 0) return -1;
+
+  // outside the triangulation (NaN-safe)
+  if (!(x >= this->bbox.a && x <= this->bbox.b && y >= this->bbox.c &&
+        y <= this->bbox.d))
+    return -1;
+
+  int p = std::min((int)((x - this->bbox.a) * this->inv_size.x),
+                   this->nbuckets.x - 1);
+  int q = std::min((int)((y - this->bbox.c) * this->inv_size.y),
+                   this->nbuckets.y - 1);
+  int b = q * this->nbuckets.x + p;
+
+  for (int r = this->bucket_offsets[b]; r < this->bucket_offsets[b + 1]; r++)
+  {
+    int k = this->bucket_triangles[r];
+    this->barycentric(k, x, y, s, t);
+
+    if (s >= 0.f && t >= 0.f && s + t <= 1.f) return 3 * k;
+  }
+
+  return -1;
+}
+
+void TriangleLocator::rasterize(Array                    &array,
+                                const std::vector<float> &xg,
+                                const std::vector<float> &yg,
+                                const std::vector<float> &values,
+                                float                     fill_value) const
+{
+  const int ntri = (int)this->inv_area.size();
+
+  // nodes already assigned to a triangle (triangles are scanned in
+  // ascending order and the first one containing a node wins)
+  std::vector<uint8_t> done(array.size(), 0);
+
+  for (int k = 0; k < ntri; k++)
+  {
+    Vec4<float> b = this->triangle_bbox(k);
+
+    int i0 = (int)(std::lower_bound(xg.begin(), xg.end(), b.a) - xg.begin());
+    int i1 = (int)(std::upper_bound(xg.begin(), xg.end(), b.b) - xg.begin());
+    int j0 = (int)(std::lower_bound(yg.begin(), yg.end(), b.c) - yg.begin());
+    int j1 = (int)(std::upper_bound(yg.begin(), yg.end(), b.d) - yg.begin());
+
+    int p0 = this->triangles[3 * k];
+    int p1 = this->triangles[3 * k + 1];
+    int p2 = this->triangles[3 * k + 2];
+
+    for (int j = j0; j < j1; j++)
+      for (int i = i0; i < i1; i++)
+      {
+        int r = array.linear_index(i, j);
+        if (done[r]) continue;
+
+        float s, t;
+        this->barycentric(k, xg[i], yg[j], s, t);
+
+        if (s >= 0.f && t >= 0.f && s + t <= 1.f)
+        {
+          array.vector[r] = values[p0] + s * (values[p1] - values[p0]) +
+                            t * (values[p2] - values[p0]);
+          done[r] = 1;
+        }
+      }
+  }
+
+  for (size_t r = 0; r < done.size(); r++)
+    if (!done[r]) array.vector[r] = fill_value;
+}
+
+Vec4<float> TriangleLocator::triangle_bbox(int k) const
+{
+  int p0 = this->triangles[3 * k];
+  int p1 = this->triangles[3 * k + 1];
+  int p2 = this->triangles[3 * k + 2];
+
+  Vec4<float> b = {std::min({this->x[p0], this->x[p1], this->x[p2]}),
+                   std::max({this->x[p0], this->x[p1], this->x[p2]}),
+                   std::min({this->y[p0], this->y[p1], this->y[p2]}),
+                   std::max({this->y[p0], this->y[p1], this->y[p2]})};
+
+  float eps = 1e-5f * std::max({b.b - b.a,
+                                b.d - b.c,
+                                std::abs(b.a),
+                                std::abs(b.b),
+                                std::abs(b.c),
+                                std::abs(b.d)});
+
+  return {b.a - eps, b.b + eps, b.c - eps, b.d + eps};
+}
+
+//----------------------------------------------------------------------
+// KdTree2D
+//----------------------------------------------------------------------
+
+KdTree2D::KdTree2D(const std::vector<float> &x, const std::vector<float> &y)
+    : x(x), y(y)
+{
+  this->nodes.resize(x.size());
+  for (size_t k = 0; k < x.size(); k++)
+    this->nodes[k] = (int)k;
+
+  this->build(0, (int)this->nodes.size(), 0);
+}
+
+void KdTree2D::build(int lo, int hi, int axis)
+{
+  if (hi - lo <= 1) return;
+
+  int                       mid = (lo + hi) / 2;
+  const std::vector<float> &c = axis == 0 ? this->x : this->y;
+
+  std::nth_element(this->nodes.begin() + lo,
+                   this->nodes.begin() + mid,
+                   this->nodes.begin() + hi,
+                   [&c](int a, int b) { return c[a] < c[b]; });
+
+  this->build(lo, mid, 1 - axis);
+  this->build(mid + 1, hi, 1 - axis);
+}
+
+int KdTree2D::nearest(float x, float y) const
+{
+  int   best = -1;
+  float dbest = std::numeric_limits<float>::max();
+
+  this->search(0, (int)this->nodes.size(), 0, x, y, best, dbest);
+  return best;
+}
+
+void KdTree2D::search(int    lo,
+                      int    hi,
+                      int    axis,
+                      float  xq,
+                      float  yq,
+                      int   &best,
+                      float &dbest) const
+{
+  if (hi <= lo) return;
+
+  int mid = (lo + hi) / 2;
+  int p = this->nodes[mid];
+
+  float d = std::hypot(xq - this->x[p], yq - this->y[p]);
+  if (d < dbest || (d == dbest && p < best))
+  {
+    dbest = d;
+    best = p;
+  }
+
+  float delta = axis == 0 ? xq - this->x[p] : yq - this->y[p];
+
+  // nearest side first, the other side is only visited if it may contain a
+  // closer (or equally close) point
+  if (delta < 0.f)
+  {
+    this->search(lo, mid, 1 - axis, xq, yq, best, dbest);
+    if (-delta <= dbest)
+      this->search(mid + 1, hi, 1 - axis, xq, yq, best, dbest);
+  }
+  else
+  {
+    this->search(mid + 1, hi, 1 - axis, xq, yq, best, dbest);
+    if (delta <= dbest) this->search(lo, mid, 1 - axis, xq, yq, best, dbest);
+  }
+}
+
+} // namespace hmap
@@ -5,6 +5,7 @@
 #include <cmath>
 
 #include "highmap/array.hpp"
+#include "highmap/array_expr.hpp"
 #include "highmap/geometry/grids.hpp"
 
 namespace hmap
@@ -157,13 +158,13 @@ Array hypot(const Array &array1, const Array &array2)
 
 Array lerp(const Array &array1, const Array &array2, const Array &t)
 {
-  Array array_out = array1 * (1.f - t) + array2 * t;
+  Array array_out = lazy(array1) * (1.f - lazy(t)) + lazy(array2) * t;
   return array_out;
 }
 
 Array lerp(const Array &array1, const Array &array2, float t)
 {
-  Array array_out = array1 * (1.f - t) + array2 * t;
+  Array array_out = lazy(array1) * (1.f - t) + lazy(array2) * t;
   return array_out;
 }
 
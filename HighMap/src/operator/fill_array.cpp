@@ -4,107 +4,72 @@
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
+#include "highmap/functions.hpp"
 #include "highmap/geometry/grids.hpp"
 
 namespace hmap
 {
 
-void fill_array_using_xy_function(
-    Array                                    &array,
-    Vec4<float>                               bbox,
-    const Array                              *p_ctrl_param,
-    const Array                              *p_noise_x,
-    const Array                              *p_noise_y,
-    const Array                              *p_stretching,
-    std::function<float(float, float, float)> fct_xy)
+// row-by-row filling: the coordinates of each row (including domain warping
+// and stretching) are gathered in contiguous buffers and the function is
+// evaluated for the whole row at once by 'fct_row(x, y, ctrl, out, n)'
+template <typename F>
+static void fill_array_by_rows(Array       &array,
+                               Vec4<float>  bbox,
+                               const Array *p_ctrl_param,
+                               const Array *p_noise_x,
+                               const Array *p_noise_y,
+                               const Array *p_stretching,
+                               F            fct_row)
 {
   Vec2<int>          shape = array.shape;
   std::vector<float> x, y;
   grid_xy_vector(x, y, shape, bbox, false); // no endpoint
 
-  Array ctrl_array = p_ctrl_param == nullptr ? Array(shape, 1.f)
-                                             : *p_ctrl_param;
+  std::vector<float> xr(shape.x), yr(shape.x);
 
-  if (p_stretching) // with stretching
+  for (int j = 0; j < shape.y; j++)
   {
-    if ((!p_noise_x) and (!p_noise_y))
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i, j) = fct_xy(x[i] * (*p_stretching)(i, j),
-                               y[j] * (*p_stretching)(i, j),
-                               ctrl_array(i, j));
-    }
-    else if (p_noise_x and (!p_noise_y))
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i,
-                j) = fct_xy(x[i] * (*p_stretching)(i, j) + (*p_noise_x)(i, j),
-                            y[j] * (*p_stretching)(i, j),
-                            ctrl_array(i, j));
-    }
-    else if ((!p_noise_x) and p_noise_y)
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i,
-                j) = fct_xy(x[i] * (*p_stretching)(i, j),
-                            y[j] * (*p_stretching)(i, j) + (*p_noise_y)(i, j),
-                            ctrl_array(i, j));
-    }
-    else if (p_noise_x and p_noise_y)
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i,
-                j) = fct_xy(x[i] * (*p_stretching)(i, j) + (*p_noise_x)(i, j),
-                            y[j] * (*p_stretching)(i, j) + (*p_noise_y)(i, j),
-                            ctrl_array(i, j));
-    }
-  }
-  else // without stretching
-  {
-    if ((!p_noise_x) and (!p_noise_y))
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i, j) = fct_xy(x[i], y[j], ctrl_array(i, j));
-    }
-    else if (p_noise_x and (!p_noise_y))
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i,
-                j) = fct_xy(x[i] + (*p_noise_x)(i, j), y[j], ctrl_array(i, j));
-    }
-    else if ((!p_noise_x) and p_noise_y)
-    {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i,
-                j) = fct_xy(x[i], y[j] + (*p_noise_y)(i, j), ctrl_array(i, j));
-    }
-    else if (p_noise_x and p_noise_y)
+    size_t offset = (size_t)j * shape.x;
+
+    for (int i = 0; i < shape.x; i++)
     {
-      for (int j = 0; j < shape.y; j++)
-        for (int i = 0; i < shape.x; i++)
-          array(i, j) = fct_xy(x[i] + (*p_noise_x)(i, j),
-                               y[j] + (*p_noise_y)(i, j),
-                               ctrl_array(i, j));
+      xr[i] = x[i];
+      yr[i] = y[j];
     }
+
+    if (p_stretching)
+      for (int i = 0; i < shape.x; i++)
+      {
+        xr[i] *= p_stretching->vector[offset + i];
+        yr[i] *= p_stretching->vector[offset + i];
+      }
+
+    if (p_noise_x)
+      for (int i = 0; i < shape.x; i++)
+        xr[i] += p_noise_x->vector[offset + i];
+
+    if (p_noise_y)
+      for (int i = 0; i < shape.x; i++)
+        yr[i] += p_noise_y->vector[offset + i];
+
+    const float *ctrl = p_ctrl_param ? &p_ctrl_param->vector[offset] : nullptr;
+
+    fct_row(xr.data(), yr.data(), ctrl, &array.vector[offset], shape.x);
   }
 }
 
-void fill_array_using_xy_function(
-    Array                                    &array,
-    Vec4<float>                               bbox,
-    const Array                              *p_ctrl_param,
-    const Array                              *p_noise_x,
-    const Array                              *p_noise_y,
-    const Array                              *p_stretching,
-    std::function<float(float, float, float)> fct_xy,
-    int                                       subsampling)
+// subsampled filling, 'fill_fct' fills the subsampled array using the
+// subsampled inputs
+template <typename F>
+static void fill_array_subsampled(Array       &array,
+                                  Vec4<float>  bbox,
+                                  const Array *p_ctrl_param,
+                                  const Array *p_noise_x,
+                                  const Array *p_noise_y,
+                                  const Array *p_stretching,
+                                  int          subsampling,
+                                  F            fill_fct)
 {
   Vec2<int> shape = array.shape;
   Vec2<int> shape_sub = Vec2<int>(shape.x / subsampling, shape.y / subsampling);
@@ -113,25 +78,27 @@ void fill_array_using_xy_function(
   std::vector<float> x, y;
   grid_xy_vector(x, y, shape, bbox, false);
 
-  Array ctrl_array = p_ctrl_param == nullptr ? Array(shape, 1.f)
-                                             : *p_ctrl_param;
-
   // subsampled grid (with endpoints to cover the exact same domain as
   // the original grid)
   Vec4<float> bbox_sub = Vec4<float>(x.front(), x.back(), y.front(), y.back());
 
-  // resample control parameter
-  Array ctrl_array_sub = ctrl_array.resample_to_shape(shape_sub);
-
-  // also resample input noise and stretching
+  // resample control parameter, input noise and stretching
+  Array ctrl_array_sub;
   Array noise_x_sub;
   Array noise_y_sub;
   Array stretching_sub;
 
+  Array *p_ctrl_array_sub = nullptr;
   Array *p_noise_x_sub = nullptr;
   Array *p_noise_y_sub = nullptr;
   Array *p_stretching_sub = nullptr;
 
+  if (p_ctrl_param != nullptr)
+  {
+    ctrl_array_sub = p_ctrl_param->resample_to_shape(shape_sub);
+    p_ctrl_array_sub = &ctrl_array_sub;
+  }
+
   if (p_noise_x != nullptr)
   {
     noise_x_sub = p_noise_x->resample_to_shape(shape_sub);
@@ -140,26 +107,142 @@ void fill_array_using_xy_function(
 
   if (p_noise_y != nullptr)
   {
-    noise_x_sub = p_noise_y->resample_to_shape(shape_sub);
-    p_noise_y_sub = &noise_x_sub;
+    noise_y_sub = p_noise_y->resample_to_shape(shape_sub);
+    p_noise_y_sub = &noise_y_sub;
   }
 
   if (p_stretching != nullptr)
   {
-    noise_x_sub = p_stretching->resample_to_shape(shape_sub);
-    p_stretching_sub = &noise_x_sub;
+    stretching_sub = p_stretching->resample_to_shape(shape_sub);
+    p_stretching_sub = &stretching_sub;
   }
 
-  fill_array_using_xy_function(array_sub,
-                               bbox_sub,
-                               &ctrl_array_sub,
-                               p_noise_x_sub,
-                               p_noise_y_sub,
-                               p_stretching_sub,
-                               fct_xy);
+  fill_fct(array_sub,
+           bbox_sub,
+           p_ctrl_array_sub,
+           p_noise_x_sub,
+           p_noise_y_sub,
+           p_stretching_sub);
 
   // interpolate on finer grid
   array = array_sub.resample_to_shape(shape);
 }
 
+void fill_array_using_xy_function(
+    Array                                    &array,
+    Vec4<float>                               bbox,
+    const Array                              *p_ctrl_param,
+    const Array                              *p_noise_x,
+    const Array                              *p_noise_y,
+    const Array                              *p_stretching,
+    std::function<float(float, float, float)> fct_xy)
+{
+  fill_array_by_rows(array,
+                     bbox,
+                     p_ctrl_param,
+                     p_noise_x,
+                     p_noise_y,
+                     p_stretching,
+                     [&fct_xy](const float *x,
+                               const float *y,
+                               const float *ctrl,
+                               float       *out,
+                               size_t       n)
+                     {
+                       for (size_t r = 0; r < n; r++)
+                         out[r] = fct_xy(x[r], y[r], ctrl ? ctrl[r] : 1.f);
+                     });
+}
+
+void fill_array_using_xy_function(Array          &array,
+                                  Vec4<float>     bbox,
+                                  const Array    *p_ctrl_param,
+                                  const Array    *p_noise_x,
+                                  const Array    *p_noise_y,
+                                  const Array    *p_stretching,
+                                  const Function &fct)
+{
+  fill_array_by_rows(array,
+                     bbox,
+                     p_ctrl_param,
+                     p_noise_x,
+                     p_noise_y,
+                     p_stretching,
+                     [&fct](const float *x,
+                            const float *y,
+                            const float *ctrl,
+                            float       *out,
+                            size_t       n)
+                     { fct.get_values(x, y, ctrl, out, n); });
+}
+
+void fill_array_using_xy_function(
+    Array                                    &array,
+    Vec4<float>                               bbox,
+    const Array                              *p_ctrl_param,
+    const Array                              *p_noise_x,
+    const Array                              *p_noise_y,
+    const Array                              *p_stretching,
+    std::function<float(float, float, float)> fct_xy,
+    int                                       subsampling)
+{
+  fill_array_subsampled(
+      array,
+      bbox,
+      p_ctrl_param,
+      p_noise_x,
+      p_noise_y,
+      p_stretching,
+      subsampling,
+      [&fct_xy](Array       &array_sub,
+                Vec4<float>  bbox_sub,
+                const Array *p_ctrl_sub,
+                const Array *p_noise_x_sub,
+                const Array *p_noise_y_sub,
+                const Array *p_stretching_sub)
+      {
+        fill_array_using_xy_function(array_sub,
+                                     bbox_sub,
+                                     p_ctrl_sub,
+                                     p_noise_x_sub,
+                                     p_noise_y_sub,
+                                     p_stretching_sub,
+                                     fct_xy);
+      });
+}
+
+void fill_array_using_xy_function(Array          &array,
+                                  Vec4<float>     bbox,
+                                  const Array    *p_ctrl_param,
+                                  const Array    *p_noise_x,
+                                  const Array    *p_noise_y,
+                                  const Array    *p_stretching,
+                                  const Function &fct,
+                                  int             subsampling)
+{
+  fill_array_subsampled(
+      array,
+      bbox,
+      p_ctrl_param,
+      p_noise_x,
+      p_noise_y,
+      p_stretching,
+      subsampling,
+      [&fct](Array       &array_sub,
+             Vec4<float>  bbox_sub,
+             const Array *p_ctrl_sub,
+             const Array *p_noise_x_sub,
+             const Array *p_noise_y_sub,
+             const Array *p_stretching_sub)
+      {
+        fill_array_using_xy_function(array_sub,
+                                     bbox_sub,
+                                     p_ctrl_sub,
+                                     p_noise_x_sub,
+                                     p_noise_y_sub,
+                                     p_stretching_sub,
+                                     fct);
+      });
+}
+
 } // namespace hmap
@@ -1,16 +1,195 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <cstdint>
+
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
 #include "highmap/boundary.hpp"
 #include "highmap/filters.hpp"
 #include "highmap/math.hpp"
+#include "highmap/thread_pool.hpp"
+
+// maximum Chebyshev distance stored in the distance-to-cluster field
+#define HMAP_DLA_DISTANCE_MAX 12
+// minimum free radius for a walker jump (single steps otherwise)
+#define HMAP_DLA_JUMP_MIN 3
+// quantization step of the cluster bounding circle radius
+#define HMAP_DLA_RADIUS_STEP 8
+// number of walkers simulated concurrently before being committed
+#define HMAP_DLA_BATCH_SIZE 64
 
 namespace hmap
 {
 
+namespace
+{
+
+// neighbor search
+const int DI_DLA[8] = {-1, 0, 0, 1, -1, -1, 1, 1};
+const int DJ_DLA[8] = {0, 1, -1, 0, -1, 1, -1, 1};
+
+struct Cluster
+{
+  Array                wrk;      // cluster values (> 0 within the cluster)
+  std::vector<uint8_t> distance; // Chebyshev distance to the cluster, capped
+  int                  ic, jc;   // cluster seed
+  int                  radius;   // bounding circle radius (quantized)
+
+  Cluster(Vec2<int> shape, int ic, int jc)
+      : wrk(shape),
+        distance(shape.x * shape.y, HMAP_DLA_DISTANCE_MAX),
+        ic(ic),
+        jc(jc),
+        radius(0)
+  {
+  }
+
+  // add a cell and update the distance field and the bounding circle
+  void add_cell(int i, int j, float value)
+  {
+    this->wrk(i, j) = value;
+
+    const int dmax = HMAP_DLA_DISTANCE_MAX;
+    int       p1 = std::max(0, i - dmax);
+    int       p2 = std::min(this->wrk.shape.x - 1, i + dmax);
+    int       q1 = std::max(0, j - dmax);
+    int       q2 = std::min(this->wrk.shape.y - 1, j + dmax);
+
+    for (int q = q1; q <= q2; q++)
+      for (int p = p1; p <= p2; p++)
+      {
+        uint8_t  d = (uint8_t)std::max(std::abs(p - i), std::abs(q - j));
+        uint8_t &dref = this->distance[this->wrk.linear_index(p, q)];
+        dref = std::min(dref, d);
+      }
+
+    float r = std::hypot((float)(i - this->ic), (float)(j - this->jc));
+    int   rq = HMAP_DLA_RADIUS_STEP * ((int)r / HMAP_DLA_RADIUS_STEP + 1);
+    this->radius = std::max(this->radius, rq);
+  }
+};
+
+// walker trajectory: positions and distance-to-cluster values the walker
+// decisions were based on
+struct Walk
+{
+  std::vector<Vec2<int>> ij;
+  std::vector<int>       d;
+  int                    radius;
+  bool                   is_stuck;
+  int                    i, j;
+  float                  value;
+};
+
+// random walk of a single walker, the cluster is only read. Far from the
+// cluster, the walker jumps at once to a random point of the largest circle
+// free of any cluster cell (exit point of a random walk started at the circle
+// center)
+void random_walk(const Cluster &cluster,
+                 uint           seed,
+                 int            k,
+                 float          seeding_radius,
+                 float          seeding_outer_radius_ratio,
+                 float          ratio,
+                 Walk          &walk)
+{
+  const Vec2<int> shape = cluster.wrk.shape;
+
+  // cheap to seed generator (one per walker), seeded with a hash of the
+  // global seed and the walker index to decorrelate the walkers
+  uint64_t h = ((uint64_t)seed << 32) + (uint64_t)k + 0x9E3779B97F4A7C15ull;
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+  h ^= h >> 31;
+
+  std::minstd_rand                      gen((uint32_t)h);
+  std::uniform_real_distribution<float> dis(0.f, 1.f);
+
+  walk.ij.clear();
+  walk.d.clear();
+  walk.radius = cluster.radius;
+  walk.is_stuck = false;
+
+  // pick a random cell on a circle
+  float theta = 2.f * M_PI * dis(gen);
+  int   i = (int)(0.5f * shape.x +
+                  seeding_radius *
+                      (1.f + seeding_outer_radius_ratio * dis(gen)) *
+                      (shape.x - 1.0) * std::cos(theta));
+  int   j = (int)(0.5f * shape.y +
+                  seeding_radius *
+                      (1.f + seeding_outer_radius_ratio * dis(gen)) *
+                      (shape.y - 1.0) * std::sin(theta));
+
+  while (i > 0 && j > 0 && i < shape.x - 1 && j < shape.y - 1)
+  {
+    int d = cluster.distance[cluster.wrk.linear_index(i, j)];
+
+    walk.ij.push_back({i, j});
+    walk.d.push_back(d);
+
+    if (d <= 1)
+    {
+      // check neighbors for encounter with an already cell touched by
+      // diffusion
+      for (int p = 0; p < 8; p++)
+        if (cluster.wrk(i + DI_DLA[p], j + DJ_DLA[p]) > 0.f)
+        {
+          walk.is_stuck = true;
+          walk.i = i;
+          walk.j = j;
+          walk.value = ratio * cluster.wrk(i + DI_DLA[p], j + DJ_DLA[p]);
+          return;
+        }
+    }
+
+    // free radius: the walker cannot touch the cluster (nor the domain
+    // borders) within a Chebyshev ball of radius 'rho'
+    float dist_c = std::hypot((float)(i - cluster.ic), (float)(j - cluster.jc));
+    int   rho = std::max(d - 2,
+                       (int)((dist_c - cluster.radius) * M_SQRT1_2) - 2);
+
+    rho = std::min(rho, std::min({i, j, shape.x - 1 - i, shape.y - 1 - j}) - 1);
+
+    if (rho >= HMAP_DLA_JUMP_MIN)
+    {
+      float alpha = 2.f * M_PI * dis(gen);
+      float r = (float)(rho - 1);
+      i += (int)std::lround(r * std::cos(alpha));
+      j += (int)std::lround(r * std::sin(alpha));
+    }
+    else
+    {
+      // next step in random direction
+      int p = (int)(std::floor(8.f * dis(gen)));
+      i += DI_DLA[p];
+      j += DJ_DLA[p];
+    }
+  }
+}
+
+// check whether a walk would have been the same with a new cluster cell
+bool is_walk_valid(const Walk &walk, const Cluster &cluster, Vec2<int> ij_new)
+{
+  if (walk.radius != cluster.radius) return false;
+
+  for (size_t r = 0; r < walk.ij.size(); r++)
+  {
+    int dc = std::max(std::abs(walk.ij[r].x - ij_new.x),
+                      std::abs(walk.ij[r].y - ij_new.y));
+    // the walker decisions depend on the distance field (cells closer than
+    // 'd') and, next to the cluster, on the 8 neighbors values
+    if (dc <= std::max(walk.d[r], 1)) return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
 Array diffusion_limited_aggregation(Vec2<int> shape,
                                     float     scale,
                                     uint      seed,
@@ -19,18 +198,10 @@ Array diffusion_limited_aggregation(Vec2<int> shape,
                                     float     slope,
                                     float     noise_ratio)
 {
-  std::mt19937                          gen(seed);
-  std::uniform_real_distribution<float> dis(0.f, 1.f);
-
-  // neighbor search
-  std::vector<int> di = {-1, 0, 0, 1, -1, -1, 1, 1};
-  std::vector<int> dj = {0, 1, -1, 0, -1, 1, -1, 1};
-
   // --- work on a grid with a resolution defined by the 'scale'
   int ncells = std::max(1, (int)(1.f / scale));
 
   hmap::Vec2<int> shape_wrk = {ncells, ncells};
-  Array           wrk = Array(shape_wrk);
 
   int   nwalkers = ncells * ncells;
   float ratio = std::pow(0.01f, 1.f / ncells);
@@ -38,45 +209,62 @@ Array diffusion_limited_aggregation(Vec2<int> shape,
   // seed the diffusion process (center of domain)
   int ic = (int)(0.5f * ncells);
   int jc = (int)(0.5f * ncells);
-  wrk(ic, jc) = 1.f;
 
-  for (int k = 0; k < nwalkers; k++)
+  Cluster cluster(shape_wrk, ic, jc);
+  cluster.add_cell(ic, jc, 1.f);
+
+  // Walkers have their own random sequence and the result is the same as
+  // releasing them one after the other. Batches of walkers are simulated
+  // concurrently on the current cluster, and then committed in order: a walk
+  // is kept if none of the cells committed before it within the batch could
+  // have changed it, otherwise it is simulated again on the updated cluster.
+  // The result does not depend on the number of threads.
+  std::vector<Walk> walks(HMAP_DLA_BATCH_SIZE);
+
+  for (int k0 = 0; k0 < nwalkers; k0 += HMAP_DLA_BATCH_SIZE)
   {
-    // pick a random cell on a circle
-    float theta = 2.f * M_PI * dis(gen);
-    int   i = (int)(0.5f * shape_wrk.x +
-                  seeding_radius *
-                      (1.f + seeding_outer_radius_ratio * dis(gen)) *
-                      (shape_wrk.x - 1.0) * std::cos(theta));
-    int   j = (int)(0.5f * shape_wrk.y +
-                  seeding_radius *
-                      (1.f + seeding_outer_radius_ratio * dis(gen)) *
-                      (shape_wrk.y - 1.0) * std::sin(theta));
+    int nbatch = std::min(HMAP_DLA_BATCH_SIZE, nwalkers - k0);
+
+    auto lambda_walk = [&](size_t b)
+    {
+      random_walk(cluster,
+                  seed,
+                  k0 + (int)b,
+                  seeding_radius,
+                  seeding_outer_radius_ratio,
+                  ratio,
+                  walks[b]);
+    };
+
+    parallel_for(nbatch, lambda_walk);
 
-    // random_walk
-    bool keep_walking = true;
+    std::vector<Vec2<int>> committed = {};
 
-    while (i > 0 && j > 0 && i < shape_wrk.x - 1 && j < shape_wrk.y - 1 &&
-           keep_walking)
+    for (int b = 0; b < nbatch; b++)
     {
-      // check neighbors for encounter with an already cell
-      // touched by diffusion
-      for (size_t p = 0; p < di.size(); p++)
-        if (wrk(i + di[p], j + dj[p]) > 0.f)
+      for (auto &ij : committed)
+        if (!is_walk_valid(walks[b], cluster, ij))
         {
-          wrk(i, j) = ratio * wrk(i + di[p], j + dj[p]);
-          keep_walking = false;
+          random_walk(cluster,
+                      seed,
+                      k0 + b,
+                      seeding_radius,
+                      seeding_outer_radius_ratio,
+                      ratio,
+                      walks[b]);
           break;
         }
 
-      // next step in random direction
-      int p = (int)(std::floor(8.f * dis(gen)));
-
-      i += di[p];
-      j += dj[p];
+      if (walks[b].is_stuck)
+      {
+        cluster.add_cell(walks[b].i, walks[b].j, walks[b].value);
+        committed.push_back({walks[b].i, walks[b].j});
+      }
     }
   }
 
+  Array &wrk = cluster.wrk;
+
   // clean-up, remove spurious values outward the seeding radius
   for (int j = 0; j < shape_wrk.y; j++)
     for (int i = 0; i < shape_wrk.x; i++)
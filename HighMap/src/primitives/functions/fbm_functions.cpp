@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
 #include <cmath>
 
 #include "highmap/functions.hpp"
@@ -20,31 +21,60 @@ FbmFunction::FbmFunction(std::unique_ptr<NoiseFunction> p_base,
                              persistence,
                              lacunarity)
 {
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        float sum = 0.f;
-        float amp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        for (int k = 0; k < this->octaves; k++)
-        {
-          this->p_base->set_seed(kseed);
-          float value = this->p_base->get_value(ki * x, kj * y, 0.f);
-          sum += value * amp;
-          amp *= (1.f - local_weight) +
-                 local_weight * std::min(value + 1.f, 2.f) * 0.5f;
-
-          ki *= this->lacunarity;
-          kj *= this->lacunarity;
-          amp *= this->persistence;
-          kseed++;
-        }
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmFunction::get_values(const float *x,
+                             const float *y,
+                             const float *ctrl_param,
+                             float       *out,
+                             size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+
+  std::fill(out, out + n, 0.f);
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r];
+      yw[r] = kj * y[r];
+    }
+
+    this->get_base_values(xw, yw, value, n);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      out[r] += value[r] * amp[r];
+      amp[r] *= (1.f - local_weight[r]) +
+                local_weight[r] * std::min(value[r] + 1.f, 2.f) * 0.5f;
+      amp[r] *= this->persistence;
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 FbmIqFunction::FbmIqFunction(std::unique_ptr<NoiseFunction> p_base,
@@ -60,53 +90,73 @@ FbmIqFunction::FbmIqFunction(std::unique_ptr<NoiseFunction> p_base,
                              lacunarity),
       gradient_scale(gradient_scale)
 {
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        float sum = 0.f;
-        float dx_sum = 0.f;
-        float dy_sum = 0.f;
-        float amp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        for (int k = 0; k < this->octaves; k++)
-        {
-          this->p_base->set_seed(kseed);
-
-          float xw = ki * x;
-          float yw = kj * y;
-
-          float value = this->p_base->get_value(xw, yw, 0.f);
-          float dvdx =
-              (this->p_base->get_value(xw + HMAP_GRADIENT_OFFSET, yw, 0.f) -
-               this->p_base->get_value(xw - HMAP_GRADIENT_OFFSET, yw, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-          float dvdy =
-              (this->p_base->get_value(xw, yw + HMAP_GRADIENT_OFFSET, 0.f) -
-               this->p_base->get_value(xw, yw - HMAP_GRADIENT_OFFSET, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-
-          value = smoothstep3(0.5f + value);
-
-          dx_sum += dvdx;
-          dy_sum += dvdy;
-
-          sum += value * amp /
-                 (1.f +
-                  this->gradient_scale * (dx_sum * dx_sum + dy_sum * dy_sum));
-          amp *= (1.f - local_weight) +
-                 local_weight * std::min(value + 1.f, 2.f) * 0.5f;
-
-          ki *= this->lacunarity;
-          kj *= this->lacunarity;
-          amp *= this->persistence;
-          kseed++;
-        }
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmIqFunction::get_values(const float *x,
+                               const float *y,
+                               const float *ctrl_param,
+                               float       *out,
+                               size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float dx_sum[HMAP_FCT_BLOCK_SIZE];
+  float dy_sum[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float dvdx[HMAP_FCT_BLOCK_SIZE];
+  float dvdy[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+  std::fill(dx_sum, dx_sum + n, 0.f);
+  std::fill(dy_sum, dy_sum + n, 0.f);
+
+  std::fill(out, out + n, 0.f);
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r];
+      yw[r] = kj * y[r];
+    }
+
+    this->get_base_values_and_gradient(xw, yw, value, dvdx, dvdy, n);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      float v = smoothstep3(0.5f + value[r]);
+
+      dx_sum[r] += dvdx[r];
+      dy_sum[r] += dvdy[r];
+
+      out[r] += v * amp[r] /
+                (1.f + this->gradient_scale * (dx_sum[r] * dx_sum[r] +
+                                               dy_sum[r] * dy_sum[r]));
+      amp[r] *= (1.f - local_weight[r]) +
+                local_weight[r] * std::min(v + 1.f, 2.f) * 0.5f;
+      amp[r] *= this->persistence;
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 FbmJordanFunction::FbmJordanFunction(std::unique_ptr<NoiseFunction> p_base,
@@ -128,84 +178,106 @@ FbmJordanFunction::FbmJordanFunction(std::unique_ptr<NoiseFunction> p_base,
       warp_scale(warp_scale),
       damp_scale(damp_scale)
 {
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        // based on https://www.decarpentier.nl/scape-procedural-extensions
-        float sum = 0.f;
-        float amp = this->amp0;
-        float amp_damp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        // --- 1st octave
-
-        this->p_base->set_seed(kseed);
-        float value = this->p_base->get_value(x, y, 0.f);
-        float dvdx =
-            (this->p_base->get_value(x + HMAP_GRADIENT_OFFSET, y, 0.f) -
-             this->p_base->get_value(x - HMAP_GRADIENT_OFFSET, y, 0.f)) /
-            HMAP_GRADIENT_OFFSET;
-        float dvdy =
-            (this->p_base->get_value(x, y + HMAP_GRADIENT_OFFSET, 0.f) -
-             this->p_base->get_value(x, y - HMAP_GRADIENT_OFFSET, 0.f)) /
-            HMAP_GRADIENT_OFFSET;
-
-        sum += value * value;
-        float dx_sum_warp = this->warp0 * value * dvdx;
-        float dy_sum_warp = this->warp0 * value * dvdy;
-        float dx_sum_damp = this->damp0 * value * dvdx;
-        float dy_sum_damp = this->damp0 * value * dvdy;
-
-        amp *= (1.f - local_weight) +
-               local_weight * std::min(value * value + 1.f, 2.f) * 0.5f;
-
-        ki *= this->lacunarity;
-        kj *= this->lacunarity;
-        amp *= this->persistence;
-        amp_damp *= this->persistence;
-        kseed++;
-
-        // --- other octaves
-
-        for (int k = 0; k < this->octaves; k++)
-        {
-          this->p_base->set_seed(kseed);
-
-          float xw = ki * x + this->warp_scale * dx_sum_warp;
-          float yw = kj * y + this->warp_scale * dy_sum_warp;
-
-          float value = this->p_base->get_value(xw, yw, 0.f);
-          float dvdx =
-              (this->p_base->get_value(xw + HMAP_GRADIENT_OFFSET, yw, 0.f) -
-               this->p_base->get_value(xw - HMAP_GRADIENT_OFFSET, yw, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-          float dvdy =
-              (this->p_base->get_value(xw, yw + HMAP_GRADIENT_OFFSET, 0.f) -
-               this->p_base->get_value(xw, yw - HMAP_GRADIENT_OFFSET, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-
-          sum += amp_damp * value * value;
-          dx_sum_warp += this->warp0 * value * dvdx;
-          dy_sum_warp += this->warp0 * value * dvdy;
-          dx_sum_damp += this->damp0 * value * dvdx;
-          dy_sum_damp += this->damp0 * value * dvdy;
-
-          amp *= (1.f - local_weight) +
-                 local_weight * std::min(value * value + 1.f, 2.f) * 0.5f;
-
-          ki *= this->lacunarity;
-          kj *= this->lacunarity;
-          amp *= this->persistence;
-          amp_damp = amp * (1.f - this->damp_scale /
-                                      (1.f + dx_sum_damp * dx_sum_damp +
-                                       dy_sum_damp * dy_sum_damp));
-          kseed++;
-        }
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmJordanFunction::get_values(const float *x,
+                                   const float *y,
+                                   const float *ctrl_param,
+                                   float       *out,
+                                   size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  // based on https://www.decarpentier.nl/scape-procedural-extensions
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float amp_damp[HMAP_FCT_BLOCK_SIZE];
+  float dx_sum_warp[HMAP_FCT_BLOCK_SIZE];
+  float dy_sum_warp[HMAP_FCT_BLOCK_SIZE];
+  float dx_sum_damp[HMAP_FCT_BLOCK_SIZE];
+  float dy_sum_damp[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float dvdx[HMAP_FCT_BLOCK_SIZE];
+  float dvdy[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+  std::fill(amp_damp, amp_damp + n, this->amp0);
+
+  std::fill(out, out + n, 0.f);
+
+  // --- 1st octave
+
+  this->p_base->set_seed(kseed);
+  this->get_base_values_and_gradient(x, y, value, dvdx, dvdy, n);
+
+  for (size_t r = 0; r < n; r++)
+  {
+    float v = value[r];
+
+    out[r] += v * v;
+    dx_sum_warp[r] = this->warp0 * v * dvdx[r];
+    dy_sum_warp[r] = this->warp0 * v * dvdy[r];
+    dx_sum_damp[r] = this->damp0 * v * dvdx[r];
+    dy_sum_damp[r] = this->damp0 * v * dvdy[r];
+
+    amp[r] *= (1.f - local_weight[r]) +
+              local_weight[r] * std::min(v * v + 1.f, 2.f) * 0.5f;
+    amp[r] *= this->persistence;
+    amp_damp[r] *= this->persistence;
+  }
+
+  ki *= this->lacunarity;
+  kj *= this->lacunarity;
+  kseed++;
+
+  // --- other octaves
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r] + this->warp_scale * dx_sum_warp[r];
+      yw[r] = kj * y[r] + this->warp_scale * dy_sum_warp[r];
+    }
+
+    this->get_base_values_and_gradient(xw, yw, value, dvdx, dvdy, n);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      float v = value[r];
+
+      out[r] += amp_damp[r] * v * v;
+      dx_sum_warp[r] += this->warp0 * v * dvdx[r];
+      dy_sum_warp[r] += this->warp0 * v * dvdy[r];
+      dx_sum_damp[r] += this->damp0 * v * dvdx[r];
+      dy_sum_damp[r] += this->damp0 * v * dvdy[r];
+
+      amp[r] *= (1.f - local_weight[r]) +
+                local_weight[r] * std::min(v * v + 1.f, 2.f) * 0.5f;
+      amp[r] *= this->persistence;
+      amp_damp[r] = amp[r] * (1.f - this->damp_scale /
+                                        (1.f + dx_sum_damp[r] * dx_sum_damp[r] +
+                                         dy_sum_damp[r] * dy_sum_damp[r]));
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 FbmPingpongFunction::FbmPingpongFunction(std::unique_ptr<NoiseFunction> p_base,
@@ -219,35 +291,64 @@ FbmPingpongFunction::FbmPingpongFunction(std::unique_ptr<NoiseFunction> p_base,
                              persistence,
                              lacunarity)
 {
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        float sum = 0.f;
-        float amp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        for (int k = 0; k < this->octaves; k++)
-        {
-          this->p_base->set_seed(kseed);
-          float value = (this->p_base->get_value(ki * x, kj * y, 0.f) + 1.f) *
-                        2.f;
-          value -= (int)(value * 0.5f) * 2;
-          value = value < 1 ? value : 2 - value;
-          value = smoothstep5(value);
-
-          sum += (value - 0.5f) * 2.f * amp;
-          amp *= (1.f - local_weight) + local_weight * value;
-
-          ki *= this->lacunarity;
-          kj *= this->lacunarity;
-          amp *= this->persistence;
-          kseed++;
-        }
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmPingpongFunction::get_values(const float *x,
+                                     const float *y,
+                                     const float *ctrl_param,
+                                     float       *out,
+                                     size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+
+  std::fill(out, out + n, 0.f);
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r];
+      yw[r] = kj * y[r];
+    }
+
+    this->get_base_values(xw, yw, value, n);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      float v = (value[r] + 1.f) * 2.f;
+      v -= (int)(v * 0.5f) * 2;
+      v = v < 1 ? v : 2 - v;
+      v = smoothstep5(v);
+
+      out[r] += (v - 0.5f) * 2.f * amp[r];
+      amp[r] *= (1.f - local_weight[r]) + local_weight[r] * v;
+      amp[r] *= this->persistence;
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 FbmRidgedFunction::FbmRidgedFunction(std::unique_ptr<NoiseFunction> p_base,
@@ -263,47 +364,66 @@ FbmRidgedFunction::FbmRidgedFunction(std::unique_ptr<NoiseFunction> p_base,
                              lacunarity),
       k_smoothing(k_smoothing)
 {
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        float sum = 0.f;
-        float amp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        if (this->k_smoothing == 0.f)
-          for (int k = 0; k < this->octaves; k++)
-          {
-            this->p_base->set_seed(kseed);
-            float value = std::abs(
-                this->p_base->get_value(ki * x, kj * y, 0.f));
-            sum += (1.f - 2.f * value) * amp;
-            amp *= 1.f - local_weight * value;
-
-            ki *= this->lacunarity;
-            kj *= this->lacunarity;
-            amp *= this->persistence;
-            kseed++;
-          }
-        else
-          for (int k = 0; k < this->octaves; k++)
-          {
-            this->p_base->set_seed(kseed);
-            float value = this->p_base->get_value(ki * x, kj * y, 0.f);
-            value = abs_smooth(value, this->k_smoothing);
-            sum += (1.f - 2.f * value) * amp;
-            amp *= 1.f - local_weight * value;
-
-            ki *= this->lacunarity;
-            kj *= this->lacunarity;
-            amp *= this->persistence;
-            kseed++;
-          }
-
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmRidgedFunction::get_values(const float *x,
+                                   const float *y,
+                                   const float *ctrl_param,
+                                   float       *out,
+                                   size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+
+  std::fill(out, out + n, 0.f);
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r];
+      yw[r] = kj * y[r];
+    }
+
+    this->get_base_values(xw, yw, value, n);
+
+    if (this->k_smoothing == 0.f)
+      for (size_t r = 0; r < n; r++)
+        value[r] = std::abs(value[r]);
+    else
+      for (size_t r = 0; r < n; r++)
+        value[r] = abs_smooth(value[r], this->k_smoothing);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      out[r] += (1.f - 2.f * value[r]) * amp[r];
+      amp[r] *= 1.f - local_weight[r] * value[r];
+      amp[r] *= this->persistence;
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 FbmSwissFunction::FbmSwissFunction(std::unique_ptr<NoiseFunction> p_base,
@@ -320,51 +440,72 @@ FbmSwissFunction::FbmSwissFunction(std::unique_ptr<NoiseFunction> p_base,
 {
   this->set_warp_scale(warp_scale);
 
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        // based on https://www.decarpentier.nl/scape-procedural-extensions
-        float sum = 0.f;
-        float amp = this->amp0;
-        float ki = 1.f;
-        float kj = 1.f;
-        int   kseed = this->seed;
-        float local_weight = (1.f - ctrl_param) + this->weight * ctrl_param;
-
-        float dx_sum = 0.f;
-        float dy_sum = 0.f;
-
-        for (int k = 0; k < this->octaves; k++)
-        {
-          this->p_base->set_seed(kseed);
-
-          float xw = ki * x + this->warp_scale_normalized * dx_sum;
-          float yw = kj * y + this->warp_scale_normalized * dy_sum;
-
-          float value = this->p_base->get_value(xw, yw, 0.f);
-          float dvdx =
-              (this->p_base->get_value(xw + HMAP_GRADIENT_OFFSET, yw, 0.f) -
-               this->p_base->get_value(xw - HMAP_GRADIENT_OFFSET, yw, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-          float dvdy =
-              (this->p_base->get_value(xw, yw + HMAP_GRADIENT_OFFSET, 0.f) -
-               this->p_base->get_value(xw, yw - HMAP_GRADIENT_OFFSET, 0.f)) /
-              HMAP_GRADIENT_OFFSET;
-
-          sum += value * amp;
-          dx_sum += amp * dvdx * -(value + 0.5f);
-          dy_sum += amp * dvdy * -(value + 0.5f);
-
-          amp *= (1.f - local_weight) +
-                 local_weight * std::min(value + 1.f, 2.f) * 0.5f;
-
-          ki *= this->lacunarity;
-          kj *= this->lacunarity;
-          amp *= this->persistence;
-          kseed++;
-        }
-        return sum;
-      });
+  this->set_delegate_from_values();
+}
+
+void FbmSwissFunction::get_values(const float *x,
+                                  const float *y,
+                                  const float *ctrl_param,
+                                  float       *out,
+                                  size_t       n) const
+{
+  // evaluated by blocks, the working arrays are on the stack
+  if (n > HMAP_FCT_BLOCK_SIZE)
+  {
+    this->get_values_by_blocks(x, y, ctrl_param, out, n);
+    return;
+  }
+
+  // based on https://www.decarpentier.nl/scape-procedural-extensions
+  float local_weight[HMAP_FCT_BLOCK_SIZE];
+  float amp[HMAP_FCT_BLOCK_SIZE];
+  float dx_sum[HMAP_FCT_BLOCK_SIZE];
+  float dy_sum[HMAP_FCT_BLOCK_SIZE];
+  float xw[HMAP_FCT_BLOCK_SIZE];
+  float yw[HMAP_FCT_BLOCK_SIZE];
+  float value[HMAP_FCT_BLOCK_SIZE];
+  float dvdx[HMAP_FCT_BLOCK_SIZE];
+  float dvdy[HMAP_FCT_BLOCK_SIZE];
+  float ki = 1.f;
+  float kj = 1.f;
+  int   kseed = this->seed;
+
+  this->get_local_weights(ctrl_param, local_weight, n);
+  std::fill(amp, amp + n, this->amp0);
+  std::fill(dx_sum, dx_sum + n, 0.f);
+  std::fill(dy_sum, dy_sum + n, 0.f);
+
+  std::fill(out, out + n, 0.f);
+
+  for (int k = 0; k < this->octaves; k++)
+  {
+    this->p_base->set_seed(kseed);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      xw[r] = ki * x[r] + this->warp_scale_normalized * dx_sum[r];
+      yw[r] = kj * y[r] + this->warp_scale_normalized * dy_sum[r];
+    }
+
+    this->get_base_values_and_gradient(xw, yw, value, dvdx, dvdy, n);
+
+    for (size_t r = 0; r < n; r++)
+    {
+      float v = value[r];
+
+      out[r] += v * amp[r];
+      dx_sum[r] += amp[r] * dvdx[r] * -(v + 0.5f);
+      dy_sum[r] += amp[r] * dvdy[r] * -(v + 0.5f);
+
+      amp[r] *= (1.f - local_weight[r]) +
+                local_weight[r] * std::min(v + 1.f, 2.f) * 0.5f;
+      amp[r] *= this->persistence;
+    }
+
+    ki *= this->lacunarity;
+    kj *= this->lacunarity;
+    kseed++;
+  }
 }
 
 GenericFractalFunction::GenericFractalFunction(
@@ -400,4 +541,64 @@ void GenericFractalFunction::update_amp0()
   this->amp0 = 1.f / amp_fractal;
 }
 
+void GenericFractalFunction::get_base_values(const float *x,
+                                             const float *y,
+                                             float       *value,
+                                             size_t       n) const
+{
+  // the base function is evaluated with a zero control parameter (and not
+  // with nullptr, which stands for a unit control parameter)
+  static const float zeros[HMAP_FCT_BLOCK_SIZE] = {};
+  this->p_base->get_values(x, y, zeros, value, n);
+}
+
+void GenericFractalFunction::get_base_values_and_gradient(const float *x,
+                                                          const float *y,
+                                                          float *value,
+                                                          float *dvdx,
+                                                          float *dvdy,
+                                                          size_t n) const
+{
+  float xy_shift[HMAP_FCT_BLOCK_SIZE];
+  float v_plus[HMAP_FCT_BLOCK_SIZE];
+  float v_minus[HMAP_FCT_BLOCK_SIZE];
+
+  this->get_base_values(x, y, value, n);
+
+  // x-derivative
+  for (size_t r = 0; r < n; r++)
+    xy_shift[r] = x[r] + HMAP_GRADIENT_OFFSET;
+  this->get_base_values(xy_shift, y, v_plus, n);
+
+  for (size_t r = 0; r < n; r++)
+    xy_shift[r] = x[r] - HMAP_GRADIENT_OFFSET;
+  this->get_base_values(xy_shift, y, v_minus, n);
+
+  for (size_t r = 0; r < n; r++)
+    dvdx[r] = (v_plus[r] - v_minus[r]) / HMAP_GRADIENT_OFFSET;
+
+  // y-derivative
+  for (size_t r = 0; r < n; r++)
+    xy_shift[r] = y[r] + HMAP_GRADIENT_OFFSET;
+  this->get_base_values(x, xy_shift, v_plus, n);
+
+  for (size_t r = 0; r < n; r++)
+    xy_shift[r] = y[r] - HMAP_GRADIENT_OFFSET;
+  this->get_base_values(x, xy_shift, v_minus, n);
+
+  for (size_t r = 0; r < n; r++)
+    dvdy[r] = (v_plus[r] - v_minus[r]) / HMAP_GRADIENT_OFFSET;
+}
+
+void GenericFractalFunction::get_local_weights(const float *ctrl_param,
+                                               float       *local_weight,
+                                               size_t       n) const
+{
+  for (size_t r = 0; r < n; r++)
+  {
+    float c = ctrl_param ? ctrl_param[r] : 1.f;
+    local_weight[r] = (1.f - c) + this->weight * c;
+  }
+}
+
 } // namespace hmap
@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+
 #include "highmap/functions.hpp"
 #include "highmap/math.hpp"
 
@@ -21,11 +23,49 @@ float Function::get_value(float x, float y, float ctrl_param) const
   return this->delegate(x, y, ctrl_param);
 }
 
+void Function::get_values(const float *x,
+                          const float *y,
+                          const float *ctrl_param,
+                          float       *out,
+                          size_t       n) const
+{
+  if (ctrl_param)
+    for (size_t k = 0; k < n; k++)
+      out[k] = this->delegate(x[k], y[k], ctrl_param[k]);
+  else
+    for (size_t k = 0; k < n; k++)
+      out[k] = this->delegate(x[k], y[k], 1.f);
+}
+
+void Function::get_values_by_blocks(const float *x,
+                                    const float *y,
+                                    const float *ctrl_param,
+                                    float       *out,
+                                    size_t       n) const
+{
+  for (size_t r = 0; r < n; r += HMAP_FCT_BLOCK_SIZE)
+    this->get_values(x + r,
+                     y + r,
+                     ctrl_param ? ctrl_param + r : nullptr,
+                     out + r,
+                     std::min((size_t)HMAP_FCT_BLOCK_SIZE, n - r));
+}
+
 void Function::set_delegate(HMAP_FCT_XY_TYPE new_delegate)
 {
   this->delegate = std::move(new_delegate);
 }
 
+void Function::set_delegate_from_values()
+{
+  this->delegate = [this](float x, float y, float ctrl_param)
+  {
+    float value;
+    this->get_values(&x, &y, &ctrl_param, &value, 1);
+    return value;
+  };
+}
+
 //----------------------------------------------------------------------
 // derived from Function class
 //----------------------------------------------------------------------
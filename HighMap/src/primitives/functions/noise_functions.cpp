@@ -13,9 +13,26 @@
 #include "highmap/primitives.hpp"
 #include "highmap/range.hpp"
 
+#include "highmap/internal/point_location.hpp"
+
 namespace hmap
 {
 
+// batched FastNoiseLite evaluation, the raw noise values are post-processed
+// using the (inlined) function 'post'
+template <typename F>
+static void get_noise_values(const FastNoiseLite &noise,
+                             Vec2<float>          kw,
+                             const float         *x,
+                             const float         *y,
+                             float               *out,
+                             size_t               n,
+                             F                    post)
+{
+  for (size_t r = 0; r < n; r++)
+    out[r] = post(noise.GetNoise(kw.x * x[r], kw.y * y[r]));
+}
+
 //----------------------------------------------------------------------
 // derived from NoiseFunction class
 //----------------------------------------------------------------------
@@ -27,9 +44,22 @@ PerlinFunction::PerlinFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      { return this->noise.GetNoise(this->kw.x * x, this->kw.y * y); });
+  this->set_delegate_from_values();
+}
+
+void PerlinFunction::get_values(const float *x,
+                                const float *y,
+                                const float *,
+                                float       *out,
+                                size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return v; });
 }
 
 PerlinBillowFunction::PerlinBillowFunction(Vec2<float> kw, uint seed)
@@ -39,12 +69,22 @@ PerlinBillowFunction::PerlinBillowFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      {
-        float value = this->noise.GetNoise(this->kw.x * x, this->kw.y * y);
-        return 2.f * std::abs(value) - 1.f;
-      });
+  this->set_delegate_from_values();
+}
+
+void PerlinBillowFunction::get_values(const float *x,
+                                      const float *y,
+                                      const float *,
+                                      float       *out,
+                                      size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return 2.f * std::abs(v) - 1.f; });
 }
 
 PerlinHalfFunction::PerlinHalfFunction(Vec2<float> kw, uint seed, float k)
@@ -54,12 +94,23 @@ PerlinHalfFunction::PerlinHalfFunction(Vec2<float> kw, uint seed, float k)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      {
-        float value = this->noise.GetNoise(this->kw.x * x, this->kw.y * y);
-        return clamp_min_smooth(value, 0.f, this->k);
-      });
+  this->set_delegate_from_values();
+}
+
+void PerlinHalfFunction::get_values(const float *x,
+                                    const float *y,
+                                    const float *,
+                                    float       *out,
+                                    size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [this](float v)
+                    { return clamp_min_smooth(v, 0.f, this->k); });
 }
 
 PerlinMixFunction::PerlinMixFunction(Vec2<float> kw, uint seed)
@@ -69,12 +120,22 @@ PerlinMixFunction::PerlinMixFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      {
-        float value = this->noise.GetNoise(this->kw.x * x, this->kw.y * y);
-        return 0.5f * value + std::abs(value) - 0.5f;
-      });
+  this->set_delegate_from_values();
+}
+
+void PerlinMixFunction::get_values(const float *x,
+                                   const float *y,
+                                   const float *,
+                                   float       *out,
+                                   size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return 0.5f * v + std::abs(v) - 0.5f; });
 }
 
 Simplex2Function::Simplex2Function(Vec2<float> kw, uint seed)
@@ -84,9 +145,22 @@ Simplex2Function::Simplex2Function(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(0.5f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      { return this->noise.GetNoise(this->kw.x * x, this->kw.y * y); });
+  this->set_delegate_from_values();
+}
+
+void Simplex2Function::get_values(const float *x,
+                                  const float *y,
+                                  const float *,
+                                  float       *out,
+                                  size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return v; });
 }
 
 Simplex2SFunction::Simplex2SFunction(Vec2<float> kw, uint seed)
@@ -96,9 +170,22 @@ Simplex2SFunction::Simplex2SFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(0.5f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2S);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      { return this->noise.GetNoise(this->kw.x * x, this->kw.y * y); });
+  this->set_delegate_from_values();
+}
+
+void Simplex2SFunction::get_values(const float *x,
+                                   const float *y,
+                                   const float *,
+                                   float       *out,
+                                   size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return v; });
 }
 
 ValueNoiseFunction::ValueNoiseFunction(Vec2<float> kw, uint seed)
@@ -108,9 +195,22 @@ ValueNoiseFunction::ValueNoiseFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_Value);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      { return this->noise.GetNoise(this->kw.x * x, this->kw.y * y); });
+  this->set_delegate_from_values();
+}
+
+void ValueNoiseFunction::get_values(const float *x,
+                                    const float *y,
+                                    const float *,
+                                    float       *out,
+                                    size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return v; });
 }
 
 ValueCubicNoiseFunction::ValueCubicNoiseFunction(Vec2<float> kw, uint seed)
@@ -120,9 +220,22 @@ ValueCubicNoiseFunction::ValueCubicNoiseFunction(Vec2<float> kw, uint seed)
   this->noise.SetFrequency(1.f);
   this->noise.SetNoiseType(FastNoiseLite::NoiseType_ValueCubic);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      { return 1.43f * this->noise.GetNoise(this->kw.x * x, this->kw.y * y); });
+  this->set_delegate_from_values();
+}
+
+void ValueCubicNoiseFunction::get_values(const float *x,
+                                         const float *y,
+                                         const float *,
+                                         float       *out,
+                                         size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return 1.43f * v; });
 }
 
 ValueDelaunayNoiseFunction::ValueDelaunayNoiseFunction(Vec2<float> kw,
@@ -159,48 +272,9 @@ void ValueDelaunayNoiseFunction::update_interpolation_function()
 
   delaunator::Delaunator<float> d(coords);
 
-  // compute and store triangles area
-  std::vector<float> area(d.triangles.size());
-
-  for (size_t k = 0; k < d.triangles.size(); k += 3)
-  {
-    int p0 = d.triangles[k];
-    int p1 = d.triangles[k + 1];
-    int p2 = d.triangles[k + 2];
-
-    // true area
-    area[k] = 0.5f * (-y[p1] * x[p2] + y[p0] * (-x[p1] + x[p2]) +
-                      x[p0] * (y[p1] - y[p2]) + x[p1] * y[p2]);
-
-    // but stored like this to avoid doing it at each evaluation while
-    // interpolating
-    area[k] = 1.f / (2.f * area[k]);
-  }
-
-  auto itp_fct = [x, y, value, d, area](float x_, float y_, float)
-  {
-    // https://stackoverflow.com/questions/2049582
-
-    // compute barycentric coordinates to find in which triangle the
-    // point (x_, y_) is inside
-    for (size_t k = 0; k < d.triangles.size(); k += 3)
-    {
-      int p0 = d.triangles[k];
-      int p1 = d.triangles[k + 1];
-      int p2 = d.triangles[k + 2];
-
-      float s = area[k] * (y[p0] * x[p2] - x[p0] * y[p2] +
-                           (y[p2] - y[p0]) * x_ + (x[p0] - x[p2]) * y_);
-      float t = area[k] * (x[p0] * y[p1] - y[p0] * x[p1] +
-                           (y[p0] - y[p1]) * x_ + (x[p1] - x[p0]) * y_);
-
-      if (s >= 0.f && t >= 0.f && s + t <= 1.f)
-        return value[p0] + s * (value[p1] - value[p0]) +
-               t * (value[p2] - value[p0]);
-    }
-
-    return 1.f;
-  };
+  auto itp_fct = [locator = TriangleLocator(x, y, d.triangles),
+                  value](float x_, float y_, float)
+  { return locator.interpolate(x_, y_, value, 1.f); };
 
   this->set_delegate(itp_fct);
 }
@@ -284,12 +358,22 @@ WorleyFunction::WorleyFunction(Vec2<float> kw,
     this->noise.SetCellularReturnType(
         FastNoiseLite::CellularReturnType_Distance);
 
-  this->set_delegate(
-      [this](float x, float y, float)
-      {
-        return 1.66f *
-               (0.4f + this->noise.GetNoise(this->kw.x * x, this->kw.y * y));
-      });
+  this->set_delegate_from_values();
+}
+
+void WorleyFunction::get_values(const float *x,
+                                const float *y,
+                                const float *,
+                                float       *out,
+                                size_t       n) const
+{
+  get_noise_values(this->noise,
+                   this->kw,
+                   x,
+                   y,
+                   out,
+                   n,
+                   [](float v) { return 1.66f * (0.4f + v); });
 }
 
 WorleyDoubleFunction::WorleyDoubleFunction(Vec2<float> kw,
@@ -306,20 +390,28 @@ WorleyDoubleFunction::WorleyDoubleFunction(Vec2<float> kw,
   this->noise1.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
   this->noise2.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
 
-  this->set_delegate(
-      [this](float x, float y, float ctrl_param)
-      {
-        float local_ratio = ctrl_param * this->ratio;
-
-        float w1 = this->noise1.GetNoise(this->kw.x * x, this->kw.y * y);
-        float w2 = this->noise2.GetNoise(this->kw.x * x, this->kw.y * y);
-        if (this->k)
-          return maximum_smooth(local_ratio * w1,
-                                (1.f - local_ratio) * w2,
-                                this->k);
-        else
-          return std::max(local_ratio * w1, (1.f - local_ratio) * w2);
-      });
+  this->set_delegate_from_values();
+}
+
+void WorleyDoubleFunction::get_values(const float *x,
+                                      const float *y,
+                                      const float *ctrl_param,
+                                      float       *out,
+                                      size_t       n) const
+{
+  for (size_t r = 0; r < n; r++)
+  {
+    float local_ratio = (ctrl_param ? ctrl_param[r] : 1.f) * this->ratio;
+
+    float w1 = this->noise1.GetNoise(this->kw.x * x[r], this->kw.y * y[r]);
+    float w2 = this->noise2.GetNoise(this->kw.x * x[r], this->kw.y * y[r]);
+    if (this->k)
+      out[r] = maximum_smooth(local_ratio * w1,
+                              (1.f - local_ratio) * w2,
+                              this->k);
+    else
+      out[r] = std::max(local_ratio * w1, (1.f - local_ratio) * w2);
+  }
 }
 
 // --- helper
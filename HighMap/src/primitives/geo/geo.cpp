@@ -115,7 +115,7 @@ Array crater(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                nullptr,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -34,7 +34,7 @@ Array biquad_pulse(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -56,7 +56,7 @@ Array bump(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -87,7 +87,7 @@ Array disk(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -109,7 +109,7 @@ Array gaussian_pulse(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -174,7 +174,7 @@ Array rectangle(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -203,7 +203,7 @@ Array rift(Vec2<int>         shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -226,7 +226,7 @@ Array slope(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -249,7 +249,7 @@ Array step(Vec2<int>         shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
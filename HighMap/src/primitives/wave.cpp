@@ -36,7 +36,7 @@ Array wave_dune(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -60,7 +60,7 @@ Array wave_sine(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -84,7 +84,7 @@ Array wave_square(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -110,7 +110,7 @@ Array wave_triangular(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -32,7 +32,7 @@ Array worley_double(Vec2<int>    shape,
                                p_noise_x,
                                p_noise_y,
                                p_stretching,
-                               f.get_delegate());
+                               f);
   return array;
 }
 
@@ -3,6 +3,7 @@
  * this software. */
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include "macrologger.h"
 
@@ -197,65 +198,161 @@ Array maximum(const Array &array1, const float value)
   return array_out;
 }
 
-Array maximum_local(const Array &array, int ir)
+// van Herk/Gil-Werman running maximum over a window of half-width ir, applied
+// to n elements made of nw contiguous values (a single value for a row, a
+// whole row for a column so that the inner loops are vectorized). The
+// sequence is virtually padded with ir lowest values at both ends and split
+// into blocks of the window size: prefix (g) and suffix (h) maxima are
+// computed per block, and any window spans at most two consecutive blocks.
+// The cost is three comparisons per value whatever the radius.
+static void running_max(const float        *src,
+                        float              *dst,
+                        int                 n,
+                        int                 nw,
+                        int                 ir,
+                        std::vector<float> &g,
+                        std::vector<float> &h)
 {
-  Array array_out = Array(array.shape);
-  Array array_tmp = Array(array.shape);
+  if (ir <= 0)
+  {
+    std::copy(src, src + (size_t)n * nw, dst);
+    return;
+  }
 
-  // row
-  for (int i = 0; i < array.shape.x; i++)
+  const int   w = 2 * ir + 1;
+  const int   m = n + 2 * ir;
+  const float lowest = std::numeric_limits<float>::lowest();
+
+  g.resize((size_t)m * nw);
+  h.resize((size_t)m * nw);
+
+  // padded source element
+  const std::vector<float> pad(nw, lowest);
+
+  auto lambda_src = [&](int k) -> const float *
   {
-    int i1 = std::max(0, i - ir);
-    int i2 = std::min(array.shape.x, i + ir + 1);
+    if (k < ir || k >= n + ir) return pad.data();
+    return src + (size_t)(k - ir) * nw;
+  };
 
-    for (int j = 0; j < array.shape.y; j++)
-    {
-      float max = array(i, j);
-      for (int u = i1; u < i2; u++)
-        if (array(u, j) > max) max = array(u, j);
-      array_tmp(i, j) = max;
-    }
+  for (int k = 0; k < m; k++)
+  {
+    const float *p_src = lambda_src(k);
+    float       *p_g = &g[(size_t)k * nw];
+
+    if (k % w == 0)
+      std::copy(p_src, p_src + nw, p_g);
+    else
+      for (int c = 0; c < nw; c++)
+        p_g[c] = std::max(p_g[c - nw], p_src[c]);
+  }
+
+  for (int k = m - 1; k >= 0; k--)
+  {
+    const float *p_src = lambda_src(k);
+    float       *p_h = &h[(size_t)k * nw];
+
+    if (k % w == w - 1 || k == m - 1)
+      std::copy(p_src, p_src + nw, p_h);
+    else
+      for (int c = 0; c < nw; c++)
+        p_h[c] = std::max(p_h[c + nw], p_src[c]);
   }
 
-  // column
+  // window [k - ir, k + ir] of the source is [k, k + w - 1] once padded
+  for (int k = 0; k < n; k++)
+  {
+    const float *p_h = &h[(size_t)k * nw];
+    const float *p_g = &g[(size_t)(k + w - 1) * nw];
+    float       *p_dst = &dst[(size_t)k * nw];
+
+    for (int c = 0; c < nw; c++)
+      p_dst[c] = std::max(p_h[c], p_g[c]);
+  }
+}
+
+Array maximum_local(const Array &array, int ir)
+{
+  Array array_out = Array(array.shape);
+  Array array_tmp = Array(array.shape);
+
+  std::vector<float> g, h;
+
+  // row, elements are single values
   for (int j = 0; j < array.shape.y; j++)
   {
-    int j1 = std::max(0, j - ir);
-    int j2 = std::min(array.shape.y, j + ir + 1);
-    for (int i = 0; i < array.shape.x; i++)
-    {
-      float max = array_tmp(i, j);
-      for (int v = j1; v < j2; v++)
-        if (array_tmp(i, v) > max) max = array_tmp(i, v);
-      array_out(i, j) = max;
-    }
+    const int r = array.linear_index(0, j);
+    running_max(&array.vector[r],
+                &array_tmp.vector[r],
+                array.shape.x,
+                1,
+                ir,
+                g,
+                h);
   }
 
+  // column, elements are whole rows
+  running_max(array_tmp.vector.data(),
+              array_out.vector.data(),
+              array.shape.y,
+              array.shape.x,
+              ir,
+              g,
+              h);
+
   return array_out;
 }
 
 Array maximum_local_disk(const Array &array, int ir)
 {
-  Array array_out = array;
+  // the disk is decomposed into horizontal spans: for a row offset dq,
+  // the span half-width is the largest integer hw such that hw^2 + dq^2 <=
+  // ir^2. Each span width is handled by a running maximum along the rows,
+  // shared by the rows above and below (+dq and -dq)
+  const int ni = array.shape.x;
+  const int nj = array.shape.y;
 
-  int ni = array.shape.x;
-  int nj = array.shape.y;
+  Array array_out = Array(array.shape);
+  Array array_row = Array(array.shape);
 
+  std::vector<float> g, h;
+  int                hw = std::max(0, ir);
+
+  // center row (dq = 0), full span
   for (int j = 0; j < nj; j++)
   {
-    int q1 = std::max(0, j - ir) - j;
-    int q2 = std::min(nj, j + ir + 1) - j;
-    for (int i = 0; i < ni; i++)
+    const int r = array.linear_index(0, j);
+    running_max(&array.vector[r], &array_out.vector[r], ni, 1, hw, g, h);
+  }
+
+  // rows above and below
+  int hw_prev = -1;
+
+  for (int dq = 1; dq <= ir; dq++)
+  {
+    while (hw * hw + dq * dq > ir * ir)
+      hw--;
+
+    if (hw != hw_prev)
+    {
+      for (int j = 0; j < nj; j++)
+      {
+        const int r = array.linear_index(0, j);
+        running_max(&array.vector[r], &array_row.vector[r], ni, 1, hw, g, h);
+      }
+      hw_prev = hw;
+    }
+
+    for (int j = 0; j < nj; j++)
     {
-      int p1 = std::max(0, i - ir) - i;
-      int p2 = std::min(ni, i + ir + 1) - i;
+      float *p_out = &array_out.vector[array.linear_index(0, j)];
 
-      for (int q = q1; q < q2; q++)
-        for (int p = p1; p < p2; p++)
+      for (int q : {j - dq, j + dq})
+        if (q >= 0 && q < nj)
         {
-          float r2 = (float)(p * p + q * q) / (float)ir;
-          if (r2 <= 1.f)
-            array_out(i, j) = std::max(array_out(i, j), array(i + p, j + q));
+          const float *p_row = &array_row.vector[array.linear_index(0, q)];
+          for (int i = 0; i < ni; i++)
+            p_out[i] = std::max(p_out[i], p_row[i]);
         }
     }
   }
@@ -45,13 +45,13 @@ Graph generate_network_alpha_model(const std::vector<float> &xc,
     // Delanay triangulation
     graph = cloud.to_graph_delaunay();
     graph.set_values_from_array(z, bbox);
-    graph.update_connectivity();
+    graph.update_csr();
   }
 
   //--- road weights
 
-  Array is_road = Array(
-      Vec2<int>((int)graph.get_npoints(), (int)graph.get_npoints()));
+  // number of times each edge is used by a road
+  std::vector<float> is_road(graph.get_nedges(), 0.f);
 
   // define number of trips between each cities
   std::vector<float> ntrips = {};
@@ -69,27 +69,29 @@ Graph generate_network_alpha_model(const std::vector<float> &xc,
       trips_iend.push_back(j);
     }
 
-  // compute adjacency matrix based on the Euclidian distance
-  // between points and add elevation difference
-  graph.update_adjacency_matrix();
-
-  //
+  // edge weights are based on the Euclidian distance between points
+  // (default edge weight), add elevation difference
   std::vector<float> local_weight(graph.get_npoints());
   if (p_weight != nullptr)
     local_weight = graph.interpolate_values_from_array(*p_weight, bbox);
 
-  for (size_t i = 0; i < graph.get_npoints(); i++)
-    for (size_t r = 0; r < graph.connectivity[i].size(); r++)
-    {
-      int j = graph.connectivity[i][r];
-      if (j > (int)i)
-      {
-        float dz = graph.points[i].v - graph.points[j].v;
-        graph.adjacency_matrix[{i, j}] += std::abs(dz) * dz_weight;
-        graph.adjacency_matrix[{i, j}] += local_weight[i] + local_weight[j];
-        graph.adjacency_matrix[{j, i}] = graph.adjacency_matrix[{i, j}];
-      }
-    }
+  for (size_t k = 0; k < graph.get_nedges(); k++)
+  {
+    int   i = graph.edges[k][0];
+    int   j = graph.edges[k][1];
+    float dz = graph.points[i].v - graph.points[j].v;
+
+    graph.weights[k] += std::abs(dz) * dz_weight;
+    graph.weights[k] += local_weight[i] + local_weight[j];
+  }
+
+  // index of the edge connecting points i and j
+  auto edge_index = [&graph](int i, int j)
+  {
+    for (int r = graph.csr_offsets[i]; r < graph.csr_offsets[i + 1]; r++)
+      if (graph.csr_neighbors[r] == j) return graph.csr_edges[r];
+    return -1;
+  };
 
   // start with the most important connections
   std::vector<size_t> ksort = argsort(ntrips);
@@ -103,37 +105,24 @@ Graph generate_network_alpha_model(const std::vector<float> &xc,
     std::vector<int> path = graph.dijkstra(i0, j0);
 
     // update road/non-road status
-    for (size_t i = 0; i < path.size() - 1; i++)
-    {
-      int i1 = std::min(path[i], path[i + 1]);
-      int i2 = std::max(path[i], path[i + 1]);
-      is_road(i1, i2) += 1.f;
-    }
+    for (size_t i = 1; i < path.size(); i++)
+      is_road[edge_index(path[i - 1], path[i])] += 1.f;
 
-    // weight adjacency matrix using elevation difference and
-    // road/non-road type of the edge
-    for (size_t i = 0; i < graph.get_npoints(); i++)
-      // loop over neighbors
-      for (size_t r = 0; r < graph.connectivity[i].size(); r++)
-      {
-        int j = graph.connectivity[i][r];
-        if ((j > (int)i) and (is_road(i, j) == 1))
-        {
-          graph.adjacency_matrix[{i, j}] *= alpha;
-          graph.adjacency_matrix[{j, i}] = graph.adjacency_matrix[{i, j}];
-        }
-      }
+    // weight edges using road/non-road type of the edge
+    for (size_t e = 0; e < graph.get_nedges(); e++)
+      if (is_road[e] == 1) graph.weights[e] *= alpha;
   }
 
   //--- remove orphan edges and rebuild road network graph
   Graph network = Graph(graph.get_x(), graph.get_y());
 
   for (size_t i = 0; i < graph.get_npoints(); i++)
-    for (size_t r = 0; r < graph.connectivity[i].size(); r++)
+    for (int r = graph.csr_offsets[i]; r < graph.csr_offsets[i + 1]; r++)
     {
-      int j = graph.connectivity[i][r];
-      if ((j > (int)i) and (is_road(i, j) > 0))
-        network.add_edge({(int)i, j}, is_road((int)i, j));
+      int j = graph.csr_neighbors[r];
+      int e = graph.csr_edges[r];
+      if ((j > (int)i) and (is_road[e] > 0))
+        network.add_edge({(int)i, j}, is_road[e]);
     }
 
   // store city size in node value (equals to 0 if the node is not a
@@ -1,6 +1,7 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
 #include <cmath>
 #include <numeric>
 
@@ -11,10 +12,117 @@
 #include "highmap/gradient.hpp"
 #include "highmap/math.hpp"
 #include "highmap/primitives.hpp"
+#include "highmap/thread_pool.hpp"
 
 namespace hmap
 {
 
+namespace
+{
+
+// Tangent of the horizon angle (positive part) in the direction of the light
+// (dx, dy) for every cell. Elevations are compared along lines parallel to the
+// light direction, sampled at every cell along the major axis of the
+// direction (linear interpolation along the minor axis), i.e. on a sheared
+// grid aligned with the light. Each line is swept once starting from the
+// light side, maintaining the upper convex hull of the elevation profile: the
+// horizon of a sample is its tangent to the hull, found in amortized constant
+// time. Lines are swept concurrently and the horizon of each cell is
+// interpolated from the two lines bracketing the cell.
+Array horizon_tangent(const Array &z, float dx, float dy, float talus_ref)
+{
+  Array th = Array(z.shape);
+
+  // major (u) and minor (v) axes of the light direction
+  bool  transposed = std::abs(dy) > std::abs(dx);
+  int   nu = transposed ? z.shape.y : z.shape.x;
+  int   nv = transposed ? z.shape.x : z.shape.y;
+  int   su = transposed ? z.shape.x : 1; // linear index strides
+  int   sv = transposed ? 1 : z.shape.x;
+  float du = transposed ? dy : dx;
+  float dv = transposed ? dx : dy;
+
+  if (nu < 2 || nv < 2 || du == 0.f) return th;
+
+  // sweep index t from the light side, moving one cell toward the light
+  // shifts the minor axis coordinate by 'm': v(t) = c - m * t
+  auto u_of_t = [du, nu](int t) { return du > 0.f ? nu - 1 - t : t; };
+
+  float m = dv / std::abs(du);
+  float step = std::hypot(1.f, m) * talus_ref; // distance between samples
+
+  float cmin = std::min(0.f, m * (nu - 1));
+  float cmax = (float)(nv - 1) + std::max(0.f, m * (nu - 1));
+  int   c0 = (int)std::floor(cmin);
+  int   nlines = (int)std::ceil(cmax) - c0 + 1;
+
+  // horizon tangent of each line sample (negative if outside the array)
+  std::vector<float> sheared((size_t)nlines * nu, -1.f);
+
+  auto lambda_line = [&](size_t l)
+  {
+    std::vector<float> hull_x = {};
+    std::vector<float> hull_h = {};
+    float             *p_out = sheared.data() + l * nu;
+
+    for (int t = 0; t < nu; t++)
+    {
+      float v = (float)(c0 + (int)l) - m * (float)t;
+      if (v < 0.f || v > (float)(nv - 1)) continue;
+
+      int   v0 = std::min((int)v, nv - 2);
+      float a = v - (float)v0;
+      int   r = u_of_t(t) * su + v0 * sv;
+      float h = (1.f - a) * z.vector[r] + a * z.vector[r + sv];
+      float x = step * (float)t;
+
+      // pop the hull vertices below the tangent
+      size_t n = hull_x.size();
+      while (n >= 2 && (hull_h[n - 2] - h) * (x - hull_x[n - 1]) >=
+                           (hull_h[n - 1] - h) * (x - hull_x[n - 2]))
+      {
+        hull_x.pop_back();
+        hull_h.pop_back();
+        n--;
+      }
+
+      p_out[t] = 0.f;
+      if (n > 0)
+        p_out[t] = std::max(0.f, (hull_h[n - 1] - h) / (x - hull_x[n - 1]));
+
+      hull_x.push_back(x);
+      hull_h.push_back(h);
+    }
+  };
+
+  parallel_for(nlines, lambda_line);
+
+  // back to the array grid
+  auto lambda_row = [&](size_t v)
+  {
+    for (int t = 0; t < nu; t++)
+    {
+      float c = (float)v + m * (float)t - (float)c0;
+      int   l = std::clamp((int)c, 0, nlines - 2);
+      float a = c - (float)l;
+
+      float h0 = sheared[l * nu + t];
+      float h1 = sheared[(l + 1) * nu + t];
+
+      // samples outside the array are discarded
+      float value = h0 < 0.f ? h1 : (h1 < 0.f ? h0 : (1.f - a) * h0 + a * h1);
+
+      th.vector[u_of_t(t) * su + v * sv] = std::max(0.f, value);
+    }
+  };
+
+  parallel_for(nv, lambda_row);
+
+  return th;
+}
+
+} // namespace
+
 Array hillshade(const Array &z, float azimuth, float zenith, float talus_ref)
 {
   float azimuth_rad = M_PI * azimuth / 180.f;
@@ -47,6 +155,35 @@ Array topographic_shading(const Array &z,
   return sh;
 }
 
+Array shadow_cast(const Array &z,
+                  float        azimuth,
+                  float        zenith,
+                  float        talus_ref)
+{
+  if (talus_ref <= 0.f)
+  {
+    LOG_ERROR("talus_ref must be positive (%f), no shadow computed",
+              talus_ref);
+    return Array(z.shape, 1.f);
+  }
+
+  float azimuth_rad = M_PI * azimuth / 180.f;
+  float zenith_rad = M_PI * zenith / 180.f;
+
+  // same light direction as shadow_heightmap
+  Array th = horizon_tangent(z,
+                             std::cos(azimuth_rad),
+                             -std::sin(azimuth_rad),
+                             talus_ref);
+
+  float tan_zenith = std::tan(zenith_rad);
+
+  for (auto &v : th.vector)
+    v = v > tan_zenith ? 0.f : 1.f;
+
+  return th;
+}
+
 Array shadow_grid(const Array &z, float shadow_talus)
 {
   Array sh = Array(z.shape);
@@ -82,38 +219,15 @@ Array shadow_heightmap(const Array &z,
     for (int i = 1; i < z.shape.x - 1; i++)
     {
       Vec3<float> normal = z.get_normal_at(i, j);
-      Vec3<float> pos;
 
       float ndl = -normal.x * light_vector.x - normal.y * light_vector.y +
                   normal.z * light_vector.z;
 
       sh(i, j) = 1.f;
 
-      if (ndl > 0.f)
-      {
-        sh(i, j) = std::max(0.f, sh(i, j) - ndl * 0.6f); // diffuse light
-
-        for (float r = 0.f; r <= 1.f; r += 0.01f)
-        {
-          pos = {r * light_vector.x + (float)i,
-                 r * light_vector.y + (float)j,
-                 r * light_vector.z + z(i, j)};
-
-          int ip = (int)pos.x;
-          int jp = (int)pos.y;
-
-          if ((ip > 0) and (jp > 0) and (ip < z.shape.x) and (jp < z.shape.y))
-          {
-            if (pos.z < z(ip, jp) - 0.01f)
-            {
-              // sh(i, j) = 0.f;
-              break;
-            }
-          }
-          else
-            break;
-        }
-      }
+      // diffuse light (the occlusion of the light by the terrain is not
+      // accounted for, see shadow_cast)
+      if (ndl > 0.f) sh(i, j) = std::max(0.f, sh(i, j) - ndl * 0.6f);
 
       // ambient
       sh(i, j) += std::max(0.f, 0.3f * normal.z);
@@ -124,4 +238,30 @@ Array shadow_heightmap(const Array &z,
   return sh;
 }
 
+Array sky_view_factor(const Array &z, int ndirections, float talus_ref)
+{
+  Array svf = Array(z.shape, 1.f);
+
+  if (talus_ref <= 0.f)
+  {
+    LOG_ERROR("talus_ref must be positive (%f), unobstructed sky assumed",
+              talus_ref);
+    return svf;
+  }
+
+  for (int k = 0; k < ndirections; k++)
+  {
+    float alpha = 2.f * M_PI * (float)k / (float)ndirections;
+    Array th = horizon_tangent(z, std::cos(alpha), std::sin(alpha), talus_ref);
+
+    // sine of the horizon angle
+    for (size_t r = 0; r < svf.vector.size(); r++)
+      svf.vector[r] -= th.vector[r] /
+                       std::sqrt(1.f + th.vector[r] * th.vector[r]) /
+                       (float)ndirections;
+  }
+
+  return svf;
+}
+
 } // namespace hmap
@@ -1,137 +1,238 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+#include <limits>
+
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
 #include "highmap/math.hpp"
+#include "highmap/shortest_path.hpp"
+#include "highmap/thread_pool.hpp"
+
+#include "highmap/internal/indexed_heap.hpp"
 
 namespace hmap
 {
 
-void find_path_dijkstra(const Array                   &z,
-                        Vec2<int>                      ij_start,
-                        std::vector<Vec2<int>>         ij_end_list,
-                        std::vector<std::vector<int>> &i_path_list,
-                        std::vector<std::vector<int>> &j_path_list,
-                        float                          elevation_ratio,
-                        float                          distance_exponent,
-                        float                          upward_penalization,
-                        const Array                   *p_mask_nogo)
+// neighbors pattern
+static const int   DI8[8] = {-1, 0, 0, 1, -1, -1, 1, 1};
+static const int   DJ8[8] = {0, 1, -1, 0, -1, 1, -1, 1};
+static const float CD8[8] = {1.f,
+                             1.f,
+                             1.f,
+                             1.f,
+                             M_SQRT2,
+                             M_SQRT2,
+                             M_SQRT2,
+                             M_SQRT2};
+
+// cost of the move from cell (i, j) to its neighbor (p, q) in direction k
+static float edge_cost(const Array &z,
+                       int          i,
+                       int          j,
+                       int          k,
+                       float        elevation_ratio,
+                       float        distance_exponent,
+                       float        upward_penalization,
+                       const Array *p_mask_nogo)
 {
-  // https://math.stackexchange.com/questions/3088292
+  int p = i + DI8[k];
+  int q = j + DJ8[k];
 
-  Vec2<int> shape = z.shape;
+  // elevation difference contribution (weighted for diagonal
+  // directions to avoid artifacts)
+  float dz = (z(i, j) - z(p, q)) * CD8[k];
+  if (dz < 0.f) dz *= upward_penalization;
+  dz = std::abs(dz);
 
-  // neighbors pattern
-  const std::vector<int>   di = {-1, 0, 0, 1, -1, -1, 1, 1};
-  const std::vector<int>   dj = {0, 1, -1, 0, -1, 1, -1, 1};
-  const std::vector<float> cd =
-      {1.f, 1.f, 1.f, 1.f, M_SQRT2, M_SQRT2, M_SQRT2, M_SQRT2};
-  const size_t nb = di.size();
+  float cost = (1.f - elevation_ratio) * std::pow(dz, distance_exponent);
 
-  // working queue and arrays
-  std::vector<int>   queue_i;
-  std::vector<int>   queue_j;
-  std::vector<float> queue_d; // distance
-  queue_i.reserve(shape.x * shape.y);
-  queue_j.reserve(shape.x * shape.y);
-  queue_d.reserve(shape.x * shape.y);
+  // absolute elevation contribution (puts the emphasize on
+  // going downslope rather than upslope)
+  cost += elevation_ratio * std::max(0.f, CD8[k] * (z(p, q) - z(i, j)));
 
-  Mat<float> distance(shape);
-  Mat<int>   mask(shape);
-  Mat<int>   next_idx_i(shape);
-  Mat<int>   next_idx_j(shape);
+  if (p_mask_nogo) cost += 1e5f * (*p_mask_nogo)(p, q);
 
-  // --- Dijkstra's algorithm
+  return cost;
+}
 
-  queue_i.push_back(ij_start.x);
-  queue_j.push_back(ij_start.y);
-  queue_d.push_back(0.f);
-  mask(ij_start.x, ij_start.y) = true;
+// Settle cells from the start cell until every target cell is settled, using
+// an indexed binary heap (decrease-key) for the frontier. With a single target,
+// the search can be guided by an admissible and consistent heuristic (A*).
+// Returns the predecessor (linear index) of each cell, or -1 if not reached.
+static std::vector<int> shortest_path_search(
+    const Array                  &z,
+    Vec2<int>                     ij_start,
+    const std::vector<Vec2<int>> &ij_end_list,
+    float                         elevation_ratio,
+    float                         distance_exponent,
+    float                         upward_penalization,
+    const Array                  *p_mask_nogo,
+    bool                          use_heuristic)
+{
+  // https://math.stackexchange.com/questions/3088292
+
+  const Vec2<int> shape = z.shape;
+  const int       ncells = shape.x * shape.y;
+
+  // working arrays (linear indexing, consistent with Array storage)
+  std::vector<float>   distance(ncells, std::numeric_limits<float>::max());
+  std::vector<int>     predecessor(ncells, -1);
+  std::vector<uint8_t> settled(ncells, 0);
+  std::vector<uint8_t> is_target(ncells, 0);
+
+  size_t ntargets = 0;
+  for (auto &ij : ij_end_list)
+  {
+    int r = z.linear_index(ij.x, ij.y);
+    if (!is_target[r]) ntargets++;
+    is_target[r] = 1;
+  }
 
-  while (queue_i.size() > 0)
+  // A* heuristic, lower bound of the remaining cost to the (single) target
+  // based on the net elevation difference: the cumulated positive elevation
+  // differences along any path are larger than the net one, and for an
+  // exponent <= 1, the sum of the powers is larger than the power of the sum
+  // (subadditivity)
+  const bool  heuristic = use_heuristic && ij_end_list.size() == 1 &&
+                         elevation_ratio >= 0.f && elevation_ratio <= 1.f;
+  const float z_target = heuristic ? z(ij_end_list[0].x, ij_end_list[0].y)
+                                   : 0.f;
+  const float dz_coeff = std::min(1.f, std::abs(upward_penalization));
+  const bool  use_exponent_bound = distance_exponent > 0.f &&
+                                  distance_exponent <= 1.f;
+
+  auto lambda_h = [&](int i, int j)
   {
-    // next cell == min distance value
-    int kmin = std::distance(queue_d.begin(),
-                             std::min_element(queue_d.begin(), queue_d.end()));
+    if (!heuristic) return 0.f;
 
-    int i = queue_i[kmin];
-    int j = queue_j[kmin];
-    mask(i, j) = false;
+    float dz = z_target - z(i, j);
+    float h = elevation_ratio * std::max(0.f, dz);
 
-    queue_i.erase(queue_i.begin() + kmin);
-    queue_j.erase(queue_j.begin() + kmin);
-    queue_d.erase(queue_d.begin() + kmin);
+    if (use_exponent_bound)
+      h += (1.f - elevation_ratio) *
+           std::pow(dz_coeff * std::abs(dz), distance_exponent);
 
-    // loop over neighbors
-    for (size_t k = 0; k < nb; k++)
-    {
-      int p = i + di[k];
-      int q = j + dj[k];
+    return h;
+  };
 
-      if ((p >= 0) and (p < shape.x) and (q >= 0) and (q < shape.y))
-      {
-        // previous cumulative value
-        float dist = distance(i, j);
+  // --- Dijkstra's algorithm (A* if a heuristic is used)
+
+  IndexedMinHeap<float> queue(ncells);
 
-        // elevation difference contribution (weighted for diagonal
-        // directions to avoid artifacts)
-        float dz = (z(i, j) - z(p, q)) * cd[k];
-        if (dz < 0.f) dz *= upward_penalization;
-        dz = std::abs(dz);
+  int r_start = z.linear_index(ij_start.x, ij_start.y);
+  distance[r_start] = 0.f;
+  queue.push_or_decrease(r_start, lambda_h(ij_start.x, ij_start.y));
 
-        dist += (1.f - elevation_ratio) * std::pow(dz, distance_exponent);
+  while (!queue.empty())
+  {
+    float key;
+    int   r = queue.pop(key);
+    int   i = r % shape.x;
+    int   j = r / shape.x;
+
+    settled[r] = 1;
+
+    // early exit once every target is settled
+    if (is_target[r] && --ntargets == 0) break;
 
-        // absolute elevation contribution (puts the emphasize on
-        // going downslope rather than upslope)
-        dist += elevation_ratio * std::max(0.f, cd[k] * (z(p, q) - z(i, j)));
+    // loop over neighbors
+    for (int k = 0; k < 8; k++)
+    {
+      int p = i + DI8[k];
+      int q = j + DJ8[k];
 
-        if (p_mask_nogo) dist += 1e5f * (*p_mask_nogo)(p, q);
+      if ((p < 0) || (p >= shape.x) || (q < 0) || (q >= shape.y)) continue;
 
-        if (distance(p, q) == 0.f)
-          if ((mask(p, q) == 0) or (dist < distance(p, q)))
-          {
-            distance(p, q) = dist;
+      int s = z.linear_index(p, q);
+      if (settled[s]) continue;
 
-            mask(p, q) = true;
-            queue_i.push_back(p);
-            queue_j.push_back(q);
-            queue_d.push_back(dist);
+      float dist = distance[r] + edge_cost(z,
+                                           i,
+                                           j,
+                                           k,
+                                           elevation_ratio,
+                                           distance_exponent,
+                                           upward_penalization,
+                                           p_mask_nogo);
 
-            next_idx_i(p, q) = i;
-            next_idx_j(p, q) = j;
-          }
+      if (dist < distance[s])
+      {
+        distance[s] = dist;
+        predecessor[s] = r;
+        queue.push_or_decrease(s, dist + lambda_h(p, q));
       }
     }
   }
 
-  // --- Build path backwards
+  return predecessor;
+}
 
-  i_path_list.clear();
-  j_path_list.clear();
+// build path backwards, from the end cell to the start cell
+static void backtrack_path(const Array            &z,
+                           const std::vector<int> &predecessor,
+                           Vec2<int>               ij_start,
+                           Vec2<int>               ij_end,
+                           std::vector<int>       &i_path,
+                           std::vector<int>       &j_path)
+{
+  i_path.clear();
+  j_path.clear();
 
-  for (auto ij_end : ij_end_list)
+  int r_start = z.linear_index(ij_start.x, ij_start.y);
+  int r = z.linear_index(ij_end.x, ij_end.y);
+
+  while (r != r_start)
   {
-    int ic = ij_end.x;
-    int jc = ij_end.y;
+    i_path.push_back(r % z.shape.x);
+    j_path.push_back(r / z.shape.x);
 
-    std::vector<int> i_path, j_path;
+    r = predecessor[r];
 
-    while ((ic != ij_start.x) or (jc != ij_start.y))
+    if (r < 0)
     {
-      i_path.push_back(ic);
-      j_path.push_back(jc);
-
-      ic = next_idx_i(ic, jc);
-      jc = next_idx_j(ic, jc);
+      LOG_ERROR("end cell (%d, %d) could not be reached",
+                ij_end.x,
+                ij_end.y);
+      break;
     }
+  }
+
+  i_path.push_back(ij_start.x);
+  j_path.push_back(ij_start.y);
 
-    i_path.push_back(ic);
-    j_path.push_back(jc);
+  std::reverse(i_path.begin(), i_path.end());
+  std::reverse(j_path.begin(), j_path.end());
+}
 
-    std::reverse(i_path.begin(), i_path.end());
-    std::reverse(j_path.begin(), j_path.end());
+void find_path_dijkstra(const Array                   &z,
+                        Vec2<int>                      ij_start,
+                        std::vector<Vec2<int>>         ij_end_list,
+                        std::vector<std::vector<int>> &i_path_list,
+                        std::vector<std::vector<int>> &j_path_list,
+                        float                          elevation_ratio,
+                        float                          distance_exponent,
+                        float                          upward_penalization,
+                        const Array                   *p_mask_nogo)
+{
+  std::vector<int> predecessor = shortest_path_search(z,
+                                                      ij_start,
+                                                      ij_end_list,
+                                                      elevation_ratio,
+                                                      distance_exponent,
+                                                      upward_penalization,
+                                                      p_mask_nogo,
+                                                      false);
+
+  i_path_list.clear();
+  j_path_list.clear();
+
+  for (auto ij_end : ij_end_list)
+  {
+    std::vector<int> i_path, j_path;
+    backtrack_path(z, predecessor, ij_start, ij_end, i_path, j_path);
 
     i_path_list.push_back(i_path);
     j_path_list.push_back(j_path);
@@ -148,21 +249,276 @@ void find_path_dijkstra(const Array      &z,
                         float             upward_penalization,
                         const Array      *p_mask_nogo)
 {
-  std::vector<std::vector<int>> i_path_list = {i_path};
-  std::vector<std::vector<int>> j_path_list = {j_path};
-
-  find_path_dijkstra(z,
-                     ij_start,
-                     {ij_end},
-                     i_path_list,
-                     j_path_list,
-                     elevation_ratio,
-                     distance_exponent,
-                     upward_penalization,
-                     p_mask_nogo);
-
-  i_path = i_path_list[0];
-  j_path = j_path_list[0];
+  // single target, A* search
+  std::vector<int> predecessor = shortest_path_search(z,
+                                                      ij_start,
+                                                      {ij_end},
+                                                      elevation_ratio,
+                                                      distance_exponent,
+                                                      upward_penalization,
+                                                      p_mask_nogo,
+                                                      true);
+
+  backtrack_path(z, predecessor, ij_start, ij_end, i_path, j_path);
+}
+
+//----------------------------------------------------------------------
+// CostField
+//----------------------------------------------------------------------
+
+struct CostField::Search
+{
+  std::vector<float>    distance;
+  std::vector<int>      predecessor;
+  std::vector<uint8_t>  settled;
+  IndexedMinHeap<float> queue;
+  std::mutex            mutex;
+
+  Search(size_t ncells, const std::vector<int> &sources)
+      : distance(ncells, std::numeric_limits<float>::max()),
+        predecessor(ncells, -1),
+        settled(ncells, 0),
+        queue(ncells)
+  {
+    for (int r : sources)
+    {
+      this->distance[r] = 0.f;
+      this->queue.push_or_decrease(r, 0.f);
+    }
+  }
+
+  // resume the search until the target cell is settled (or every cell if the
+  // target is negative)
+  void settle(const Vec2<int>          &shape,
+              const std::vector<float> &costs,
+              int                       r_target)
+  {
+    while (!(r_target >= 0 && this->settled[r_target]) && !this->queue.empty())
+    {
+      float key;
+      int   r = this->queue.pop(key);
+      int   i = r % shape.x;
+      int   j = r / shape.x;
+
+      this->settled[r] = 1;
+
+      for (int k = 0; k < 8; k++)
+      {
+        int p = i + DI8[k];
+        int q = j + DJ8[k];
+
+        if ((p < 0) || (p >= shape.x) || (q < 0) || (q >= shape.y)) continue;
+
+        int s = q * shape.x + p;
+        if (this->settled[s]) continue;
+
+        float dist = this->distance[r] + costs[8 * r + k];
+
+        if (dist < this->distance[s])
+        {
+          this->distance[s] = dist;
+          this->predecessor[s] = r;
+          this->queue.push_or_decrease(s, dist);
+        }
+      }
+    }
+  }
+};
+
+CostField::CostField(const Array &z,
+                     float        elevation_ratio,
+                     float        distance_exponent,
+                     float        upward_penalization,
+                     const Array *p_mask_nogo,
+                     size_t       max_cached_searches)
+    : shape(z.shape), max_cached_searches(max_cached_searches)
+{
+  this->costs.resize(8 * z.size());
+
+  auto lambda_row = [&](size_t j)
+  {
+    for (int i = 0; i < z.shape.x; i++)
+    {
+      int r = z.linear_index(i, (int)j);
+
+      for (int k = 0; k < 8; k++)
+      {
+        int p = i + DI8[k];
+        int q = (int)j + DJ8[k];
+
+        if ((p < 0) || (p >= z.shape.x) || (q < 0) || (q >= z.shape.y))
+          this->costs[8 * r + k] = std::numeric_limits<float>::max();
+        else
+          this->costs[8 * r + k] = edge_cost(z,
+                                             i,
+                                             (int)j,
+                                             k,
+                                             elevation_ratio,
+                                             distance_exponent,
+                                             upward_penalization,
+                                             p_mask_nogo);
+      }
+    }
+  };
+
+  parallel_for(z.shape.y, lambda_row);
+}
+
+CostField::~CostField() = default;
+
+void CostField::clear_cache()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->searches.clear();
+}
+
+bool CostField::find_path(Vec2<int>         ij_start,
+                          Vec2<int>         ij_end,
+                          std::vector<int> &i_path,
+                          std::vector<int> &j_path) const
+{
+  return this->find_path(std::vector<Vec2<int>>{ij_start},
+                         ij_end,
+                         i_path,
+                         j_path);
+}
+
+bool CostField::find_path(const std::vector<Vec2<int>> &ij_sources,
+                          Vec2<int>                     ij_end,
+                          std::vector<int>             &i_path,
+                          std::vector<int>             &j_path) const
+{
+  i_path.clear();
+  j_path.clear();
+
+  std::shared_ptr<Search> search = this->get_search(ij_sources);
+  if (!search) return false;
+
+  if (!this->is_within(ij_end))
+  {
+    LOG_ERROR("end cell (%d, %d) out of bounds", ij_end.x, ij_end.y);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(search->mutex);
+
+  int r = ij_end.y * this->shape.x + ij_end.x;
+  search->settle(this->shape, this->costs, r);
+
+  if (!search->settled[r])
+  {
+    LOG_ERROR("end cell (%d, %d) could not be reached", ij_end.x, ij_end.y);
+    return false;
+  }
+
+  // build path backwards, from the end cell to the source
+  for (; r >= 0; r = search->predecessor[r])
+  {
+    i_path.push_back(r % this->shape.x);
+    j_path.push_back(r / this->shape.x);
+  }
+
+  std::reverse(i_path.begin(), i_path.end());
+  std::reverse(j_path.begin(), j_path.end());
+
+  return true;
+}
+
+float CostField::get_cost(const std::vector<Vec2<int>> &ij_sources,
+                          Vec2<int>                     ij_end) const
+{
+  std::shared_ptr<Search> search = this->get_search(ij_sources);
+  if (!search) return std::numeric_limits<float>::max();
+
+  if (!this->is_within(ij_end))
+  {
+    LOG_ERROR("end cell (%d, %d) out of bounds", ij_end.x, ij_end.y);
+    return std::numeric_limits<float>::max();
+  }
+
+  std::lock_guard<std::mutex> lock(search->mutex);
+
+  int r = ij_end.y * this->shape.x + ij_end.x;
+  search->settle(this->shape, this->costs, r);
+
+  return search->distance[r];
+}
+
+Array CostField::get_cost_map(const std::vector<Vec2<int>> &ij_sources) const
+{
+  std::shared_ptr<Search> search = this->get_search(ij_sources);
+  if (!search)
+    return Array(this->shape, std::numeric_limits<float>::max());
+
+  std::lock_guard<std::mutex> lock(search->mutex);
+
+  search->settle(this->shape, this->costs, -1);
+
+  Array cost_map = Array(this->shape);
+  cost_map.vector = search->distance;
+  return cost_map;
+}
+
+std::shared_ptr<CostField::Search> CostField::get_search(
+    const std::vector<Vec2<int>> &ij_sources) const
+{
+  if (ij_sources.empty())
+  {
+    LOG_ERROR("no source cell");
+    return nullptr;
+  }
+
+  // searches are identified by their (sorted) source cells
+  std::vector<int> sources;
+  for (auto &ij : ij_sources)
+  {
+    if (!this->is_within(ij))
+    {
+      LOG_ERROR("source cell (%d, %d) out of bounds", ij.x, ij.y);
+      return nullptr;
+    }
+    sources.push_back(ij.y * this->shape.x + ij.x);
+  }
+
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+  size_t ncells = (size_t)this->shape.x * this->shape.y;
+
+  if (this->max_cached_searches == 0)
+    return std::make_shared<Search>(ncells, sources);
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  // linear search, the cache only holds a few entries
+  for (auto &cached : this->searches)
+    if (cached.sources == sources)
+    {
+      cached.last_use = ++this->clock;
+      return cached.search;
+    }
+
+  // release the least recently used search (still usable by the threads
+  // currently holding it)
+  if (this->searches.size() >= this->max_cached_searches)
+  {
+    auto it = std::min_element(this->searches.begin(),
+                               this->searches.end(),
+                               [](const CachedSearch &a, const CachedSearch &b)
+                               { return a.last_use < b.last_use; });
+    this->searches.erase(it);
+  }
+
+  auto search = std::make_shared<Search>(ncells, sources);
+  this->searches.push_back({sources, search, ++this->clock});
+
+  return search;
+}
+
+bool CostField::is_within(Vec2<int> ij) const
+{
+  return ij.x >= 0 && ij.x < this->shape.x && ij.y >= 0 &&
+         ij.y < this->shape.y;
 }
 
 } // namespace hmap
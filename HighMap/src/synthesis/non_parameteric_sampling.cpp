@@ -6,6 +6,7 @@
 #include "highmap/array.hpp"
 #include "highmap/kernels.hpp"
 #include "highmap/operator.hpp"
+#include "highmap/thread_pool.hpp"
 
 namespace hmap
 {
@@ -88,6 +89,22 @@ Array non_parametric_sampling(const Array    &array,
 
   // --- synthesis
 
+  // candidate patches (lower-left corners) and patch half-size
+  Vec2<int> ncandidates = Vec2<int>(std::max(0, shape.x - patch_shape.x),
+                                    std::max(0, shape.y - patch_shape.y));
+  int       npx2 = (int)std::floor(0.5f * patch_shape.x);
+  int       npy2 = (int)std::floor(0.5f * patch_shape.y);
+
+  struct Tap
+  {
+    int   offset;
+    float weight;
+    float value;
+  };
+
+  std::vector<Tap>   taps;
+  std::vector<float> ssd_list(ncandidates.x * ncandidates.y);
+
   while (queue.size() > 0)
   {
 
@@ -99,43 +116,50 @@ Array non_parametric_sampling(const Array    &array,
     int i = current.second.first;
     int j = current.second.second;
 
-    // compute "sum of squared difference" for all possible patches
-    std::vector<float> ssd_list = {};
-    std::vector<float> value_list = {};
+    // cells of the patch centered on (i, j) already synthesized (the same
+    // for every candidate patch), stored as offsets with respect to the
+    // candidate patch origin in the input array
+    taps.clear();
+    float dsum = 0.f;
 
-    for (int q = 0; q < shape.y - patch_shape.y; q++)
-      for (int p = 0; p < shape.x - patch_shape.x; p++)
+    for (int s = 0; s < patch_shape.y; s++)
+      for (int r = 0; r < patch_shape.x; r++)
       {
-        Vec4<int> idx = Vec4<int>(p, p + patch_shape.x, q, q + patch_shape.y);
-        Array     patch = array.extract_slice(idx);
+        int ip = i - npx2 + r;
+        int jq = j - npy2 + s;
 
-        // compute SSD
-        int npx2 = (int)std::floor(0.5f * patch_shape.x);
-        int npy2 = (int)std::floor(0.5f * patch_shape.y);
-
-        float ssd_sum = 0.f;
-        float dsum = 0.f;
-
-        for (int s = 0; s < patch_shape.y; s++)
-          for (int r = 0; r < patch_shape.x; r++)
+        if (ip >= 0 && ip < shape.x && jq >= 0 && jq < shape.y)
+          if (is_cell_done(ip, jq) > 0)
           {
-            int ip = i - npx2 + r;
-            int jq = j - npy2 + s;
-
-            if (ip >= 0 && ip < shape.x && jq >= 0 && jq < shape.y)
-              if (is_cell_done(ip, jq) > 0)
-              {
-                float v = patch(r, s) - array_out(ip, jq);
-                ssd_sum += v * v * kernel(r, s);
-                dsum += kernel(r, s);
-              }
+            taps.push_back({array.linear_index(r, s),
+                            kernel(r, s),
+                            array_out(ip, jq)});
+            dsum += kernel(r, s);
           }
+      }
 
-        if (dsum > 0.f) ssd_sum = ssd_sum / dsum;
+    // compute "sum of squared difference" for all possible patches, read
+    // directly from the input array (one row of candidates per task)
+    auto lambda_row = [&](size_t q)
+    {
+      for (int p = 0; p < ncandidates.x; p++)
+      {
+        const float *patch = array.vector.data() +
+                             array.linear_index(p, (int)q);
+        float        ssd_sum = 0.f;
 
-        ssd_list.push_back(ssd_sum);
-        value_list.push_back(patch(npx2, npy2));
+        for (auto &tap : taps)
+        {
+          float v = patch[tap.offset] - tap.value;
+          ssd_sum += v * v * tap.weight;
+        }
+
+        if (dsum > 0.f) ssd_sum = ssd_sum / dsum;
+        ssd_list[q * ncandidates.x + p] = ssd_sum;
       }
+    };
+
+    parallel_for(ncandidates.y, lambda_row);
 
     // pick-up a source patch
     float ssd_best = 0.f;
@@ -149,7 +173,9 @@ Array non_parametric_sampling(const Array    &array,
         short_list.push_back(k);
 
     size_t k = (size_t)(dis(gen) * (short_list.size() - 1));
-    array_out(i, j) = value_list[short_list[k]];
+    int    i_src = (int)short_list[k] % ncandidates.x + npx2;
+    int    j_src = (int)short_list[k] / ncandidates.x + npy2;
+    array_out(i, j) = array(i_src, j_src);
     is_cell_done(i, j) = 1;
 
     // add neighbors
@@ -0,0 +1,255 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+#include "macrologger.h"
+
+#include "highmap/thread_pool.hpp"
+
+namespace hmap
+{
+
+// worker identification (index within the pool, -1 for non-worker threads)
+static thread_local int         tl_worker_id = -1;
+static thread_local ThreadPool *tl_p_pool = nullptr;
+
+ThreadPool &ThreadPool::get_instance()
+{
+  static ThreadPool instance;
+  return instance;
+}
+
+ThreadPool::ThreadPool()
+{
+  this->start(0);
+}
+
+ThreadPool::~ThreadPool()
+{
+  this->stop();
+}
+
+size_t ThreadPool::get_num_threads() const
+{
+  return this->num_threads;
+}
+
+bool ThreadPool::is_worker_thread() const
+{
+  return tl_p_pool == this;
+}
+
+void ThreadPool::parallel_for(size_t                              count,
+                              const std::function<void(size_t)> &fct)
+{
+  if (count == 0) return;
+
+  // nothing to distribute
+  if (count == 1 || this->workers.empty())
+  {
+    for (size_t k = 0; k < count; ++k)
+      fct(k);
+    return;
+  }
+
+  // shared state, helpers may still be queued (and will then do nothing) after
+  // this function returns
+  struct State
+  {
+    std::atomic<size_t>                next = 0;
+    std::atomic<size_t>                done = 0;
+    size_t                             count = 0;
+    const std::function<void(size_t)> *p_fct = nullptr;
+    std::mutex                         mutex;
+    std::condition_variable            cv;
+    std::exception_ptr                 exception = nullptr;
+  };
+
+  auto p_state = std::make_shared<State>();
+  p_state->count = count;
+  p_state->p_fct = &fct;
+
+  auto run = [p_state]()
+  {
+    size_t k;
+    while ((k = p_state->next.fetch_add(1)) < p_state->count)
+    {
+      try
+      {
+        (*p_state->p_fct)(k);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(p_state->mutex);
+        if (!p_state->exception) p_state->exception = std::current_exception();
+      }
+
+      if (p_state->done.fetch_add(1) + 1 == p_state->count)
+      {
+        std::lock_guard<std::mutex> lock(p_state->mutex);
+        p_state->cv.notify_all();
+      }
+    }
+  };
+
+  size_t nhelpers = std::min(count - 1, this->workers.size());
+  for (size_t k = 0; k < nhelpers; ++k)
+    this->push(run);
+
+  // the calling thread takes part in the work and then only waits for the
+  // indices already being processed by the workers
+  run();
+
+  {
+    std::unique_lock<std::mutex> lock(p_state->mutex);
+    p_state->cv.wait(lock,
+                     [&p_state]() { return p_state->done == p_state->count; });
+  }
+
+  if (p_state->exception) std::rethrow_exception(p_state->exception);
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+  // no worker, run in the calling thread
+  if (this->workers.empty())
+  {
+    task();
+    return;
+  }
+
+  size_t iq = this->is_worker_thread()
+                  ? (size_t)tl_worker_id
+                  : this->next_queue.fetch_add(1) % this->queues.size();
+
+  // counted before being visible so that the counter never underflows
+  this->pending.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(this->queues[iq]->mutex);
+    this->queues[iq]->tasks.push_back(std::move(task));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->wake_mutex);
+  }
+  this->wake_cv.notify_one();
+}
+
+void ThreadPool::set_num_threads(size_t new_num_threads)
+{
+  if (this->is_worker_thread())
+  {
+    LOG_ERROR("the number of threads cannot be changed from a pool task");
+    return;
+  }
+
+  this->stop();
+  this->start(new_num_threads);
+}
+
+void ThreadPool::start(size_t new_num_threads)
+{
+  if (new_num_threads == 0)
+    new_num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  this->num_threads = new_num_threads;
+  this->stopping = false;
+
+  // the calling thread is the last "worker"
+  size_t nworkers = new_num_threads - 1;
+
+  this->queues.clear();
+  for (size_t k = 0; k < nworkers; ++k)
+    this->queues.push_back(std::make_unique<WorkerQueue>());
+
+  for (size_t k = 0; k < nworkers; ++k)
+    this->workers.emplace_back(&ThreadPool::worker_loop, this, k);
+}
+
+void ThreadPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->wake_mutex);
+    this->stopping = true;
+  }
+  this->wake_cv.notify_all();
+
+  for (auto &w : this->workers)
+    if (w.joinable()) w.join();
+
+  this->workers.clear();
+}
+
+bool ThreadPool::try_pop(size_t worker_id, std::function<void()> &task)
+{
+  size_t nq = this->queues.size();
+
+  // own queue first (LIFO), then steal from the others (FIFO)
+  for (size_t r = 0; r < nq; ++r)
+  {
+    size_t       iq = (worker_id + r) % nq;
+    WorkerQueue &queue = *this->queues[iq];
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+
+    if (r == 0)
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+
+    this->pending.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
+
+void ThreadPool::worker_loop(size_t worker_id)
+{
+  tl_worker_id = (int)worker_id;
+  tl_p_pool = this;
+
+  while (true)
+  {
+    std::function<void()> task;
+
+    if (this->try_pop(worker_id, task))
+    {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(this->wake_mutex);
+    this->wake_cv.wait(lock,
+                       [this]()
+                       { return this->stopping || this->pending > 0; });
+
+    // pending tasks are completed before leaving
+    if (this->stopping && this->pending == 0) return;
+  }
+}
+
+// --- functions
+
+size_t get_num_threads()
+{
+  return ThreadPool::get_instance().get_num_threads();
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)> &fct)
+{
+  ThreadPool::get_instance().parallel_for(count, fct);
+}
+
+void set_num_threads(size_t num_threads)
+{
+  ThreadPool::get_instance().set_num_threads(num_threads);
+}
+
+} // namespace hmap
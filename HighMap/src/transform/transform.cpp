@@ -1,6 +1,8 @@
 /* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
  * Public License. The full license is in the file LICENSE, distributed with
  * this software. */
+#include <algorithm>
+
 #include "macrologger.h"
 
 #include "highmap/array.hpp"
@@ -114,7 +116,7 @@ Array translate(const Array &array,
                                &dx_array,
                                &dy_array,
                                nullptr,
-                               f.get_delegate());
+                               f);
 
   return array_out;
 }
@@ -123,9 +125,20 @@ Array transpose(const Array &array)
 {
   Array array_out = Array(Vec2<int>(array.shape.y, array.shape.x));
 
-  for (int j = 0; j < array.shape.y; j++)
-    for (int i = 0; i < array.shape.x; i++)
-      array_out(j, i) = array(i, j);
+  // cache-blocked, both the source and the destination blocks fit in
+  // the L1 cache
+  const int nb = 32;
+
+  for (int jb = 0; jb < array.shape.y; jb += nb)
+    for (int ib = 0; ib < array.shape.x; ib += nb)
+    {
+      int j2 = std::min(jb + nb, array.shape.y);
+      int i2 = std::min(ib + nb, array.shape.x);
+
+      for (int j = jb; j < j2; j++)
+        for (int i = ib; i < i2; i++)
+          array_out(j, i) = array(i, j);
+    }
 
   return array_out;
 }
@@ -157,7 +170,7 @@ Array zoom(const Array &array,
                                p_noise_x,
                                p_noise_y,
                                nullptr,
-                               f.get_delegate());
+                               f);
 
   return array_out;
 }
@@ -0,0 +1,38 @@
+#include <vector>
+
+#include "highmap.hpp"
+
+int main(void)
+{
+  hmap::Vec2<int>   shape = {256, 256};
+  hmap::Vec2<float> res = {2.f, 2.f};
+  int               seed = 1;
+
+  hmap::Array z = hmap::noise_fbm(hmap::NoiseType::PERLIN, shape, res, seed);
+  z.to_png("ex_cost_field0.png", hmap::Cmap::TERRAIN, true);
+
+  // move costs computed once for all the queries
+  hmap::CostField cf(z);
+
+  // paths from the same source to several targets, the search is resumed
+  // for each new target
+  hmap::Vec2<int>              ij_start = {40, 40};
+  std::vector<hmap::Vec2<int>> targets = {{230, 230}, {230, 60}, {60, 220}};
+
+  hmap::Array w = hmap::Array(shape);
+
+  for (auto &ij_end : targets)
+  {
+    std::vector<int> i, j;
+    cf.find_path(ij_start, ij_end, i, j);
+
+    for (size_t k = 0; k < i.size(); k++)
+      w(i[k], j[k]) = 1.f;
+  }
+
+  w.to_png("ex_cost_field1.png", hmap::Cmap::GRAY);
+
+  // cumulated cost from two sources
+  hmap::Array cost = cf.get_cost_map({{40, 40}, {200, 128}});
+  cost.to_png("ex_cost_field2.png", hmap::Cmap::INFERNO);
+}
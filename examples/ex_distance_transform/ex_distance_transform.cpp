@@ -1,5 +1,5 @@
 #include "highmap.hpp"
-#include "highmap/dbg/timer.hpp"
+#include "highmap/dbg/profiler.hpp"
 
 int main(void)
 {
@@ -12,20 +12,22 @@ int main(void)
 
   hmap::clamp_min(z, 0.f);
 
-  hmap::Timer::Start("exact");
+  hmap::Profiler::get_instance().begin("exact");
   auto d0 = hmap::distance_transform(z);
-  hmap::Timer::Stop("exact");
+  hmap::Profiler::get_instance().end();
 
-  hmap::Timer::Start("approx.");
+  hmap::Profiler::get_instance().begin("approx.");
   auto d1 = hmap::distance_transform_approx(z);
-  hmap::Timer::Stop("approx.");
+  hmap::Profiler::get_instance().end();
 
-  hmap::Timer::Start("manhattan");
+  hmap::Profiler::get_instance().begin("manhattan");
   auto d2 = hmap::distance_transform_manhattan(z);
-  hmap::Timer::Stop("manhattan");
+  hmap::Profiler::get_instance().end();
 
   z.to_png("ex_distance_transform0.png", hmap::Cmap::VIRIDIS);
   d0.to_png("ex_distance_transform1.png", hmap::Cmap::VIRIDIS);
   d1.to_png("ex_distance_transform2.png", hmap::Cmap::VIRIDIS);
   d2.to_png("ex_distance_transform3.png", hmap::Cmap::VIRIDIS);
+
+  hmap::Profiler::get_instance().dump();
 }
@@ -1,7 +1,7 @@
 #include "highmap.hpp"
 
 #include "highmap/dbg/assert.hpp"
-#include "highmap/dbg/timer.hpp"
+#include "highmap/dbg/profiler.hpp"
 
 #include <iostream>
 
@@ -26,16 +26,16 @@ void compare(F1 fct1, F2 fct2, float tolerance, const std::string &fname)
   hmap::Array z2 = z;
 
   // host
-  hmap::Timer::Start("host");
+  hmap::Profiler::get_instance().begin("host");
   fct1(z1);
-  hmap::Timer::Stop("host");
+  hmap::Profiler::get_instance().end();
 
   z1.to_png_grayscale("out1.png", CV_16U);
 
   // GPU
-  hmap::Timer::Start("GPU");
+  hmap::Profiler::get_instance().begin("GPU");
   fct2(z2);
-  hmap::Timer::Stop("GPU");
+  hmap::Profiler::get_instance().end();
 
   z2.to_png_grayscale("out2.png", CV_16U);
 
@@ -132,4 +132,6 @@ int main(void)
   //         "noise_fbm" + std::to_string(type) + ".png");
   //   }
   // }
+
+  hmap::Profiler::get_instance().dump();
 }
@@ -0,0 +1,64 @@
+import argparse
+import json
+import sys
+
+# Compare highmap_bench results to a baseline and flag the regressions.
+#
+# usage: python3 scripts/compare_bench.py baseline.json current.json
+#                [--threshold 0.1]
+#
+# Benchmarks are matched on (name, size, threads). A benchmark is a
+# regression when its median time is larger than the baseline one by more
+# than the threshold (relative). Exit code is 1 if any regression is found.
+
+
+def load(fname):
+    with open(fname) as f:
+        data = json.load(f)
+    return {(b['name'], b['size'], b['threads']): b
+            for b in data['benchmarks']}
+
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='relative slowdown flagged as a regression')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    print('{:<28} {:>6} {:>7} {:>12} {:>12} {:>9}'.format(
+        'name', 'size', 'threads', 'base [ms]', 'curr [ms]', 'change'))
+
+    regressions = []
+
+    for key in sorted(current.keys()):
+        if key not in baseline:
+            continue
+
+        t_base = baseline[key]['time_median_ms']
+        t_curr = current[key]['time_median_ms']
+        change = (t_curr - t_base) / t_base if t_base > 0 else 0.
+
+        flag = ''
+        if change > args.threshold:
+            flag = '  REGRESSION'
+            regressions.append(key)
+
+        print('{:<28} {:>6} {:>7} {:>12.3f} {:>12.3f} {:>+8.1f}%{}'.format(
+            key[0], key[1], key[2], t_base, t_curr, 100. * change, flag))
+
+    missing = [k for k in baseline.keys() if k not in current]
+    if missing:
+        print('\nnot in current results: {}'.format(len(missing)))
+
+    if regressions:
+        print('\n{} regression(s) above {:.0f}%'.format(
+            len(regressions), 100. * args.threshold))
+        sys.exit(1)
+
+    print('\nno regression')
@@ -0,0 +1,615 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+// Performance suite of the library hot paths.
+//
+// Each case is timed for every requested array size and thread count, after
+// warm-up runs, over several repetitions (the case input is reset before each
+// repetition, outside of the timed region). The median time is used to
+// compute the throughput in Mpixels/s. Results are printed and written to a
+// JSON file that can be compared to a stored baseline with compare_bench.py.
+//
+// Usage: highmap_bench [--sizes 256,1024,4096] [--threads 1,8]
+//                      [--warmup 1] [--repetitions 5] [--filter name]
+//                      [--no-cap] [--full] [--out highmap_bench.json]
+//
+// Heavy cases (erosion, flow accumulation...) are capped to a maximum array
+// size unless --no-cap is given. --full runs every case from 256^2 to 8192^2
+// without any cap (equivalent to --sizes 256,1024,4096,8192 --no-cap, this
+// takes hours for the erosion cases).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "highmap.hpp"
+
+const hmap::Vec2<float> kw = {4.f, 4.f};
+const int               seed = 1;
+
+// timed function and input reset (not timed)
+struct Runner
+{
+  std::function<void()> reset = []() {};
+  std::function<void()> run;
+};
+
+struct BenchCase
+{
+  std::string                             name;
+  int                                     max_size; // largest array side
+  std::function<Runner(hmap::Vec2<int>)> make_runner;
+};
+
+struct BenchResult
+{
+  std::string name;
+  int         size;
+  size_t      threads;
+  int         repetitions;
+  double      time_min; // ms
+  double      time_median;
+  double      time_mean;
+  double      time_stddev;
+  double      mpixels_per_s;
+};
+
+struct Options
+{
+  std::vector<int>    sizes = {256, 1024, 4096};
+  std::vector<size_t> threads = {};
+  int                 warmup = 1;
+  int                 repetitions = 5;
+  std::string         filter = "";
+  bool                no_cap = false;
+  std::string         out = "highmap_bench.json";
+};
+
+// --- helpers
+
+hmap::Array input_array(hmap::Vec2<int> shape)
+{
+  hmap::Array z = hmap::noise_fbm(hmap::NoiseType::PERLIN, shape, kw, seed);
+  hmap::remap(z);
+  return z;
+}
+
+template <typename T> std::vector<T> parse_list(const std::string &str)
+{
+  std::vector<T>    list = {};
+  std::stringstream ss(str);
+  std::string       item;
+
+  while (std::getline(ss, item, ','))
+    if (!item.empty()) list.push_back((T)std::stoll(item));
+
+  return list;
+}
+
+std::string json_escape(const std::string &str)
+{
+  std::string out;
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+// --- benchmark cases
+
+std::vector<BenchCase> bench_cases()
+{
+  std::vector<BenchCase> cases = {};
+
+  // primitives
+
+  cases.push_back({"noise_perlin",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     Runner r;
+                     r.run = [shape]()
+                     { hmap::noise(hmap::NoiseType::PERLIN, shape, kw, seed); };
+                     return r;
+                   }});
+
+  cases.push_back(
+      {"noise_fbm_perlin",
+       8192,
+       [](hmap::Vec2<int> shape)
+       {
+         Runner r;
+         r.run = [shape]()
+         { hmap::noise_fbm(hmap::NoiseType::PERLIN, shape, kw, seed); };
+         return r;
+       }});
+
+  // filters
+
+  cases.push_back({"smooth_cpulse",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z0 = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     auto   z = std::make_shared<hmap::Array>();
+                     Runner r;
+                     r.reset = [z0, z]() { *z = *z0; };
+                     r.run = [z]() { hmap::smooth_cpulse(*z, 16); };
+                     return r;
+                   }});
+
+  cases.push_back({"maximum_local",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     Runner r;
+                     r.run = [z]() { hmap::maximum_local(*z, 8); };
+                     return r;
+                   }});
+
+  cases.push_back({"minimum_local",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     Runner r;
+                     r.run = [z]() { hmap::minimum_local(*z, 8); };
+                     return r;
+                   }});
+
+  cases.push_back({"convolve2d",
+                   1024, // direct convolution, slow
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto z = std::make_shared<hmap::Array>(input_array(shape));
+                     auto kernel = std::make_shared<hmap::Array>(
+                         hmap::cubic_pulse({17, 17}));
+                     Runner r;
+                     r.run = [z, kernel]() { hmap::convolve2d(*z, *kernel); };
+                     return r;
+                   }});
+
+  // hydrology / erosion
+
+  cases.push_back({"flow_accumulation_d8",
+                   4096,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     Runner r;
+                     r.run = [z]() { hmap::flow_accumulation_d8(*z); };
+                     return r;
+                   }});
+
+  cases.push_back({"thermal",
+                   2048,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z0 = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     auto   z = std::make_shared<hmap::Array>();
+                     float  talus = 2.f / (float)shape.x;
+                     Runner r;
+                     r.reset = [z0, z]() { *z = *z0; };
+                     r.run = [z, talus]() { hmap::thermal(*z, talus, 10); };
+                     return r;
+                   }});
+
+  cases.push_back({"hydraulic_particle",
+                   2048,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto z0 = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     auto z = std::make_shared<hmap::Array>();
+                     int  nparticles = shape.x * shape.y / 16;
+                     Runner r;
+                     r.reset = [z0, z]() { *z = *z0; };
+                     r.run = [z, nparticles]()
+                     { hmap::hydraulic_particle(*z, nparticles, seed); };
+                     return r;
+                   }});
+
+  // grid-based schemes, sequential and parallel (checkerboard) schedules
+  for (bool parallel : {false, true})
+  {
+    std::string suffix = parallel ? "_parallel" : "";
+
+    cases.push_back({"hydraulic_benes" + suffix,
+                     2048,
+                     [parallel](hmap::Vec2<int> shape)
+                     {
+                       auto z0 = std::make_shared<hmap::Array>(
+                           input_array(shape));
+                       auto   z = std::make_shared<hmap::Array>();
+                       Runner r;
+                       r.reset = [z0, z]() { *z = *z0; };
+                       r.run = [z, parallel]()
+                       {
+                         hmap::hydraulic_benes(*z,
+                                               10,
+                                               nullptr,
+                                               nullptr,
+                                               nullptr,
+                                               nullptr,
+                                               40.f,
+                                               0.2f,
+                                               0.8f,
+                                               0.005f,
+                                               0.01f,
+                                               0.5f,
+                                               parallel);
+                       };
+                       return r;
+                     }});
+
+    cases.push_back({"hydraulic_musgrave" + suffix,
+                     2048,
+                     [parallel](hmap::Vec2<int> shape)
+                     {
+                       auto z0 = std::make_shared<hmap::Array>(
+                           input_array(shape));
+                       auto   z = std::make_shared<hmap::Array>();
+                       Runner r;
+                       r.reset = [z0, z]() { *z = *z0; };
+                       r.run = [z, parallel]()
+                       {
+                         hmap::hydraulic_musgrave(*z,
+                                                  20,
+                                                  1.f,
+                                                  0.1f,
+                                                  0.1f,
+                                                  0.01f,
+                                                  0.01f,
+                                                  parallel);
+                       };
+                       return r;
+                     }});
+  }
+
+  // morphology / interpolation
+
+  cases.push_back({"distance_transform",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     hmap::Array z = input_array(shape);
+                     hmap::make_binary(z, 0.5f);
+                     auto   zb = std::make_shared<hmap::Array>(z);
+                     Runner r;
+                     r.run = [zb]() { hmap::distance_transform(*zb); };
+                     return r;
+                   }});
+
+  cases.push_back({"resample_to_shape_bicubic",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     hmap::Vec2<int> shape_in = {shape.x / 2, shape.y / 2};
+                     auto            z = std::make_shared<hmap::Array>(
+                         input_array(shape_in));
+                     Runner r;
+                     r.run = [z, shape]()
+                     { z->resample_to_shape_bicubic(shape); };
+                     return r;
+                   }});
+
+  // scattered data interpolation (fixed number of points)
+  for (auto method : {hmap::InterpolationMethod2D::DELAUNAY,
+                      hmap::InterpolationMethod2D::NEAREST})
+  {
+    std::string suffix = method == hmap::InterpolationMethod2D::DELAUNAY
+                             ? "_delaunay"
+                             : "_nearest";
+
+    cases.push_back({"interpolate2d" + suffix,
+                     8192,
+                     [method](hmap::Vec2<int> shape)
+                     {
+                       std::mt19937                          gen(seed);
+                       std::uniform_real_distribution<float> dis(0.f, 1.f);
+
+                       auto x = std::make_shared<std::vector<float>>(10000);
+                       auto y = std::make_shared<std::vector<float>>(10000);
+                       auto v = std::make_shared<std::vector<float>>(10000);
+
+                       for (size_t k = 0; k < x->size(); k++)
+                       {
+                         (*x)[k] = dis(gen);
+                         (*y)[k] = dis(gen);
+                         (*v)[k] = dis(gen);
+                       }
+
+                       Runner r;
+                       r.run = [shape, method, x, y, v]()
+                       { hmap::interpolate2d(shape, *x, *y, *v, method); };
+                       return r;
+                     }});
+  }
+
+  // heightmap
+
+  cases.push_back({"heightmap_transform",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto h = std::make_shared<hmap::Heightmap>(
+                         shape,
+                         hmap::Vec2<int>(4, 4),
+                         0.25f);
+                     Runner r;
+                     r.run = [h]()
+                     {
+                       hmap::transform(
+                           {h.get()},
+                           [](std::vector<hmap::Array *> p_arrays,
+                              hmap::Vec2<int>           shape,
+                              hmap::Vec4<float>         bbox)
+                           {
+                             *p_arrays[0] = hmap::noise(hmap::NoiseType::PERLIN,
+                                                        shape,
+                                                        kw,
+                                                        seed,
+                                                        nullptr,
+                                                        nullptr,
+                                                        nullptr,
+                                                        bbox);
+                           },
+                           hmap::TransformMode::DISTRIBUTED);
+                     };
+                     return r;
+                   }});
+
+  cases.push_back({"heightmap_to_array",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto h = std::make_shared<hmap::Heightmap>(
+                         shape,
+                         hmap::Vec2<int>(4, 4),
+                         0.25f,
+                         1.f);
+                     Runner r;
+                     r.run = [h]() { h->to_array(); };
+                     return r;
+                   }});
+
+  // export
+
+  cases.push_back({"export_raw_16bit",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     auto   fname = (std::filesystem::temp_directory_path() /
+                                   "highmap_bench.raw")
+                                      .string();
+                     Runner r;
+                     r.run = [z, fname]() { hmap::write_raw_16bit(fname, *z); };
+                     return r;
+                   }});
+
+  cases.push_back({"export_png_16bit",
+                   8192,
+                   [](hmap::Vec2<int> shape)
+                   {
+                     auto   z = std::make_shared<hmap::Array>(
+                         input_array(shape));
+                     auto   fname = (std::filesystem::temp_directory_path() /
+                                   "highmap_bench.png")
+                                      .string();
+                     Runner r;
+                     r.run = [z, fname]()
+                     { z->to_png_grayscale(fname, CV_16U); };
+                     return r;
+                   }});
+
+  return cases;
+}
+
+// --- timing
+
+BenchResult run_case(const BenchCase &bench_case,
+                     int              size,
+                     size_t           threads,
+                     const Options   &options)
+{
+  hmap::Vec2<int> shape = {size, size};
+  Runner          runner = bench_case.make_runner(shape);
+
+  for (int k = 0; k < options.warmup; k++)
+  {
+    runner.reset();
+    runner.run();
+  }
+
+  std::vector<double> times = {};
+
+  for (int k = 0; k < options.repetitions; k++)
+  {
+    runner.reset();
+
+    auto t0 = std::chrono::steady_clock::now();
+    runner.run();
+    auto t1 = std::chrono::steady_clock::now();
+
+    times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+  }
+
+  std::sort(times.begin(), times.end());
+
+  size_t n = times.size();
+  double median = n % 2 ? times[n / 2]
+                        : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+  double mean = 0.0;
+  double var = 0.0;
+
+  for (double t : times)
+    mean += t / (double)n;
+  for (double t : times)
+    var += (t - mean) * (t - mean) / (double)n;
+
+  BenchResult result;
+  result.name = bench_case.name;
+  result.size = size;
+  result.threads = threads;
+  result.repetitions = options.repetitions;
+  result.time_min = times.front();
+  result.time_median = median;
+  result.time_mean = mean;
+  result.time_stddev = std::sqrt(var);
+  result.mpixels_per_s = (double)size * (double)size / (median * 1e3);
+
+  return result;
+}
+
+void write_json(const std::string              &fname,
+                const std::vector<BenchResult> &results,
+                const Options                  &options)
+{
+  std::ofstream f(fname);
+
+  std::time_t now = std::time(nullptr);
+  char        date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+  f << "{\n";
+  f << "  \"context\": {\n";
+  f << "    \"date\": \"" << date << "\",\n";
+  f << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency()
+    << ",\n";
+  f << "    \"warmup\": " << options.warmup << ",\n";
+  f << "    \"repetitions\": " << options.repetitions << "\n";
+  f << "  },\n";
+  f << "  \"benchmarks\": [\n";
+
+  for (size_t k = 0; k < results.size(); k++)
+  {
+    const BenchResult &r = results[k];
+
+    f << "    {";
+    f << "\"name\": \"" << json_escape(r.name) << "\", ";
+    f << "\"size\": " << r.size << ", ";
+    f << "\"threads\": " << r.threads << ", ";
+    f << "\"repetitions\": " << r.repetitions << ", ";
+    f << "\"time_min_ms\": " << r.time_min << ", ";
+    f << "\"time_median_ms\": " << r.time_median << ", ";
+    f << "\"time_mean_ms\": " << r.time_mean << ", ";
+    f << "\"time_stddev_ms\": " << r.time_stddev << ", ";
+    f << "\"mpixels_per_s\": " << r.mpixels_per_s;
+    f << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  f << "  ]\n";
+  f << "}\n";
+}
+
+// ---
+
+int main(int argc, char *argv[])
+{
+  Options options;
+
+  for (int k = 1; k < argc; k++)
+  {
+    std::string arg = argv[k];
+    bool        has_value = k + 1 < argc;
+
+    if (arg == "--sizes" && has_value)
+      options.sizes = parse_list<int>(argv[++k]);
+    else if (arg == "--threads" && has_value)
+      options.threads = parse_list<size_t>(argv[++k]);
+    else if (arg == "--warmup" && has_value)
+      options.warmup = std::stoi(argv[++k]);
+    else if (arg == "--repetitions" && has_value)
+      options.repetitions = std::max(1, std::stoi(argv[++k]));
+    else if (arg == "--filter" && has_value)
+      options.filter = argv[++k];
+    else if (arg == "--no-cap")
+      options.no_cap = true;
+    else if (arg == "--full")
+    {
+      options.sizes = {256, 1024, 4096, 8192};
+      options.no_cap = true;
+    }
+    else if (arg == "--out" && has_value)
+      options.out = argv[++k];
+    else
+    {
+      std::cout << "usage: highmap_bench [--sizes 256,1024,4096] "
+                   "[--threads 1,8] [--warmup 1] [--repetitions 5] "
+                   "[--filter name] [--no-cap] [--full] "
+                   "[--out highmap_bench.json]\n";
+      return 1;
+    }
+  }
+
+  // default: single thread and all the hardware threads
+  if (options.threads.empty())
+  {
+    options.threads = {1};
+    size_t nmax = std::max(1u, std::thread::hardware_concurrency());
+    if (nmax > 1) options.threads.push_back(nmax);
+  }
+
+  std::vector<BenchResult> results = {};
+
+  std::printf("%-28s %6s %7s %12s %12s %12s\n",
+              "name",
+              "size",
+              "threads",
+              "median [ms]",
+              "stddev [ms]",
+              "Mpixels/s");
+
+  for (auto &bench_case : bench_cases())
+  {
+    if (bench_case.name.find(options.filter) == std::string::npos) continue;
+
+    for (int size : options.sizes)
+    {
+      if (!options.no_cap && size > bench_case.max_size) continue;
+
+      for (size_t threads : options.threads)
+      {
+        hmap::set_num_threads(threads);
+
+        BenchResult r = run_case(bench_case, size, threads, options);
+        results.push_back(r);
+
+        std::printf("%-28s %6d %7zu %12.3f %12.3f %12.3f\n",
+                    r.name.c_str(),
+                    r.size,
+                    r.threads,
+                    r.time_median,
+                    r.time_stddev,
+                    r.mpixels_per_s);
+        std::fflush(stdout);
+      }
+    }
+  }
+
+  write_json(options.out, results, options);
+  std::cout << "results written to: " << options.out << "\n";
+
+  return 0;
+}
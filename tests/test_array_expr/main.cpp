@@ -0,0 +1,124 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+#include <iostream>
+
+#include "highmap/array.hpp"
+#include "highmap/array_expr.hpp"
+#include "highmap/curvature.hpp"
+#include "highmap/dbg/assert.hpp"
+#include "highmap/math.hpp"
+#include "highmap/primitives.hpp"
+
+// lazy expressions must give the same results as the eager operators, up to
+// rounding: the same operations are performed in the same order but, once
+// fused in a single expression, they may be contracted (FMA) by the compiler
+// (e.g. with -ffast-math or on AArch64)
+#define TOLERANCE 1e-5f
+
+int nok = 0;
+
+void check(const hmap::Array &a_lazy,
+           const hmap::Array &a_eager,
+           const std::string &name)
+{
+  hmap::AssertResults res;
+  hmap::assert_almost_equal(a_lazy, a_eager, TOLERANCE, "", &res);
+  std::cout << "[" << name << "] ";
+  res.print();
+
+  if (!res.ret) nok++;
+}
+
+void check_shape(hmap::Vec2<int> shape)
+{
+  std::string suffix = " " + std::to_string(shape.x) + "x" +
+                       std::to_string(shape.y);
+
+  hmap::Array a = hmap::noise(hmap::NoiseType::PERLIN, shape, {2.f, 4.f}, 1);
+  hmap::Array b = hmap::noise(hmap::NoiseType::PERLIN, shape, {4.f, 2.f}, 2);
+  hmap::Array c = hmap::noise(hmap::NoiseType::PERLIN, shape, {3.f, 3.f}, 3);
+
+  // arithmetic
+  {
+    hmap::Array e = -2.f * (a * b + c * c) / (a * a + b * b + 1.f) - 0.5f;
+    hmap::Array l = -2.f * (hmap::lazy(a) * b + hmap::lazy(c) * c) /
+                        (hmap::lazy(a) * a + hmap::lazy(b) * b + 1.f) -
+                    0.5f;
+    check(l, e, "arithmetic" + suffix);
+  }
+
+  // functions
+  {
+    hmap::Array e = hmap::sqrt(hmap::abs(a - b)) +
+                    hmap::pow(hmap::exp(c), 0.5f);
+    hmap::Array l = hmap::sqrt(hmap::abs(hmap::lazy(a) - b)) +
+                    hmap::pow(hmap::exp(hmap::lazy(c)), 0.5f);
+    check(l, e, "functions" + suffix);
+
+    e = a * (1.f - c) + b * c;
+    l = hmap::lerp(hmap::lazy(a), hmap::lazy(b), hmap::lazy(c));
+    check(l, e, "lerp" + suffix);
+  }
+
+  // self-aliasing
+  {
+    hmap::Array e = a;
+    hmap::Array l = a;
+
+    e = e * b;
+    l = hmap::lazy(l) * b;
+    check(l, e, "self-aliasing" + suffix);
+
+    e = b - e * e;
+    l = b - hmap::lazy(l) * l;
+    check(l, e, "self-aliasing, squared" + suffix);
+
+    e *= a + b;
+    l *= hmap::lazy(a) + b;
+    check(l, e, "compound assignment" + suffix);
+
+    e += e * c;
+    l += hmap::lazy(l) * c;
+    check(l, e, "compound assignment, self-aliasing" + suffix);
+  }
+
+  // assignment to an array with a different shape
+  {
+    hmap::Array e = a * b;
+    hmap::Array l = hmap::Array(hmap::Vec2<int>(3, 5));
+
+    l = hmap::lazy(a) * b;
+    check(l, e, "reshape" + suffix);
+  }
+}
+
+int main(void)
+{
+  // evaluated in the calling thread
+  check_shape({64, 128});
+
+  // evaluated block-wise on the thread pool
+  check_shape({1024, 512});
+
+  // curvature, rewritten using lazy expressions
+  {
+    hmap::Array z = hmap::noise(hmap::NoiseType::PERLIN,
+                                {256, 256},
+                                {2.f, 4.f},
+                                1);
+    hmap::Array p, q, r, s, t;
+    hmap::compute_curvature_gradients(z, p, q, r, s, t);
+
+    hmap::Array e = (r * t - s * s) / hmap::pow(1.f + p * p + q * q, 2.f);
+    check(hmap::compute_curvature_k(p, q, r, s, t), e, "curvature_k");
+  }
+
+  if (nok)
+    std::cout << nok << " check(s) failed\n";
+  else
+    std::cout << "all checks passed\n";
+
+  return nok ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "highmap/array.hpp"
+#include "highmap/array_file.hpp"
+#include "highmap/primitives.hpp"
+
+// round trip of the native array file format: float32 data must be read back
+// exactly, 16-bit data within a quantization step, for the raw and
+// delta-bitpack codecs and tilings not dividing the array shape
+int nok = 0;
+
+void check(bool is_ok, const std::string &name)
+{
+  std::cout << "[" << name << "] " << (is_ok ? "ok" : "NOK") << "\n";
+  if (!is_ok) nok++;
+}
+
+float max_diff(const hmap::Array &a, const hmap::Array &b)
+{
+  if (a.shape != b.shape) return std::numeric_limits<float>::max();
+
+  float d = 0.f;
+  for (size_t k = 0; k < a.vector.size(); k++)
+    d = std::max(d, std::abs(a.vector[k] - b.vector[k]));
+  return d;
+}
+
+void check_round_trip(const hmap::Array   &z,
+                      hmap::Vec2<int>      tiling,
+                      hmap::ArrayFileDtype dtype,
+                      hmap::ArrayFileCodec codec,
+                      const std::string   &fname)
+{
+  std::string name = (dtype == hmap::DTYPE_FLOAT32 ? "float32" : "uint16") +
+                     std::string(codec == hmap::CODEC_RAW ? " raw"
+                                                          : " bitpack") +
+                     " " + std::to_string(z.shape.x) + "x" +
+                     std::to_string(z.shape.y) + " tiling " +
+                     std::to_string(tiling.x) + "x" + std::to_string(tiling.y);
+
+  if (!hmap::write_array_file(fname, z, tiling, dtype, codec))
+  {
+    check(false, name + " write");
+    return;
+  }
+
+  hmap::ArrayFile f(fname);
+  check(f.is_open() && f.get_shape() == z.shape && f.get_tiling() == tiling,
+        name + " header");
+
+  // half a quantization step for 16-bit data, plus the float rounding errors
+  float tolerance = 0.f;
+  if (dtype == hmap::DTYPE_UINT16) tolerance = (z.max() - z.min()) / 65535.f;
+
+  check(max_diff(f.read(), z) <= tolerance, name + " read");
+
+  // every tile, compared to the corresponding sub-array
+  bool is_ok = true;
+
+  for (int jt = 0; jt < tiling.y; jt++)
+    for (int it = 0; it < tiling.x; it++)
+    {
+      hmap::Vec4<int> ext = f.get_tile_extent(it, jt);
+      hmap::Array     tile = f.read_tile(it, jt);
+      hmap::Array     ref = z.extract_slice(ext);
+
+      is_ok &= max_diff(tile, ref) <= tolerance;
+
+      if (dtype == hmap::DTYPE_FLOAT32 && codec == hmap::CODEC_RAW)
+        is_ok &= max_diff(f.view_tile(it, jt).to_array(), ref) == 0.f;
+    }
+
+  check(is_ok, name + " tiles");
+
+  // out of range tiles
+  check(f.read_tile(tiling.x, 0).size() == 0 &&
+            f.read_tile(0, -1).size() == 0 &&
+            f.view_tile(-1, tiling.y).data == nullptr,
+        name + " out of range tiles");
+}
+
+int main(void)
+{
+  std::string fname = (std::filesystem::temp_directory_path() /
+                       "test_array_file.hma")
+                          .string();
+
+  for (hmap::Vec2<int> shape : {hmap::Vec2<int>(256, 256),
+                                hmap::Vec2<int>(250, 133)})
+  {
+    hmap::Array z = hmap::noise_fbm(hmap::NoiseType::PERLIN,
+                                    shape,
+                                    {4.f, 4.f},
+                                    1);
+
+    for (hmap::Vec2<int> tiling : {hmap::Vec2<int>(1, 1),
+                                   hmap::Vec2<int>(4, 4),
+                                   hmap::Vec2<int>(3, 7)})
+    {
+      check_round_trip(z,
+                       tiling,
+                       hmap::DTYPE_FLOAT32,
+                       hmap::CODEC_RAW,
+                       fname);
+      check_round_trip(z, tiling, hmap::DTYPE_UINT16, hmap::CODEC_RAW, fname);
+      check_round_trip(z,
+                       tiling,
+                       hmap::DTYPE_UINT16,
+                       hmap::CODEC_DELTA_BITPACK,
+                       fname);
+    }
+  }
+
+  // corrupted tile table (tile size overflowing the offset)
+  {
+    hmap::Array z = hmap::noise(hmap::NoiseType::PERLIN,
+                                {64, 64},
+                                {4.f, 4.f},
+                                1);
+    hmap::write_array_file(fname, z, {2, 2});
+
+    std::fstream fs(fname, std::ios::in | std::ios::out | std::ios::binary);
+    uint64_t     size = std::numeric_limits<uint64_t>::max();
+    fs.seekp(64 + 8); // first tile entry, size field
+    fs.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    fs.close();
+
+    hmap::ArrayFile f(fname);
+    check(!f.is_open() && f.read().size() == 0, "corrupted tile table");
+  }
+
+  std::filesystem::remove(fname);
+
+  if (nok)
+    std::cout << nok << " check(s) failed\n";
+  else
+    std::cout << "all checks passed\n";
+
+  return nok ? 1 : 0;
+}
@@ -7,7 +7,7 @@
 
 #include "highmap.hpp"
 #include "highmap/dbg/assert.hpp"
-#include "highmap/dbg/timer.hpp"
+#include "highmap/dbg/profiler.hpp"
 
 // const hmap::Vec2<int>   shape = {2048, 2048};
 // const hmap::Vec2<int> shape = {1024, 1024};
@@ -26,25 +26,27 @@ void compare(F1 fct1, F2 fct2, float tolerance, const std::string &name)
   hmap::Array z2 = z;
 
   // host
-  hmap::Timer::Start(name + " - host");
-  fct1(z1);
-  hmap::Timer::Stop(name + " - host");
+  {
+    hmap::ProfileZone zone(name + " - host");
+    fct1(z1);
+  }
 
   // GPU
-  hmap::Timer::Start(name + " - GPU");
-  fct2(z2);
-  hmap::Timer::Stop(name + " - GPU");
+  {
+    hmap::ProfileZone zone(name + " - GPU");
+    fct2(z2);
+  }
 
-  // retrieve timer data
-  auto records = hmap::Timer::get_instance().get_records();
+  // retrieve profiler data
+  auto stats = hmap::Profiler::get_instance().get_stats();
 
   hmap::AssertResults res;
   hmap::assert_almost_equal(z1, z2, tolerance, "diff_" + name + ".png", &res);
   res.msg += "[" + name + "]";
   res.print();
 
-  float dt_host = records[name + " - host"]->total;
-  float dt_gpu = records[name + " - GPU"]->total;
+  float dt_host = (float)stats[name + " - host"].total;
+  float dt_gpu = (float)stats[name + " - GPU"].total;
 
   f << name << ";";
   f << dt_host / dt_gpu << ";";
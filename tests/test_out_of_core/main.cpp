@@ -0,0 +1,123 @@
+/* Copyright (c) 2023 Otto Link. Distributed under the terms of the GNU General
+ * Public License. The full license is in the file LICENSE, distributed with
+ * this software. */
+
+#include <iostream>
+
+#include "highmap/dbg/assert.hpp"
+#include "highmap/erosion.hpp"
+#include "highmap/heightmap.hpp"
+#include "highmap/primitives.hpp"
+#include "highmap/tile_cache.hpp"
+
+// out-of-core heightmaps (tiles paged to a scratch file) must give exactly the
+// same results as in-core heightmaps, with a memory budget smaller than a
+// single heightmap
+int nok = 0;
+
+void check(hmap::Heightmap   &h_ooc,
+           hmap::Heightmap   &h_ref,
+           const std::string &name)
+{
+  hmap::AssertResults res;
+  hmap::assert_almost_equal(h_ooc.to_array(), h_ref.to_array(), 0.f, "", &res);
+  std::cout << "[" << name << "] ";
+  res.print();
+
+  if (!res.ret) nok++;
+}
+
+void check_budget(const hmap::TileCache &cache, const std::string &name)
+{
+  bool is_ok = cache.get_memory_usage() <= cache.get_memory_budget();
+  std::cout << "[" << name << "] memory usage: " << cache.get_memory_usage()
+            << " / " << cache.get_memory_budget() << " bytes"
+            << (is_ok ? "" : " (over budget)") << "\n";
+
+  if (!is_ok) nok++;
+}
+
+int main(void)
+{
+  hmap::Vec2<int> shape = {512, 512};
+  hmap::Vec2<int> tiling = {4, 4};
+  float           overlap = 0.25f;
+
+  auto lambda_fill = [](std::vector<hmap::Array *> p_arrays,
+                        hmap::Vec2<int>            shape,
+                        hmap::Vec4<float>          bbox)
+  {
+    *p_arrays[0] = hmap::noise_fbm(hmap::NoiseType::PERLIN,
+                                   shape,
+                                   {4.f, 4.f},
+                                   1,
+                                   8,
+                                   0.7f,
+                                   0.5f,
+                                   2.f,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr,
+                                   bbox);
+  };
+
+  auto lambda_product = [](std::vector<hmap::Array *> p_arrays)
+  { *p_arrays[1] = (*p_arrays[0]) * (*p_arrays[0]); };
+
+  // in-core references
+  hmap::Heightmap h_ref(shape, tiling, overlap);
+  hmap::Heightmap h2_ref(shape, tiling, overlap);
+
+  // out-of-core heightmaps sharing a quarter of a heightmap memory budget
+  // (tiles with their overlap buffers)
+  size_t tile_bytes = sizeof(float) * h_ref.tiles[0].size();
+  auto   cache = std::make_shared<hmap::TileCache>(h_ref.get_ntiles() *
+                                                     tile_bytes / 4);
+
+  hmap::Heightmap h;
+  hmap::Heightmap h2;
+  h.enable_out_of_core(cache);
+  h2.enable_out_of_core(cache);
+  h.set_sto(shape, tiling, overlap);
+  h2.set_sto(shape, tiling, overlap);
+
+  // fill, distributed over the thread pool
+  hmap::transform({&h_ref}, lambda_fill);
+  hmap::transform({&h}, lambda_fill);
+  check(h, h_ref, "fill");
+  check_budget(*cache, "fill");
+
+  // two heightmaps, sequential
+  hmap::transform({&h_ref, &h2_ref},
+                  lambda_product,
+                  hmap::TransformMode::SEQUENTIAL);
+  hmap::transform({&h, &h2}, lambda_product, hmap::TransformMode::SEQUENTIAL);
+  check(h2, h2_ref, "transform sequential");
+  check_budget(*cache, "transform sequential");
+
+  // serial loops over the tiles
+  h_ref.smooth_overlap_buffers();
+  h.smooth_overlap_buffers();
+  h_ref.remap(-1.f, 2.f);
+  h.remap(-1.f, 2.f);
+  check(h, h_ref, "smooth_overlap_buffers / remap");
+  check_budget(*cache, "smooth_overlap_buffers / remap");
+
+  // tiled depression filling
+  hmap::depression_filling(h_ref);
+  hmap::depression_filling(h);
+  check(h, h_ref, "depression_filling");
+  check_budget(*cache, "depression_filling");
+
+  // back in core
+  h.disable_out_of_core();
+  check(h, h_ref, "disable_out_of_core");
+
+  if (nok)
+    std::cout << nok << " check(s) failed\n";
+  else
+    std::cout << "all checks passed\n";
+
+  return nok ? 1 : 0;
+}